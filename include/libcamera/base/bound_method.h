@@ -7,7 +7,8 @@
 
 #pragma once
 
-#include <memory>
+#include <cstddef>
+#include <new>
 #include <tuple>
 #include <type_traits>
 #include <utility>
@@ -23,10 +24,27 @@ enum ConnectionType {
 	ConnectionTypeBlocking,
 };
 
+namespace details {
+
+template<typename Base, typename T>
+Base *moveTo(T &&obj, void *mem, std::size_t size)
+{
+	using Type = std::remove_reference_t<T>;
+
+	if (sizeof(Type) <= size && alignof(Type) <= alignof(std::max_align_t))
+		return new (mem) Type(std::move(obj));
+	else
+		return new Type(std::move(obj));
+}
+
+} /* namespace details */
+
 class BoundMethodPackBase
 {
 public:
 	virtual ~BoundMethodPackBase() = default;
+
+	virtual BoundMethodPackBase *moveTo(void *mem, std::size_t size) = 0;
 };
 
 template<typename R, typename... Args>
@@ -38,6 +56,11 @@ public:
 	{
 	}
 
+	BoundMethodPackBase *moveTo(void *mem, std::size_t size) override
+	{
+		return details::moveTo<BoundMethodPackBase>(std::move(*this), mem, size);
+	}
+
 	R returnValue()
 	{
 		return ret_;
@@ -56,6 +79,11 @@ public:
 	{
 	}
 
+	BoundMethodPackBase *moveTo(void *mem, std::size_t size) override
+	{
+		return details::moveTo<BoundMethodPackBase>(std::move(*this), mem, size);
+	}
+
 	void returnValue()
 	{
 	}
@@ -79,10 +107,10 @@ public:
 	Object *object() const { return object_; }
 
 	virtual void invokePack(BoundMethodPackBase *pack) = 0;
+	virtual BoundMethodBase *moveTo(void *mem, std::size_t size) = 0;
 
 protected:
-	bool activatePack(std::shared_ptr<BoundMethodPackBase> pack,
-			  bool deleteMethod);
+	bool activatePack(BoundMethodPackBase *pack, bool temporary);
 
 	void *obj_;
 	Object *object_;
@@ -124,7 +152,7 @@ public:
 		invokePack(pack, std::make_index_sequence<sizeof...(Args)>{});
 	}
 
-	virtual R activate(Args... args, bool deleteMethod = false) = 0;
+	virtual R activate(Args... args, bool temporary = false) = 0;
 	virtual R invoke(Args... args) = 0;
 };
 
@@ -140,14 +168,14 @@ public:
 	{
 	}
 
-	R activate(Args... args, bool deleteMethod = false) override
+	R activate(Args... args, bool temporary = false) override
 	{
 		if (!this->object_)
 			return func_(args...);
 
-		auto pack = std::make_shared<PackType>(args...);
-		bool sync = BoundMethodBase::activatePack(pack, deleteMethod);
-		return sync ? pack->returnValue() : R();
+		PackType pack(args...);
+		bool sync = BoundMethodBase::activatePack(&pack, temporary);
+		return sync ? pack.returnValue() : R();
 	}
 
 	R invoke(Args... args) override
@@ -155,6 +183,11 @@ public:
 		return func_(args...);
 	}
 
+	BoundMethodBase *moveTo(void *mem, std::size_t size) override
+	{
+		return details::moveTo<BoundMethodBase>(std::move(*this), mem, size);
+	}
+
 private:
 	Func func_;
 };
@@ -173,16 +206,16 @@ public:
 
 	bool match(R (T::*func)(Args...)) const { return func == func_; }
 
-	R activate(Args... args, bool deleteMethod = false) override
+	R activate(Args... args, bool temporary = false) override
 	{
 		if (!this->object_) {
 			T *obj = static_cast<T *>(this->obj_);
 			return (obj->*func_)(args...);
 		}
 
-		auto pack = std::make_shared<PackType>(args...);
-		bool sync = BoundMethodBase::activatePack(pack, deleteMethod);
-		return sync ? pack->returnValue() : R();
+		PackType pack(args...);
+		bool sync = BoundMethodBase::activatePack(&pack, temporary);
+		return sync ? pack.returnValue() : R();
 	}
 
 	R invoke(Args... args) override
@@ -191,6 +224,11 @@ public:
 		return (obj->*func_)(args...);
 	}
 
+	BoundMethodBase *moveTo(void *mem, std::size_t size) override
+	{
+		return details::moveTo<BoundMethodBase>(std::move(*this), mem, size);
+	}
+
 private:
 	R (T::*func_)(Args...);
 };
@@ -207,7 +245,7 @@ public:
 
 	bool match(R (*func)(Args...)) const { return func == func_; }
 
-	R activate(Args... args, [[maybe_unused]] bool deleteMethod = false) override
+	R activate(Args... args, [[maybe_unused]] bool temporary = false) override
 	{
 		return (*func_)(args...);
 	}
@@ -217,6 +255,11 @@ public:
 		return R();
 	}
 
+	BoundMethodBase *moveTo(void *mem, std::size_t size) override
+	{
+		return details::moveTo<BoundMethodBase>(std::move(*this), mem, size);
+	}
+
 private:
 	R (*func_)(Args...);
 };
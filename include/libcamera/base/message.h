@@ -8,6 +8,7 @@
 #pragma once
 
 #include <atomic>
+#include <cstddef>
 
 #include <libcamera/base/bound_method.h>
 
@@ -49,10 +50,8 @@ private:
 class InvokeMessage : public Message
 {
 public:
-	InvokeMessage(BoundMethodBase *method,
-		      std::shared_ptr<BoundMethodPackBase> pack,
-		      Semaphore *semaphore = nullptr,
-		      bool deleteMethod = false);
+	InvokeMessage(BoundMethodBase *method, BoundMethodPackBase *pack,
+		      Semaphore *semaphore = nullptr, bool temporary = false);
 	~InvokeMessage();
 
 	Semaphore *semaphore() const { return semaphore_; }
@@ -60,10 +59,23 @@ public:
 	void invoke();
 
 private:
+	friend class Thread;
+
+	void assign(BoundMethodBase *method, BoundMethodPackBase *pack,
+		    Semaphore *semaphore, bool temporary);
+	void release();
+
 	BoundMethodBase *method_;
-	std::shared_ptr<BoundMethodPackBase> pack_;
+	BoundMethodPackBase *pack_;
 	Semaphore *semaphore_;
-	bool deleteMethod_;
+	bool ownsMethod_;
+	bool ownsPack_;
+
+	static constexpr std::size_t kMethodStorageSize = 64;
+	static constexpr std::size_t kPackStorageSize = 192;
+
+	alignas(std::max_align_t) unsigned char methodStorage_[kMethodStorageSize];
+	alignas(std::max_align_t) unsigned char packStorage_[kPackStorageSize];
 };
 
 } /* namespace libcamera */
@@ -37,8 +37,8 @@ public:
 		       Args&&... args)
 	{
 		T *obj = static_cast<T *>(this);
-		auto *method = new BoundMethodMember<T, R, FuncArgs...>(obj, this, func, type);
-		return method->activate(args..., true);
+		BoundMethodMember<T, R, FuncArgs...> method(obj, this, func, type);
+		return method.activate(args..., true);
 	}
 
 	Thread *thread() const { return thread_; }
@@ -7,8 +7,8 @@
 
 #pragma once
 
+#include <atomic>
 #include <functional>
-#include <list>
 #include <type_traits>
 #include <vector>
 
@@ -23,15 +23,58 @@ public:
 	void disconnect(Object *object);
 
 protected:
-	using SlotList = std::list<BoundMethodBase *>;
+	using SlotList = std::vector<BoundMethodBase *>;
+
+	struct State {
+		State()
+			: slots(nullptr), refs(1), pending(false), orphaned(false)
+		{
+		}
+
+		std::atomic<const SlotList *> slots;
+		std::atomic<unsigned int> refs;
+		std::atomic<bool> pending;
+
+		/* Protected by the signals lock. */
+		bool orphaned;
+		std::vector<const SlotList *> retiredLists;
+		std::vector<BoundMethodBase *> retiredSlots;
+	};
+
+	SignalBase();
+	~SignalBase();
 
 	void connect(BoundMethodBase *slot);
-	void disconnect(std::function<bool(SlotList::iterator &)> match);
+	void disconnect(std::function<bool(BoundMethodBase *)> match);
+
+	State *state() const { return state_; }
+
+	static const SlotList *acquireSlots(State *state)
+	{
+		state->refs.fetch_add(1);
+		return state->slots.load();
+	}
 
-	SlotList slots();
+	static void releaseSlots(State *state)
+	{
+		/* Reclaim retired slots when completing the last emission. */
+		if (state->pending.load() && state->refs.load() <= 2) {
+			releaseSlotsAndReclaim(state);
+			return;
+		}
+
+		if (state->refs.fetch_sub(1) == 1)
+			destroy(state);
+	}
 
 private:
-	SlotList slots_;
+	static void releaseSlotsAndReclaim(State *state);
+	static void reclaim(State *state);
+	static void destroy(State *state);
+
+	void publish(SlotList *slots, std::vector<BoundMethodBase *> removed);
+
+	State *state_;
 };
 
 template<typename... Args>
@@ -88,7 +131,7 @@ public:
 
 	void disconnect()
 	{
-		SignalBase::disconnect([]([[maybe_unused]] SlotList::iterator &iter) {
+		SignalBase::disconnect([]([[maybe_unused]] BoundMethodBase *slot) {
 			return true;
 		});
 	}
@@ -96,17 +139,17 @@ public:
 	template<typename T>
 	void disconnect(T *obj)
 	{
-		SignalBase::disconnect([obj](SlotList::iterator &iter) {
-			return (*iter)->match(obj);
+		SignalBase::disconnect([obj](BoundMethodBase *slot) {
+			return slot->match(obj);
 		});
 	}
 
 	template<typename T, typename R>
 	void disconnect(T *obj, R (T::*func)(Args...))
 	{
-		SignalBase::disconnect([obj, func](SlotList::iterator &iter) {
+		SignalBase::disconnect([obj, func](BoundMethodBase *base) {
 			BoundMethodArgs<R, Args...> *slot =
-				static_cast<BoundMethodArgs<R, Args...> *>(*iter);
+				static_cast<BoundMethodArgs<R, Args...> *>(base);
 
 			if (!slot->match(obj))
 				return false;
@@ -124,9 +167,9 @@ public:
 	template<typename R>
 	void disconnect(R (*func)(Args...))
 	{
-		SignalBase::disconnect([func](SlotList::iterator &iter) {
+		SignalBase::disconnect([func](BoundMethodBase *base) {
 			BoundMethodArgs<R, Args...> *slot =
-				static_cast<BoundMethodArgs<R, Args...> *>(*iter);
+				static_cast<BoundMethodArgs<R, Args...> *>(base);
 
 			if (!slot->match(nullptr))
 				return false;
@@ -138,11 +181,19 @@ public:
 	void emit(Args... args)
 	{
 		/*
-		 * Make a copy of the slots list as the slot could call the
-		 * disconnect operation, invalidating the iterator.
+		 * The slots list is immutable and stays valid until the
+		 * emission completes, even if a slot calls the connect or
+		 * disconnect operations, or destroys the signal. The signal
+		 * shall thus not be accessed after calling the slots, only the
+		 * state it references.
 		 */
-		for (BoundMethodBase *slot : slots())
-			static_cast<BoundMethodArgs<void, Args...> *>(slot)->activate(args...);
+		State *state = this->state();
+		const SlotList *slots = acquireSlots(state);
+		if (slots) {
+			for (BoundMethodBase *slot : *slots)
+				static_cast<BoundMethodArgs<void, Args...> *>(slot)->activate(args...);
+		}
+		releaseSlots(state);
 	}
 };
 
@@ -19,9 +19,13 @@
 
 namespace libcamera {
 
+class BoundMethodBase;
+class BoundMethodPackBase;
 class EventDispatcher;
+class InvokeMessage;
 class Message;
 class Object;
+class Semaphore;
 class ThreadData;
 class ThreadMain;
 
@@ -57,6 +61,11 @@ private:
 	void postMessage(std::unique_ptr<Message> msg, Object *receiver);
 	void removeMessages(Object *receiver);
 
+	std::unique_ptr<InvokeMessage>
+	createInvokeMessage(BoundMethodBase *method, BoundMethodPackBase *pack,
+			    Semaphore *semaphore, bool temporary);
+
+	friend class BoundMethodBase;
 	friend class Object;
 	friend class ThreadData;
 	friend class ThreadMain;
@@ -38,11 +38,17 @@ protected:
 	void message(Message *msg) override;
 
 private:
+	friend class TimerWheel;
+
 	void registerTimer();
 	void unregisterTimer();
 
 	bool running_;
 	std::chrono::steady_clock::time_point deadline_;
+
+	Timer *prev_;
+	Timer *next_;
+	unsigned int slot_;
 };
 
 } /* namespace libcamera */
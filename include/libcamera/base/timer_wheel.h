@@ -0,0 +1,57 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * timer_wheel.h - Hierarchical timer wheel
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <libcamera/base/private.h>
+
+#include <libcamera/base/class.h>
+#include <libcamera/base/utils.h>
+
+namespace libcamera {
+
+class Timer;
+
+class TimerWheel
+{
+public:
+	TimerWheel();
+
+	void insert(Timer *timer);
+	void remove(Timer *timer);
+
+	Timer *first() const;
+	Timer *expired(utils::time_point now);
+
+private:
+	LIBCAMERA_DISABLE_COPY_AND_MOVE(TimerWheel)
+
+	static constexpr unsigned int kTickShift = 20;
+	static constexpr unsigned int kSlotBits = 6;
+	static constexpr unsigned int kSlots = 1 << kSlotBits;
+	static constexpr unsigned int kLevels = 6;
+
+	struct Slot {
+		Timer *head;
+		Timer *tail;
+	};
+
+	static uint64_t tick(utils::time_point time);
+
+	void link(Timer *timer);
+	bool lowestSlot(unsigned int *level, unsigned int *index) const;
+	uint64_t slotTick(unsigned int level, unsigned int index) const;
+	Timer *earliest(unsigned int level, unsigned int index) const;
+
+	uint64_t current_;
+	uint64_t occupied_[kLevels];
+	Slot slots_[kLevels][kSlots];
+};
+
+} /* namespace libcamera */
@@ -7,17 +7,25 @@
 
 #pragma once
 
+#include <chrono>
+#include <functional>
+#include <map>
 #include <memory>
+#include <optional>
 #include <set>
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 #include <libcamera/base/class.h>
 #include <libcamera/base/flags.h>
 #include <libcamera/base/object.h>
 #include <libcamera/base/signal.h>
+#include <libcamera/base/span.h>
 
+#include <libcamera/completion_queue.h>
 #include <libcamera/controls.h>
+#include <libcamera/geometry.h>
 #include <libcamera/request.h>
 #include <libcamera/stream.h>
 #include <libcamera/transform.h>
@@ -29,6 +37,13 @@ class FrameBufferAllocator;
 class PipelineHandler;
 class Request;
 
+struct SensorConfiguration {
+	unsigned int bitDepth = 0;
+	Size outputSize;
+
+	bool isValid() const;
+};
+
 class CameraConfiguration
 {
 public:
@@ -66,6 +81,7 @@ public:
 	std::size_t size() const;
 
 	Transform transform;
+	std::optional<SensorConfiguration> sensorConfig;
 
 protected:
 	CameraConfiguration();
@@ -82,6 +98,26 @@ protected:
 	std::vector<StreamConfiguration> config_;
 };
 
+struct StreamStatistics {
+	uint64_t framesDelivered;
+	uint64_t framesDropped;
+	uint64_t framesCancelled;
+	uint64_t underruns;
+	uint64_t framesAbsorbed;
+
+	std::chrono::nanoseconds minFrameInterval;
+	std::chrono::nanoseconds avgFrameInterval;
+	std::chrono::nanoseconds maxFrameInterval;
+	std::chrono::nanoseconds p99FrameInterval;
+};
+
+struct CameraStatistics {
+	uint64_t requestsCompleted;
+	uint64_t requestsCancelled;
+
+	std::map<const Stream *, StreamStatistics> streams;
+};
+
 class Camera final : public Object, public std::enable_shared_from_this<Camera>,
 		     public Extensible
 {
@@ -106,14 +142,24 @@ public:
 
 	const std::set<Stream *> &streams() const;
 	std::unique_ptr<CameraConfiguration> generateConfiguration(const StreamRoles &roles = {});
+	std::vector<CameraConfiguration::Status>
+	validateConfigurations(StreamRole role,
+			       std::vector<StreamConfiguration> &candidates);
 	int configure(CameraConfiguration *config);
+	int reconfigure(CameraConfiguration *config);
 
 	std::unique_ptr<Request> createRequest(uint64_t cookie = 0);
 	int queueRequest(Request *request);
+	int queueRequests(Span<Request *const> requests);
+
+	using CompletionHandler = std::function<bool(const RequestCompletion &)>;
+	int setCompletionHandler(CompletionHandler handler);
 
 	int start(const ControlList *controls = nullptr);
 	int stop();
 
+	CameraStatistics statistics() const;
+
 private:
 	LIBCAMERA_DISABLE_COPY(Camera)
 
@@ -0,0 +1,52 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * completion_queue.h - Lock-free request completion queue
+ */
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <vector>
+
+#include <libcamera/base/class.h>
+#include <libcamera/base/unique_fd.h>
+
+#include <libcamera/request.h>
+
+namespace libcamera {
+
+struct RequestCompletion {
+	Request *request;
+	uint64_t cookie;
+	Request::Status status;
+	uint32_t sequence;
+	uint64_t timestamp;
+};
+
+class RequestCompletionQueue
+{
+public:
+	RequestCompletionQueue(unsigned int size);
+
+	bool isValid() const { return eventfd_.isValid(); }
+	const UniqueFD &fd() const { return eventfd_; }
+
+	bool push(const RequestCompletion &completion);
+	bool pop(RequestCompletion *completion);
+
+private:
+	LIBCAMERA_DISABLE_COPY_AND_MOVE(RequestCompletionQueue)
+
+	UniqueFD eventfd_;
+
+	std::vector<RequestCompletion> slots_;
+	unsigned int mask_;
+
+	alignas(64) std::atomic<unsigned int> head_;
+	alignas(64) std::atomic<unsigned int> tail_;
+};
+
+} /* namespace libcamera */
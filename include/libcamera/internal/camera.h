@@ -20,6 +20,7 @@
 namespace libcamera {
 
 class CameraControlValidator;
+class CameraTelemetry;
 class PipelineHandler;
 class Stream;
 
@@ -40,6 +41,7 @@ public:
 	uint32_t requestSequence_;
 
 	const CameraControlValidator *validator() const { return validator_.get(); }
+	CameraTelemetry *telemetry() const { return telemetry_.get(); }
 
 private:
 	enum State {
@@ -56,6 +58,7 @@ private:
 	int isAccessAllowed(State low, State high,
 			    bool allowDisconnected = false,
 			    const char *from = __builtin_FUNCTION()) const;
+	int validateRequest(const Request *request) const;
 
 	void disconnect();
 	void setState(State state);
@@ -69,6 +72,9 @@ private:
 	std::atomic<State> state_;
 
 	std::unique_ptr<CameraControlValidator> validator_;
+	std::unique_ptr<CameraTelemetry> telemetry_;
+
+	CompletionHandler completionHandler_;
 };
 
 } /* namespace libcamera */
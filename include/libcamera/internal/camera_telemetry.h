@@ -0,0 +1,74 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * camera_telemetry.h - Camera frame delivery telemetry
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdint.h>
+
+#include <libcamera/base/class.h>
+
+#include <libcamera/camera.h>
+
+namespace libcamera {
+
+class Request;
+class Stream;
+
+class CameraTelemetry
+{
+public:
+	static constexpr unsigned int kIntervalShift = 10;
+	static constexpr unsigned int kIntervalSubBucketBits = 4;
+	static constexpr unsigned int kIntervalBuckets = 352;
+
+	CameraTelemetry(const std::set<Stream *> &streams);
+	~CameraTelemetry();
+
+	void reset();
+	void requestCompleted(const Request *request, bool lastQueued);
+	void frameAbsorbed(const Stream *stream);
+
+	CameraStatistics statistics() const;
+
+private:
+	LIBCAMERA_DISABLE_COPY_AND_MOVE(CameraTelemetry)
+
+	static unsigned int intervalBucket(uint64_t interval);
+	static uint64_t intervalBucketLimit(unsigned int bucket);
+
+	struct StreamTelemetry {
+		std::atomic<uint64_t> framesDelivered;
+		std::atomic<uint64_t> framesDropped;
+		std::atomic<uint64_t> framesCancelled;
+		std::atomic<uint64_t> underruns;
+		std::atomic<uint64_t> framesAbsorbed;
+
+		std::atomic<uint64_t> intervalCount;
+		std::atomic<uint64_t> intervalSum;
+		std::atomic<uint64_t> intervalMin;
+		std::atomic<uint64_t> intervalMax;
+		std::array<std::atomic<uint32_t>, kIntervalBuckets> intervals;
+
+		/* Only accessed by the pipeline handler thread. */
+		bool valid;
+		uint32_t lastSequence;
+		uint64_t lastTimestamp;
+	};
+
+	std::atomic<uint64_t> requestsCompleted_;
+	std::atomic<uint64_t> requestsCancelled_;
+	std::map<const Stream *, std::unique_ptr<StreamTelemetry>> streams_;
+
+	bool starved_;
+};
+
+} /* namespace libcamera */
@@ -0,0 +1,65 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2020, Raspberry Pi (Trading) Limited
+ * Copyright (C) 2022, Google Inc.
+ *
+ * dma_buf_allocator.h - dma-buf allocator with buffer recycling
+ */
+
+#pragma once
+
+#include <memory>
+#include <stddef.h>
+#include <vector>
+
+#include <libcamera/base/flags.h>
+#include <libcamera/base/unique_fd.h>
+
+namespace libcamera {
+
+class FrameBuffer;
+
+class DmaBufAllocator
+{
+public:
+	enum class DmaBufAllocatorFlag {
+		CmaHeap = 1 << 0,
+		SystemHeap = 1 << 1,
+		UDmaBuf = 1 << 2,
+		MemFd = 1 << 3,
+	};
+
+	using DmaBufAllocatorFlags = Flags<DmaBufAllocatorFlag>;
+
+	static constexpr unsigned int kMaxPooledBuffers = 32;
+
+	DmaBufAllocator(DmaBufAllocatorFlags type = DmaBufAllocatorFlag::CmaHeap);
+	~DmaBufAllocator();
+
+	bool isValid() const { return valid_; }
+	DmaBufAllocatorFlag type() const { return type_; }
+
+	UniqueFD alloc(const char *name, std::size_t size);
+
+	int exportBuffers(unsigned int count,
+			  const std::vector<unsigned int> &planeSizes,
+			  std::vector<std::unique_ptr<FrameBuffer>> *buffers);
+	void clear();
+
+private:
+	class Pool;
+
+	UniqueFD allocFromHeap(const char *name, std::size_t size);
+	UniqueFD allocFromUDmaBuf(const char *name, std::size_t size);
+	UniqueFD allocFromMemFd(const char *name, std::size_t size);
+
+	UniqueFD providerHandle_;
+	DmaBufAllocatorFlag type_;
+	bool valid_;
+
+	std::shared_ptr<Pool> pool_;
+};
+
+LIBCAMERA_FLAGS_ENABLE_OPERATORS(DmaBufAllocator::DmaBufAllocatorFlag)
+
+} /* namespace libcamera */
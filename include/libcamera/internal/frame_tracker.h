@@ -0,0 +1,138 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * frame_tracker.h - Tracking of in-flight frames for pipeline handlers
+ */
+
+#pragma once
+
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <libcamera/request.h>
+
+namespace libcamera {
+
+class FrameBuffer;
+
+template<typename Info>
+class FrameTracker;
+
+struct FrameInfo {
+	unsigned int id;
+	Request *request;
+
+private:
+	template<typename T> friend class FrameTracker;
+	std::vector<FrameBuffer *> buffers_;
+};
+
+template<typename Info>
+class FrameTracker
+{
+	static_assert(std::is_base_of_v<FrameInfo, Info>,
+		      "Info must be derived from FrameInfo");
+
+public:
+	Info *create(unsigned int id, Request *request)
+	{
+		Info *info;
+
+		if (free_.empty()) {
+			pool_.push_back(std::make_unique<Info>());
+			info = pool_.back().get();
+		} else {
+			info = free_.back();
+			free_.pop_back();
+		}
+
+		/* Reset the frame but preserve the capacity of its buffers list. */
+		std::vector<FrameBuffer *> buffers = std::move(info->buffers_);
+		buffers.clear();
+		*info = {};
+		info->buffers_ = std::move(buffers);
+
+		info->id = id;
+		info->request = request;
+
+		frames_[id] = info;
+		requests_[request] = info;
+
+		for (const auto &[stream, buffer] : request->buffers())
+			addBuffer(info, buffer);
+
+		return info;
+	}
+
+	void addBuffer(Info *info, FrameBuffer *buffer)
+	{
+		if (!buffer)
+			return;
+
+		info->buffers_.push_back(buffer);
+		buffers_[buffer] = info;
+	}
+
+	void remove(Info *info)
+	{
+		for (FrameBuffer *buffer : info->buffers_) {
+			/*
+			 * Internal buffers can be reused by a newer frame
+			 * before this one completes, don't drop their entry in
+			 * that case.
+			 */
+			auto it = buffers_.find(buffer);
+			if (it != buffers_.end() && it->second == info)
+				buffers_.erase(it);
+		}
+
+		requests_.erase(info->request);
+		frames_.erase(info->id);
+
+		free_.push_back(info);
+	}
+
+	void clear()
+	{
+		for (const auto &[id, info] : frames_)
+			free_.push_back(info);
+
+		frames_.clear();
+		requests_.clear();
+		buffers_.clear();
+	}
+
+	Info *find(unsigned int id) const
+	{
+		auto it = frames_.find(id);
+		return it != frames_.end() ? it->second : nullptr;
+	}
+
+	Info *find(const FrameBuffer *buffer) const
+	{
+		auto it = buffers_.find(buffer);
+		return it != buffers_.end() ? it->second : nullptr;
+	}
+
+	Info *find(const Request *request) const
+	{
+		auto it = requests_.find(request);
+		return it != requests_.end() ? it->second : nullptr;
+	}
+
+	const std::unordered_map<unsigned int, Info *> &frames() const { return frames_; }
+
+private:
+	std::vector<std::unique_ptr<Info>> pool_;
+	std::vector<Info *> free_;
+
+	std::unordered_map<unsigned int, Info *> frames_;
+	std::unordered_map<const Request *, Info *> requests_;
+	std::unordered_map<const FrameBuffer *, Info *> buffers_;
+};
+
+} /* namespace libcamera */
@@ -31,6 +31,8 @@ public:
 	Fence *fence() const { return fence_.get(); }
 	void setFence(std::unique_ptr<Fence> fence) { fence_ = std::move(fence); }
 
+	FrameMetadata &metadata() { return LIBCAMERA_O_PTR()->metadata_; }
+
 private:
 	std::unique_ptr<Fence> fence_;
 	Request *request_;
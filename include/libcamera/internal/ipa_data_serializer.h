@@ -29,6 +29,9 @@ namespace libcamera {
 
 LOG_DECLARE_CATEGORY(IPADataSerializer)
 
+template<typename T>
+class IPADataSerializer;
+
 namespace {
 
 template<typename T,
@@ -40,6 +43,15 @@ void appendPOD(std::vector<uint8_t> &vec, T val)
 	memcpy(&*(vec.end() - byteWidth), &val, byteWidth);
 }
 
+template<typename T,
+	 std::enable_if_t<std::is_arithmetic_v<T>> * = nullptr>
+void writePOD(std::vector<uint8_t> &vec, size_t pos, T val)
+{
+	ASSERT(pos + sizeof(val) <= vec.size());
+
+	memcpy(&vec[pos], &val, sizeof(val));
+}
+
 template<typename T,
 	 std::enable_if_t<std::is_arithmetic_v<T>> * = nullptr>
 T readPOD(std::vector<uint8_t>::const_iterator it, size_t pos,
@@ -60,6 +72,22 @@ T readPOD(std::vector<uint8_t> &vec, size_t pos)
 	return readPOD<T>(vec.cbegin(), pos, vec.end());
 }
 
+template<typename T>
+void serializeMember(const T &data, std::vector<uint8_t> &dataVec,
+		     std::vector<SharedFD> &fdsVec, ControlSerializer *cs)
+{
+	const size_t sizePos = dataVec.size();
+	const size_t fdsStart = fdsVec.size();
+
+	appendPOD<uint32_t>(dataVec, 0);
+	appendPOD<uint32_t>(dataVec, 0);
+
+	IPADataSerializer<T>::serialize(data, dataVec, fdsVec, cs);
+
+	writePOD<uint32_t>(dataVec, sizePos, dataVec.size() - sizePos - 8);
+	writePOD<uint32_t>(dataVec, sizePos + 4, fdsVec.size() - fdsStart);
+}
+
 } /* namespace */
 
 template<typename T>
@@ -68,6 +96,9 @@ class IPADataSerializer
 public:
 	static std::tuple<std::vector<uint8_t>, std::vector<SharedFD>>
 	serialize(const T &data, ControlSerializer *cs = nullptr);
+	static void serialize(const T &data, std::vector<uint8_t> &dataVec,
+			      std::vector<SharedFD> &fdsVec,
+			      ControlSerializer *cs = nullptr);
 
 	static T deserialize(const std::vector<uint8_t> &data,
 			     ControlSerializer *cs = nullptr);
@@ -110,26 +141,23 @@ public:
 		std::vector<uint8_t> dataVec;
 		std::vector<SharedFD> fdsVec;
 
+		serialize(data, dataVec, fdsVec, cs);
+
+		return { std::move(dataVec), std::move(fdsVec) };
+	}
+
+	static void serialize(const std::vector<V> &data,
+			      std::vector<uint8_t> &dataVec,
+			      std::vector<SharedFD> &fdsVec,
+			      ControlSerializer *cs = nullptr)
+	{
 		/* Serialize the length. */
 		uint32_t vecLen = data.size();
 		appendPOD<uint32_t>(dataVec, vecLen);
 
 		/* Serialize the members. */
-		for (auto const &it : data) {
-			std::vector<uint8_t> dvec;
-			std::vector<SharedFD> fvec;
-
-			std::tie(dvec, fvec) =
-				IPADataSerializer<V>::serialize(it, cs);
-
-			appendPOD<uint32_t>(dataVec, dvec.size());
-			appendPOD<uint32_t>(dataVec, fvec.size());
-
-			dataVec.insert(dataVec.end(), dvec.begin(), dvec.end());
-			fdsVec.insert(fdsVec.end(), fvec.begin(), fvec.end());
-		}
-
-		return { dataVec, fdsVec };
+		for (auto const &it : data)
+			serializeMember(it, dataVec, fdsVec, cs);
 	}
 
 	static std::vector<V> deserialize(std::vector<uint8_t> &data, ControlSerializer *cs = nullptr)
@@ -207,35 +235,25 @@ public:
 		std::vector<uint8_t> dataVec;
 		std::vector<SharedFD> fdsVec;
 
+		serialize(data, dataVec, fdsVec, cs);
+
+		return { std::move(dataVec), std::move(fdsVec) };
+	}
+
+	static void serialize(const std::map<K, V> &data,
+			      std::vector<uint8_t> &dataVec,
+			      std::vector<SharedFD> &fdsVec,
+			      ControlSerializer *cs = nullptr)
+	{
 		/* Serialize the length. */
 		uint32_t mapLen = data.size();
 		appendPOD<uint32_t>(dataVec, mapLen);
 
 		/* Serialize the members. */
 		for (auto const &it : data) {
-			std::vector<uint8_t> dvec;
-			std::vector<SharedFD> fvec;
-
-			std::tie(dvec, fvec) =
-				IPADataSerializer<K>::serialize(it.first, cs);
-
-			appendPOD<uint32_t>(dataVec, dvec.size());
-			appendPOD<uint32_t>(dataVec, fvec.size());
-
-			dataVec.insert(dataVec.end(), dvec.begin(), dvec.end());
-			fdsVec.insert(fdsVec.end(), fvec.begin(), fvec.end());
-
-			std::tie(dvec, fvec) =
-				IPADataSerializer<V>::serialize(it.second, cs);
-
-			appendPOD<uint32_t>(dataVec, dvec.size());
-			appendPOD<uint32_t>(dataVec, fvec.size());
-
-			dataVec.insert(dataVec.end(), dvec.begin(), dvec.end());
-			fdsVec.insert(fdsVec.end(), fvec.begin(), fvec.end());
+			serializeMember<K>(it.first, dataVec, fdsVec, cs);
+			serializeMember<V>(it.second, dataVec, fdsVec, cs);
 		}
-
-		return { dataVec, fdsVec };
 	}
 
 	static std::map<K, V> deserialize(std::vector<uint8_t> &data, ControlSerializer *cs = nullptr)
@@ -34,6 +34,7 @@ public:
 
 	bool lock();
 	void unlock();
+	unsigned int lockGeneration() const { return lockGeneration_; }
 
 	int populate();
 	bool isValid() const { return valid_; }
@@ -86,6 +87,7 @@ private:
 	UniqueFD fd_;
 	bool valid_;
 	bool acquired_;
+	unsigned int lockGeneration_;
 
 	std::map<unsigned int, MediaObject *> objects_;
 	std::vector<MediaEntity *> entities_;
@@ -59,6 +59,7 @@ private:
 	MediaPad *source_;
 	MediaPad *sink_;
 	unsigned int flags_;
+	unsigned int flagsGeneration_;
 };
 
 class MediaPad : public MediaObject
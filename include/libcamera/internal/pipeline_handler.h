@@ -17,6 +17,7 @@
 #include <libcamera/base/mutex.h>
 #include <libcamera/base/object.h>
 
+#include <libcamera/camera.h>
 #include <libcamera/controls.h>
 #include <libcamera/stream.h>
 
@@ -24,8 +25,6 @@
 
 namespace libcamera {
 
-class Camera;
-class CameraConfiguration;
 class CameraManager;
 class DeviceEnumerator;
 class DeviceMatch;
@@ -50,7 +49,11 @@ public:
 
 	virtual CameraConfiguration *generateConfiguration(Camera *camera,
 		const StreamRoles &roles) = 0;
+	virtual std::vector<CameraConfiguration::Status>
+	validateConfigurations(Camera *camera, StreamRole role,
+			       std::vector<StreamConfiguration> &candidates);
 	virtual int configure(Camera *camera, CameraConfiguration *config) = 0;
+	virtual int reconfigure(Camera *camera, CameraConfiguration *config);
 
 	virtual int exportFrameBuffers(Camera *camera, Stream *stream,
 				       std::vector<std::unique_ptr<FrameBuffer>> *buffers) = 0;
@@ -61,6 +64,7 @@ public:
 
 	void registerRequest(Request *request);
 	void queueRequest(Request *request);
+	void queueRequests(const std::vector<Request *> &requests);
 
 	bool completeBuffer(Request *request, FrameBuffer *buffer);
 	void completeRequest(Request *request);
@@ -87,6 +91,7 @@ private:
 	std::vector<std::weak_ptr<Camera>> cameras_;
 
 	std::queue<Request *> waitingRequests_;
+	bool batching_;
 
 	const char *name_;
 
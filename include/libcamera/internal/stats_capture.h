@@ -0,0 +1,137 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * stats_capture.h - ISP statistics capture file format
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <libcamera/base/class.h>
+#include <libcamera/base/file.h>
+#include <libcamera/base/span.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/unique_fd.h>
+
+#include <libcamera/ipa/core_ipa_interface.h>
+
+#include "libcamera/internal/control_serializer.h"
+#include "libcamera/internal/mapped_framebuffer.h"
+
+namespace libcamera {
+
+struct StatsCaptureHeader {
+	static constexpr uint32_t kMagic = 0x5343434c; /* "LCCS" */
+	static constexpr uint32_t kVersion = 1;
+
+	uint32_t magic;
+	uint32_t version;
+	char pipeline[56];
+};
+
+enum class StatsCaptureRecordType : uint32_t {
+	SensorInfo = 1,
+	ControlInfo = 2,
+	PipelineConfig = 3,
+	SensorControls = 4,
+	Params = 5,
+	Statistics = 6,
+};
+
+struct StatsCaptureRecordHeader {
+	uint32_t type;
+	uint32_t sequence;
+	uint64_t timestamp;
+	uint32_t size;
+	uint32_t reserved;
+};
+
+struct StatsCaptureRecord {
+	StatsCaptureRecordType type;
+	uint32_t sequence;
+	uint64_t timestamp;
+	std::vector<uint8_t> data;
+};
+
+class StatsCaptureReader
+{
+public:
+	StatsCaptureReader();
+
+	int open(const std::string &path);
+	void close();
+
+	const std::string &pipeline() const { return pipeline_; }
+
+	int read(StatsCaptureRecord *record);
+
+private:
+	LIBCAMERA_DISABLE_COPY(StatsCaptureReader)
+
+	File file_;
+	std::string pipeline_;
+};
+
+class StatsCaptureWriter : protected Thread
+{
+public:
+	StatsCaptureWriter();
+	~StatsCaptureWriter();
+
+	static std::unique_ptr<StatsCaptureWriter> create(const std::string &pipeline);
+
+	int open(const std::string &path, const std::string &pipeline);
+	void close();
+
+	unsigned int dropped() const { return dropped_; }
+
+	void writeSensorInfo(const IPACameraSensorInfo &sensorInfo);
+	void writeControlInfo(unsigned int entity, const ControlInfoMap &infoMap);
+	void writePipelineConfig(Span<const uint32_t> config);
+	void writeSensorControls(uint32_t sequence, uint64_t timestamp,
+				 const ControlList &controls);
+	void writeBuffer(StatsCaptureRecordType type, uint32_t sequence,
+			 uint64_t timestamp, const FrameBuffer *buffer);
+
+	void releaseBuffers();
+
+protected:
+	void run() override;
+
+private:
+	LIBCAMERA_DISABLE_COPY_AND_MOVE(StatsCaptureWriter)
+
+	static constexpr unsigned int kNumSlots = 16;
+
+	struct Slot {
+		StatsCaptureRecordHeader header;
+		std::vector<uint8_t> data;
+	};
+
+	void write(StatsCaptureRecordType type, uint32_t sequence,
+		   uint64_t timestamp, Span<const uint8_t> data);
+	void flush();
+
+	File file_;
+	UniqueFD eventfd_;
+
+	std::array<Slot, kNumSlots> slots_;
+	std::atomic<unsigned int> head_;
+	std::atomic<unsigned int> tail_;
+	std::atomic<bool> stopping_;
+	unsigned int dropped_;
+
+	ControlSerializer serializer_;
+	std::vector<uint8_t> scratch_;
+	std::map<const FrameBuffer *, MappedFrameBuffer> mappings_;
+};
+
+} /* namespace libcamera */
@@ -0,0 +1,48 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * underrun_guard.h - Keep capture devices streaming when requests run out
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <libcamera/base/class.h>
+
+namespace libcamera {
+
+class FrameBuffer;
+class V4L2VideoDevice;
+
+class UnderrunGuard
+{
+public:
+	static constexpr unsigned int kNumScratchBuffers = 1;
+
+	UnderrunGuard(V4L2VideoDevice *video);
+	~UnderrunGuard();
+
+	int start(unsigned int bufferCount);
+	void stop();
+	void clear();
+
+	int queueBuffer(FrameBuffer *buffer);
+	bool bufferReady(FrameBuffer *buffer);
+
+private:
+	LIBCAMERA_DISABLE_COPY_AND_MOVE(UnderrunGuard)
+
+	void fill();
+
+	V4L2VideoDevice *video_;
+
+	std::vector<std::unique_ptr<FrameBuffer>> scratchBuffers_;
+	std::vector<FrameBuffer *> availableBuffers_;
+	unsigned int queuedBuffers_;
+	unsigned int queuedScratchBuffers_;
+};
+
+} /* namespace libcamera */
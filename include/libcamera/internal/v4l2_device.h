@@ -10,6 +10,7 @@
 #include <map>
 #include <memory>
 #include <optional>
+#include <set>
 #include <vector>
 
 #include <linux/videodev2.h>
@@ -58,6 +59,8 @@ protected:
 
 	int fd() const { return fd_.get(); }
 
+	unsigned int layoutGeneration() const { return layoutGeneration_; }
+
 	template<typename T>
 	static std::optional<ColorSpace> toColorSpace(const T &v4l2Format);
 
@@ -77,6 +80,7 @@ private:
 	void eventAvailable();
 
 	std::map<unsigned int, struct v4l2_query_ext_ctrl> controlInfo_;
+	std::set<unsigned int> layoutControls_;
 	std::vector<std::unique_ptr<ControlId>> controlIds_;
 	ControlIdMap controlIdMap_;
 	ControlInfoMap controls_;
@@ -85,6 +89,8 @@ private:
 
 	EventNotifier *fdEventNotifier_;
 	bool frameStartEnabled_;
+
+	unsigned int layoutGeneration_;
 };
 
 } /* namespace libcamera */
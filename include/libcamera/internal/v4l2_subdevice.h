@@ -82,6 +82,15 @@ private:
 	const MediaEntity *entity_;
 
 	std::string model_;
+
+	struct FormatCacheEntry {
+		V4L2SubdeviceFormat request;
+		V4L2SubdeviceFormat format;
+	};
+
+	std::map<unsigned int, FormatCacheEntry> formatCache_;
+	unsigned int formatCacheGeneration_;
+	unsigned int formatCacheLockGeneration_;
 };
 
 } /* namespace libcamera */
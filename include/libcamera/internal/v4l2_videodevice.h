@@ -257,6 +257,12 @@ private:
 	V4L2DeviceFormat format_;
 	const PixelFormatInfo *formatInfo_;
 
+	const MediaDevice *media_;
+	bool formatCacheEnabled_;
+	std::optional<V4L2DeviceFormat> formatRequest_;
+	unsigned int formatRequestGeneration_;
+	unsigned int formatRequestLockGeneration_;
+
 	enum v4l2_buf_type bufferType_;
 	enum v4l2_memory memoryType_;
 
@@ -417,28 +417,34 @@ CameraCapabilities::initializeYUVResolutions(const PixelFormat &pixelFormat,
 					     const std::vector<Size> &resolutions)
 {
 	std::vector<Size> supportedResolutions;
-	std::unique_ptr<CameraConfiguration> cameraConfig =
-		camera_->generateConfiguration({ StreamRole::Viewfinder });
-	if (!cameraConfig) {
-		LOG(HAL, Error) << "Failed to get supported YUV resolutions";
-		return supportedResolutions;
-	}
-
-	StreamConfiguration &cfg = cameraConfig->at(0);
+	std::vector<StreamConfiguration> candidates;
+	candidates.reserve(resolutions.size());
 
 	for (const Size &res : resolutions) {
+		StreamConfiguration cfg;
 		cfg.pixelFormat = pixelFormat;
 		cfg.size = res;
+		candidates.push_back(cfg);
+	}
+
+	/*
+	 * Validate all the candidates in one go to let the pipeline handler
+	 * share the work between them.
+	 */
+	std::vector<CameraConfiguration::Status> statuses =
+		camera_->validateConfigurations(StreamRole::Viewfinder, candidates);
+
+	for (unsigned int i = 0; i < resolutions.size(); ++i) {
+		const StreamConfiguration &cfg = candidates[i];
 
-		CameraConfiguration::Status status = cameraConfig->validate();
-		if (status != CameraConfiguration::Valid) {
+		if (statuses[i] != CameraConfiguration::Valid) {
 			LOG(HAL, Debug) << cfg.toString() << " not supported";
 			continue;
 		}
 
 		LOG(HAL, Debug) << cfg.toString() << " supported";
 
-		supportedResolutions.push_back(res);
+		supportedResolutions.push_back(resolutions[i]);
 	}
 
 	return supportedResolutions;
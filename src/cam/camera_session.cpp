@@ -216,6 +216,8 @@ void CameraSession::stop()
 	int ret = camera_->stop();
 	if (ret)
 		std::cout << "Failed to stop capture" << std::endl;
+	else
+		printStatistics();
 
 	if (sink_) {
 		ret = sink_->stop();
@@ -230,6 +232,28 @@ void CameraSession::stop()
 	allocator_.reset();
 }
 
+void CameraSession::printStatistics() const
+{
+	CameraStatistics stats = camera_->statistics();
+
+	auto ms = [](std::chrono::nanoseconds interval) {
+		return interval.count() / 1000000.0;
+	};
+
+	for (const auto &[stream, name] : streamNames_) {
+		const StreamStatistics &s = stats.streams[stream];
+
+		std::cout << name << ": " << s.framesDelivered << " frames, "
+			  << s.framesDropped << " dropped, "
+			  << s.underruns << " underruns, interval min/avg/max/p99 "
+			  << std::fixed << std::setprecision(2)
+			  << ms(s.minFrameInterval) << "/"
+			  << ms(s.avgFrameInterval) << "/"
+			  << ms(s.maxFrameInterval) << "/"
+			  << ms(s.p99FrameInterval) << " ms" << std::endl;
+	}
+}
+
 int CameraSession::startCapture()
 {
 	int ret;
@@ -55,6 +55,7 @@ private:
 	void requestComplete(libcamera::Request *request);
 	void processRequest(libcamera::Request *request);
 	void sinkRelease(libcamera::Request *request);
+	void printStatistics() const;
 
 	const OptionsParser::Options &options_;
 	std::shared_ptr<libcamera::Camera> camera_;
@@ -0,0 +1,131 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * ipu3_replayer.cpp - ipa-replay - IPU3 IPA replay
+ */
+
+#include <errno.h>
+#include <iostream>
+
+#include <linux/intel-ipu3.h>
+
+#include <libcamera/ipa/ipu3_ipa_interface.h>
+
+#include "replayer.h"
+
+using namespace libcamera;
+using namespace libcamera::ipa::ipu3;
+
+class IPU3Replayer : public Replayer
+{
+protected:
+	size_t paramsSize() const override { return sizeof(ipu3_uapi_params); }
+	size_t statsSize() const override { return sizeof(ipu3_uapi_stats_3a); }
+
+	int configure(IPAInterface *ipa, const std::string &configFile) override;
+	void start() override;
+	void stop() override;
+	void prepare(const ReplayFrame &frame) override;
+	void process(const ReplayFrame &frame) override;
+
+private:
+	void queueFrameAction(unsigned int frame, const IPU3Action &action);
+
+	IPAIPU3Interface *ipa_;
+};
+
+/*
+ * The pipeline configuration stores the BDS output size and the IF crop size
+ * computed by the ImgU, as width and height pairs.
+ */
+int IPU3Replayer::configure(IPAInterface *ipa, const std::string &configFile)
+{
+	const ControlInfoMap *sensorControls = controlInfo(0);
+	if (!sensorControls || pipelineConfig_.size() < 4) {
+		std::cerr << "Incomplete IPU3 configuration in capture"
+			  << std::endl;
+		return -EINVAL;
+	}
+
+	ipa_ = static_cast<IPAIPU3Interface *>(ipa);
+	ipa_->queueFrameAction.connect(this, &IPU3Replayer::queueFrameAction);
+
+	ControlInfoMap ipaControls;
+	int ret = ipa_->init(IPASettings{ configFile, sensorInfo_.model },
+			     sensorInfo_, *sensorControls, &ipaControls);
+	if (ret)
+		return ret;
+
+	IPAConfigInfo configInfo;
+	configInfo.sensorInfo = sensorInfo_;
+	configInfo.sensorControls = *sensorControls;
+	if (const ControlInfoMap *lensControls = controlInfo(1))
+		configInfo.lensControls = *lensControls;
+	configInfo.bdsOutputSize = Size(pipelineConfig_[0], pipelineConfig_[1]);
+	configInfo.iif = Size(pipelineConfig_[2], pipelineConfig_[3]);
+
+	ret = ipa_->configure(configInfo, &ipaControls);
+	if (ret)
+		return ret;
+
+	ipa_->mapBuffers({ params_.ipaBuffer, stats_.ipaBuffer });
+
+	return 0;
+}
+
+void IPU3Replayer::start()
+{
+	ipa_->start();
+}
+
+void IPU3Replayer::stop()
+{
+	ipa_->stop();
+	ipa_->unmapBuffers({ params_.ipaBuffer.id, stats_.ipaBuffer.id });
+}
+
+void IPU3Replayer::prepare(const ReplayFrame &frame)
+{
+	IPU3Event ev;
+	ev.op = EventProcessControls;
+	ev.frame = frame.sequence;
+	ipa_->processEvent(ev);
+
+	ev.op = EventFillParams;
+	ev.frame = frame.sequence;
+	ev.bufferId = params_.ipaBuffer.id;
+	ipa_->processEvent(ev);
+}
+
+void IPU3Replayer::process(const ReplayFrame &frame)
+{
+	IPU3Event ev;
+	ev.op = EventStatReady;
+	ev.frame = frame.sequence;
+	ev.frameTimestamp = frame.timestamp;
+	ev.bufferId = stats_.ipaBuffer.id;
+	ev.sensorControls = frame.sensorControls;
+	ipa_->processEvent(ev);
+}
+
+void IPU3Replayer::queueFrameAction([[maybe_unused]] unsigned int frame,
+				    const IPU3Action &action)
+{
+	/* Actions emitted outside of a frame, by start(), are ignored. */
+	if (!current_)
+		return;
+
+	switch (action.op) {
+	case ActionSetSensorControls:
+		current_->sensorControls = action.sensorControls;
+		break;
+	case ActionMetadataReady:
+		current_->metadata = action.controls;
+		break;
+	default:
+		break;
+	}
+}
+
+REGISTER_REPLAYER("PipelineHandlerIPU3", IPU3Replayer)
@@ -0,0 +1,131 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * main.cpp - ipa-replay - Replay captured statistics through an IPA module
+ */
+
+#include <iostream>
+#include <memory>
+#include <string.h>
+
+#include <libcamera/ipa/ipa_interface.h>
+#include <libcamera/ipa/ipa_module_info.h>
+
+#include "libcamera/internal/ipa_module.h"
+#include "libcamera/internal/stats_capture.h"
+
+#include "../cam/options.h"
+#include "replayer.h"
+
+using namespace libcamera;
+
+enum {
+	OptCapture = 'c',
+	OptHelp = 'h',
+	OptModule = 'm',
+	OptTuning = 't',
+	OptVerbose = 'v',
+};
+
+static int parseOptions(int argc, char **argv, OptionsParser::Options *options)
+{
+	OptionsParser parser;
+	parser.addOption(OptCapture, OptionString,
+			 "Statistics capture file to replay", "capture",
+			 ArgumentRequired, "file");
+	parser.addOption(OptHelp, OptionNone, "Display this help message",
+			 "help");
+	parser.addOption(OptModule, OptionString,
+			 "Path to the IPA module to load", "module",
+			 ArgumentRequired, "module");
+	parser.addOption(OptTuning, OptionString,
+			 "IPA configuration (tuning) file", "tuning",
+			 ArgumentRequired, "file");
+	parser.addOption(OptVerbose, OptionNone,
+			 "Print per-frame results in CSV format", "verbose");
+
+	*options = parser.parse(argc, argv);
+	if (!options->valid())
+		return -EINVAL;
+
+	if (options->isSet(OptHelp)) {
+		parser.usage();
+		return -EINTR;
+	}
+
+	if (!options->isSet(OptCapture) || !options->isSet(OptModule)) {
+		std::cerr << "Both a capture file and an IPA module are required"
+			  << std::endl;
+		parser.usage();
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	OptionsParser::Options options;
+	int ret = parseOptions(argc, argv, &options);
+	if (ret == -EINTR)
+		return EXIT_SUCCESS;
+	if (ret < 0)
+		return EXIT_FAILURE;
+
+	StatsCaptureReader reader;
+	ret = reader.open(options[OptCapture]);
+	if (ret)
+		return EXIT_FAILURE;
+
+	IPAModule module(options[OptModule]);
+	if (!module.isValid()) {
+		std::cerr << "Invalid IPA module " << options[OptModule].toString()
+			  << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if (reader.pipeline() != module.info().pipelineName) {
+		std::cerr << "Capture from " << reader.pipeline()
+			  << " can't be replayed with an IPA module for "
+			  << module.info().pipelineName << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::unique_ptr<Replayer> replayer = Replayer::create(reader.pipeline());
+	if (!replayer) {
+		std::cerr << "Replay of " << reader.pipeline()
+			  << " captures is not supported" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	ret = replayer->load(reader);
+	if (ret) {
+		std::cerr << "Failed to load capture: " << strerror(-ret)
+			  << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if (!module.load()) {
+		std::cerr << "Failed to load IPA module" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::unique_ptr<IPAInterface> ipa{ module.createInterface() };
+	if (!ipa) {
+		std::cerr << "Failed to create IPA interface" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::string tuningFile;
+	if (options.isSet(OptTuning))
+		tuningFile = options[OptTuning].toString();
+
+	ret = replayer->run(ipa.get(), tuningFile);
+	if (ret)
+		return EXIT_FAILURE;
+
+	replayer->report(std::cout, options.isSet(OptVerbose));
+
+	return EXIT_SUCCESS;
+}
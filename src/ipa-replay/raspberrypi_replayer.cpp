@@ -0,0 +1,141 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * raspberrypi_replayer.cpp - ipa-replay - Raspberry Pi IPA replay
+ */
+
+#include <errno.h>
+#include <iostream>
+
+#include <linux/bcm2835-isp.h>
+
+#include <libcamera/control_ids.h>
+
+#include <libcamera/ipa/raspberrypi_ipa_interface.h>
+
+#include "replayer.h"
+
+using namespace libcamera;
+using namespace libcamera::ipa::RPi;
+
+class RPiReplayer : public Replayer
+{
+public:
+	~RPiReplayer();
+
+protected:
+	size_t paramsSize() const override { return 0; }
+	size_t statsSize() const override { return sizeof(bcm2835_isp_stats); }
+
+	int configure(IPAInterface *ipa, const std::string &configFile) override;
+	void start() override;
+	void stop() override;
+	void prepare(const ReplayFrame &frame) override;
+	void process(const ReplayFrame &frame) override;
+
+private:
+	void setDelayedControls(const ControlList &sensorControls);
+	void statsMetadataComplete(uint32_t bufferId, const ControlList &metadata);
+
+	IPARPiInterface *ipa_;
+	Buffer lsTable_;
+};
+
+RPiReplayer::~RPiReplayer()
+{
+	releaseBuffer(&lsTable_);
+}
+
+/*
+ * The pipeline configuration stores the transform. The ISP controls are
+ * stored as entity 1, as in the pipeline handler.
+ */
+int RPiReplayer::configure(IPAInterface *ipa, const std::string &configFile)
+{
+	if (!controlInfo(0) || !controlInfo(1) || pipelineConfig_.size() < 1) {
+		std::cerr << "Incomplete Raspberry Pi configuration in capture"
+			  << std::endl;
+		return -EINVAL;
+	}
+
+	if (configFile.empty()) {
+		std::cerr << "The Raspberry Pi IPA requires a tuning file"
+			  << std::endl;
+		return -EINVAL;
+	}
+
+	ipa_ = static_cast<IPARPiInterface *>(ipa);
+	ipa_->setDelayedControls.connect(this, &RPiReplayer::setDelayedControls);
+	ipa_->statsMetadataComplete.connect(this, &RPiReplayer::statsMetadataComplete);
+
+	SensorConfig sensorConfig;
+	int ret = ipa_->init(IPASettings{ configFile, sensorInfo_.model },
+			     &sensorConfig);
+	if (ret)
+		return ret;
+
+	ret = createBuffer(0, MaxLsGridSize, &lsTable_);
+	if (ret)
+		return ret;
+
+	IPAConfig ipaConfig;
+	ipaConfig.transform = pipelineConfig_[0];
+	ipaConfig.lsTableHandle = lsTable_.ipaBuffer.planes[0].fd;
+
+	ControlList controls;
+	ret = ipa_->configure(sensorInfo_, {}, controlInfo_, ipaConfig, &controls);
+	if (ret)
+		return ret;
+
+	/* The IPA identifies statistics buffers by their ID mask. */
+	stats_.ipaBuffer.id |= MaskStats;
+	ipa_->mapBuffers({ stats_.ipaBuffer });
+
+	return 0;
+}
+
+void RPiReplayer::start()
+{
+	StartConfig startConfig;
+	ipa_->start(ControlList(controls::controls), &startConfig);
+}
+
+void RPiReplayer::stop()
+{
+	ipa_->stop();
+	ipa_->unmapBuffers({ stats_.ipaBuffer.id });
+}
+
+void RPiReplayer::prepare(const ReplayFrame &frame)
+{
+	ISPConfig ispConfig;
+	ispConfig.embeddedBufferPresent = false;
+	ispConfig.embeddedBufferId = 0;
+	ispConfig.bayerBufferId = 0;
+	ispConfig.controls = frame.sensorControls;
+	ispConfig.controls.set(controls::SensorTimestamp,
+			       static_cast<int64_t>(frame.timestamp));
+
+	ipa_->signalIspPrepare(ispConfig);
+}
+
+void RPiReplayer::process([[maybe_unused]] const ReplayFrame &frame)
+{
+	ipa_->signalStatReady(stats_.ipaBuffer.id);
+}
+
+void RPiReplayer::setDelayedControls(const ControlList &sensorControls)
+{
+	if (current_)
+		current_->sensorControls = sensorControls;
+}
+
+void RPiReplayer::statsMetadataComplete([[maybe_unused]] uint32_t bufferId,
+					const ControlList &metadata)
+{
+	if (current_)
+		current_->metadata = metadata;
+}
+
+REGISTER_REPLAYER("PipelineHandlerRPi", RPiReplayer)
@@ -0,0 +1,383 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * replayer.cpp - ipa-replay - Replay captured statistics through an IPA module
+ */
+
+#include "replayer.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <iomanip>
+#include <iostream>
+#include <linux/v4l2-controls.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <libcamera/base/shared_fd.h>
+#include <libcamera/base/unique_fd.h>
+
+#include <libcamera/ipa/core_ipa_serializer.h>
+
+#include "libcamera/internal/byte_stream_buffer.h"
+
+using namespace libcamera;
+using namespace std::chrono;
+
+ReplayerRegistration::ReplayerRegistration(const char *pipeline, Factory factory)
+{
+	registry()[pipeline] = factory;
+}
+
+const std::map<std::string, ReplayerRegistration::Factory> &ReplayerRegistration::factories()
+{
+	return registry();
+}
+
+std::map<std::string, ReplayerRegistration::Factory> &ReplayerRegistration::registry()
+{
+	static std::map<std::string, Factory> factories;
+	return factories;
+}
+
+std::unique_ptr<Replayer> Replayer::create(const std::string &pipeline)
+{
+	const auto &factories = ReplayerRegistration::factories();
+	auto it = factories.find(pipeline);
+	if (it == factories.end())
+		return nullptr;
+
+	return it->second();
+}
+
+Replayer::Replayer()
+	: current_(nullptr), serializer_(ControlSerializer::Role::Worker)
+{
+}
+
+Replayer::~Replayer()
+{
+	releaseBuffer(&params_);
+	releaseBuffer(&stats_);
+}
+
+/*
+ * Load all records from the capture file upfront, to keep file I/O out of the
+ * measurements.
+ */
+int Replayer::load(StatsCaptureReader &reader)
+{
+	StatsCaptureRecord record;
+	int ret;
+
+	while ((ret = reader.read(&record)) == 0) {
+		const std::vector<uint8_t> &data = record.data;
+		ByteStreamBuffer buffer(data.data(), data.size());
+
+		if (record.type == StatsCaptureRecordType::SensorInfo) {
+			sensorInfo_ = IPADataSerializer<IPACameraSensorInfo>::deserialize(record.data);
+			continue;
+		}
+
+		if (record.type == StatsCaptureRecordType::ControlInfo) {
+			ControlInfoMap infoMap = serializer_.deserialize<ControlInfoMap>(buffer);
+			if (buffer.overflow()) {
+				std::cerr << "Invalid control info record" << std::endl;
+				return -EINVAL;
+			}
+
+			controlInfo_[record.sequence] = std::move(infoMap);
+			continue;
+		}
+
+		if (record.type == StatsCaptureRecordType::PipelineConfig) {
+			pipelineConfig_.resize(record.data.size() / sizeof(uint32_t));
+			memcpy(pipelineConfig_.data(), record.data.data(),
+			       pipelineConfig_.size() * sizeof(uint32_t));
+			continue;
+		}
+
+		/* All other records relate to a frame. */
+		if (frames_.empty() || frames_.back().sequence != record.sequence)
+			frames_.push_back({ record.sequence, record.timestamp, {}, {}, {} });
+
+		ReplayFrame &frame = frames_.back();
+		if (record.timestamp)
+			frame.timestamp = record.timestamp;
+
+		switch (record.type) {
+		case StatsCaptureRecordType::SensorControls:
+			frame.sensorControls = serializer_.deserialize<ControlList>(buffer);
+			break;
+		case StatsCaptureRecordType::Params:
+			frame.params = std::move(record.data);
+			break;
+		case StatsCaptureRecordType::Statistics:
+			frame.stats = std::move(record.data);
+			break;
+		default:
+			std::cerr << "Skipping unknown record type "
+				  << static_cast<uint32_t>(record.type) << std::endl;
+			break;
+		}
+	}
+
+	if (ret != -ENODATA)
+		return ret;
+
+	/* Frames without statistics can't be replayed. */
+	frames_.erase(std::remove_if(frames_.begin(), frames_.end(),
+				     [](const ReplayFrame &frame) {
+					     return frame.stats.empty();
+				     }),
+		      frames_.end());
+
+	if (frames_.empty()) {
+		std::cerr << "No frame to replay" << std::endl;
+		return -ENODATA;
+	}
+
+	return 0;
+}
+
+int Replayer::run(IPAInterface *ipa, const std::string &configFile)
+{
+	size_t size = statsSize();
+	for (const ReplayFrame &frame : frames_)
+		size = std::max(size, frame.stats.size());
+
+	/* Not all platforms use a parameters buffer. */
+	if (paramsSize()) {
+		int ret = createBuffer(1, paramsSize(), &params_);
+		if (ret)
+			return ret;
+	}
+
+	int ret = createBuffer(2, size, &stats_);
+	if (ret)
+		return ret;
+
+	ret = configure(ipa, configFile);
+	if (ret) {
+		std::cerr << "Failed to configure the IPA: " << strerror(-ret)
+			  << std::endl;
+		return ret;
+	}
+
+	start();
+
+	results_.clear();
+	results_.reserve(frames_.size());
+
+	for (const ReplayFrame &frame : frames_) {
+		results_.push_back({ frame.sequence, {}, {}, {}, {}, {} });
+		current_ = &results_.back();
+
+		auto begin = steady_clock::now();
+		prepare(frame);
+		auto prepared = steady_clock::now();
+
+		/*
+		 * Compare the parameters computed by the IPA with the ones
+		 * captured for the same frame, to detect algorithm changes.
+		 */
+		if (!params_.mem.empty() && !frame.params.empty())
+			current_->paramsMatch =
+				frame.params.size() <= params_.mem.size() &&
+				!memcmp(params_.mem.data(), frame.params.data(),
+					frame.params.size());
+
+		/* Copying the statistics is not part of the IPA processing time. */
+		memcpy(stats_.mem.data(), frame.stats.data(), frame.stats.size());
+
+		auto copied = steady_clock::now();
+		process(frame);
+		auto end = steady_clock::now();
+
+		current_->prepareTime = duration_cast<nanoseconds>(prepared - begin);
+		current_->processTime = duration_cast<nanoseconds>(end - copied);
+	}
+
+	current_ = nullptr;
+
+	stop();
+
+	return 0;
+}
+
+const ControlInfoMap *Replayer::controlInfo(unsigned int entity) const
+{
+	auto it = controlInfo_.find(entity);
+	if (it == controlInfo_.end())
+		return nullptr;
+
+	return &it->second;
+}
+
+int Replayer::createBuffer(unsigned int id, size_t size, Buffer *buffer)
+{
+	UniqueFD fd(memfd_create("ipa-replay", MFD_CLOEXEC));
+	if (!fd.isValid()) {
+		int ret = -errno;
+		std::cerr << "Failed to create buffer: " << strerror(-ret)
+			  << std::endl;
+		return ret;
+	}
+
+	if (ftruncate(fd.get(), size) < 0) {
+		int ret = -errno;
+		std::cerr << "Failed to size buffer: " << strerror(-ret)
+			  << std::endl;
+		return ret;
+	}
+
+	void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			 fd.get(), 0);
+	if (mem == MAP_FAILED) {
+		int ret = -errno;
+		std::cerr << "Failed to map buffer: " << strerror(-ret)
+			  << std::endl;
+		return ret;
+	}
+
+	FrameBuffer::Plane plane;
+	plane.fd = SharedFD(std::move(fd));
+	plane.offset = 0;
+	plane.length = size;
+
+	buffer->ipaBuffer = IPABuffer(id, { plane });
+	buffer->mem = { static_cast<uint8_t *>(mem), size };
+
+	return 0;
+}
+
+void Replayer::releaseBuffer(Buffer *buffer)
+{
+	if (buffer->mem.empty())
+		return;
+
+	munmap(buffer->mem.data(), buffer->mem.size());
+	buffer->mem = {};
+}
+
+namespace {
+
+struct LatencyStats {
+	LatencyStats(std::vector<nanoseconds> samples)
+	{
+		std::sort(samples.begin(), samples.end());
+
+		nanoseconds total{ 0 };
+		for (const nanoseconds &sample : samples)
+			total += sample;
+
+		min = samples.front();
+		max = samples.back();
+		avg = total / samples.size();
+		p99 = samples[(samples.size() - 1) * 99 / 100];
+	}
+
+	nanoseconds min;
+	nanoseconds avg;
+	nanoseconds p99;
+	nanoseconds max;
+};
+
+std::ostream &operator<<(std::ostream &out, const LatencyStats &stats)
+{
+	auto us = [](nanoseconds ns) {
+		return duration_cast<duration<double, std::micro>>(ns).count();
+	};
+
+	out << std::fixed << std::setprecision(1)
+	    << "min " << us(stats.min) << "us, avg " << us(stats.avg)
+	    << "us, p99 " << us(stats.p99) << "us, max " << us(stats.max) << "us";
+
+	return out;
+}
+
+int32_t controlValue(const ControlList &controls, unsigned int id)
+{
+	if (!controls.contains(id))
+		return 0;
+
+	return controls.get(id).get<int32_t>();
+}
+
+} /* namespace */
+
+void Replayer::report(std::ostream &out, bool verbose) const
+{
+	static constexpr size_t kMinStableFrames = 3;
+
+	if (results_.empty())
+		return;
+
+	if (verbose) {
+		out << "frame,prepare_us,process_us,exposure,gain,params_match" << std::endl;
+
+		for (const ReplayResult &result : results_) {
+			out << result.sequence << ","
+			    << result.prepareTime.count() / 1000.0 << ","
+			    << result.processTime.count() / 1000.0 << ","
+			    << controlValue(result.sensorControls, V4L2_CID_EXPOSURE) << ","
+			    << controlValue(result.sensorControls, V4L2_CID_ANALOGUE_GAIN) << ",";
+			if (result.paramsMatch)
+				out << *result.paramsMatch;
+			out << std::endl;
+		}
+	}
+
+	std::vector<nanoseconds> prepare;
+	std::vector<nanoseconds> process;
+	size_t paramsChecked = 0;
+	size_t paramsMismatch = 0;
+	for (const ReplayResult &result : results_) {
+		prepare.push_back(result.prepareTime);
+		process.push_back(result.processTime);
+
+		if (result.paramsMatch) {
+			paramsChecked++;
+			if (!*result.paramsMatch)
+				paramsMismatch++;
+		}
+	}
+
+	out << "Replayed " << results_.size() << " frames" << std::endl;
+	out << "prepare: " << LatencyStats(prepare) << std::endl;
+	out << "process: " << LatencyStats(process) << std::endl;
+
+	if (paramsChecked)
+		out << "Parameters differ from the capture in " << paramsMismatch
+		    << " of " << paramsChecked << " frames" << std::endl;
+
+	/*
+	 * Consider the exposure converged from the frame after the last one
+	 * whose requested exposure and gain deviate by more than 2% from the
+	 * final values, provided it then stays stable for a few frames.
+	 */
+	const ControlList &last = results_.back().sensorControls;
+	int32_t finalExposure = controlValue(last, V4L2_CID_EXPOSURE);
+	int32_t finalGain = controlValue(last, V4L2_CID_ANALOGUE_GAIN);
+
+	auto deviates = [](int32_t value, int32_t target) {
+		return std::abs(value - target) > std::abs(target) / 50;
+	};
+
+	size_t converged = 0;
+	for (size_t i = 0; i < results_.size(); ++i) {
+		const ControlList &ctrls = results_[i].sensorControls;
+		if (deviates(controlValue(ctrls, V4L2_CID_EXPOSURE), finalExposure) ||
+		    deviates(controlValue(ctrls, V4L2_CID_ANALOGUE_GAIN), finalGain))
+			converged = i + 1;
+	}
+
+	if (converged + kMinStableFrames <= results_.size())
+		out << "Exposure converged after " << converged
+		    << " frames (exposure " << finalExposure << ", gain "
+		    << finalGain << ")" << std::endl;
+	else
+		out << "Exposure did not converge" << std::endl;
+}
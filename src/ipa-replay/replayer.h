@@ -0,0 +1,117 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * replayer.h - ipa-replay - Replay captured statistics through an IPA module
+ */
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <libcamera/base/span.h>
+
+#include <libcamera/controls.h>
+
+#include <libcamera/ipa/core_ipa_interface.h>
+
+#include "libcamera/internal/control_serializer.h"
+#include "libcamera/internal/stats_capture.h"
+
+namespace libcamera {
+class IPAInterface;
+}
+
+struct ReplayFrame {
+	uint32_t sequence;
+	uint64_t timestamp;
+	std::vector<uint8_t> params;
+	std::vector<uint8_t> stats;
+	libcamera::ControlList sensorControls;
+};
+
+struct ReplayResult {
+	uint32_t sequence;
+	std::chrono::nanoseconds prepareTime;
+	std::chrono::nanoseconds processTime;
+	libcamera::ControlList sensorControls;
+	libcamera::ControlList metadata;
+	std::optional<bool> paramsMatch;
+};
+
+class Replayer
+{
+public:
+	static std::unique_ptr<Replayer> create(const std::string &pipeline);
+
+	virtual ~Replayer();
+
+	int load(libcamera::StatsCaptureReader &reader);
+	int run(libcamera::IPAInterface *ipa, const std::string &configFile);
+
+	void report(std::ostream &out, bool verbose) const;
+
+protected:
+	struct Buffer {
+		libcamera::IPABuffer ipaBuffer;
+		libcamera::Span<uint8_t> mem;
+	};
+
+	Replayer();
+
+	virtual size_t paramsSize() const = 0;
+	virtual size_t statsSize() const = 0;
+
+	virtual int configure(libcamera::IPAInterface *ipa,
+			      const std::string &configFile) = 0;
+	virtual void start() = 0;
+	virtual void stop() = 0;
+	virtual void prepare(const ReplayFrame &frame) = 0;
+	virtual void process(const ReplayFrame &frame) = 0;
+
+	const libcamera::ControlInfoMap *controlInfo(unsigned int entity) const;
+
+	int createBuffer(unsigned int id, size_t size, Buffer *buffer);
+	void releaseBuffer(Buffer *buffer);
+
+	libcamera::IPACameraSensorInfo sensorInfo_;
+	std::map<unsigned int, libcamera::ControlInfoMap> controlInfo_;
+	std::vector<uint32_t> pipelineConfig_;
+
+	Buffer params_;
+	Buffer stats_;
+
+	ReplayResult *current_;
+
+private:
+	libcamera::ControlSerializer serializer_;
+	std::vector<ReplayFrame> frames_;
+	std::vector<ReplayResult> results_;
+};
+
+#define REGISTER_REPLAYER(pipeline, replayer)					\
+static std::unique_ptr<Replayer> create##replayer()				\
+{										\
+	return std::make_unique<replayer>();					\
+}										\
+static ReplayerRegistration registration##replayer(pipeline, create##replayer);
+
+class ReplayerRegistration
+{
+public:
+	using Factory = std::unique_ptr<Replayer> (*)();
+
+	ReplayerRegistration(const char *pipeline, Factory factory);
+
+	static const std::map<std::string, Factory> &factories();
+
+private:
+	static std::map<std::string, Factory> &registry();
+};
@@ -0,0 +1,110 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * rkisp1_replayer.cpp - ipa-replay - RkISP1 IPA replay
+ */
+
+#include <errno.h>
+#include <iostream>
+
+#include <linux/rkisp1-config.h>
+
+#include <libcamera/control_ids.h>
+
+#include <libcamera/ipa/rkisp1_ipa_interface.h>
+
+#include "replayer.h"
+
+using namespace libcamera;
+using namespace libcamera::ipa::rkisp1;
+
+class RkISP1Replayer : public Replayer
+{
+protected:
+	size_t paramsSize() const override { return sizeof(rkisp1_params_cfg); }
+	size_t statsSize() const override { return sizeof(rkisp1_stat_buffer); }
+
+	int configure(IPAInterface *ipa, const std::string &configFile) override;
+	void start() override;
+	void stop() override;
+	void prepare(const ReplayFrame &frame) override;
+	void process(const ReplayFrame &frame) override;
+
+private:
+	void setSensorControls(unsigned int frame, const ControlList &sensorControls);
+	void metadataReady(unsigned int frame, const ControlList &metadata);
+
+	IPARkISP1Interface *ipa_;
+};
+
+/* The pipeline configuration stores the ISP hardware revision. */
+int RkISP1Replayer::configure(IPAInterface *ipa, const std::string &configFile)
+{
+	const ControlInfoMap *sensorControls = controlInfo(0);
+	if (!sensorControls || pipelineConfig_.size() < 1) {
+		std::cerr << "Incomplete RkISP1 configuration in capture"
+			  << std::endl;
+		return -EINVAL;
+	}
+
+	ipa_ = static_cast<IPARkISP1Interface *>(ipa);
+	ipa_->setSensorControls.connect(this, &RkISP1Replayer::setSensorControls);
+	ipa_->metadataReady.connect(this, &RkISP1Replayer::metadataReady);
+
+	int ret = ipa_->init(IPASettings{ configFile, sensorInfo_.model },
+			     pipelineConfig_[0]);
+	if (ret)
+		return ret;
+
+	std::map<uint32_t, ControlInfoMap> entityControls;
+	entityControls.emplace(0, *sensorControls);
+
+	ret = ipa_->configure(sensorInfo_, {}, entityControls);
+	if (ret)
+		return ret;
+
+	ipa_->mapBuffers({ params_.ipaBuffer, stats_.ipaBuffer });
+
+	return 0;
+}
+
+void RkISP1Replayer::start()
+{
+	ipa_->start();
+}
+
+void RkISP1Replayer::stop()
+{
+	ipa_->stop();
+	ipa_->unmapBuffers({ params_.ipaBuffer.id, stats_.ipaBuffer.id });
+}
+
+void RkISP1Replayer::prepare(const ReplayFrame &frame)
+{
+	ipa_->queueRequest(frame.sequence, params_.ipaBuffer.id,
+			   ControlList(controls::controls));
+}
+
+void RkISP1Replayer::process(const ReplayFrame &frame)
+{
+	ipa_->processStatsBuffer(frame.sequence, stats_.ipaBuffer.id,
+				 frame.sensorControls);
+}
+
+void RkISP1Replayer::setSensorControls([[maybe_unused]] unsigned int frame,
+				       const ControlList &sensorControls)
+{
+	/* Controls emitted outside of a frame, by start(), are ignored. */
+	if (current_)
+		current_->sensorControls = sensorControls;
+}
+
+void RkISP1Replayer::metadataReady([[maybe_unused]] unsigned int frame,
+				   const ControlList &metadata)
+{
+	if (current_)
+		current_->metadata = metadata;
+}
+
+REGISTER_REPLAYER("PipelineHandlerRkISP1", RkISP1Replayer)
@@ -145,7 +145,10 @@ Af::Af()
 /**
  * \copydoc libcamera::ipa::Algorithm::prepare
  */
-void Af::prepare(IPAContext &context, ipu3_uapi_params *params)
+void Af::prepare(IPAContext &context,
+		 [[maybe_unused]] const uint32_t frame,
+		 [[maybe_unused]] IPAFrameContext &frameContext,
+		 ipu3_uapi_params *params)
 {
 	const struct ipu3_uapi_grid_config &grid = context.configuration.af.afGrid;
 	params->acc_param.af.grid_cfg = grid;
@@ -185,11 +188,11 @@ int Af::configure(IPAContext &context, const IPAConfigInfo &configInfo)
 	maxStep_ = kMaxFocusSteps;
 
 	/* Initial focus value */
-	context.frameContext.af.focus = 0;
+	context.activeState.af.focus = 0;
 	/* Maximum variance of the AF statistics */
-	context.frameContext.af.maxVariance = 0;
+	context.activeState.af.maxVariance = 0;
 	/* The stable AF value flag. if it is true, the AF should be in a stable state. */
-	context.frameContext.af.stable = false;
+	context.activeState.af.stable = false;
 
 	return 0;
 }
@@ -211,10 +214,10 @@ void Af::afCoarseScan(IPAContext &context)
 
 	if (afScan(context, kCoarseSearchStep)) {
 		coarseCompleted_ = true;
-		context.frameContext.af.maxVariance = 0;
-		focus_ = context.frameContext.af.focus -
-			 (context.frameContext.af.focus * kFineRange);
-		context.frameContext.af.focus = focus_;
+		context.activeState.af.maxVariance = 0;
+		focus_ = context.activeState.af.focus -
+			 (context.activeState.af.focus * kFineRange);
+		context.activeState.af.focus = focus_;
 		previousVariance_ = 0;
 		maxStep_ = std::clamp(focus_ + static_cast<uint32_t>((focus_ * kFineRange)),
 				      0U, kMaxFocusSteps);
@@ -237,7 +240,7 @@ void Af::afFineScan(IPAContext &context)
 		return;
 
 	if (afScan(context, kFineSearchStep)) {
-		context.frameContext.af.stable = true;
+		context.activeState.af.stable = true;
 		fineCompleted_ = true;
 	}
 }
@@ -254,10 +257,10 @@ void Af::afReset(IPAContext &context)
 	if (afNeedIgnoreFrame())
 		return;
 
-	context.frameContext.af.maxVariance = 0;
-	context.frameContext.af.focus = 0;
+	context.activeState.af.maxVariance = 0;
+	context.activeState.af.focus = 0;
 	focus_ = 0;
-	context.frameContext.af.stable = false;
+	context.activeState.af.stable = false;
 	ignoreCounter_ = kIgnoreFrame;
 	previousVariance_ = 0.0;
 	coarseCompleted_ = false;
@@ -280,7 +283,7 @@ bool Af::afScan(IPAContext &context, int min_step)
 {
 	if (focus_ > maxStep_) {
 		/* If reach the max step, move lens to the position. */
-		context.frameContext.af.focus = bestFocus_;
+		context.activeState.af.focus = bestFocus_;
 		return true;
 	} else {
 		/*
@@ -288,8 +291,8 @@ bool Af::afScan(IPAContext &context, int min_step)
 		 * derivative. If the direction changes, it means we have
 		 * passed a maximum one step before.
 		 */
-		if ((currentVariance_ - context.frameContext.af.maxVariance) >=
-		    -(context.frameContext.af.maxVariance * 0.1)) {
+		if ((currentVariance_ - context.activeState.af.maxVariance) >=
+		    -(context.activeState.af.maxVariance * 0.1)) {
 			/*
 			 * Positive and zero derivative:
 			 * The variance is still increasing. The focus could be
@@ -298,8 +301,8 @@ bool Af::afScan(IPAContext &context, int min_step)
 			 */
 			bestFocus_ = focus_;
 			focus_ += min_step;
-			context.frameContext.af.focus = focus_;
-			context.frameContext.af.maxVariance = currentVariance_;
+			context.activeState.af.focus = focus_;
+			context.activeState.af.maxVariance = currentVariance_;
 		} else {
 			/*
 			 * Negative derivative:
@@ -307,7 +310,7 @@ bool Af::afScan(IPAContext &context, int min_step)
 			 * variance is found. Set focus step to previous good one
 			 * then return immediately.
 			 */
-			context.frameContext.af.focus = bestFocus_;
+			context.activeState.af.focus = bestFocus_;
 			return true;
 		}
 	}
@@ -395,13 +398,13 @@ double Af::afEstimateVariance(y_table_item_t *y_item, uint32_t len,
 bool Af::afIsOutOfFocus(IPAContext context)
 {
 	const uint32_t diff_var = std::abs(currentVariance_ -
-					   context.frameContext.af.maxVariance);
-	const double var_ratio = diff_var / context.frameContext.af.maxVariance;
+					   context.activeState.af.maxVariance);
+	const double var_ratio = diff_var / context.activeState.af.maxVariance;
 
 	LOG(IPU3Af, Debug) << "Variance change rate: "
 			   << var_ratio
 			   << " Current VCM step: "
-			   << context.frameContext.af.focus;
+			   << context.activeState.af.focus;
 
 	if (var_ratio > kMaxChange)
 		return true;
@@ -412,6 +415,8 @@ bool Af::afIsOutOfFocus(IPAContext context)
 /**
  * \brief Determine the max contrast image and lens position.
  * \param[in] context The IPA context.
+ * \param[in] frame The frame context sequence number
+ * \param[in] frameContext The current frame context
  * \param[in] stats The statistics buffer of IPU3.
  *
  * Ideally, a clear image also has a relatively higher contrast. So, every
@@ -425,7 +430,9 @@ bool Af::afIsOutOfFocus(IPAContext context)
  *
  * [1] Hill Climbing Algorithm, https://en.wikipedia.org/wiki/Hill_climbing
  */
-void Af::process(IPAContext &context, const ipu3_uapi_stats_3a *stats)
+void Af::process(IPAContext &context, [[maybe_unused]] const uint32_t frame,
+		 [[maybe_unused]] IPAFrameContext &frameContext,
+		 const ipu3_uapi_stats_3a *stats)
 {
 	y_table_item_t y_item[IPU3_UAPI_AF_Y_TABLE_MAX_SIZE / sizeof(y_table_item_t)];
 	uint32_t afRawBufferLen;
@@ -447,7 +454,7 @@ void Af::process(IPAContext &context, const ipu3_uapi_stats_3a *stats)
 	else
 		currentVariance_ = afEstimateVariance(y_item, afRawBufferLen, true);
 
-	if (!context.frameContext.af.stable) {
+	if (!context.activeState.af.stable) {
 		afCoarseScan(context);
 		afFineScan(context);
 	} else {
@@ -16,6 +16,7 @@
 
 #include <libcamera/ipa/core_ipa_interface.h>
 
+#include "libipa/grid_statistics.h"
 #include "libipa/histogram.h"
 
 /**
@@ -87,9 +88,7 @@ int Agc::configure(IPAContext &context,
 		   [[maybe_unused]] const IPAConfigInfo &configInfo)
 {
 	const IPASessionConfiguration &configuration = context.configuration;
-	IPAFrameContext &frameContext = context.frameContext;
-
-	stride_ = configuration.grid.stride;
+	IPAActiveState &activeState = context.activeState;
 
 	minShutterSpeed_ = configuration.agc.minShutterSpeed;
 	maxShutterSpeed_ = std::min(configuration.agc.maxShutterSpeed,
@@ -99,8 +98,8 @@ int Agc::configure(IPAContext &context,
 	maxAnalogueGain_ = std::min(configuration.agc.maxAnalogueGain, kMaxAnalogueGain);
 
 	/* Configure the default exposure and gain. */
-	frameContext.agc.gain = std::max(minAnalogueGain_, kMinAnalogueGain);
-	frameContext.agc.exposure = 10ms / configuration.sensor.lineDuration;
+	activeState.agc.gain = std::max(minAnalogueGain_, kMinAnalogueGain);
+	activeState.agc.exposure = 10ms / configuration.sensor.lineDuration;
 
 	frameCount_ = 0;
 	return 0;
@@ -108,38 +107,19 @@ int Agc::configure(IPAContext &context,
 
 /**
  * \brief Estimate the mean value of the top 2% of the histogram
- * \param[in] stats The statistics computed by the ImgU
- * \param[in] grid The grid used to store the statistics in the IPU3
+ * \param[in] gridStats The statistics grid reduced by the IPA module
  * \return The mean value of the top 2% of the histogram
  */
-double Agc::measureBrightness(const ipu3_uapi_stats_3a *stats,
-			      const ipu3_uapi_grid_config &grid) const
+double Agc::measureBrightness(const GridStatistics &gridStats) const
 {
-	/* Initialise the histogram array */
-	uint32_t hist[knumHistogramBins] = { 0 };
-
-	for (unsigned int cellY = 0; cellY < grid.height; cellY++) {
-		for (unsigned int cellX = 0; cellX < grid.width; cellX++) {
-			uint32_t cellPosition = cellY * stride_ + cellX;
-
-			const ipu3_uapi_awb_set_item *cell =
-				reinterpret_cast<const ipu3_uapi_awb_set_item *>(
-					&stats->awb_raw_buffer.meta_data[cellPosition]
-				);
-
-			uint8_t gr = cell->Gr_avg;
-			uint8_t gb = cell->Gb_avg;
-			/*
-			 * Store the average green value to estimate the
-			 * brightness. Even the overexposed pixels are
-			 * taken into account.
-			 */
-			hist[(gr + gb) / 2]++;
-		}
-	}
+	/*
+	 * Use the histogram of the average green values to estimate the
+	 * brightness. Even the overexposed cells are taken into account.
+	 */
+	Span<const uint32_t> hist = gridStats.histogram(GridStatistics::Green);
 
 	/* Estimate the quantile mean of the top 2% of the histogram. */
-	return Histogram(Span<uint32_t>(hist)).interQuantileMean(0.98, 1.0);
+	return Histogram(hist).interQuantileMean(0.98, 1.0);
 }
 
 /**
@@ -179,15 +159,15 @@ utils::Duration Agc::filterExposure(utils::Duration exposureValue)
 
 /**
  * \brief Estimate the new exposure and gain values
- * \param[inout] frameContext The shared IPA frame Context
+ * \param[inout] context The shared IPA context
+ * \param[in] frameContext The FrameContext for this frame
  * \param[in] yGain The gain calculated based on the relative luminance target
  * \param[in] iqMeanGain The gain calculated based on the relative luminance target
  */
-void Agc::computeExposure(IPAContext &context, double yGain,
-			  double iqMeanGain)
+void Agc::computeExposure(IPAContext &context, IPAFrameContext &frameContext,
+			  double yGain, double iqMeanGain)
 {
 	const IPASessionConfiguration &configuration = context.configuration;
-	IPAFrameContext &frameContext = context.frameContext;
 	/* Get the effective exposure and gain applied on the sensor. */
 	uint32_t exposure = frameContext.sensor.exposure;
 	double analogueGain = frameContext.sensor.gain;
@@ -250,15 +230,15 @@ void Agc::computeExposure(IPAContext &context, double yGain,
 			    << stepGain;
 
 	/* Update the estimated exposure and gain. */
-	frameContext.agc.exposure = shutterTime / configuration.sensor.lineDuration;
-	frameContext.agc.gain = stepGain;
+	IPAActiveState &activeState = context.activeState;
+	activeState.agc.exposure = shutterTime / configuration.sensor.lineDuration;
+	activeState.agc.gain = stepGain;
 }
 
 /**
  * \brief Estimate the relative luminance of the frame with a given gain
- * \param[in] frameContext The shared IPA frame context
- * \param[in] grid The grid used to store the statistics in the IPU3
- * \param[in] stats The IPU3 statistics and ISP results
+ * \param[in] activeState The IPA active state
+ * \param[in] gridStats The statistics grid reduced by the IPA module
  * \param[in] gain The gain to apply to the frame
  * \return The relative luminance
  *
@@ -279,37 +259,23 @@ void Agc::computeExposure(IPAContext &context, double yGain,
  * More detailed information can be found in:
  * https://en.wikipedia.org/wiki/Relative_luminance
  */
-double Agc::estimateLuminance(IPAFrameContext &frameContext,
-			      const ipu3_uapi_grid_config &grid,
-			      const ipu3_uapi_stats_3a *stats,
-			      double gain)
+double Agc::estimateLuminance(IPAActiveState &activeState,
+			      const GridStatistics &gridStats, double gain)
 {
-	double redSum = 0, greenSum = 0, blueSum = 0;
+	const Size &grid = gridStats.gridSize();
 
 	/* Sum the per-channel averages, saturated to 255. */
-	for (unsigned int cellY = 0; cellY < grid.height; cellY++) {
-		for (unsigned int cellX = 0; cellX < grid.width; cellX++) {
-			uint32_t cellPosition = cellY * stride_ + cellX;
-
-			const ipu3_uapi_awb_set_item *cell =
-				reinterpret_cast<const ipu3_uapi_awb_set_item *>(
-					&stats->awb_raw_buffer.meta_data[cellPosition]
-				);
-			const uint8_t G_avg = (cell->Gr_avg + cell->Gb_avg) / 2;
-
-			redSum += std::min(cell->R_avg * gain, 255.0);
-			greenSum += std::min(G_avg * gain, 255.0);
-			blueSum += std::min(cell->B_avg * gain, 255.0);
-		}
-	}
+	double redSum = gridStats.clippedSum(GridStatistics::Red, gain);
+	double greenSum = gridStats.clippedSum(GridStatistics::Green, gain);
+	double blueSum = gridStats.clippedSum(GridStatistics::Blue, gain);
 
 	/*
 	 * Apply the AWB gains to approximate colours correctly, use the Rec.
 	 * 601 formula to calculate the relative luminance, and normalize it.
 	 */
-	double ySum = redSum * frameContext.awb.gains.red * 0.299
-		    + greenSum * frameContext.awb.gains.green * 0.587
-		    + blueSum * frameContext.awb.gains.blue * 0.114;
+	double ySum = redSum * activeState.awb.gains.red * 0.299
+		    + greenSum * activeState.awb.gains.green * 0.587
+		    + blueSum * activeState.awb.gains.blue * 0.114;
 
 	return ySum / (grid.height * grid.width) / 255;
 }
@@ -317,12 +283,16 @@ double Agc::estimateLuminance(IPAFrameContext &frameContext,
 /**
  * \brief Process IPU3 statistics, and run AGC operations
  * \param[in] context The shared IPA context
+ * \param[in] frame The current frame sequence number
+ * \param[in] frameContext The current frame context
  * \param[in] stats The IPU3 statistics and ISP results
  *
  * Identify the current image brightness, and use that to estimate the optimal
  * new exposure and gain for the scene.
  */
-void Agc::process(IPAContext &context, const ipu3_uapi_stats_3a *stats)
+void Agc::process(IPAContext &context, [[maybe_unused]] const uint32_t frame,
+		  IPAFrameContext &frameContext,
+		  [[maybe_unused]] const ipu3_uapi_stats_3a *stats)
 {
 	/*
 	 * Estimate the gain needed to have the proportion of pixels in a given
@@ -330,7 +300,7 @@ void Agc::process(IPAContext &context, const ipu3_uapi_stats_3a *stats)
 	 * cumulative histogram, and we want it to be as close as possible to a
 	 * configured target.
 	 */
-	double iqMean = measureBrightness(stats, context.configuration.grid.bdsGrid);
+	double iqMean = measureBrightness(context.gridStats);
 	double iqMeanGain = kEvGainTarget * knumHistogramBins / iqMean;
 
 	/*
@@ -344,9 +314,8 @@ void Agc::process(IPAContext &context, const ipu3_uapi_stats_3a *stats)
 	double yTarget = kRelativeLuminanceTarget;
 
 	for (unsigned int i = 0; i < 8; i++) {
-		double yValue = estimateLuminance(context.frameContext,
-						  context.configuration.grid.bdsGrid,
-						  stats, yGain);
+		double yValue = estimateLuminance(context.activeState,
+						  context.gridStats, yGain);
 		double extraGain = std::min(10.0, yTarget / (yValue + .001));
 
 		yGain *= extraGain;
@@ -357,7 +326,7 @@ void Agc::process(IPAContext &context, const ipu3_uapi_stats_3a *stats)
 			break;
 	}
 
-	computeExposure(context, yGain, iqMeanGain);
+	computeExposure(context, frameContext, yGain, iqMeanGain);
 	frameCount_++;
 }
 
@@ -28,18 +28,17 @@ public:
 	~Agc() = default;
 
 	int configure(IPAContext &context, const IPAConfigInfo &configInfo) override;
-	void process(IPAContext &context, const ipu3_uapi_stats_3a *stats) override;
+	void process(IPAContext &context, const uint32_t frame,
+		     IPAFrameContext &frameContext,
+		     const ipu3_uapi_stats_3a *stats) override;
 
 private:
-	double measureBrightness(const ipu3_uapi_stats_3a *stats,
-				 const ipu3_uapi_grid_config &grid) const;
+	double measureBrightness(const GridStatistics &gridStats) const;
 	utils::Duration filterExposure(utils::Duration currentExposure);
-	void computeExposure(IPAContext &context, double yGain,
-			     double iqMeanGain);
-	double estimateLuminance(IPAFrameContext &frameContext,
-				 const ipu3_uapi_grid_config &grid,
-				 const ipu3_uapi_stats_3a *stats,
-				 double gain);
+	void computeExposure(IPAContext &context, IPAFrameContext &frameContext,
+			     double yGain, double iqMeanGain);
+	double estimateLuminance(IPAActiveState &activeState,
+				 const GridStatistics &gridStats, double gain);
 
 	uint64_t frameCount_;
 
@@ -50,8 +49,6 @@ private:
 	double maxAnalogueGain_;
 
 	utils::Duration filteredExposure_;
-
-	uint32_t stride_;
 };
 
 } /* namespace ipa::ipu3::algorithms */
@@ -42,34 +42,6 @@ static constexpr double kMaxCellSaturationRatio = 0.8;
  */
 static constexpr uint32_t kMinCellsPerZoneRatio = 255 * 90 / 100;
 
-/**
- * \struct Accumulator
- * \brief RGB statistics for a given zone
- *
- * Accumulate red, green and blue values for each non-saturated item over a
- * zone. Items can for instance be pixels, but also the average of groups of
- * pixels, depending on who uses the accumulator.
- * \todo move this description and structure into a common header
- *
- * Zones which are saturated beyond the threshold defined in
- * ipu3_uapi_awb_config_s are not included in the average.
- *
- * \var Accumulator::counted
- * \brief Number of unsaturated cells used to calculate the sums
- *
- * \var Accumulator::sum
- * \brief A structure containing the average red, green and blue sums
- *
- * \var Accumulator::sum.red
- * \brief Sum of the average red values of each unsaturated cell in the zone
- *
- * \var Accumulator::sum.green
- * \brief Sum of the average green values of each unsaturated cell in the zone
- *
- * \var Accumulator::sum.blue
- * \brief Sum of the average blue values of each unsaturated cell in the zone
- */
-
 /**
  * \struct Awb::AwbStatus
  * \brief AWB parameters calculated
@@ -171,10 +143,10 @@ static const struct ipu3_uapi_ccm_mat_config imguCssCcmDefault = {
  * cells are ignored. The grid configuration is computed by
  * IPAIPU3::calculateBdsGrid().
  *
- * Before calculating the gains, the algorithm aggregates the cell averages for
- * each zone in generateAwbStats(). Cells that have a too high ratio of
- * saturated pixels are ignored, and only zones that contain enough
- * non-saturated cells are then used by the algorithm.
+ * The cell averages are aggregated for each zone by the IPA module, in the
+ * same pass over the statistics as the histograms used by the AGC algorithm.
+ * Cells that have a too high ratio of saturated pixels are ignored, and only
+ * zones that contain enough non-saturated cells are then used by the algorithm.
  *
  * The Grey World algorithm will then estimate the red and blue gains to apply, and
  * store the results in the metadata. The green gain is always set to 1.
@@ -200,11 +172,14 @@ int Awb::configure(IPAContext &context,
 		   [[maybe_unused]] const IPAConfigInfo &configInfo)
 {
 	const ipu3_uapi_grid_config &grid = context.configuration.grid.bdsGrid;
-	stride_ = context.configuration.grid.stride;
 
 	cellsPerZoneX_ = std::round(grid.width / static_cast<double>(kAwbStatsSizeX));
 	cellsPerZoneY_ = std::round(grid.height / static_cast<double>(kAwbStatsSizeY));
 
+	context.gridStats.setZones({ kAwbStatsSizeX, kAwbStatsSizeY },
+				   { cellsPerZoneX_, cellsPerZoneY_ },
+				   kMinCellsPerZoneRatio);
+
 	/*
 	 * Configure the minimum proportion of cells counted within a zone
 	 * for it to be relevant for the grey world algorithm.
@@ -247,77 +222,24 @@ uint32_t Awb::estimateCCT(double red, double green, double blue)
 }
 
 /* Generate an RGB vector with the average values for each zone */
-void Awb::generateZones()
+void Awb::generateZones(const GridStatistics &gridStats)
 {
 	zones_.clear();
 
-	for (unsigned int i = 0; i < kAwbStatsSizeX * kAwbStatsSizeY; i++) {
+	for (const GridStatistics::Zone &awbZone : gridStats.zones()) {
 		RGB zone;
-		double counted = awbStats_[i].counted;
+		double counted = awbZone.counted;
 		if (counted >= cellsPerZoneThreshold_) {
-			zone.G = awbStats_[i].sum.green / counted;
+			zone.G = awbZone.sum[GridStatistics::Green] / counted;
 			if (zone.G >= kMinGreenLevelInZone) {
-				zone.R = awbStats_[i].sum.red / counted;
-				zone.B = awbStats_[i].sum.blue / counted;
+				zone.R = awbZone.sum[GridStatistics::Red] / counted;
+				zone.B = awbZone.sum[GridStatistics::Blue] / counted;
 				zones_.push_back(zone);
 			}
 		}
 	}
 }
 
-/* Translate the IPU3 statistics into the default statistics zone array */
-void Awb::generateAwbStats(const ipu3_uapi_stats_3a *stats)
-{
-	/*
-	 * Generate a (kAwbStatsSizeX x kAwbStatsSizeY) array from the IPU3 grid which is
-	 * (grid.width x grid.height).
-	 */
-	for (unsigned int cellY = 0; cellY < kAwbStatsSizeY * cellsPerZoneY_; cellY++) {
-		for (unsigned int cellX = 0; cellX < kAwbStatsSizeX * cellsPerZoneX_; cellX++) {
-			uint32_t cellPosition = cellY * stride_ + cellX;
-			uint32_t zoneX = cellX / cellsPerZoneX_;
-			uint32_t zoneY = cellY / cellsPerZoneY_;
-
-			uint32_t awbZonePosition = zoneY * kAwbStatsSizeX + zoneX;
-
-			/* Cast the initial IPU3 structure to simplify the reading */
-			const ipu3_uapi_awb_set_item *currentCell =
-				reinterpret_cast<const ipu3_uapi_awb_set_item *>(
-					&stats->awb_raw_buffer.meta_data[cellPosition]
-				);
-
-			/*
-			 * Use cells which have less than 90%
-			 * saturation as an initial means to include
-			 * otherwise bright cells which are not fully
-			 * saturated.
-			 *
-			 * \todo The 90% saturation rate may require
-			 * further empirical measurements and
-			 * optimisation during camera tuning phases.
-			 */
-			if (currentCell->sat_ratio <= kMinCellsPerZoneRatio) {
-				/* The cell is not saturated, use the current cell */
-				awbStats_[awbZonePosition].counted++;
-				uint32_t greenValue = currentCell->Gr_avg + currentCell->Gb_avg;
-				awbStats_[awbZonePosition].sum.green += greenValue / 2;
-				awbStats_[awbZonePosition].sum.red += currentCell->R_avg;
-				awbStats_[awbZonePosition].sum.blue += currentCell->B_avg;
-			}
-		}
-	}
-}
-
-void Awb::clearAwbStats()
-{
-	for (unsigned int i = 0; i < kAwbStatsSizeX * kAwbStatsSizeY; i++) {
-		awbStats_[i].sum.blue = 0;
-		awbStats_[i].sum.red = 0;
-		awbStats_[i].sum.green = 0;
-		awbStats_[i].counted = 0;
-	}
-}
-
 void Awb::awbGreyWorld()
 {
 	LOG(IPU3Awb, Debug) << "Grey world AWB";
@@ -367,13 +289,9 @@ void Awb::awbGreyWorld()
 	asyncResults_.blueGain = blueGain;
 }
 
-void Awb::calculateWBGains(const ipu3_uapi_stats_3a *stats)
+void Awb::calculateWBGains(const GridStatistics &gridStats)
 {
-	ASSERT(stats->stats_3a_status.awb_en);
-
-	clearAwbStats();
-	generateAwbStats(stats);
-	generateZones();
+	generateZones(gridStats);
 
 	LOG(IPU3Awb, Debug) << "Valid zones: " << zones_.size();
 
@@ -387,19 +305,23 @@ void Awb::calculateWBGains(const ipu3_uapi_stats_3a *stats)
 /**
  * \copydoc libcamera::ipa::Algorithm::process
  */
-void Awb::process(IPAContext &context, const ipu3_uapi_stats_3a *stats)
+void Awb::process(IPAContext &context, [[maybe_unused]] const uint32_t frame,
+		  [[maybe_unused]] IPAFrameContext &frameContext,
+		  const ipu3_uapi_stats_3a *stats)
 {
-	calculateWBGains(stats);
+	ASSERT(stats->stats_3a_status.awb_en);
+
+	calculateWBGains(context.gridStats);
 
 	/*
 	 * Gains are only recalculated if enough zones were detected.
 	 * The results are cached, so if no results were calculated, we set the
 	 * cached values from asyncResults_ here.
 	 */
-	context.frameContext.awb.gains.blue = asyncResults_.blueGain;
-	context.frameContext.awb.gains.green = asyncResults_.greenGain;
-	context.frameContext.awb.gains.red = asyncResults_.redGain;
-	context.frameContext.awb.temperatureK = asyncResults_.temperatureK;
+	context.activeState.awb.gains.blue = asyncResults_.blueGain;
+	context.activeState.awb.gains.green = asyncResults_.greenGain;
+	context.activeState.awb.gains.red = asyncResults_.redGain;
+	context.activeState.awb.temperatureK = asyncResults_.temperatureK;
 }
 
 constexpr uint16_t Awb::threshold(float value)
@@ -411,7 +333,10 @@ constexpr uint16_t Awb::threshold(float value)
 /**
  * \copydoc libcamera::ipa::Algorithm::prepare
  */
-void Awb::prepare(IPAContext &context, ipu3_uapi_params *params)
+void Awb::prepare(IPAContext &context,
+		  [[maybe_unused]] const uint32_t frame,
+		  [[maybe_unused]] IPAFrameContext &frameContext,
+		  ipu3_uapi_params *params)
 {
 	/*
 	 * Green saturation thresholds are reduced because we are using the
@@ -450,10 +375,10 @@ void Awb::prepare(IPAContext &context, ipu3_uapi_params *params)
 	params->acc_param.bnr.opt_center_sqr.y_sqr_reset = params->acc_param.bnr.opt_center.y_reset
 							* params->acc_param.bnr.opt_center.y_reset;
 	/* Convert to u3.13 fixed point values */
-	params->acc_param.bnr.wb_gains.gr = 8192 * context.frameContext.awb.gains.green;
-	params->acc_param.bnr.wb_gains.r  = 8192 * context.frameContext.awb.gains.red;
-	params->acc_param.bnr.wb_gains.b  = 8192 * context.frameContext.awb.gains.blue;
-	params->acc_param.bnr.wb_gains.gb = 8192 * context.frameContext.awb.gains.green;
+	params->acc_param.bnr.wb_gains.gr = 8192 * context.activeState.awb.gains.green;
+	params->acc_param.bnr.wb_gains.r  = 8192 * context.activeState.awb.gains.red;
+	params->acc_param.bnr.wb_gains.b  = 8192 * context.activeState.awb.gains.blue;
+	params->acc_param.bnr.wb_gains.gb = 8192 * context.activeState.awb.gains.green;
 
 	LOG(IPU3Awb, Debug) << "Color temperature estimated: " << asyncResults_.temperatureK;
 
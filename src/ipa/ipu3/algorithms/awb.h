@@ -23,15 +23,6 @@ namespace ipa::ipu3::algorithms {
 static constexpr uint32_t kAwbStatsSizeX = 16;
 static constexpr uint32_t kAwbStatsSizeY = 12;
 
-struct Accumulator {
-	unsigned int counted;
-	struct {
-		uint64_t red;
-		uint64_t green;
-		uint64_t blue;
-	} sum;
-};
-
 class Awb : public Algorithm
 {
 public:
@@ -39,8 +30,12 @@ public:
 	~Awb();
 
 	int configure(IPAContext &context, const IPAConfigInfo &configInfo) override;
-	void prepare(IPAContext &context, ipu3_uapi_params *params) override;
-	void process(IPAContext &context, const ipu3_uapi_stats_3a *stats) override;
+	void prepare(IPAContext &context, const uint32_t frame,
+		     IPAFrameContext &frameContext,
+		     ipu3_uapi_params *params) override;
+	void process(IPAContext &context, const uint32_t frame,
+		     IPAFrameContext &frameContext,
+		     const ipu3_uapi_stats_3a *stats) override;
 
 private:
 	/* \todo Make these structs available to all the ISPs ? */
@@ -65,19 +60,15 @@ private:
 	};
 
 private:
-	void calculateWBGains(const ipu3_uapi_stats_3a *stats);
-	void generateZones();
-	void generateAwbStats(const ipu3_uapi_stats_3a *stats);
-	void clearAwbStats();
+	void calculateWBGains(const GridStatistics &gridStats);
+	void generateZones(const GridStatistics &gridStats);
 	void awbGreyWorld();
 	uint32_t estimateCCT(double red, double green, double blue);
 	static constexpr uint16_t threshold(float value);
 
 	std::vector<RGB> zones_;
-	Accumulator awbStats_[kAwbStatsSizeX * kAwbStatsSizeY];
 	AwbStatus asyncResults_;
 
-	uint32_t stride_;
 	uint32_t cellsPerZoneX_;
 	uint32_t cellsPerZoneY_;
 	uint32_t cellsPerZoneThreshold_;
@@ -24,19 +24,34 @@ namespace libcamera::ipa::ipu3 {
  * may also be updated in the start() operation.
  */
 
+/**
+ * \struct IPAActiveState
+ * \brief The active state of the IPA algorithms
+ *
+ * The IPA is fed with the statistics generated from the latest frame captured
+ * by the hardware. The statistics are then processed by the IPA algorithms to
+ * compute ISP parameters required for the next frame capture. The current state
+ * of the algorithms is reflected through the IPAActiveState to store the values
+ * most recently computed by the IPA algorithms.
+ */
+
 /**
  * \struct IPAFrameContext
- * \brief Per-frame context for algorithms
+ * \brief IPU3-specific FrameContext
  *
  * The frame context stores data specific to a single frame processed by the
- * IPA. Each frame processed by the IPA has a context associated with it,
- * accessible through the IPAContext structure.
+ * IPA module. Each frame has a context associated with it, allocated when the
+ * request for the frame is queued to the IPA module and retrieved from the
+ * IPAContext::frameContexts queue by its sequence number.
+ *
+ * \var IPAFrameContext::sensor
+ * \brief Effective sensor values that were applied for the frame
  *
- * \todo Detail how to access contexts for a particular frame
+ * \var IPAFrameContext::sensor.exposure
+ * \brief Exposure time expressed as a number of lines
  *
- * Each of the fields in the frame context belongs to either a specific
- * algorithm, or to the top-level IPA module. A field may be read by any
- * algorithm, but should only be written by its owner.
+ * \var IPAFrameContext::sensor.gain
+ * \brief Analogue gain multiplier
  */
 
 /**
@@ -46,13 +61,15 @@ namespace libcamera::ipa::ipu3 {
  * \var IPAContext::configuration
  * \brief The IPA session configuration, immutable during the session
  *
- * \var IPAContext::frameContext
- * \brief The frame context for the frame being processed
+ * \var IPAContext::activeState
+ * \brief The current state of IPA algorithms
+ *
+ * \var IPAContext::frameContexts
+ * \brief Queue of the per-frame contexts, indexed by frame sequence number
  *
- * \todo While the frame context is supposed to be per-frame, this
- * single frame context stores data related to both the current frame
- * and the previous frames, with fields being updated as the algorithms
- * are run. This needs to be turned into real per-frame data storage.
+ * \var IPAContext::gridStats
+ * \brief The AWB statistics grid of the frame being processed, reduced once by
+ * the IPA module before running the algorithms
  */
 
 /**
@@ -78,17 +95,17 @@ namespace libcamera::ipa::ipu3 {
  */
 
 /**
- * \var IPAFrameContext::af
+ * \var IPAActiveState::af
  * \brief Context for the Automatic Focus algorithm
  *
- * \struct  IPAFrameContext::af
- * \var IPAFrameContext::af.focus
+ * \struct  IPAActiveState::af
+ * \var IPAActiveState::af.focus
  * \brief Current position of the lens
  *
- * \var IPAFrameContext::af.maxVariance
+ * \var IPAActiveState::af.maxVariance
  * \brief The maximum variance of the current image.
  *
- * \var IPAFrameContext::af.stable
+ * \var IPAActiveState::af.stable
  * \brief It is set to true, if the best focus is found.
  */
 
@@ -121,60 +138,49 @@ namespace libcamera::ipa::ipu3 {
  */
 
 /**
- * \var IPAFrameContext::agc
+ * \var IPAActiveState::agc
  * \brief Context for the Automatic Gain Control algorithm
  *
  * The exposure and gain determined are expected to be applied to the sensor
  * at the earliest opportunity.
  *
- * \var IPAFrameContext::agc.exposure
+ * \var IPAActiveState::agc.exposure
  * \brief Exposure time expressed as a number of lines
  *
- * \var IPAFrameContext::agc.gain
+ * \var IPAActiveState::agc.gain
  * \brief Analogue gain multiplier
  *
  * The gain should be adapted to the sensor specific gain code before applying.
  */
 
 /**
- * \var IPAFrameContext::awb
+ * \var IPAActiveState::awb
  * \brief Context for the Automatic White Balance algorithm
  *
- * \struct IPAFrameContext::awb.gains
+ * \struct IPAActiveState::awb.gains
  * \brief White balance gains
  *
- * \var IPAFrameContext::awb.gains.red
+ * \var IPAActiveState::awb.gains.red
  * \brief White balance gain for R channel
  *
- * \var IPAFrameContext::awb.gains.green
+ * \var IPAActiveState::awb.gains.green
  * \brief White balance gain for G channel
  *
- * \var IPAFrameContext::awb.gains.blue
+ * \var IPAActiveState::awb.gains.blue
  * \brief White balance gain for B channel
  *
- * \var IPAFrameContext::awb.temperatureK
+ * \var IPAActiveState::awb.temperatureK
  * \brief Estimated color temperature
  */
 
 /**
- * \var IPAFrameContext::sensor
- * \brief Effective sensor values
- *
- * \var IPAFrameContext::sensor.exposure
- * \brief Exposure time expressed as a number of lines
- *
- * \var IPAFrameContext::sensor.gain
- * \brief Analogue gain multiplier
- */
-
-/**
- * \var IPAFrameContext::toneMapping
+ * \var IPAActiveState::toneMapping
  * \brief Context for ToneMapping and Gamma control
  *
- * \var IPAFrameContext::toneMapping.gamma
+ * \var IPAActiveState::toneMapping.gamma
  * \brief Gamma value for the LUT
  *
- * \var IPAFrameContext::toneMapping.gammaCorrection
+ * \var IPAActiveState::toneMapping.gammaCorrection
  * \brief Per-pixel tone mapping implemented as a LUT
  *
  * The LUT structure is defined by the IPU3 kernel interface. See
@@ -14,6 +14,9 @@
 
 #include <libcamera/geometry.h>
 
+#include "libipa/fc_queue.h"
+#include "libipa/grid_statistics.h"
+
 namespace libcamera {
 
 namespace ipa::ipu3 {
@@ -42,7 +45,7 @@ struct IPASessionConfiguration {
 	} sensor;
 };
 
-struct IPAFrameContext {
+struct IPAActiveState {
 	struct {
 		uint32_t focus;
 		double maxVariance;
@@ -64,20 +67,26 @@ struct IPAFrameContext {
 		double temperatureK;
 	} awb;
 
-	struct {
-		uint32_t exposure;
-		double gain;
-	} sensor;
-
 	struct {
 		double gamma;
 		struct ipu3_uapi_gamma_corr_lut gammaCorrection;
 	} toneMapping;
 };
 
+struct IPAFrameContext : public FrameContext {
+	struct {
+		uint32_t exposure;
+		double gain;
+	} sensor;
+};
+
 struct IPAContext {
 	IPASessionConfiguration configuration;
-	IPAFrameContext frameContext;
+	IPAActiveState activeState;
+
+	FCQueue<IPAFrameContext> frameContexts;
+
+	GridStatistics gridStats;
 };
 
 } /* namespace ipa::ipu3 */
@@ -51,6 +51,9 @@ static constexpr uint32_t kMinCellSizeLog2 = 3;
 /* log2 of the maximum grid cell width and height, in pixels */
 static constexpr uint32_t kMaxCellSizeLog2 = 6;
 
+/* Maximum number of frame contexts to be held */
+static constexpr uint32_t kMaxFrameContexts = 16;
+
 namespace libcamera {
 
 LOG_DEFINE_CATEGORY(IPAIPU3)
@@ -130,6 +133,8 @@ namespace ipa::ipu3 {
 class IPAIPU3 : public IPAIPU3Interface
 {
 public:
+	IPAIPU3();
+
 	int init(const IPASettings &settings,
 		 const IPACameraSensorInfo &sensorInfo,
 		 const ControlInfoMap &sensorControls,
@@ -152,9 +157,10 @@ private:
 	void updateSessionConfiguration(const ControlInfoMap &sensorControls);
 	void processControls(unsigned int frame, const ControlList &controls);
 	void fillParams(unsigned int frame, ipu3_uapi_params *params);
-	void parseStatistics(unsigned int frame,
+	void parseStatistics(unsigned int frame, IPAFrameContext &frameContext,
 			     int64_t frameTimestamp,
 			     const ipu3_uapi_stats_3a *stats);
+	void reduceStatistics(const ipu3_uapi_stats_3a *stats);
 	bool validateSensorControls();
 
 	void setControls(unsigned int frame);
@@ -177,6 +183,11 @@ private:
 	struct IPAContext context_;
 };
 
+IPAIPU3::IPAIPU3()
+	: context_({ {}, {}, { kMaxFrameContexts }, {} })
+{
+}
+
 /**
  * \brief Compute IPASessionConfiguration using the sensor information and the
  * sensor V4L2 controls
@@ -312,7 +323,9 @@ int IPAIPU3::init(const IPASettings &settings,
 	}
 
 	/* Clean context */
-	context_ = {};
+	context_.configuration = {};
+	context_.activeState = {};
+	context_.frameContexts.clear();
 	context_.configuration.sensor.lineDuration = sensorInfo.lineLength * 1.0s / sensorInfo.pixelRate;
 
 	/* Construct our Algorithms */
@@ -347,6 +360,7 @@ int IPAIPU3::start()
  */
 void IPAIPU3::stop()
 {
+	context_.frameContexts.clear();
 }
 
 /**
@@ -413,6 +427,8 @@ void IPAIPU3::calculateBdsGrid(const Size &bdsOutputSize)
 	/* The ImgU pads the lines to a multiple of 4 cells. */
 	context_.configuration.grid.stride = utils::alignUp(bdsGrid.width, 4);
 
+	context_.gridStats.configure({ bdsGrid.width, bdsGrid.height });
+
 	LOG(IPAIPU3, Debug) << "Best grid found is: ("
 			    << (int)bdsGrid.width << " << " << (int)bdsGrid.block_width_log2 << ") x ("
 			    << (int)bdsGrid.height << " << " << (int)bdsGrid.block_height_log2 << ")";
@@ -453,8 +469,9 @@ int IPAIPU3::configure(const IPAConfigInfo &configInfo,
 
 	calculateBdsGrid(configInfo.bdsOutputSize);
 
-	/* Clean frameContext at each reconfiguration. */
-	context_.frameContext = {};
+	/* Clean IPAActiveState at each reconfiguration. */
+	context_.activeState = {};
+	context_.frameContexts.clear();
 
 	if (!validateSensorControls()) {
 		LOG(IPAIPU3, Error) << "Sensor control validation failed.";
@@ -550,10 +567,12 @@ void IPAIPU3::processEvent(const IPU3Event &event)
 		int32_t exposure = event.sensorControls.get(V4L2_CID_EXPOSURE).get<int32_t>();
 		int32_t gain = event.sensorControls.get(V4L2_CID_ANALOGUE_GAIN).get<int32_t>();
 
-		context_.frameContext.sensor.exposure = exposure;
-		context_.frameContext.sensor.gain = camHelper_->gain(gain);
+		IPAFrameContext &frameContext = context_.frameContexts.get(event.frame);
+		frameContext.sensor.exposure = exposure;
+		frameContext.sensor.gain = camHelper_->gain(gain);
 
-		parseStatistics(event.frame, event.frameTimestamp, stats);
+		parseStatistics(event.frame, frameContext, event.frameTimestamp,
+				stats);
 		break;
 	}
 	default:
@@ -567,12 +586,15 @@ void IPAIPU3::processEvent(const IPU3Event &event)
  * \param[in] frame The number of the frame which will be processed next
  * \param[in] controls The controls for the \a frame
  *
- * Parse the request to handle any IPA-managed controls that were set from the
- * application such as manual sensor settings.
+ * Allocate the frame context for the \a frame, and parse the request to handle
+ * any IPA-managed controls that were set from the application such as manual
+ * sensor settings.
  */
-void IPAIPU3::processControls([[maybe_unused]] unsigned int frame,
+void IPAIPU3::processControls(unsigned int frame,
 			      [[maybe_unused]] const ControlList &controls)
 {
+	context_.frameContexts.alloc(frame);
+
 	/* \todo Start processing for 'frame' based on 'controls'. */
 }
 
@@ -597,8 +619,10 @@ void IPAIPU3::fillParams(unsigned int frame, ipu3_uapi_params *params)
 	 */
 	params->use = {};
 
+	IPAFrameContext &frameContext = context_.frameContexts.get(frame);
+
 	for (auto const &algo : algorithms_)
-		algo->prepare(context_, params);
+		algo->prepare(context_, frame, frameContext, params);
 
 	IPU3Action op;
 	op.op = ActionParamFilled;
@@ -606,9 +630,46 @@ void IPAIPU3::fillParams(unsigned int frame, ipu3_uapi_params *params)
 	queueFrameAction.emit(frame, op);
 }
 
+/**
+ * \brief Reduce the AWB statistics grid for all algorithms
+ * \param[in] stats The IPU3 statistics and ISP results
+ *
+ * Walk the AWB cells grid once, de-interleaving each row of cells into
+ * per-channel arrays, and accumulate them in the grid statistics shared by the
+ * algorithms. The green value of a cell is the average of its Gr and Gb values.
+ */
+void IPAIPU3::reduceStatistics(const ipu3_uapi_stats_3a *stats)
+{
+	GridStatistics &gridStats = context_.gridStats;
+	const Size &grid = gridStats.gridSize();
+	const uint32_t stride = context_.configuration.grid.stride;
+
+	std::array<uint8_t, kMaxGridWidth> red;
+	std::array<uint8_t, kMaxGridWidth> green;
+	std::array<uint8_t, kMaxGridWidth> blue;
+	std::array<uint8_t, kMaxGridWidth> saturation;
+
+	gridStats.reset();
+
+	for (unsigned int y = 0; y < grid.height; y++) {
+		const ipu3_uapi_awb_set_item *cells =
+			&stats->awb_raw_buffer.meta_data[y * stride];
+
+		for (unsigned int x = 0; x < grid.width; x++) {
+			red[x] = cells[x].R_avg;
+			green[x] = (cells[x].Gr_avg + cells[x].Gb_avg) / 2;
+			blue[x] = cells[x].B_avg;
+			saturation[x] = cells[x].sat_ratio;
+		}
+
+		gridStats.accumulateRow(y, red, green, blue, saturation);
+	}
+}
+
 /**
  * \brief Process the statistics generated by the ImgU
  * \param[in] frame The number of the latest frame processed
+ * \param[in] frameContext The context of the latest frame processed
  * \param[in] frameTimestamp The current frame timestamp
  * \param[in] stats The IPU3 statistics and ISP results
  *
@@ -617,6 +678,7 @@ void IPAIPU3::fillParams(unsigned int frame, ipu3_uapi_params *params)
  * update their state accordingly.
  */
 void IPAIPU3::parseStatistics(unsigned int frame,
+			      IPAFrameContext &frameContext,
 			      [[maybe_unused]] int64_t frameTimestamp,
 			      const ipu3_uapi_stats_3a *stats)
 {
@@ -624,8 +686,10 @@ void IPAIPU3::parseStatistics(unsigned int frame,
 	int32_t vBlank = context_.configuration.sensor.defVBlank;
 	ControlList ctrls(controls::controls);
 
+	reduceStatistics(stats);
+
 	for (auto const &algo : algorithms_)
-		algo->process(context_, stats);
+		algo->process(context_, frame, frameContext, stats);
 
 	setControls(frame);
 
@@ -633,11 +697,11 @@ void IPAIPU3::parseStatistics(unsigned int frame,
 	int64_t frameDuration = (vBlank + sensorInfo_.outputSize.height) * lineDuration;
 	ctrls.set(controls::FrameDuration, frameDuration);
 
-	ctrls.set(controls::AnalogueGain, context_.frameContext.sensor.gain);
+	ctrls.set(controls::AnalogueGain, frameContext.sensor.gain);
 
-	ctrls.set(controls::ColourTemperature, context_.frameContext.awb.temperatureK);
+	ctrls.set(controls::ColourTemperature, context_.activeState.awb.temperatureK);
 
-	ctrls.set(controls::ExposureTime, context_.frameContext.sensor.exposure * lineDuration);
+	ctrls.set(controls::ExposureTime, frameContext.sensor.exposure * lineDuration);
 
 	/*
 	 * \todo The Metadata provides a path to getting extended data
@@ -666,8 +730,8 @@ void IPAIPU3::setControls(unsigned int frame)
 	IPU3Action op;
 	op.op = ActionSetSensorControls;
 
-	int32_t exposure = context_.frameContext.agc.exposure;
-	int32_t gain = camHelper_->gainCode(context_.frameContext.agc.gain);
+	int32_t exposure = context_.activeState.agc.exposure;
+	int32_t gain = camHelper_->gainCode(context_.activeState.agc.gain);
 
 	ControlList ctrls(sensorCtrls_);
 	ctrls.set(V4L2_CID_EXPOSURE, exposure);
@@ -676,7 +740,7 @@ void IPAIPU3::setControls(unsigned int frame)
 
 	ControlList lensCtrls(lensCtrls_);
 	lensCtrls.set(V4L2_CID_FOCUS_ABSOLUTE,
-		      static_cast<int32_t>(context_.frameContext.af.focus));
+		      static_cast<int32_t>(context_.activeState.af.focus));
 	op.lensControls = lensCtrls;
 
 	queueFrameAction.emit(frame, op);
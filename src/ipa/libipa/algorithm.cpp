@@ -20,6 +20,7 @@ namespace ipa {
  * \class Algorithm
  * \brief The base class for all IPA algorithms
  * \tparam Context The type of shared IPA context
+ * \tparam FrameContext The type of per-frame IPA context
  * \tparam Config The type of the IPA configuration data
  * \tparam Params The type of the ISP specific parameters
  * \tparam Stats The type of the IPA statistics and ISP results
@@ -49,6 +50,8 @@ namespace ipa {
  * \fn Algorithm::prepare()
  * \brief Fill the \a params buffer with ISP processing parameters for a frame
  * \param[in] context The shared IPA context
+ * \param[in] frame The frame context sequence number
+ * \param[in] frameContext The FrameContext for this frame
  * \param[out] params The ISP specific parameters.
  *
  * This function is called for every frame when the camera is running before it
@@ -64,6 +67,8 @@ namespace ipa {
  * \fn Algorithm::process()
  * \brief Process ISP statistics, and run algorithm operations
  * \param[in] context The shared IPA context
+ * \param[in] frame The frame context sequence number
+ * \param[in] frameContext The current frame's context
  * \param[in] stats The IPA statistics and ISP results
  *
  * This function is called while camera is running for every frame processed by
@@ -75,16 +80,12 @@ namespace ipa {
  * computationally expensive calculations or operations must be handled
  * asynchronously in a separate thread.
  *
- * Algorithms can store state in their respective IPAFrameContext structures,
- * and reference state from the IPAFrameContext of other algorithms.
- *
- * \todo Historical data may be required as part of the processing.
- * Either the previous frame, or the IPAFrameContext state of the frame
- * that generated the statistics for this operation may be required for
- * some advanced algorithms to prevent oscillations or support control
- * loops correctly. Only a single IPAFrameContext is available currently,
- * and so any data stored may represent the results of the previously
- * completed operations.
+ * Algorithms can store state that spans multiple frames in the active state
+ * of the IPA context, and state specific to the frame being processed in its
+ * frame context. As parameters for later frames may be prepared before the
+ * statistics of the current frame are processed, the frame context passed to
+ * process() is the one of the frame that generated the statistics, and may
+ * differ from the frame context of the latest call to prepare().
  *
  * Care shall be taken to ensure the ordering of access to the information
  * such that the algorithms use up to date state as required.
@@ -6,11 +6,14 @@
  */
 #pragma once
 
+#include <stdint.h>
+
 namespace libcamera {
 
 namespace ipa {
 
-template<typename Context, typename Config, typename Params, typename Stats>
+template<typename Context, typename FrameContext, typename Config,
+	 typename Params, typename Stats>
 class Algorithm
 {
 public:
@@ -23,11 +26,15 @@ public:
 	}
 
 	virtual void prepare([[maybe_unused]] Context &context,
+			     [[maybe_unused]] const uint32_t frame,
+			     [[maybe_unused]] FrameContext &frameContext,
 			     [[maybe_unused]] Params *params)
 	{
 	}
 
 	virtual void process([[maybe_unused]] Context &context,
+			     [[maybe_unused]] const uint32_t frame,
+			     [[maybe_unused]] FrameContext &frameContext,
 			     [[maybe_unused]] const Stats *stats)
 	{
 	}
@@ -0,0 +1,123 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * fc_queue.cpp - IPA Frame context queue
+ */
+
+#include "fc_queue.h"
+
+#include <libcamera/base/log.h>
+
+namespace libcamera {
+
+LOG_DEFINE_CATEGORY(FCQueue)
+
+namespace ipa {
+
+/**
+ * \file fc_queue.h
+ * \brief Queue of per-frame contexts
+ */
+
+/**
+ * \struct FrameContext
+ * \brief Context for a frame
+ *
+ * The frame context stores data specific to a single frame processed by the
+ * IPA module. Each frame processed by the IPA module has a context associated
+ * with it, accessible through the Frame Context Queue.
+ *
+ * Fields in the frame context should reflect values and controls associated
+ * with the specific frame as requested by the application, and as configured by
+ * the hardware. Fields can be read by algorithms to determine if they should
+ * update any specific action for this frame, and finally to update the metadata
+ * control lists when the frame is fully completed.
+ *
+ * IPA modules shall derive their frame context type from this structure.
+ */
+
+/**
+ * \class FCQueue
+ * \brief A support class for managing FrameContext instances in IPA modules
+ * \tparam FrameContext The IPA module-specific FrameContext derived class type
+ *
+ * Along with the Algorithm class, the frame context queue is a core component
+ * of the libipa infrastructure. It stores per-frame contexts used by the
+ * Algorithm operations. By centralizing the lifetime management of the contexts
+ * and implementing safeguards against underflows and overflows, it simplifies
+ * IPA modules and improves their reliability.
+ *
+ * The queue references frame contexts by a monotonically increasing sequence
+ * number. The FCQueue design assumes that this number matches both the sequence
+ * number of the corresponding frame, as generated by the camera sensor, and the
+ * sequence number of the request. This allows IPA modules to obtain the frame
+ * context from any location where a request or a frame is available.
+ *
+ * A frame context normally begins its lifetime when the corresponding request
+ * is queued, way before the frame is captured by the camera sensor. IPA modules
+ * allocate the context from the queue at that point by calling alloc(). The
+ * context is then available to all operations performed on the frame,
+ * retrieved with get(), until it is processed and completed.
+ *
+ * Contexts are stored in a ring of fixed size, set at construction time. The
+ * queue size bounds the number of frames that can be in flight between
+ * alloc() and the completion of their processing: the IPA module can prepare
+ * the parameters for frame N + k while the statistics of frame N are still
+ * being processed, as long as k is smaller than the queue size. Allocating a
+ * context for a frame further ahead would overwrite the context of a frame
+ * still in flight, which the queue detects and reports when that frame's
+ * context is retrieved. IPA modules shall thus size the queue to the maximum
+ * number of requests the pipeline handler can have in flight.
+ */
+
+/**
+ * \fn FCQueue::FCQueue(unsigned int size)
+ * \brief Construct a frame contexts queue of a specified size
+ * \param[in] size The number of contexts in the queue
+ */
+
+/**
+ * \fn FCQueue::clear()
+ * \brief Clear the contexts queue
+ *
+ * IPA modules must clear the frame context queue at the beginning of a new
+ * streaming session, or when stopping the previous one.
+ */
+
+/**
+ * \fn FCQueue::alloc(uint32_t frame)
+ * \brief Allocate and return a FrameContext for the \a frame
+ * \param[in] frame The frame context sequence number
+ *
+ * The first call to obtain a FrameContext from the FCQueue should be handled
+ * through this function. The FrameContext will be initialised, if not
+ * initialised already, and returned to the caller.
+ *
+ * Frame contexts are expected to be initialised when a Request is first passed
+ * to the IPA module.
+ *
+ * \return A reference to the FrameContext for sequence \a frame
+ */
+
+/**
+ * \fn FCQueue::get(uint32_t frame)
+ * \brief Obtain the FrameContext for the \a frame
+ * \param[in] frame The frame context sequence number
+ *
+ * If the FrameContext for \a frame has not been allocated, or has been
+ * overwritten by a frame further ahead in the queue, a new context is
+ * initialised and returned, and the condition is logged.
+ *
+ * \return A reference to the FrameContext for sequence \a frame
+ */
+
+/**
+ * \fn FCQueue::size()
+ * \brief Retrieve the number of contexts in the queue
+ * \return The queue size
+ */
+
+} /* namespace ipa */
+
+} /* namespace libcamera */
@@ -0,0 +1,102 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * fc_queue.h - IPA Frame context queue
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <libcamera/base/log.h>
+
+namespace libcamera {
+
+LOG_DECLARE_CATEGORY(FCQueue)
+
+namespace ipa {
+
+template<typename FrameContext>
+class FCQueue;
+
+struct FrameContext {
+private:
+	template<typename T> friend class FCQueue;
+	uint32_t frame;
+};
+
+template<typename FrameContext>
+class FCQueue
+{
+public:
+	FCQueue(unsigned int size)
+		: contexts_(size)
+	{
+	}
+
+	void clear()
+	{
+		for (FrameContext &ctx : contexts_)
+			init(ctx, 0);
+	}
+
+	FrameContext &alloc(const uint32_t frame)
+	{
+		FrameContext &frameContext = contexts_[frame % contexts_.size()];
+
+		/*
+		 * Do not re-initialise a frame context that has already been
+		 * allocated, to avoid losing the state algorithms have stored
+		 * in it. This can happen if the pipeline handler allocates
+		 * contexts ahead of the frames being queued to the IPA.
+		 */
+		if (frame != 0 && frame == frameContext.frame) {
+			LOG(FCQueue, Warning)
+				<< "Frame " << frame << " already initialised";
+			return frameContext;
+		}
+
+		init(frameContext, frame);
+
+		return frameContext;
+	}
+
+	FrameContext &get(uint32_t frame)
+	{
+		FrameContext &frameContext = contexts_[frame % contexts_.size()];
+
+		if (frame == frameContext.frame)
+			return frameContext;
+
+		if (frame < frameContext.frame)
+			LOG(FCQueue, Error)
+				<< "Frame context for " << frame
+				<< " has been overwritten by "
+				<< frameContext.frame << ", increase the queue depth";
+		else
+			LOG(FCQueue, Warning)
+				<< "Obtained an uninitialised FrameContext for "
+				<< frame;
+
+		init(frameContext, frame);
+
+		return frameContext;
+	}
+
+	unsigned int size() const { return contexts_.size(); }
+
+private:
+	void init(FrameContext &frameContext, const uint32_t frame)
+	{
+		frameContext = {};
+		frameContext.frame = frame;
+	}
+
+	std::vector<FrameContext> contexts_;
+};
+
+} /* namespace ipa */
+
+} /* namespace libcamera */
@@ -0,0 +1,243 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * grid_statistics.cpp - Single-pass reduction of ISP statistics grids
+ */
+#include "grid_statistics.h"
+
+#include <algorithm>
+
+/**
+ * \file grid_statistics.h
+ * \brief Single-pass reduction of ISP statistics grids
+ */
+
+namespace libcamera {
+
+namespace ipa {
+
+/**
+ * \class GridStatistics
+ * \brief Reduce a grid of per-cell colour averages in a single pass
+ *
+ * Many ISPs report statistics as a grid of cells, each storing the average
+ * red, green and blue values of the pixels it covers along with the ratio of
+ * saturated pixels. Algorithms then reduce the grid to the information they
+ * need, such as per-channel histograms for exposure control or per-zone sums
+ * for white balance.
+ *
+ * The GridStatistics class computes all those reductions in a single pass
+ * over the grid, to be shared by all algorithms instead of having each of them
+ * walk the statistics buffer. The ISP-specific code de-interleaves each row of
+ * cells into per-channel arrays and passes them to accumulateRow(). The
+ * reduction loops operate on those contiguous arrays without branches, which
+ * allows the compiler to vectorize them.
+ *
+ * Per-channel histograms cover all cells of the grid. Zones are optional, and
+ * only include the cells whose saturation ratio doesn't exceed a threshold.
+ */
+
+/**
+ * \var GridStatistics::kNumBins
+ * \brief The number of bins of the per-channel histograms, for 8-bit averages
+ */
+
+/**
+ * \enum GridStatistics::Channel
+ * \brief Colour channels of a statistics cell
+ *
+ * \var GridStatistics::Red
+ * \brief The red channel
+ *
+ * \var GridStatistics::Green
+ * \brief The green channel
+ *
+ * \var GridStatistics::Blue
+ * \brief The blue channel
+ *
+ * \var GridStatistics::NumChannels
+ * \brief The number of colour channels
+ */
+
+/**
+ * \struct GridStatistics::Zone
+ * \brief Accumulated statistics of a zone of cells
+ *
+ * \var GridStatistics::Zone::counted
+ * \brief The number of non-saturated cells accumulated in the zone
+ *
+ * \var GridStatistics::Zone::sum
+ * \brief The sum of the non-saturated cells averages, for each channel
+ */
+
+GridStatistics::GridStatistics()
+	: saturationThreshold_(0)
+{
+	reset();
+}
+
+/**
+ * \brief Configure the size of the statistics grid
+ * \param[in] gridSize The grid size, in cells
+ *
+ * Configuring the grid disables zones, setZones() must be called again if
+ * needed.
+ */
+void GridStatistics::configure(const Size &gridSize)
+{
+	gridSize_ = gridSize;
+	zoneCount_ = {};
+	cellsPerZone_ = {};
+	zones_.clear();
+
+	reset();
+}
+
+/**
+ * \brief Configure the zones to accumulate
+ * \param[in] zoneCount The number of zones horizontally and vertically
+ * \param[in] cellsPerZone The size of a zone, in cells
+ * \param[in] saturationThreshold The maximum saturation ratio of a cell to be
+ * accumulated in a zone
+ *
+ * Zones are laid out from the top-left corner of the grid. Cells that are not
+ * covered by any zone are only accounted for in the histograms.
+ */
+void GridStatistics::setZones(const Size &zoneCount, const Size &cellsPerZone,
+			      uint8_t saturationThreshold)
+{
+	zoneCount_ = cellsPerZone.isNull() ? Size{} : zoneCount;
+	cellsPerZone_ = cellsPerZone;
+	saturationThreshold_ = saturationThreshold;
+	zones_.resize(zoneCount_.width * zoneCount_.height);
+
+	reset();
+}
+
+/**
+ * \brief Clear the accumulated statistics before processing a new grid
+ */
+void GridStatistics::reset()
+{
+	for (auto &histogram : histograms_)
+		histogram.fill(0);
+
+	std::fill(zones_.begin(), zones_.end(), Zone{});
+}
+
+/**
+ * \brief Accumulate a row of cells
+ * \param[in] row The row index in the grid
+ * \param[in] red The red averages of the cells in the row
+ * \param[in] green The green averages of the cells in the row
+ * \param[in] blue The blue averages of the cells in the row
+ * \param[in] saturation The saturation ratios of the cells in the row
+ *
+ * All spans shall contain at least gridSize().width entries.
+ */
+void GridStatistics::accumulateRow(unsigned int row, Span<const uint8_t> red,
+				   Span<const uint8_t> green,
+				   Span<const uint8_t> blue,
+				   Span<const uint8_t> saturation)
+{
+	const unsigned int width = gridSize_.width;
+
+	for (unsigned int x = 0; x < width; x++) {
+		histograms_[Red][red[x]]++;
+		histograms_[Green][green[x]]++;
+		histograms_[Blue][blue[x]]++;
+	}
+
+	if (row >= zoneCount_.height * cellsPerZone_.height)
+		return;
+
+	Zone *zone = &zones_[row / cellsPerZone_.height * zoneCount_.width];
+	const unsigned int zonesWidth = std::min(zoneCount_.width * cellsPerZone_.width,
+						 width);
+
+	for (unsigned int begin = 0; begin < zonesWidth;
+	     begin += cellsPerZone_.width, zone++) {
+		const unsigned int end = std::min(begin + cellsPerZone_.width,
+						  zonesWidth);
+		uint32_t counted = 0;
+		uint32_t sumRed = 0;
+		uint32_t sumGreen = 0;
+		uint32_t sumBlue = 0;
+
+		/* Mask out saturated cells instead of branching. */
+		for (unsigned int x = begin; x < end; x++) {
+			uint32_t valid = saturation[x] <= saturationThreshold_;
+
+			counted += valid;
+			sumRed += red[x] * valid;
+			sumGreen += green[x] * valid;
+			sumBlue += blue[x] * valid;
+		}
+
+		zone->counted += counted;
+		zone->sum[Red] += sumRed;
+		zone->sum[Green] += sumGreen;
+		zone->sum[Blue] += sumBlue;
+	}
+}
+
+/**
+ * \fn GridStatistics::gridSize()
+ * \brief Retrieve the size of the statistics grid
+ * \return The grid size, in cells
+ */
+
+/**
+ * \fn GridStatistics::zoneCount()
+ * \brief Retrieve the number of zones horizontally and vertically
+ * \return The number of zones, or a null size if zones are disabled
+ */
+
+/**
+ * \brief Retrieve the histogram of a channel
+ * \param[in] channel The colour channel
+ * \return The histogram of the \a channel averages of all cells in the grid,
+ * with kNumBins bins
+ */
+Span<const uint32_t> GridStatistics::histogram(Channel channel) const
+{
+	return histograms_[channel];
+}
+
+/**
+ * \fn GridStatistics::zones()
+ * \brief Retrieve the accumulated zones
+ *
+ * Zones are stored in raster order.
+ *
+ * \return The zones
+ */
+
+/**
+ * \brief Sum the averages of a channel after applying a gain
+ * \param[in] channel The colour channel
+ * \param[in] gain The gain to apply to the averages
+ *
+ * Compute the sum of the \a channel averages of all cells in the grid, each
+ * multiplied by \a gain and clipped to the maximum average value. The sum is
+ * computed from the channel histogram, making its cost independent of the
+ * grid size.
+ *
+ * \return The sum of the clipped averages
+ */
+double GridStatistics::clippedSum(Channel channel, double gain) const
+{
+	const std::array<uint32_t, kNumBins> &histogram = histograms_[channel];
+	const double max = kNumBins - 1;
+	double sum = 0.0;
+
+	for (unsigned int bin = 0; bin < kNumBins; bin++)
+		sum += histogram[bin] * std::min(bin * gain, max);
+
+	return sum;
+}
+
+} /* namespace ipa */
+
+} /* namespace libcamera */
@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * grid_statistics.h - Single-pass reduction of ISP statistics grids
+ */
+
+#pragma once
+
+#include <array>
+#include <stdint.h>
+#include <vector>
+
+#include <libcamera/base/span.h>
+
+#include <libcamera/geometry.h>
+
+namespace libcamera {
+
+namespace ipa {
+
+class GridStatistics
+{
+public:
+	static constexpr unsigned int kNumBins = 256;
+
+	enum Channel {
+		Red,
+		Green,
+		Blue,
+		NumChannels,
+	};
+
+	struct Zone {
+		uint32_t counted;
+		uint64_t sum[NumChannels];
+	};
+
+	GridStatistics();
+
+	void configure(const Size &gridSize);
+	void setZones(const Size &zoneCount, const Size &cellsPerZone,
+		      uint8_t saturationThreshold);
+
+	void reset();
+	void accumulateRow(unsigned int row, Span<const uint8_t> red,
+			   Span<const uint8_t> green, Span<const uint8_t> blue,
+			   Span<const uint8_t> saturation);
+
+	const Size &gridSize() const { return gridSize_; }
+	const Size &zoneCount() const { return zoneCount_; }
+	Span<const uint32_t> histogram(Channel channel) const;
+	const std::vector<Zone> &zones() const { return zones_; }
+
+	double clippedSum(Channel channel, double gain) const;
+
+private:
+	Size gridSize_;
+	Size zoneCount_;
+	Size cellsPerZone_;
+	uint8_t saturationThreshold_;
+
+	std::array<std::array<uint32_t, kNumBins>, NumChannels> histograms_;
+	std::vector<Zone> zones_;
+};
+
+} /* namespace ipa */
+
+} /* namespace libcamera */
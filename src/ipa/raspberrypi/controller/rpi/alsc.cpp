@@ -158,6 +158,9 @@ static void get_cal_table(double ct,
 static void resample_cal_table(double const cal_table_in[XY],
 			       CameraMode const &camera_mode,
 			       double cal_table_out[XY]);
+static void resample_calibrations(std::vector<AlscCalibration> const &calibrations,
+				  CameraMode const &camera_mode,
+				  std::vector<AlscCalibration> &resampled);
 static void compensate_lambdas_for_cal(double const cal_table[XY],
 				       double const old_lambdas[XY],
 				       double new_lambdas[XY]);
@@ -227,6 +230,13 @@ void Alsc::SwitchMode(CameraMode const &camera_mode,
 	// fixed so we can simply do it up front here.
 	resample_cal_table(config_.luminance_lut, camera_mode_, luminance_table_);
 
+	// Resampling is linear, so resampling every calibration once now gives
+	// the same result as resampling the interpolated table on every run.
+	resample_calibrations(config_.calibrations_Cr, camera_mode_,
+			      resampled_calibrations_Cr_);
+	resample_calibrations(config_.calibrations_Cb, camera_mode_,
+			      resampled_calibrations_Cb_);
+
 	if (reset_tables) {
 		// Upon every "table reset", arrange for something sensible to be
 		// generated. Construct the tables for the previous recorded colour
@@ -235,11 +245,9 @@ void Alsc::SwitchMode(CameraMode const &camera_mode,
 		// doAlsc, without the adaptive algorithm.
 		for (int i = 0; i < XY; i++)
 			lambda_r_[i] = lambda_b_[i] = 1.0;
-		double cal_table_r[XY], cal_table_b[XY], cal_table_tmp[XY];
-		get_cal_table(ct_, config_.calibrations_Cr, cal_table_tmp);
-		resample_cal_table(cal_table_tmp, camera_mode_, cal_table_r);
-		get_cal_table(ct_, config_.calibrations_Cb, cal_table_tmp);
-		resample_cal_table(cal_table_tmp, camera_mode_, cal_table_b);
+		double cal_table_r[XY], cal_table_b[XY];
+		get_cal_table(ct_, resampled_calibrations_Cr_, cal_table_r);
+		get_cal_table(ct_, resampled_calibrations_Cb_, cal_table_b);
 		compensate_lambdas_for_cal(cal_table_r, lambda_r_,
 					   async_lambda_r_);
 		compensate_lambdas_for_cal(cal_table_b, lambda_b_,
@@ -470,6 +478,18 @@ void resample_cal_table(double const cal_table_in[XY],
 	}
 }
 
+void resample_calibrations(std::vector<AlscCalibration> const &calibrations,
+			   CameraMode const &camera_mode,
+			   std::vector<AlscCalibration> &resampled)
+{
+	resampled.resize(calibrations.size());
+	for (size_t i = 0; i < calibrations.size(); i++) {
+		resampled[i].ct = calibrations[i].ct;
+		resample_cal_table(calibrations[i].table, camera_mode,
+				   resampled[i].table);
+	}
+}
+
 // Calculate chrominance statistics (R/G and B/G) for each region.
 static_assert(XY == AWB_REGIONS, "ALSC/AWB statistics region mismatch");
 static void calculate_Cr_Cb(bcm2835_isp_stats_region *awb_region, double Cr[XY],
@@ -531,23 +551,27 @@ static double compute_weight(double C_i, double C_j, double sigma)
 	return exp(-diff * diff / 2);
 }
 
-// Compute all weights.
-static void compute_W(double const C[XY], double sigma, double W[XY][4])
+// Compute all weights. Each neighbour direction is held in its own contiguous
+// array (above, right, below, left), with zero weight for neighbours that fall
+// off the edge of the grid. As the weights are symmetric, each pair of adjacent
+// cells is only evaluated once.
+static void compute_W(double const C[XY], double sigma, double W[4][XY])
 {
-	for (int i = 0; i < XY; i++) {
-		// Start with neighbour above and go clockwise.
-		W[i][0] = i >= X ? compute_weight(C[i], C[i - X], sigma) : 0;
-		W[i][1] = i % X < X - 1 ? compute_weight(C[i], C[i + 1], sigma)
-					: 0;
-		W[i][2] =
-			i < XY - X ? compute_weight(C[i], C[i + X], sigma) : 0;
-		W[i][3] = i % X ? compute_weight(C[i], C[i - 1], sigma) : 0;
+	memset(W, 0, 4 * XY * sizeof(double));
+	for (int y = 0; y < Y; y++) {
+		for (int x = 0; x < X - 1; x++) {
+			int i = y * X + x;
+			W[1][i] = W[3][i + 1] =
+				compute_weight(C[i], C[i + 1], sigma);
+		}
 	}
+	for (int i = 0; i < XY - X; i++)
+		W[2][i] = W[0][i + X] = compute_weight(C[i], C[i + X], sigma);
 }
 
 // Compute M, the large but sparse matrix such that M * lambdas = 0.
-static void construct_M(double const C[XY], double const W[XY][4],
-			double M[XY][4])
+static void construct_M(double const C[XY], double const W[4][XY],
+			double M[4][XY])
 {
 	double epsilon = 0.001;
 	for (int i = 0; i < XY; i++) {
@@ -557,20 +581,20 @@ static void construct_M(double const C[XY], double const W[XY][4],
 			!!(i % X); // total number of neighbours
 		// we'll divide the diagonal out straight away
 		double diagonal =
-			(epsilon + W[i][0] + W[i][1] + W[i][2] + W[i][3]) *
+			(epsilon + W[0][i] + W[1][i] + W[2][i] + W[3][i]) *
 			C[i];
-		M[i][0] = i >= X ? (W[i][0] * C[i - X] + epsilon / m * C[i]) /
+		M[0][i] = i >= X ? (W[0][i] * C[i - X] + epsilon / m * C[i]) /
 					   diagonal
 				 : 0;
-		M[i][1] = i % X < X - 1
-				  ? (W[i][1] * C[i + 1] + epsilon / m * C[i]) /
+		M[1][i] = i % X < X - 1
+				  ? (W[1][i] * C[i + 1] + epsilon / m * C[i]) /
 					    diagonal
 				  : 0;
-		M[i][2] = i < XY - X
-				  ? (W[i][2] * C[i + X] + epsilon / m * C[i]) /
+		M[2][i] = i < XY - X
+				  ? (W[2][i] * C[i + X] + epsilon / m * C[i]) /
 					    diagonal
 				  : 0;
-		M[i][3] = i % X ? (W[i][3] * C[i - 1] + epsilon / m * C[i]) /
+		M[3][i] = i % X ? (W[3][i] * C[i - 1] + epsilon / m * C[i]) /
 					  diagonal
 				: 0;
 	}
@@ -579,37 +603,37 @@ static void construct_M(double const C[XY], double const W[XY][4],
 // In the compute_lambda_ functions, note that the matrix coefficients for the
 // left/right neighbours are zero down the left/right edges, so we don't need
 // need to test the i value to exclude them.
-static double compute_lambda_bottom(int i, double const M[XY][4],
+static double compute_lambda_bottom(int i, double const M[4][XY],
 				    double lambda[XY])
 {
-	return M[i][1] * lambda[i + 1] + M[i][2] * lambda[i + X] +
-	       M[i][3] * lambda[i - 1];
+	return M[1][i] * lambda[i + 1] + M[2][i] * lambda[i + X] +
+	       M[3][i] * lambda[i - 1];
 }
-static double compute_lambda_bottom_start(int i, double const M[XY][4],
+static double compute_lambda_bottom_start(int i, double const M[4][XY],
 					  double lambda[XY])
 {
-	return M[i][1] * lambda[i + 1] + M[i][2] * lambda[i + X];
+	return M[1][i] * lambda[i + 1] + M[2][i] * lambda[i + X];
 }
-static double compute_lambda_interior(int i, double const M[XY][4],
+static double compute_lambda_interior(int i, double const M[4][XY],
 				      double lambda[XY])
 {
-	return M[i][0] * lambda[i - X] + M[i][1] * lambda[i + 1] +
-	       M[i][2] * lambda[i + X] + M[i][3] * lambda[i - 1];
+	return M[0][i] * lambda[i - X] + M[1][i] * lambda[i + 1] +
+	       M[2][i] * lambda[i + X] + M[3][i] * lambda[i - 1];
 }
-static double compute_lambda_top(int i, double const M[XY][4],
+static double compute_lambda_top(int i, double const M[4][XY],
 				 double lambda[XY])
 {
-	return M[i][0] * lambda[i - X] + M[i][1] * lambda[i + 1] +
-	       M[i][3] * lambda[i - 1];
+	return M[0][i] * lambda[i - X] + M[1][i] * lambda[i + 1] +
+	       M[3][i] * lambda[i - 1];
 }
-static double compute_lambda_top_end(int i, double const M[XY][4],
+static double compute_lambda_top_end(int i, double const M[4][XY],
 				     double lambda[XY])
 {
-	return M[i][0] * lambda[i - X] + M[i][3] * lambda[i - 1];
+	return M[0][i] * lambda[i - X] + M[3][i] * lambda[i - 1];
 }
 
 // Gauss-Seidel iteration with over-relaxation.
-static double gauss_seidel2_SOR(double const M[XY][4], double omega,
+static double gauss_seidel2_SOR(double const M[4][XY], double omega,
 				double lambda[XY])
 {
 	double old_lambda[XY];
@@ -654,10 +678,10 @@ static void normalise(double *ptr, size_t n)
 }
 
 static void run_matrix_iterations(double const C[XY], double lambda[XY],
-				  double const W[XY][4], double omega,
+				  double const W[4][XY], double omega,
 				  int n_iter, double threshold)
 {
-	double M[XY][4];
+	double M[4][XY];
 	construct_M(C, W, M);
 	double last_max_diff = std::numeric_limits<double>::max();
 	for (int i = 0; i < n_iter; i++) {
@@ -715,17 +739,15 @@ void add_luminance_to_tables(double results[3][Y][X], double const lambda_r[XY],
 
 void Alsc::doAlsc()
 {
-	double Cr[XY], Cb[XY], Wr[XY][4], Wb[XY][4], cal_table_r[XY],
-		cal_table_b[XY], cal_table_tmp[XY];
+	double Cr[XY], Cb[XY], Wr[4][XY], Wb[4][XY], cal_table_r[XY],
+		cal_table_b[XY];
 	// Calculate our R/B ("Cr"/"Cb") colour statistics, and assess which are
 	// usable.
 	calculate_Cr_Cb(statistics_, Cr, Cb, config_.min_count, config_.min_G);
-	// Fetch the new calibrations (if any) for this CT. Resample them in
-	// case the camera mode is not full-frame.
-	get_cal_table(ct_, config_.calibrations_Cr, cal_table_tmp);
-	resample_cal_table(cal_table_tmp, camera_mode_, cal_table_r);
-	get_cal_table(ct_, config_.calibrations_Cb, cal_table_tmp);
-	resample_cal_table(cal_table_tmp, camera_mode_, cal_table_b);
+	// Fetch the new calibrations (if any) for this CT. These have already
+	// been resampled for the camera mode in SwitchMode.
+	get_cal_table(ct_, resampled_calibrations_Cr_, cal_table_r);
+	get_cal_table(ct_, resampled_calibrations_Cb_, cal_table_b);
 	// You could print out the cal tables for this image here, if you're
 	// tuning the algorithm...
 	// Apply any calibration to the statistics, so the adaptive algorithm
@@ -9,6 +9,7 @@
 #include <mutex>
 #include <condition_variable>
 #include <thread>
+#include <vector>
 
 #include "../algorithm.hpp"
 #include "../alsc_status.h"
@@ -61,6 +62,10 @@ private:
 	bool first_time_;
 	CameraMode camera_mode_;
 	double luminance_table_[ALSC_CELLS_X * ALSC_CELLS_Y];
+	// calibration tables resampled for the current camera mode, so that
+	// they only need interpolating by colour temperature on each run
+	std::vector<AlscCalibration> resampled_calibrations_Cr_;
+	std::vector<AlscCalibration> resampled_calibrations_Cb_;
 	std::thread async_thread_;
 	void asyncFunc(); // asynchronous thread function
 	std::mutex mutex_;
@@ -32,10 +32,12 @@ namespace ipa::rkisp1::algorithms {
 /**
  * \copydoc libcamera::ipa::Algorithm::prepare
  */
-void BlackLevelCorrection::prepare(IPAContext &context,
+void BlackLevelCorrection::prepare([[maybe_unused]] IPAContext &context,
+				   const uint32_t frame,
+				   [[maybe_unused]] IPAFrameContext &frameContext,
 				   rkisp1_params_cfg *params)
 {
-	if (context.frameContext.frameCount > 0)
+	if (frame > 0)
 		return;
 	/*
 	 * Substract fixed values taken from imx219 tuning file.
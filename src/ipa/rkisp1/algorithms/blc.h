@@ -23,7 +23,9 @@ public:
 	BlackLevelCorrection() = default;
 	~BlackLevelCorrection() = default;
 
-	void prepare(IPAContext &context, rkisp1_params_cfg *params) override;
+	void prepare(IPAContext &context, const uint32_t frame,
+		     IPAFrameContext &frameContext,
+		     rkisp1_params_cfg *params) override;
 };
 
 } /* namespace ipa::rkisp1::algorithms */
@@ -24,19 +24,36 @@ namespace libcamera::ipa::rkisp1 {
  * may also be updated in the start() operation.
  */
 
+/**
+ * \struct IPAActiveState
+ * \brief Active state for algorithms
+ *
+ * The active state stores algorithm-specific data that needs to be shared
+ * between multiple algorithms and the IPA module. It is accessible through the
+ * IPAContext structure.
+ *
+ * Each of the fields in the active state belongs to either a specific
+ * algorithm, or to the top-level IPA module. A field may be read by any
+ * algorithm, but should only be written by its owner.
+ */
+
 /**
  * \struct IPAFrameContext
  * \brief Per-frame context for algorithms
  *
  * The frame context stores data specific to a single frame processed by the
  * IPA. Each frame processed by the IPA has a context associated with it,
- * accessible through the IPAContext structure.
+ * allocated when the request for the frame is queued to the IPA module and
+ * retrieved from the IPAContext::frameContexts queue by its sequence number.
  *
- * \todo Detail how to access contexts for a particular frame
+ * \var IPAFrameContext::sensor
+ * \brief Effective sensor values that were applied for the frame
  *
- * Each of the fields in the frame context belongs to either a specific
- * algorithm, or to the top-level IPA module. A field may be read by any
- * algorithm, but should only be written by its owner.
+ * \var IPAFrameContext::sensor.exposure
+ * \brief Exposure time expressed as a number of lines
+ *
+ * \var IPAFrameContext::sensor.gain
+ * \brief Analogue gain multiplier
  */
 
 /**
@@ -46,13 +63,11 @@ namespace libcamera::ipa::rkisp1 {
  * \var IPAContext::configuration
  * \brief The IPA session configuration, immutable during the session
  *
- * \var IPAContext::frameContext
- * \brief The frame context for the frame being processed
+ * \var IPAContext::activeState
+ * \brief The IPA active state, storing the latest state for all algorithms
  *
- * \todo While the frame context is supposed to be per-frame, this
- * single frame context stores data related to both the current frame
- * and the previous frames, with fields being updated as the algorithms
- * are run. This needs to be turned into real per-frame data storage.
+ * \var IPAContext::frameContexts
+ * \brief Queue of the per-frame contexts, indexed by frame sequence number
  */
 
 /**
@@ -98,59 +113,39 @@ namespace libcamera::ipa::rkisp1 {
  */
 
 /**
- * \var IPAFrameContext::agc
+ * \var IPAActiveState::agc
  * \brief Context for the Automatic Gain Control algorithm
  *
  * The exposure and gain determined are expected to be applied to the sensor
  * at the earliest opportunity.
  *
- * \var IPAFrameContext::agc.exposure
+ * \var IPAActiveState::agc.exposure
  * \brief Exposure time expressed as a number of lines
  *
- * \var IPAFrameContext::agc.gain
+ * \var IPAActiveState::agc.gain
  * \brief Analogue gain multiplier
  *
  * The gain should be adapted to the sensor specific gain code before applying.
  */
 
 /**
- * \var IPAFrameContext::awb
+ * \var IPAActiveState::awb
  * \brief Context for the Automatic White Balance algorithm
  *
- * \struct IPAFrameContext::awb.gains
+ * \struct IPAActiveState::awb.gains
  * \brief White balance gains
  *
- * \var IPAFrameContext::awb.gains.red
+ * \var IPAActiveState::awb.gains.red
  * \brief White balance gain for R channel
  *
- * \var IPAFrameContext::awb.gains.green
+ * \var IPAActiveState::awb.gains.green
  * \brief White balance gain for G channel
  *
- * \var IPAFrameContext::awb.gains.blue
+ * \var IPAActiveState::awb.gains.blue
  * \brief White balance gain for B channel
  *
- * \var IPAFrameContext::awb.temperatureK
+ * \var IPAActiveState::awb.temperatureK
  * \brief Estimated color temperature
  */
 
-/**
- * \var IPAFrameContext::sensor
- * \brief Effective sensor values
- *
- * \var IPAFrameContext::sensor.exposure
- * \brief Exposure time expressed as a number of lines
- *
- * \var IPAFrameContext::sensor.gain
- * \brief Analogue gain multiplier
- */
-
-/**
- * \var IPAFrameContext::frameCount
- * \brief Counter of requests queued to the IPA module
- *
- * The counter is reset to 0 when the IPA module is configured, and is
- * incremented for each request being queued, after calling the
- * Algorithm::prepare() function of all algorithms.
- */
-
 } /* namespace libcamera::ipa::rkisp1 */
@@ -14,6 +14,8 @@
 
 #include <libcamera/geometry.h>
 
+#include "libipa/fc_queue.h"
+
 namespace libcamera {
 
 namespace ipa::rkisp1 {
@@ -40,7 +42,7 @@ struct IPASessionConfiguration {
 	} hw;
 };
 
-struct IPAFrameContext {
+struct IPAActiveState {
 	struct {
 		uint32_t exposure;
 		double gain;
@@ -55,18 +57,20 @@ struct IPAFrameContext {
 
 		double temperatureK;
 	} awb;
+};
 
+struct IPAFrameContext : public FrameContext {
 	struct {
 		uint32_t exposure;
 		double gain;
 	} sensor;
-
-	unsigned int frameCount;
 };
 
 struct IPAContext {
 	IPASessionConfiguration configuration;
-	IPAFrameContext frameContext;
+	IPAActiveState activeState;
+
+	FCQueue<IPAFrameContext> frameContexts;
 };
 
 } /* namespace ipa::rkisp1 */
@@ -41,12 +41,17 @@ using namespace std::literals::chrono_literals;
 
 namespace ipa::rkisp1 {
 
+/* Maximum number of frame contexts to be held */
+static constexpr uint32_t kMaxFrameContexts = 16;
+
 class IPARkISP1 : public IPARkISP1Interface
 {
 public:
+	IPARkISP1();
+
 	int init(const IPASettings &settings, unsigned int hwRevision) override;
 	int start() override;
-	void stop() override {}
+	void stop() override;
 
 	int configure(const IPACameraSensorInfo &info,
 		      const std::map<uint32_t, IPAStream> &streamConfig,
@@ -86,6 +91,11 @@ private:
 	std::list<std::unique_ptr<ipa::rkisp1::Algorithm>> algorithms_;
 };
 
+IPARkISP1::IPARkISP1()
+	: context_({ {}, {}, { kMaxFrameContexts } })
+{
+}
+
 int IPARkISP1::init(const IPASettings &settings, unsigned int hwRevision)
 {
 	/* \todo Add support for other revisions */
@@ -135,6 +145,11 @@ int IPARkISP1::start()
 	return 0;
 }
 
+void IPARkISP1::stop()
+{
+	context_.frameContexts.clear();
+}
+
 /**
  * \todo The RkISP1 pipeline currently provides an empty IPACameraSensorInfo
  * if the connected sensor does not provide enough information to properly
@@ -175,7 +190,9 @@ int IPARkISP1::configure([[maybe_unused]] const IPACameraSensorInfo &info,
 		<< " Gain: " << minGain << "-" << maxGain;
 
 	/* Clean context at configuration */
-	context_ = {};
+	context_.configuration = {};
+	context_.activeState = {};
+	context_.frameContexts.clear();
 
 	/* Set the hardware revision for the algorithms. */
 	context_.configuration.hw.revision = hwRevision_;
@@ -194,8 +211,6 @@ int IPARkISP1::configure([[maybe_unused]] const IPACameraSensorInfo &info,
 	context_.configuration.agc.minAnalogueGain = camHelper_->gain(minGain);
 	context_.configuration.agc.maxAnalogueGain = camHelper_->gain(maxGain);
 
-	context_.frameContext.frameCount = 0;
-
 	for (auto const &algo : algorithms_) {
 		int ret = algo->configure(context_, info);
 		if (ret)
@@ -242,14 +257,15 @@ void IPARkISP1::queueRequest(const uint32_t frame, const uint32_t bufferId,
 		reinterpret_cast<rkisp1_params_cfg *>(
 			mappedBuffers_.at(bufferId).planes()[0].data());
 
+	IPAFrameContext &frameContext = context_.frameContexts.alloc(frame);
+
 	/* Prepare parameters buffer. */
 	memset(params, 0, sizeof(*params));
 
 	for (auto const &algo : algorithms_)
-		algo->prepare(context_, params);
+		algo->prepare(context_, frame, frameContext, params);
 
 	paramsBufferReady.emit(frame);
-	context_.frameContext.frameCount++;
 }
 
 void IPARkISP1::processStatsBuffer(const uint32_t frame, const uint32_t bufferId,
@@ -259,15 +275,17 @@ void IPARkISP1::processStatsBuffer(const uint32_t frame, const uint32_t bufferId
 		reinterpret_cast<rkisp1_stat_buffer *>(
 			mappedBuffers_.at(bufferId).planes()[0].data());
 
-	context_.frameContext.sensor.exposure =
+	IPAFrameContext &frameContext = context_.frameContexts.get(frame);
+
+	frameContext.sensor.exposure =
 		sensorControls.get(V4L2_CID_EXPOSURE).get<int32_t>();
-	context_.frameContext.sensor.gain =
+	frameContext.sensor.gain =
 		camHelper_->gain(sensorControls.get(V4L2_CID_ANALOGUE_GAIN).get<int32_t>());
 
 	unsigned int aeState = 0;
 
 	for (auto const &algo : algorithms_)
-		algo->process(context_, stats);
+		algo->process(context_, frame, frameContext, stats);
 
 	setControls(frame);
 
@@ -276,8 +294,8 @@ void IPARkISP1::processStatsBuffer(const uint32_t frame, const uint32_t bufferId
 
 void IPARkISP1::setControls(unsigned int frame)
 {
-	uint32_t exposure = context_.frameContext.agc.exposure;
-	uint32_t gain = camHelper_->gainCode(context_.frameContext.agc.gain);
+	uint32_t exposure = context_.activeState.agc.exposure;
+	uint32_t gain = camHelper_->gainCode(context_.activeState.agc.gain);
 
 	ControlList ctrls(ctrls_);
 	ctrls.set(V4L2_CID_EXPOSURE, static_cast<int32_t>(exposure));
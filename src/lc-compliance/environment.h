@@ -15,13 +15,16 @@ public:
 	static Environment *get();
 
 	void setup(libcamera::CameraManager *cm, std::string cameraId);
+	void setStressThreads(unsigned int count) { stressThreads_ = count; }
 
 	const std::string &cameraId() const { return cameraId_; }
 	libcamera::CameraManager *cm() const { return cm_; }
+	unsigned int stressThreads() const { return stressThreads_; }
 
 private:
 	Environment() = default;
 
 	std::string cameraId_;
 	libcamera::CameraManager *cm_;
+	unsigned int stressThreads_ = 0;
 };
@@ -24,6 +24,8 @@ enum {
 	OptList = 'l',
 	OptFilter = 'f',
 	OptHelp = 'h',
+	OptOutput = 'o',
+	OptStress = 's',
 };
 
 /*
@@ -74,6 +76,9 @@ static int initCamera(CameraManager *cm, OptionsParser::Options options)
 
 	Environment::get()->setup(cm, cameraId);
 
+	if (options.isSet(OptStress))
+		Environment::get()->setStressThreads(options[OptStress].toInteger());
+
 	std::cout << "Using camera " << cameraId << std::endl;
 
 	return 0;
@@ -82,10 +87,12 @@ static int initCamera(CameraManager *cm, OptionsParser::Options options)
 static int initGtestParameters(char *arg0, OptionsParser::Options options)
 {
 	const std::map<std::string, std::string> gtestFlags = { { "list", "--gtest_list_tests" },
-								{ "filter", "--gtest_filter" } };
+								{ "filter", "--gtest_filter" },
+								{ "output", "--gtest_output" } };
 
 	int argc = 0;
 	std::string filterParam;
+	std::string outputParam;
 
 	/*
 	 * +2 to have space for both the 0th argument that is needed but not
@@ -115,6 +122,14 @@ static int initGtestParameters(char *arg0, OptionsParser::Options options)
 		argc++;
 	}
 
+	if (options.isSet(OptOutput)) {
+		outputParam = gtestFlags.at("output") + "=" +
+			      static_cast<const std::string &>(options[OptOutput]);
+
+		argv[argc] = const_cast<char *>(outputParam.c_str());
+		argc++;
+	}
+
 	argv[argc] = nullptr;
 
 	::testing::InitGoogleTest(&argc, argv);
@@ -147,6 +162,14 @@ static int parseOptions(int argc, char **argv, OptionsParser::Options *options)
 			 ArgumentRequired, "filter");
 	parser.addOption(OptHelp, OptionNone, "Display this help message",
 			 "help");
+	parser.addOption(OptOutput, OptionString,
+			 "Write the test results and performance measurements to a file,\n"
+			 "in the 'json:<path>' or 'xml:<path>' format", "output",
+			 ArgumentRequired, "output");
+	parser.addOption(OptStress, OptionInteger,
+			 "Load the CPUs with the given number of busy threads during the\n"
+			 "performance tests", "stress",
+			 ArgumentRequired, "threads");
 
 	*options = parser.parse(argc, argv);
 	if (!options->valid())
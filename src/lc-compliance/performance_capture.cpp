@@ -0,0 +1,110 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * performance_capture.cpp - Capture helper recording timing information
+ */
+
+#include <gtest/gtest.h>
+
+#include "performance_capture.h"
+
+using namespace libcamera;
+
+PerformanceCapture::PerformanceCapture(std::shared_ptr<Camera> camera)
+	: SimpleCapture(camera), captureLimit_(0)
+{
+}
+
+/*
+ * Capture numFrames frames, requeuing requests as soon as they complete, and
+ * record the queue to completion latency, the sequence number and the
+ * timestamp of every frame. The optional controls are set in the first
+ * requests.
+ */
+void PerformanceCapture::capture(unsigned int numFrames, const ControlList *controls)
+{
+	frames_.clear();
+	frames_.reserve(numFrames);
+	captureLimit_ = numFrames;
+
+	loop_ = new EventLoop();
+
+	startTime_ = clock::now();
+	startLatency_ = {};
+
+	start();
+
+	Stream *stream = config_->at(0).stream();
+	const std::vector<std::unique_ptr<FrameBuffer>> &buffers = allocator_->buffers(stream);
+
+	requests_.clear();
+	queueTimes_.assign(buffers.size(), {});
+
+	for (const std::unique_ptr<FrameBuffer> &buffer : buffers) {
+		std::unique_ptr<Request> request = camera_->createRequest(requests_.size());
+		ASSERT_TRUE(request) << "Can't create request";
+
+		ASSERT_EQ(request->addBuffer(stream, buffer.get()), 0) << "Can't set buffer for request";
+
+		if (controls)
+			request->controls().merge(*controls);
+
+		requests_.push_back(std::move(request));
+	}
+
+	for (std::unique_ptr<Request> &request : requests_)
+		ASSERT_EQ(queueRequest(request.get()), 0) << "Failed to queue request";
+
+	/* Run capture session. */
+	int status = loop_->exec();
+
+	clock::time_point stopTime = clock::now();
+	stop();
+	stopLatency_ = clock::now() - stopTime;
+
+	delete loop_;
+	loop_ = nullptr;
+
+	ASSERT_EQ(status, 0) << "Capture failed";
+	ASSERT_EQ(frames_.size(), captureLimit_);
+}
+
+int PerformanceCapture::queueRequest(Request *request)
+{
+	queueTimes_[request->cookie()] = clock::now();
+	return camera_->queueRequest(request);
+}
+
+void PerformanceCapture::requestComplete(Request *request)
+{
+	clock::time_point now = clock::now();
+
+	/* Ignore the requests completed or cancelled after the capture ended. */
+	if (frames_.size() >= captureLimit_)
+		return;
+
+	EXPECT_EQ(request->status(), Request::RequestComplete)
+		<< "Request " << request->cookie() << " failed";
+	if (request->status() != Request::RequestComplete) {
+		captureLimit_ = frames_.size();
+		loop_->exit(-EIO);
+		return;
+	}
+
+	if (frames_.empty())
+		startLatency_ = now - startTime_;
+
+	const FrameMetadata &metadata = request->buffers().begin()->second->metadata();
+	frames_.push_back({ now - queueTimes_[request->cookie()],
+			    metadata.sequence, metadata.timestamp });
+
+	if (frames_.size() >= captureLimit_) {
+		loop_->exit(0);
+		return;
+	}
+
+	request->reuse(Request::ReuseBuffers);
+	if (queueRequest(request))
+		loop_->exit(-EINVAL);
+}
@@ -0,0 +1,52 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * performance_capture.h - Capture helper recording timing information
+ */
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include <libcamera/libcamera.h>
+
+#include "simple_capture.h"
+
+class PerformanceCapture : public SimpleCapture
+{
+public:
+	using clock = std::chrono::steady_clock;
+
+	struct Frame {
+		clock::duration latency;
+		unsigned int sequence;
+		uint64_t timestamp;
+	};
+
+	PerformanceCapture(std::shared_ptr<libcamera::Camera> camera);
+
+	void capture(unsigned int numFrames,
+		     const libcamera::ControlList *controls = nullptr);
+
+	const std::vector<Frame> &frames() const { return frames_; }
+	unsigned int queueDepth() const { return requests_.size(); }
+	clock::duration startLatency() const { return startLatency_; }
+	clock::duration stopLatency() const { return stopLatency_; }
+
+private:
+	int queueRequest(libcamera::Request *request);
+	void requestComplete(libcamera::Request *request) override;
+
+	std::vector<std::unique_ptr<libcamera::Request>> requests_;
+	std::vector<clock::time_point> queueTimes_;
+
+	std::vector<Frame> frames_;
+	unsigned int captureLimit_;
+
+	clock::time_point startTime_;
+	clock::duration startLatency_;
+	clock::duration stopLatency_;
+};
@@ -0,0 +1,335 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * performance_test.cpp - Test camera capture performance
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "environment.h"
+#include "performance_capture.h"
+
+using namespace libcamera;
+using namespace std::chrono;
+
+namespace {
+
+const std::vector<StreamRole> PERFORMANCE_ROLES = { VideoRecording, Viewfinder };
+
+constexpr unsigned int kFrames = 100;
+constexpr unsigned int kWarmupFrames = 10;
+constexpr unsigned int kRepeats = 5;
+
+/* Tolerance on the measured frame duration, in percent. */
+constexpr unsigned int kFrameDurationTolerance = 5;
+
+/*
+ * Load the CPUs with the number of busy threads selected on the command line,
+ * for the lifetime of the instance.
+ */
+class CpuStress
+{
+public:
+	CpuStress(unsigned int count)
+		: stop_(false)
+	{
+		for (unsigned int i = 0; i < count; ++i)
+			threads_.emplace_back([this] {
+				while (!stop_.load(std::memory_order_relaxed))
+					;
+			});
+	}
+
+	~CpuStress()
+	{
+		stop_ = true;
+		for (std::thread &thread : threads_)
+			thread.join();
+	}
+
+private:
+	std::atomic<bool> stop_;
+	std::vector<std::thread> threads_;
+};
+
+template<typename T>
+T percentile(std::vector<T> values, unsigned int p)
+{
+	std::sort(values.begin(), values.end());
+	return values[(values.size() - 1) * p / 100];
+}
+
+int64_t toMicroseconds(PerformanceCapture::clock::duration duration)
+{
+	return duration_cast<microseconds>(duration).count();
+}
+
+} /* namespace */
+
+class Performance : public testing::TestWithParam<StreamRole>
+{
+public:
+	static std::string nameParameters(const testing::TestParamInfo<Performance::ParamType> &info);
+
+protected:
+	void SetUp() override;
+	void TearDown() override;
+
+	int64_t frameDuration() const;
+	void report(const std::string &key, int64_t value);
+
+	std::shared_ptr<Camera> camera_;
+};
+
+void Performance::SetUp()
+{
+	Environment *env = Environment::get();
+
+	camera_ = env->cm()->get(env->cameraId());
+
+	ASSERT_EQ(camera_->acquire(), 0);
+}
+
+void Performance::TearDown()
+{
+	if (!camera_)
+		return;
+
+	camera_->release();
+	camera_.reset();
+}
+
+std::string Performance::nameParameters(const testing::TestParamInfo<Performance::ParamType> &info)
+{
+	std::map<StreamRole, std::string> rolesMap = { { VideoRecording, "VideoRecording" },
+						       { Viewfinder, "Viewfinder" } };
+
+	return rolesMap[info.param];
+}
+
+/*
+ * Retrieve the frame duration the camera is expected to sustain, in
+ * microseconds, from the default value of its FrameDurationLimits control, or
+ * from the minimum value if no default is reported. Return 0 if the camera
+ * doesn't report frame duration limits.
+ */
+int64_t Performance::frameDuration() const
+{
+	const ControlInfoMap &controls = camera_->controls();
+	const auto it = controls.find(&controls::FrameDurationLimits);
+	if (it == controls.end())
+		return 0;
+
+	const ControlInfo &info = it->second;
+	const ControlValue &value = info.def().isNone() ? info.min() : info.def();
+	if (value.isArray())
+		return value.get<Span<const int64_t>>()[0];
+
+	return value.get<int64_t>();
+}
+
+/*
+ * Print a measurement and record it as a property of the test, in the
+ * machine-readable output selected with the --output option.
+ */
+void Performance::report(const std::string &key, int64_t value)
+{
+	std::cout << key << ": " << value << std::endl;
+	RecordProperty(key, std::to_string(value));
+}
+
+/*
+ * Test sustained frame rate
+ *
+ * Makes sure the camera delivers frames at the rate given by the default
+ * value of its FrameDurationLimits control, using the frame timestamps.
+ * Example failure is a pipeline that can't process frames at the sensor rate.
+ */
+TEST_P(Performance, FrameRate)
+{
+	PerformanceCapture capture(camera_);
+
+	capture.configure(GetParam());
+	if (HasFatalFailure())
+		return;
+
+	int64_t expected = frameDuration();
+	if (!expected) {
+		std::cout << "Camera doesn't limit the frame duration" << std::endl;
+		GTEST_SKIP();
+	}
+
+	ControlList controls;
+	controls.set(controls::FrameDurationLimits, { expected, expected });
+
+	capture.capture(kFrames, &controls);
+	if (HasFatalFailure())
+		return;
+
+	const std::vector<PerformanceCapture::Frame> &frames = capture.frames();
+	ASSERT_GT(frames.size(), kWarmupFrames + 1)
+		<< "Not enough frames to measure the frame rate";
+
+	const PerformanceCapture::Frame &first = frames[kWarmupFrames];
+	const PerformanceCapture::Frame &last = frames.back();
+
+	int64_t duration = (last.timestamp - first.timestamp) / 1000
+			 / (frames.size() - kWarmupFrames - 1);
+
+	report("ExpectedFrameDurationUs", expected);
+	report("FrameDurationUs", duration);
+
+	EXPECT_LE(duration, expected * (100 + kFrameDurationTolerance) / 100)
+		<< "Frame rate lower than expected";
+}
+
+/*
+ * Test request latency
+ *
+ * Measures the time between queuing a request and its completion. Example
+ * failure is a pipeline that holds requests for more frames than buffers are
+ * queued.
+ */
+TEST_P(Performance, Latency)
+{
+	PerformanceCapture capture(camera_);
+
+	capture.configure(GetParam());
+	if (HasFatalFailure())
+		return;
+
+	capture.capture(kFrames);
+	if (HasFatalFailure())
+		return;
+
+	std::vector<int64_t> latencies;
+	for (const PerformanceCapture::Frame &frame : capture.frames())
+		latencies.push_back(toMicroseconds(frame.latency));
+
+	report("LatencyP50Us", percentile(latencies, 50));
+	report("LatencyP90Us", percentile(latencies, 90));
+	report("LatencyP99Us", percentile(latencies, 99));
+	report("LatencyMaxUs", percentile(latencies, 100));
+
+	/*
+	 * A request waits for the requests queued before it, and shall complete
+	 * within two frames once it reaches the head of the queue.
+	 */
+	int64_t duration = frameDuration();
+	if (duration) {
+		EXPECT_LE(percentile(latencies, 99),
+			  duration * (capture.queueDepth() + 2))
+			<< "Requests complete too late";
+	}
+}
+
+/*
+ * Test frame continuity under load
+ *
+ * Makes sure the camera doesn't drop frames when the CPUs are loaded by the
+ * number of busy threads selected with the --stress option. Example failure
+ * is a pipeline that relies on being scheduled in time to requeue buffers.
+ */
+TEST_P(Performance, SequenceGaps)
+{
+	PerformanceCapture capture(camera_);
+
+	capture.configure(GetParam());
+	if (HasFatalFailure())
+		return;
+
+	CpuStress stress(Environment::get()->stressThreads());
+
+	capture.capture(kFrames);
+	if (HasFatalFailure())
+		return;
+
+	const std::vector<PerformanceCapture::Frame> &frames = capture.frames();
+	int64_t gaps = 0;
+
+	for (unsigned int i = 1; i < frames.size(); ++i) {
+		if (frames[i].sequence != frames[i - 1].sequence + 1)
+			gaps++;
+	}
+
+	report("StressThreads", Environment::get()->stressThreads());
+	report("SequenceGaps", gaps);
+
+	EXPECT_EQ(gaps, 0) << "Frames dropped";
+}
+
+/*
+ * Test start and stop latency
+ *
+ * Measures the time from starting the camera to the completion of the first
+ * request, and the time taken to stop the camera, over multiple cycles.
+ */
+TEST_P(Performance, StartStopLatency)
+{
+	PerformanceCapture capture(camera_);
+
+	capture.configure(GetParam());
+	if (HasFatalFailure())
+		return;
+
+	std::vector<int64_t> startLatencies;
+	std::vector<int64_t> stopLatencies;
+
+	for (unsigned int i = 0; i < kRepeats; ++i) {
+		capture.capture(kWarmupFrames);
+		if (HasFatalFailure())
+			return;
+
+		startLatencies.push_back(toMicroseconds(capture.startLatency()));
+		stopLatencies.push_back(toMicroseconds(capture.stopLatency()));
+	}
+
+	report("StartLatencyP50Us", percentile(startLatencies, 50));
+	report("StartLatencyMaxUs", percentile(startLatencies, 100));
+	report("StopLatencyP50Us", percentile(stopLatencies, 50));
+	report("StopLatencyMaxUs", percentile(stopLatencies, 100));
+}
+
+/*
+ * Test reconfiguration latency
+ *
+ * Measures the time taken to generate, validate and apply a configuration to
+ * a camera that has already been configured and has captured frames.
+ */
+TEST_P(Performance, ReconfigureLatency)
+{
+	PerformanceCapture capture(camera_);
+
+	capture.configure(GetParam());
+	if (HasFatalFailure())
+		return;
+
+	std::vector<int64_t> latencies;
+
+	for (unsigned int i = 0; i < kRepeats; ++i) {
+		capture.capture(kWarmupFrames);
+		if (HasFatalFailure())
+			return;
+
+		auto begin = PerformanceCapture::clock::now();
+		capture.configure(GetParam());
+		if (HasFatalFailure())
+			return;
+
+		latencies.push_back(toMicroseconds(PerformanceCapture::clock::now() - begin));
+	}
+
+	report("ReconfigureLatencyP50Us", percentile(latencies, 50));
+	report("ReconfigureLatencyMaxUs", percentile(latencies, 100));
+}
+
+INSTANTIATE_TEST_SUITE_P(PerformanceTests,
+			 Performance,
+			 testing::ValuesIn(PERFORMANCE_ROLES),
+			 Performance::nameParameters);
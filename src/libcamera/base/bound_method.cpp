@@ -52,20 +52,23 @@ namespace libcamera {
 /**
  * \brief Invoke the bound method with packed arguments
  * \param[in] pack Packed arguments
- * \param[in] deleteMethod True to delete \a this bound method instance when
- * method invocation completes
+ * \param[in] temporary True if \a this bound method instance is destroyed when
+ * the caller returns
  *
  * The bound method stores its return value, if any, in the arguments \a pack.
  * For direct and blocking invocations, this is performed synchronously, and
  * the return value contained in the pack may be used. For queued invocations,
- * the return value is stored at an undefined point of time and shall thus not
- * be used by the caller.
+ * the \a pack is moved to the message posted to the receiver, as well as the
+ * bound method if it is \a temporary. The return value is then stored at an
+ * undefined point of time and shall thus not be used by the caller.
+ *
+ * The caller may thus allocate both the \a pack and, for \a temporary
+ * methods, the bound method on the stack.
  *
  * \return True if the return value contained in the \a pack may be used by the
  * caller, false otherwise
  */
-bool BoundMethodBase::activatePack(std::shared_ptr<BoundMethodPackBase> pack,
-				   bool deleteMethod)
+bool BoundMethodBase::activatePack(BoundMethodPackBase *pack, bool temporary)
 {
 	ConnectionType type = connectionType_;
 	if (type == ConnectionTypeAuto) {
@@ -81,14 +84,13 @@ bool BoundMethodBase::activatePack(std::shared_ptr<BoundMethodPackBase> pack,
 	switch (type) {
 	case ConnectionTypeDirect:
 	default:
-		invokePack(pack.get());
-		if (deleteMethod)
-			delete this;
+		invokePack(pack);
 		return true;
 
 	case ConnectionTypeQueued: {
 		std::unique_ptr<Message> msg =
-			std::make_unique<InvokeMessage>(this, pack, nullptr, deleteMethod);
+			object_->thread()->createInvokeMessage(this, pack, nullptr,
+							       temporary);
 		object_->postMessage(std::move(msg));
 		return false;
 	}
@@ -97,7 +99,8 @@ bool BoundMethodBase::activatePack(std::shared_ptr<BoundMethodPackBase> pack,
 		Semaphore semaphore;
 
 		std::unique_ptr<Message> msg =
-			std::make_unique<InvokeMessage>(this, pack, &semaphore, deleteMethod);
+			object_->thread()->createInvokeMessage(this, pack, &semaphore,
+							       temporary);
 		object_->postMessage(std::move(msg));
 
 		semaphore.acquire();
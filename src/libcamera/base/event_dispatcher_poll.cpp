@@ -113,31 +113,12 @@ void EventDispatcherPoll::unregisterEventNotifier(EventNotifier *notifier)
 
 void EventDispatcherPoll::registerTimer(Timer *timer)
 {
-	for (auto iter = timers_.begin(); iter != timers_.end(); ++iter) {
-		if ((*iter)->deadline() > timer->deadline()) {
-			timers_.insert(iter, timer);
-			return;
-		}
-	}
-
-	timers_.push_back(timer);
+	timers_.insert(timer);
 }
 
 void EventDispatcherPoll::unregisterTimer(Timer *timer)
 {
-	for (auto iter = timers_.begin(); iter != timers_.end(); ++iter) {
-		if (*iter == timer) {
-			timers_.erase(iter);
-			return;
-		}
-
-		/*
-		 * As the timers list is ordered, we can stop as soon as we go
-		 * past the deadline.
-		 */
-		if ((*iter)->deadline() > timer->deadline())
-			break;
-	}
+	timers_.remove(timer);
 }
 
 void EventDispatcherPoll::processEvents()
@@ -202,7 +183,7 @@ short EventDispatcherPoll::EventNotifierSetPoll::events() const
 int EventDispatcherPoll::poll(std::vector<struct pollfd> *pollfds)
 {
 	/* Compute the timeout. */
-	Timer *nextTimer = !timers_.empty() ? timers_.front() : nullptr;
+	Timer *nextTimer = timers_.first();
 	struct timespec timeout;
 
 	if (nextTimer) {
@@ -293,12 +274,8 @@ void EventDispatcherPoll::processTimers()
 {
 	utils::time_point now = utils::clock::now();
 
-	while (!timers_.empty()) {
-		Timer *timer = timers_.front();
-		if (timer->deadline() > now)
-			break;
-
-		timers_.pop_front();
+	while (Timer *timer = timers_.expired(now)) {
+		timers_.remove(timer);
 		timer->stop();
 		timer->timeout.emit();
 	}
@@ -114,6 +114,13 @@ Message::Type Message::registerMessageType()
 /**
  * \class InvokeMessage
  * \brief A message carrying a method invocation across threads
+ *
+ * The InvokeMessage stores the method to be invoked and its arguments. When
+ * the sender doesn't wait for the invocation to complete, the arguments pack,
+ * and the method if it is temporary, are moved to storage internal to the
+ * message. Small packs and methods are stored inline in the message, avoiding
+ * any memory allocation besides the message itself, which is recycled by the
+ * receiving thread.
  */
 
 /**
@@ -121,21 +128,25 @@ Message::Type Message::registerMessageType()
  * \param[in] method The bound method
  * \param[in] pack The packed method arguments
  * \param[in] semaphore The semaphore used to signal message delivery
- * \param[in] deleteMethod True to delete the \a method when the message is
- * destroyed
- */
-InvokeMessage::InvokeMessage(BoundMethodBase *method,
-			     std::shared_ptr<BoundMethodPackBase> pack,
-			     Semaphore *semaphore, bool deleteMethod)
-	: Message(Message::InvokeMessage), method_(method), pack_(pack),
-	  semaphore_(semaphore), deleteMethod_(deleteMethod)
+ * \param[in] temporary True if the \a method is destroyed when the caller
+ * returns
+ *
+ * When a \a semaphore is given, the caller shall wait on the semaphore before
+ * destroying the \a method and \a pack, which are then referenced by the
+ * message. Otherwise, the \a pack is moved to the message, as well as the \a
+ * method if it is \a temporary.
+ */
+InvokeMessage::InvokeMessage(BoundMethodBase *method, BoundMethodPackBase *pack,
+			     Semaphore *semaphore, bool temporary)
+	: Message(Message::InvokeMessage), method_(nullptr), pack_(nullptr),
+	  semaphore_(nullptr), ownsMethod_(false), ownsPack_(false)
 {
+	assign(method, pack, semaphore, temporary);
 }
 
 InvokeMessage::~InvokeMessage()
 {
-	if (deleteMethod_)
-		delete method_;
+	release();
 }
 
 /**
@@ -150,7 +161,65 @@ InvokeMessage::~InvokeMessage()
  */
 void InvokeMessage::invoke()
 {
-	method_->invokePack(pack_.get());
+	method_->invokePack(pack_);
+}
+
+/**
+ * \brief Set the method invocation carried by the message
+ * \param[in] method The bound method
+ * \param[in] pack The packed method arguments
+ * \param[in] semaphore The semaphore used to signal message delivery
+ * \param[in] temporary True if the \a method is destroyed when the caller
+ * returns
+ *
+ * This function is used to reuse a message after release().
+ */
+void InvokeMessage::assign(BoundMethodBase *method, BoundMethodPackBase *pack,
+			   Semaphore *semaphore, bool temporary)
+{
+	semaphore_ = semaphore;
+
+	if (semaphore) {
+		method_ = method;
+		pack_ = pack;
+		return;
+	}
+
+	pack_ = pack->moveTo(packStorage_, sizeof(packStorage_));
+	ownsPack_ = true;
+
+	if (temporary) {
+		method_ = method->moveTo(methodStorage_, sizeof(methodStorage_));
+		ownsMethod_ = true;
+	} else {
+		method_ = method;
+	}
+}
+
+/**
+ * \brief Destroy the method and arguments pack owned by the message
+ */
+void InvokeMessage::release()
+{
+	if (ownsPack_) {
+		if (static_cast<void *>(pack_) == packStorage_)
+			pack_->~BoundMethodPackBase();
+		else
+			delete pack_;
+	}
+
+	if (ownsMethod_) {
+		if (static_cast<void *>(method_) == methodStorage_)
+			method_->~BoundMethodBase();
+		else
+			delete method_;
+	}
+
+	method_ = nullptr;
+	pack_ = nullptr;
+	semaphore_ = nullptr;
+	ownsMethod_ = false;
+	ownsPack_ = false;
 }
 
 /**
@@ -7,6 +7,7 @@
 
 #include <libcamera/base/signal.h>
 
+#include <libcamera/base/log.h>
 #include <libcamera/base/mutex.h>
 
 /**
@@ -19,14 +20,122 @@ namespace libcamera {
 namespace {
 
 /*
- * Mutex to protect the SignalBase::slots_ and Object::signals_ lists. If lock
- * contention needs to be decreased, this could be replaced with locks in
- * Object and SignalBase, or with a mutex pool.
+ * Mutex to serialize the connect and disconnect operations, protecting the
+ * SignalBase retired slots and Object::signals_ lists. Emission doesn't take
+ * the lock.
  */
 Mutex signalsLock;
 
 } /* namespace */
 
+/*
+ * The slots of a signal are stored in an immutable SlotList, replaced with an
+ * updated copy by the connect and disconnect operations. Emission reads the
+ * current list without locking, and holds a reference to the signal State for
+ * the duration of the emission.
+ *
+ * The State is reference-counted, with one reference held by the signal and
+ * one by each emission in progress. It outlives the signal if the signal is
+ * destroyed during its emission, for instance by one of its slots, and is then
+ * freed with the lists and slots it still holds by the last emission.
+ *
+ * The list and the slots replaced or removed by connect and disconnect can
+ * only be freed when no emission is in progress, otherwise they are retired
+ * and the State is marked as pending reclaim. The reference count is
+ * incremented before loading the list, and the list is replaced before reading
+ * the count, both with sequentially consistent ordering. A writer that reads
+ * a count of one is thus guaranteed that any emission starting afterwards will
+ * use the new list. The last emission to complete reclaims the retired lists
+ * and slots if it sees the pending flag. Lists and slots retired concurrently
+ * with the completion of the last emission, after it checked the flag, or when
+ * multiple emissions complete concurrently, are reclaimed when the next
+ * emission completes or by the next connect or disconnect operation.
+ */
+
+SignalBase::SignalBase()
+	: state_(new State())
+{
+}
+
+SignalBase::~SignalBase()
+{
+	MutexLocker locker(signalsLock);
+
+	/* Slots are deleted by Signal::~Signal() through disconnect(). */
+	const SlotList *slots = state_->slots.exchange(nullptr);
+	if (slots)
+		state_->retiredLists.push_back(slots);
+
+	/*
+	 * Hand the state over to the emissions in progress, if any. The last
+	 * one will free it.
+	 */
+	state_->orphaned = true;
+	state_->pending.store(true);
+
+	if (state_->refs.fetch_sub(1) == 1)
+		destroy(state_);
+}
+
+void SignalBase::publish(SlotList *slots, std::vector<BoundMethodBase *> removed)
+{
+	if (slots && slots->empty()) {
+		delete slots;
+		slots = nullptr;
+	}
+
+	const SlotList *old = state_->slots.exchange(slots);
+
+	if (old)
+		state_->retiredLists.push_back(old);
+	state_->retiredSlots.insert(state_->retiredSlots.end(),
+				    removed.begin(), removed.end());
+
+	if (state_->retiredLists.empty() && state_->retiredSlots.empty())
+		return;
+
+	state_->pending.store(true);
+
+	if (state_->refs.load() == 1)
+		reclaim(state_);
+}
+
+void SignalBase::releaseSlotsAndReclaim(State *state)
+{
+	MutexLocker locker(signalsLock);
+
+	unsigned int refs = state->refs.fetch_sub(1);
+	if (refs == 1) {
+		/* The signal has been destroyed, and this was the last emission. */
+		destroy(state);
+		return;
+	}
+
+	/* Reclaim if only the reference held by the signal remains. */
+	if (refs == 2 && !state->orphaned)
+		reclaim(state);
+}
+
+void SignalBase::reclaim(State *state)
+{
+	for (const SlotList *list : state->retiredLists)
+		delete list;
+	state->retiredLists.clear();
+
+	for (BoundMethodBase *slot : state->retiredSlots)
+		delete slot;
+	state->retiredSlots.clear();
+
+	state->pending.store(false);
+}
+
+void SignalBase::destroy(State *state)
+{
+	delete state->slots.load();
+	reclaim(state);
+	delete state;
+}
+
 void SignalBase::connect(BoundMethodBase *slot)
 {
 	MutexLocker locker(signalsLock);
@@ -34,38 +143,50 @@ void SignalBase::connect(BoundMethodBase *slot)
 	Object *object = slot->object();
 	if (object)
 		object->connect(this);
-	slots_.push_back(slot);
+
+	const SlotList *current = state_->slots.load();
+	SlotList *slots = current ? new SlotList(*current) : new SlotList();
+	slots->push_back(slot);
+
+	publish(slots, {});
 }
 
 void SignalBase::disconnect(Object *object)
 {
-	disconnect([object](SlotList::iterator &iter) {
-		return (*iter)->match(object);
+	disconnect([object](BoundMethodBase *slot) {
+		return slot->match(object);
 	});
 }
 
-void SignalBase::disconnect(std::function<bool(SlotList::iterator &)> match)
+void SignalBase::disconnect(std::function<bool(BoundMethodBase *)> match)
 {
 	MutexLocker locker(signalsLock);
 
-	for (auto iter = slots_.begin(); iter != slots_.end(); ) {
-		if (match(iter)) {
-			Object *object = (*iter)->object();
+	const SlotList *current = state_->slots.load();
+	if (!current)
+		return;
+
+	SlotList *slots = new SlotList();
+	std::vector<BoundMethodBase *> removed;
+
+	for (BoundMethodBase *slot : *current) {
+		if (match(slot)) {
+			Object *object = slot->object();
 			if (object)
 				object->disconnect(this);
 
-			delete *iter;
-			iter = slots_.erase(iter);
+			removed.push_back(slot);
 		} else {
-			++iter;
+			slots->push_back(slot);
 		}
 	}
-}
 
-SignalBase::SlotList SignalBase::slots()
-{
-	MutexLocker locker(signalsLock);
-	return slots_;
+	if (removed.empty()) {
+		delete slots;
+		return;
+	}
+
+	publish(slots, std::move(removed));
 }
 
 /**
@@ -197,8 +318,13 @@ SignalBase::SlotList SignalBase::slots()
  * of the arguments (when passed by pointer or reference), the modification is
  * thus visible to all subsequently called slots.
  *
- * This function is not \threadsafe, but thread-safety is guaranteed against
- * concurrent connect() and disconnect() calls.
+ * Emission doesn't lock, and operates on a snapshot of the connected slots:
+ * slots connected or disconnected while the signal is being emitted, including
+ * by the slots themselves, take effect for the next emission only. A slot may
+ * destroy the signal, in which case the remaining slots of the snapshot are
+ * still called.
+ *
+ * This function is \threadsafe.
  */
 
 } /* namespace libcamera */
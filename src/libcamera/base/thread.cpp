@@ -12,6 +12,7 @@
 #include <sys/syscall.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <vector>
 
 #include <libcamera/base/event_dispatcher.h>
 #include <libcamera/base/event_dispatcher_poll.h>
@@ -118,10 +119,29 @@ class ThreadMain;
 class MessageQueue
 {
 public:
+	/**
+	 * \brief The maximum number of entries in the recycling pools
+	 */
+	static constexpr unsigned int kPoolSize = 32;
+
+	MessageQueue()
+	{
+		invokeMessages_.reserve(kPoolSize);
+	}
+
 	/**
 	 * \brief List of queued Message instances
 	 */
 	std::list<std::unique_ptr<Message>> list_;
+	/**
+	 * \brief Pool of empty list entries, reused to queue messages
+	 */
+	std::list<std::unique_ptr<Message>> freeEntries_;
+	/**
+	 * \brief Pool of delivered InvokeMessage instances, reused for new
+	 * method invocations
+	 */
+	std::vector<std::unique_ptr<InvokeMessage>> invokeMessages_;
 	/**
 	 * \brief Protects the \ref list_
 	 */
@@ -531,8 +551,16 @@ void Thread::postMessage(std::unique_ptr<Message> msg, Object *receiver)
 
 	ASSERT(data_ == receiver->thread()->data_);
 
-	MutexLocker locker(data_->messages_.mutex_);
-	data_->messages_.list_.push_back(std::move(msg));
+	MessageQueue &messages = data_->messages_;
+
+	MutexLocker locker(messages.mutex_);
+	if (!messages.freeEntries_.empty()) {
+		messages.list_.splice(messages.list_.end(), messages.freeEntries_,
+				      messages.freeEntries_.begin());
+		messages.list_.back() = std::move(msg);
+	} else {
+		messages.list_.push_back(std::move(msg));
+	}
 	receiver->pendingMessages_++;
 	locker.unlock();
 
@@ -625,23 +653,89 @@ void Thread::dispatchMessages(Message::Type type)
 
 		locker.unlock();
 		receiver->message(message.get());
-		message.reset();
+
+		/*
+		 * Release the resources held by invoke messages without the
+		 * lock, and recycle the message if the pool isn't full.
+		 */
+		std::unique_ptr<InvokeMessage> invokeMessage;
+		if (message->type() == Message::InvokeMessage) {
+			invokeMessage.reset(static_cast<InvokeMessage *>(message.release()));
+			invokeMessage->release();
+		} else {
+			message.reset();
+		}
+
 		locker.lock();
+
+		std::vector<std::unique_ptr<InvokeMessage>> &pool =
+			data_->messages_.invokeMessages_;
+		if (invokeMessage && pool.size() < MessageQueue::kPoolSize)
+			pool.push_back(std::move(invokeMessage));
 	}
 
 	/*
-	 * If the recursion level is 0, erase all null messages in the list. We
-	 * can't do so during recursion, as it would invalidate the iterator of
-	 * the outer calls.
+	 * If the recursion level is 0, remove all null messages from the list
+	 * and keep them for reuse by postMessage(). We can't do so during
+	 * recursion, as it would invalidate the iterator of the outer calls.
 	 */
 	if (!--data_->messages_.recursion_) {
+		std::list<std::unique_ptr<Message>> &freeEntries =
+			data_->messages_.freeEntries_;
+
 		for (auto iter = messages.begin(); iter != messages.end(); ) {
-			if (!*iter)
-				iter = messages.erase(iter);
-			else
+			if (*iter) {
 				++iter;
+				continue;
+			}
+
+			auto entry = iter++;
+			if (freeEntries.size() < MessageQueue::kPoolSize)
+				freeEntries.splice(freeEntries.end(), messages, entry);
+			else
+				messages.erase(entry);
+		}
+	}
+}
+
+/**
+ * \brief Create a message to invoke a method in this thread
+ * \param[in] method The bound method
+ * \param[in] pack The packed method arguments
+ * \param[in] semaphore The semaphore used to signal message delivery
+ * \param[in] temporary True if the \a method is destroyed when the caller
+ * returns
+ *
+ * Reuse an InvokeMessage previously delivered by the thread if available, or
+ * allocate a new one otherwise.
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return The message
+ */
+std::unique_ptr<InvokeMessage>
+Thread::createInvokeMessage(BoundMethodBase *method, BoundMethodPackBase *pack,
+			    Semaphore *semaphore, bool temporary)
+{
+	std::unique_ptr<InvokeMessage> msg;
+
+	{
+		MutexLocker locker(data_->messages_.mutex_);
+
+		std::vector<std::unique_ptr<InvokeMessage>> &pool =
+			data_->messages_.invokeMessages_;
+		if (!pool.empty()) {
+			msg = std::move(pool.back());
+			pool.pop_back();
 		}
 	}
+
+	if (!msg)
+		return std::make_unique<InvokeMessage>(method, pack, semaphore,
+						       temporary);
+
+	msg->assign(method, pack, semaphore, temporary);
+	return msg;
 }
 
 /**
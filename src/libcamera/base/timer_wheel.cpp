@@ -0,0 +1,240 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * timer_wheel.cpp - Hierarchical timer wheel
+ */
+
+#include <libcamera/base/timer_wheel.h>
+
+#include <algorithm>
+
+#include <libcamera/base/timer.h>
+
+/**
+ * \file base/timer_wheel.h
+ * \brief Hierarchical timer wheel
+ */
+
+namespace libcamera {
+
+/**
+ * \class TimerWheel
+ * \brief Store running timers for an event dispatcher
+ *
+ * The TimerWheel stores Timer instances in a hierarchy of kLevels wheels of
+ * kSlots slots each. Time is divided in ticks of 2^kTickShift nanoseconds
+ * (about one millisecond). The slots of the first level each cover one tick,
+ * and the slots of each subsequent level cover a full turn of the previous
+ * level. A timer is stored in the lowest level whose slot can hold its
+ * deadline, relative to the current tick of the wheel.
+ *
+ * Inserting and removing a timer are constant time operations, independent of
+ * the number of timers in the wheel. Timers are linked in the slots through
+ * their prev_ and next_ members, so the wheel doesn't allocate memory.
+ *
+ * When the current tick advances past the start of a slot of a higher level,
+ * the timers of that slot are cascaded to the lower levels. Each timer is thus
+ * moved at most kLevels times before it expires. Deadlines are compared with
+ * nanosecond precision when looking for the first or expired timers, the tick
+ * granularity only affects the distribution of timers in slots.
+ *
+ * Deadlines beyond the range of the wheel, about two years, are clamped to
+ * the last slot of the last level, and cascaded again when reaching it.
+ */
+
+/**
+ * \brief Construct an empty TimerWheel
+ */
+TimerWheel::TimerWheel()
+	: current_(tick(utils::clock::now())), occupied_{}, slots_{}
+{
+}
+
+/**
+ * \brief Insert a timer in the wheel
+ * \param[in] timer The timer
+ *
+ * The \a timer is stored according to its current deadline, and shall be
+ * removed before its deadline is modified.
+ */
+void TimerWheel::insert(Timer *timer)
+{
+	link(timer);
+}
+
+/**
+ * \brief Remove a timer from the wheel
+ * \param[in] timer The timer
+ *
+ * Timers that are not stored in the wheel are ignored.
+ */
+void TimerWheel::remove(Timer *timer)
+{
+	if (!timer->slot_)
+		return;
+
+	unsigned int level = (timer->slot_ - 1) / kSlots;
+	unsigned int index = (timer->slot_ - 1) % kSlots;
+
+	Slot &slot = slots_[level][index];
+
+	if (timer->prev_)
+		timer->prev_->next_ = timer->next_;
+	else
+		slot.head = timer->next_;
+
+	if (timer->next_)
+		timer->next_->prev_ = timer->prev_;
+	else
+		slot.tail = timer->prev_;
+
+	if (!slot.head)
+		occupied_[level] &= ~(1ULL << index);
+
+	timer->prev_ = nullptr;
+	timer->next_ = nullptr;
+	timer->slot_ = 0;
+}
+
+/**
+ * \brief Retrieve the timer with the earliest deadline
+ * \return The timer with the earliest deadline, or nullptr if the wheel is
+ * empty
+ */
+Timer *TimerWheel::first() const
+{
+	unsigned int level;
+	unsigned int index;
+
+	if (!lowestSlot(&level, &index))
+		return nullptr;
+
+	return earliest(level, index);
+}
+
+/**
+ * \brief Retrieve a timer whose deadline has expired
+ * \param[in] now The current time
+ *
+ * Advance the wheel to \a now, and return the timer with the earliest deadline
+ * if it is not later than \a now. The timer is not removed from the wheel.
+ *
+ * \return A timer whose deadline has expired, or nullptr if no timer has
+ * expired
+ */
+Timer *TimerWheel::expired(utils::time_point now)
+{
+	uint64_t nowTick = tick(now);
+
+	while (true) {
+		unsigned int level;
+		unsigned int index;
+
+		if (!lowestSlot(&level, &index)) {
+			current_ = std::max(current_, nowTick);
+			return nullptr;
+		}
+
+		uint64_t start = slotTick(level, index);
+		if (start > nowTick)
+			return nullptr;
+
+		current_ = start;
+
+		if (level == 0) {
+			Timer *timer = earliest(level, index);
+			return timer->deadline() <= now ? timer : nullptr;
+		}
+
+		/* Cascade the slot to the lower levels. */
+		Timer *timer = slots_[level][index].head;
+		slots_[level][index] = {};
+		occupied_[level] &= ~(1ULL << index);
+
+		while (timer) {
+			Timer *next = timer->next_;
+			link(timer);
+			timer = next;
+		}
+	}
+}
+
+uint64_t TimerWheel::tick(utils::time_point time)
+{
+	auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch());
+	return ns.count() > 0 ? static_cast<uint64_t>(ns.count()) >> kTickShift : 0;
+}
+
+void TimerWheel::link(Timer *timer)
+{
+	constexpr uint64_t range = (1ULL << (kLevels * kSlotBits)) - 1;
+
+	uint64_t expires = std::max(tick(timer->deadline()), current_);
+	if ((expires ^ current_) > range)
+		expires = current_ | range;
+
+	/*
+	 * Store the timer in the level of the most significant slot index that
+	 * differs from the current tick, all the more significant indices being
+	 * equal.
+	 */
+	uint64_t diff = expires ^ current_;
+	unsigned int level = diff ? (63 - __builtin_clzll(diff)) / kSlotBits : 0;
+	unsigned int index = (expires >> (level * kSlotBits)) & (kSlots - 1);
+
+	Slot &slot = slots_[level][index];
+
+	timer->prev_ = slot.tail;
+	timer->next_ = nullptr;
+	if (slot.tail)
+		slot.tail->next_ = timer;
+	else
+		slot.head = timer;
+	slot.tail = timer;
+
+	timer->slot_ = level * kSlots + index + 1;
+	occupied_[level] |= 1ULL << index;
+}
+
+bool TimerWheel::lowestSlot(unsigned int *level, unsigned int *index) const
+{
+	/*
+	 * The slot indices of the timers stored in a level are never lower
+	 * than the index of the current tick in that level, the first occupied
+	 * slot of the lowest occupied level thus holds the earliest timers.
+	 */
+	for (unsigned int i = 0; i < kLevels; ++i) {
+		if (!occupied_[i])
+			continue;
+
+		*level = i;
+		*index = __builtin_ctzll(occupied_[i]);
+		return true;
+	}
+
+	return false;
+}
+
+uint64_t TimerWheel::slotTick(unsigned int level, unsigned int index) const
+{
+	unsigned int shift = level * kSlotBits;
+	uint64_t mask = (1ULL << (shift + kSlotBits)) - 1;
+
+	return (current_ & ~mask) | (static_cast<uint64_t>(index) << shift);
+}
+
+Timer *TimerWheel::earliest(unsigned int level, unsigned int index) const
+{
+	/* Timers with identical deadlines expire in insertion order. */
+	Timer *first = slots_[level][index].head;
+
+	for (Timer *timer = first->next_; timer; timer = timer->next_) {
+		if (timer->deadline() < first->deadline())
+			first = timer;
+	}
+
+	return first;
+}
+
+} /* namespace libcamera */
@@ -7,20 +7,24 @@
 
 #include <libcamera/camera.h>
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <iomanip>
 
 #include <libcamera/base/log.h>
 #include <libcamera/base/thread.h>
+#include <libcamera/base/utils.h>
 
 #include <libcamera/color_space.h>
+#include <libcamera/control_ids.h>
 #include <libcamera/framebuffer_allocator.h>
 #include <libcamera/request.h>
 #include <libcamera/stream.h>
 
 #include "libcamera/internal/camera.h"
 #include "libcamera/internal/camera_controls.h"
+#include "libcamera/internal/camera_telemetry.h"
 #include "libcamera/internal/formats.h"
 #include "libcamera/internal/pipeline_handler.h"
 
@@ -110,6 +114,38 @@ namespace libcamera {
 
 LOG_DECLARE_CATEGORY(Camera)
 
+/**
+ * \struct SensorConfiguration
+ * \brief Camera sensor configuration
+ *
+ * The SensorConfiguration describes the camera sensor output format that
+ * applications can request through CameraConfiguration::sensorConfig, instead
+ * of letting the pipeline handler select the sensor mode based on the stream
+ * configurations. It is typically used to select a binned or a full
+ * resolution sensor mode without changing the output streams, for instance
+ * to switch between a high frame rate preview and a still capture mode with
+ * Camera::reconfigure().
+ *
+ * \var SensorConfiguration::bitDepth
+ * \brief The sensor output bit depth
+ *
+ * \var SensorConfiguration::outputSize
+ * \brief The sensor output frame size
+ */
+
+/**
+ * \brief Check if the sensor configuration is valid
+ *
+ * A sensor configuration is valid if both its bit depth and output size are
+ * set.
+ *
+ * \return True if the sensor configuration is valid, false otherwise
+ */
+bool SensorConfiguration::isValid() const
+{
+	return bitDepth && !outputSize.isNull();
+}
+
 /**
  * \class CameraConfiguration
  * \brief Hold configuration for streams of the camera
@@ -411,6 +447,21 @@ CameraConfiguration::Status CameraConfiguration::validateColorSpaces(ColorSpaceF
  * may adjust this field at its discretion if the selection is not supported.
  */
 
+/**
+ * \var CameraConfiguration::sensorConfig
+ * \brief The camera sensor configuration
+ *
+ * The sensorConfig field lets applications select the camera sensor output
+ * format explicitly. When set, pipeline handlers that support it use the
+ * sensor mode matching the requested configuration exactly, and validate()
+ * returns CameraConfiguration::Invalid if no such mode exists. When not set,
+ * the sensor mode is selected by the pipeline handler based on the stream
+ * configurations.
+ *
+ * Pipeline handlers that don't support selecting the sensor mode ignore this
+ * field.
+ */
+
 /**
  * \var CameraConfiguration::config_
  * \brief The vector of stream configurations
@@ -456,6 +507,12 @@ Camera::Private::~Private()
  * \return The control validator associated with this camera
  */
 
+/**
+ * \fn Camera::Private::telemetry()
+ * \brief Retrieve the frame delivery telemetry of this camera
+ * \return The telemetry associated with this camera
+ */
+
 /**
  * \var Camera::Private::queuedRequests_
  * \brief The list of queued and not yet completed requests
@@ -554,6 +611,25 @@ int Camera::Private::isAccessAllowed(State low, State high,
 	return -EACCES;
 }
 
+int Camera::Private::validateRequest(const Request *request) const
+{
+	if (request->buffers().empty()) {
+		LOG(Camera, Error) << "Request contains no buffers";
+		return -EINVAL;
+	}
+
+	for (auto const &it : request->buffers()) {
+		const Stream *stream = it.first;
+
+		if (activeStreams_.find(stream) == activeStreams_.end()) {
+			LOG(Camera, Error) << "Invalid request";
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
 void Camera::Private::disconnect()
 {
 	/*
@@ -572,6 +648,71 @@ void Camera::Private::setState(State state)
 	state_.store(state, std::memory_order_release);
 }
 
+/**
+ * \struct StreamStatistics
+ * \brief Frame delivery statistics for a stream
+ *
+ * The StreamStatistics structure reports counters about the buffers completed
+ * for a stream, and the interval between consecutive frames delivered
+ * successfully, as computed from the buffers' FrameMetadata::timestamp.
+ *
+ * \var StreamStatistics::framesDelivered
+ * \brief The number of buffers completed successfully
+ *
+ * \var StreamStatistics::framesDropped
+ * \brief The number of frames lost while requests were queued
+ *
+ * Frames are considered as lost when the FrameMetadata::sequence of
+ * consecutive buffers delivered for the stream are not contiguous, or when a
+ * buffer completes with an error.
+ *
+ * \var StreamStatistics::framesCancelled
+ * \brief The number of buffers cancelled, usually when stopping the camera
+ *
+ * \var StreamStatistics::underruns
+ * \brief The number of frames lost because the camera ran out of requests
+ *
+ * Frames captured by the camera while the application had no request queued
+ * are counted as underruns instead of dropped frames.
+ *
+ * \var StreamStatistics::framesAbsorbed
+ * \brief The number of underruns captured to internal buffers
+ *
+ * Some pipeline handlers keep the camera streaming to internal buffers when
+ * the application runs out of requests, to avoid stalling the capture. This
+ * counts the frames captured to those internal buffers, which are part of the
+ * underruns.
+ *
+ * \var StreamStatistics::minFrameInterval
+ * \brief The minimum interval between consecutive frames
+ *
+ * \var StreamStatistics::avgFrameInterval
+ * \brief The average interval between consecutive frames
+ *
+ * \var StreamStatistics::maxFrameInterval
+ * \brief The maximum interval between consecutive frames
+ *
+ * \var StreamStatistics::p99FrameInterval
+ * \brief The 99th percentile of the interval between consecutive frames
+ *
+ * The percentile is computed with a granularity of 1/16th of its value, and
+ * a minimum granularity of about 1µs, for intervals up to about 34s.
+ */
+
+/**
+ * \struct CameraStatistics
+ * \brief Frame delivery statistics for a camera
+ *
+ * \var CameraStatistics::requestsCompleted
+ * \brief The number of requests completed, including cancelled requests
+ *
+ * \var CameraStatistics::requestsCancelled
+ * \brief The number of requests cancelled
+ *
+ * \var CameraStatistics::streams
+ * \brief The statistics for each stream of the camera
+ */
+
 /**
  * \class Camera
  * \brief Camera device
@@ -633,7 +774,7 @@ void Camera::Private::setState(State state)
  *
  *   Running -> Stopping [label = "stop()"];
  *   Stopping -> Configured;
- *   Running -> Running [label = "createRequest(), queueRequest()"];
+ *   Running -> Running [label = "createRequest(), queueRequest(),\nreconfigure()"];
  * }
  * \enddot
  *
@@ -661,7 +802,8 @@ void Camera::Private::setState(State state)
  * \subsubsection Running
  * The camera is running and ready to process requests queued by the
  * application. The camera remains in this state until it is stopped and moved
- * to the Configured state.
+ * to the Configured state. The sensor configuration may be changed without
+ * leaving this state with reconfigure().
  */
 
 /**
@@ -756,6 +898,7 @@ Camera::Camera(std::unique_ptr<Private> d, const std::string &id,
 	_d()->id_ = id;
 	_d()->streams_ = streams;
 	_d()->validator_ = std::make_unique<CameraControlValidator>(this);
+	_d()->telemetry_ = std::make_unique<CameraTelemetry>(streams);
 }
 
 Camera::~Camera()
@@ -971,6 +1114,44 @@ std::unique_ptr<CameraConfiguration> Camera::generateConfiguration(const StreamR
 	return std::unique_ptr<CameraConfiguration>(config);
 }
 
+/**
+ * \brief Validate candidate configurations for a single stream in one call
+ * \param[in] role The stream role the candidates are intended for
+ * \param[inout] candidates The candidate stream configurations
+ *
+ * Probing the capabilities of a camera often requires validating a large number
+ * of single stream configurations that differ only by their pixel format and
+ * size. This function validates all the \a candidates in one call, each as the
+ * sole stream of a camera configuration generated for the \a role. It is
+ * equivalent to, but usually cheaper than, calling generateConfiguration()
+ * and CameraConfiguration::validate() for each candidate, as the pipeline
+ * handler can share intermediate results between the candidates.
+ *
+ * Only the pixel format and size of the candidates are considered, all other
+ * stream parameters are set to their default values for the \a role. Each
+ * candidate is updated with the configuration as adjusted by the validation.
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return The validation status of each candidate, in the same order as the
+ * \a candidates. All candidates are reported as CameraConfiguration::Invalid
+ * if the camera can't generate a configuration for the \a role.
+ */
+std::vector<CameraConfiguration::Status>
+Camera::validateConfigurations(StreamRole role,
+			       std::vector<StreamConfiguration> &candidates)
+{
+	Private *const d = _d();
+
+	int ret = d->isAccessAllowed(Private::CameraAvailable,
+				     Private::CameraRunning);
+	if (ret < 0)
+		return std::vector<CameraConfiguration::Status>(candidates.size(),
+								CameraConfiguration::Invalid);
+
+	return d->pipe_->validateConfigurations(this, role, candidates);
+}
+
 /**
  * \brief Configure the camera prior to capture
  * \param[in] config The camera configurations to setup
@@ -1027,11 +1208,17 @@ int Camera::configure(CameraConfiguration *config)
 
 	LOG(Camera, Info) << msg.str();
 
+	utils::time_point start = utils::clock::now();
+
 	ret = d->pipe_->invokeMethod(&PipelineHandler::configure,
 				     ConnectionTypeBlocking, this, config);
 	if (ret)
 		return ret;
 
+	utils::Duration elapsed = utils::clock::now() - start;
+	LOG(Camera, Debug)
+		<< "Pipeline configured in " << elapsed.get<std::micro>() << "us";
+
 	d->activeStreams_.clear();
 	for (const StreamConfiguration &cfg : *config) {
 		Stream *stream = cfg.stream();
@@ -1051,6 +1238,103 @@ int Camera::configure(CameraConfiguration *config)
 	return 0;
 }
 
+/**
+ * \brief Change the sensor configuration of a running camera
+ * \param[in] config The new camera configuration
+ *
+ * Changing the sensor mode with stop(), configure() and start() releases all
+ * buffers, restarts the image processing algorithms and drops many frames.
+ * This function instead applies a new configuration to a running camera for
+ * changes that don't affect the output streams, such as a different
+ * CameraConfiguration::sensorConfig to switch between binned and full
+ * resolution sensor modes. The buffers allocated for the streams, and the
+ * internal buffers and algorithm state of the pipeline handler where
+ * possible, are preserved.
+ *
+ * The \a config shall be the configuration previously passed to configure(),
+ * modified by the caller and validated with CameraConfiguration::validate().
+ * Its stream configurations shall be identical to the active stream
+ * configurations, otherwise an -EINVAL error is returned and the camera keeps
+ * running with its current configuration.
+ *
+ * Depending on the pipeline handler, requests queued to the camera when this
+ * function is called may be cancelled and complete with the
+ * Request::RequestCancelled status. Requests queued afterwards are processed
+ * with the new configuration. If the new configuration can't be applied, the
+ * camera is stopped, and shall be configured again before being restarted.
+ *
+ * \context This function may only be called when the camera is in the Running
+ * state as defined in \ref camera_operation, and shall be synchronized by the
+ * caller with other functions that affect the camera state.
+ *
+ * \return 0 on success or a negative error code otherwise
+ * \retval -ENODEV The camera has been disconnected from the system
+ * \retval -EACCES The camera is not running
+ * \retval -EINVAL The configuration is not valid or changes the streams
+ * \retval -ENOTSUP The pipeline handler doesn't support reconfiguration
+ */
+int Camera::reconfigure(CameraConfiguration *config)
+{
+	Private *const d = _d();
+
+	int ret = d->isAccessAllowed(Private::CameraRunning);
+	if (ret < 0)
+		return ret;
+
+	if (config->validate() != CameraConfiguration::Valid) {
+		LOG(Camera, Error)
+			<< "Can't reconfigure camera with invalid configuration";
+		return -EINVAL;
+	}
+
+	if (config->size() != d->activeStreams_.size()) {
+		LOG(Camera, Error) << "Reconfiguration can't change the streams";
+		return -EINVAL;
+	}
+
+	for (const StreamConfiguration &cfg : *config) {
+		Stream *stream = cfg.stream();
+		if (!stream || !d->activeStreams_.count(stream)) {
+			LOG(Camera, Error)
+				<< "Reconfiguration can't change the streams";
+			return -EINVAL;
+		}
+
+		const StreamConfiguration &active = stream->configuration();
+		if (cfg.pixelFormat != active.pixelFormat ||
+		    cfg.size != active.size || cfg.stride != active.stride ||
+		    cfg.frameSize != active.frameSize ||
+		    cfg.bufferCount != active.bufferCount ||
+		    cfg.colorSpace != active.colorSpace) {
+			LOG(Camera, Error)
+				<< "Reconfiguration can't change stream "
+				<< active.toString() << " to " << cfg.toString();
+			return -EINVAL;
+		}
+	}
+
+	LOG(Camera, Debug) << "Reconfiguring capture";
+
+	utils::time_point start = utils::clock::now();
+
+	ret = d->pipe_->invokeMethod(&PipelineHandler::reconfigure,
+				     ConnectionTypeBlocking, this, config);
+	if (ret == -ENOTSUP)
+		return ret;
+
+	if (ret) {
+		LOG(Camera, Error) << "Failed to reconfigure camera, stopping";
+		stop();
+		return ret;
+	}
+
+	utils::Duration elapsed = utils::clock::now() - start;
+	LOG(Camera, Debug)
+		<< "Pipeline reconfigured in " << elapsed.get<std::micro>() << "us";
+
+	return 0;
+}
+
 /**
  * \brief Create a request object for the camera
  * \param[in] cookie Opaque cookie for application use
@@ -1125,22 +1409,121 @@ int Camera::queueRequest(Request *request)
 	 * this.
 	 */
 
-	if (request->buffers().empty()) {
-		LOG(Camera, Error) << "Request contains no buffers";
-		return -EINVAL;
-	}
+	ret = d->validateRequest(request);
+	if (ret < 0)
+		return ret;
 
-	for (auto const &it : request->buffers()) {
-		const Stream *stream = it.first;
+	d->pipe_->invokeMethod(&PipelineHandler::queueRequest,
+			       ConnectionTypeQueued, request);
 
-		if (d->activeStreams_.find(stream) == d->activeStreams_.end()) {
-			LOG(Camera, Error) << "Invalid request";
+	return 0;
+}
+
+/**
+ * \brief Queue a batch of requests to the camera
+ * \param[in] requests The requests to queue to the camera
+ *
+ * This function queues all the \a requests to the camera for capture, in the
+ * order in which they appear in the span. It behaves as if queueRequest() was
+ * called for each request in turn, but validates the whole batch upfront and
+ * hands it over to the pipeline handler in a single cross-thread message. This
+ * lets pipeline handlers queue multiple requests to the device per wakeup, and
+ * reduces the per-request overhead for applications that queue many requests
+ * at once, such as high frame rate or multi-stream applications.
+ *
+ * Queuing is all-or-nothing: if any request in the batch is invalid, no request
+ * is queued and an error is returned. A request appearing more than once in the
+ * batch is invalid. Queuing an empty batch is a no-op.
+ *
+ * \context This function is \threadsafe. It may only be called when the camera
+ * is in the Running state as defined in \ref camera_operation.
+ *
+ * \return 0 on success or a negative error code otherwise
+ * \retval -ENODEV The camera has been disconnected from the system
+ * \retval -EACCES The camera is not running so requests can't be queued
+ * \retval -EINVAL One of the requests is invalid
+ */
+int Camera::queueRequests(Span<Request *const> requests)
+{
+	Private *const d = _d();
+
+	int ret = d->isAccessAllowed(Private::CameraRunning);
+	if (ret < 0)
+		return ret;
+
+	if (requests.empty())
+		return 0;
+
+	for (auto it = requests.begin(); it != requests.end(); ++it) {
+		ret = d->validateRequest(*it);
+		if (ret < 0)
+			return ret;
+
+		/* Batches are small, a linear search is cheaper than a set. */
+		if (std::find(requests.begin(), it, *it) != it) {
+			LOG(Camera, Error) << "Request queued twice in a batch";
 			return -EINVAL;
 		}
 	}
 
-	d->pipe_->invokeMethod(&PipelineHandler::queueRequest,
-			       ConnectionTypeQueued, request);
+	d->pipe_->invokeMethod(&PipelineHandler::queueRequests,
+			       ConnectionTypeQueued,
+			       std::vector<Request *>(requests.begin(),
+						      requests.end()));
+
+	return 0;
+}
+
+/**
+ * \typedef Camera::CompletionHandler
+ * \brief Function called on the camera's internal thread when a request
+ * completes
+ *
+ * The handler receives a RequestCompletion describing the completed request,
+ * and returns true if it has handled the completion, or false to request the
+ * completion to be notified through the requestCompleted signal.
+ */
+
+/**
+ * \brief Set a low-latency request completion handler
+ * \param[in] handler The completion handler, or an empty function to remove it
+ *
+ * By default, request completion is reported through the requestCompleted
+ * signal. Applications that run their own event loop commonly connect a slot
+ * to the signal only to forward the completion to their own thread, paying for
+ * an additional thread hop.
+ *
+ * This function sets a \a handler that is called for every completed request,
+ * before the requestCompleted signal is emitted, with a RequestCompletion
+ * record pre-filled with the request data. If the handler returns true, the
+ * requestCompleted signal is not emitted for the request. The bufferCompleted
+ * signal is not affected.
+ *
+ * The handler is called synchronously from the camera's internal thread, and
+ * shall thus return quickly and not call any function of the camera other than
+ * queueRequest() and queueRequests(). It is typically used to push the
+ * completion to a RequestCompletionQueue, which the application then drains
+ * from its own thread.
+ *
+ * \context This function shall be synchronized by the caller with other
+ * functions that affect the camera state. It may only be called when the
+ * camera is in the Acquired or Configured state as defined in
+ * \ref camera_operation.
+ *
+ * \return 0 on success or a negative error code otherwise
+ * \retval -ENODEV The camera has been disconnected from the system
+ * \retval -EACCES The camera is not in a state where the handler can be set
+ */
+int Camera::setCompletionHandler(CompletionHandler handler)
+{
+	Private *const d = _d();
+
+	int ret = d->isAccessAllowed(Private::CameraAcquired,
+				     Private::CameraConfigured);
+	if (ret < 0)
+		return ret;
+
+	d->completionHandler_ = std::move(handler);
 
 	return 0;
 }
@@ -1173,6 +1556,8 @@ int Camera::start(const ControlList *controls)
 
 	LOG(Camera, Debug) << "Starting capture";
 
+	d->telemetry_->reset();
+
 	ret = d->pipe_->invokeMethod(&PipelineHandler::start,
 				     ConnectionTypeBlocking, this, controls);
 	if (ret)
@@ -1227,12 +1612,32 @@ int Camera::stop()
 	return 0;
 }
 
+/**
+ * \brief Retrieve frame delivery statistics
+ *
+ * Counters are accumulated by the camera for all requests completed since the
+ * camera was last started, and are updated without locking. Statistics can be
+ * retrieved at any time, including while the camera is running, to monitor
+ * the health of the capture session. They remain available after the camera
+ * is stopped until it is started again.
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return The camera statistics
+ */
+CameraStatistics Camera::statistics() const
+{
+	return _d()->telemetry_->statistics();
+}
+
 /**
  * \brief Handle request completion and notify application
  * \param[in] request The request that has completed
  *
  * This function is called by the pipeline handler to notify the camera that
- * the request has completed. It emits the requestCompleted signal.
+ * the request has completed. It passes the completion to the completion handler
+ * if one has been set, and emits the requestCompleted signal if the request
+ * hasn't been handled.
  */
 void Camera::requestComplete(Request *request)
 {
@@ -1241,6 +1646,21 @@ void Camera::requestComplete(Request *request)
 				  true))
 		LOG(Camera, Fatal) << "Trying to complete a request when stopped";
 
+	const CompletionHandler &handler = _d()->completionHandler_;
+	if (handler) {
+		int64_t timestamp = request->metadata().get(controls::SensorTimestamp);
+		RequestCompletion completion = {
+			request,
+			request->cookie(),
+			request->status(),
+			request->sequence(),
+			static_cast<uint64_t>(timestamp),
+		};
+
+		if (handler(completion))
+			return;
+	}
+
 	requestCompleted.emit(request);
 }
 
@@ -0,0 +1,321 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * camera_telemetry.cpp - Camera frame delivery telemetry
+ */
+
+#include "libcamera/internal/camera_telemetry.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <libcamera/framebuffer.h>
+#include <libcamera/request.h>
+
+/**
+ * \file internal/camera_telemetry.h
+ * \brief Camera frame delivery telemetry
+ */
+
+namespace libcamera {
+
+/**
+ * \class CameraTelemetry
+ * \brief Track the health of frame delivery for a camera
+ *
+ * The CameraTelemetry class accumulates counters about the requests and frames
+ * completed by a camera, and computes the CameraStatistics reported to
+ * applications by Camera::statistics().
+ *
+ * Counters are updated by the pipeline handler thread when requests complete,
+ * and can be read concurrently from any thread without locking. Each counter
+ * is individually consistent, but a set of statistics retrieved while the
+ * camera is running may reflect the completion of a request partially.
+ *
+ * Frame intervals are recorded in a log-linear histogram used to compute the
+ * 99th percentile. Intervals are expressed in units of 2^kIntervalShift
+ * nanoseconds, and each power of two range is split in 2^kIntervalSubBucketBits
+ * linear buckets. This bounds the relative error of the percentile to 1/16
+ * with a constant number of buckets, from microseconds to the histogram range
+ * of about 34 seconds. Intervals longer than the histogram range are accounted
+ * in the last bucket.
+ */
+
+/**
+ * \var CameraTelemetry::kIntervalShift
+ * \brief The base 2 logarithm of the frame interval histogram unit, in
+ * nanoseconds
+ */
+
+/**
+ * \var CameraTelemetry::kIntervalSubBucketBits
+ * \brief The base 2 logarithm of the number of buckets per power of two in the
+ * frame interval histogram
+ */
+
+/**
+ * \var CameraTelemetry::kIntervalBuckets
+ * \brief The number of buckets in the frame interval histogram
+ */
+
+/**
+ * \brief Construct a CameraTelemetry for a set of streams
+ * \param[in] streams The streams of the camera
+ */
+CameraTelemetry::CameraTelemetry(const std::set<Stream *> &streams)
+{
+	for (const Stream *stream : streams)
+		streams_[stream] = std::make_unique<StreamTelemetry>();
+
+	reset();
+}
+
+CameraTelemetry::~CameraTelemetry() = default;
+
+/**
+ * \brief Reset all counters
+ *
+ * This function shall not be called concurrently with requestCompleted().
+ */
+void CameraTelemetry::reset()
+{
+	requestsCompleted_.store(0, std::memory_order_relaxed);
+	requestsCancelled_.store(0, std::memory_order_relaxed);
+
+	for (auto &[stream, telemetry] : streams_) {
+		StreamTelemetry &t = *telemetry;
+
+		t.framesDelivered.store(0, std::memory_order_relaxed);
+		t.framesDropped.store(0, std::memory_order_relaxed);
+		t.framesCancelled.store(0, std::memory_order_relaxed);
+		t.underruns.store(0, std::memory_order_relaxed);
+		t.framesAbsorbed.store(0, std::memory_order_relaxed);
+
+		t.intervalCount.store(0, std::memory_order_relaxed);
+		t.intervalSum.store(0, std::memory_order_relaxed);
+		t.intervalMin.store(std::numeric_limits<uint64_t>::max(),
+				    std::memory_order_relaxed);
+		t.intervalMax.store(0, std::memory_order_relaxed);
+		for (std::atomic<uint32_t> &bucket : t.intervals)
+			bucket.store(0, std::memory_order_relaxed);
+
+		t.valid = false;
+		t.lastSequence = 0;
+		t.lastTimestamp = 0;
+	}
+
+	starved_ = false;
+}
+
+/**
+ * \brief Account for a completed request
+ * \param[in] request The request
+ * \param[in] lastQueued True if no other request is queued to the pipeline
+ * handler after \a request
+ *
+ * Update the counters with the status of the \a request and of its buffers.
+ * Gaps in the sequence numbers of the buffers of a stream are accounted as
+ * underruns if the camera ran out of requests, as reported by \a lastQueued
+ * for the previous request, and as dropped frames otherwise.
+ *
+ * This function shall be called from the pipeline handler thread, for all
+ * requests in completion order.
+ */
+void CameraTelemetry::requestCompleted(const Request *request, bool lastQueued)
+{
+	const bool starved = starved_;
+	starved_ = lastQueued;
+
+	requestsCompleted_.fetch_add(1, std::memory_order_relaxed);
+	if (request->status() == Request::RequestCancelled)
+		requestsCancelled_.fetch_add(1, std::memory_order_relaxed);
+
+	for (const auto &[stream, buffer] : request->buffers()) {
+		auto iter = streams_.find(stream);
+		if (iter == streams_.end())
+			continue;
+
+		StreamTelemetry &t = *iter->second;
+		const FrameMetadata &metadata = buffer->metadata();
+
+		if (metadata.status == FrameMetadata::FrameCancelled) {
+			t.framesCancelled.fetch_add(1, std::memory_order_relaxed);
+			continue;
+		}
+
+		/*
+		 * Sequence numbers going backward, including by wrapping
+		 * around, indicate a restart of the device and are not
+		 * considered as a gap.
+		 */
+		int32_t gap = metadata.sequence - t.lastSequence - 1;
+		if (t.valid && gap > 0) {
+			std::atomic<uint64_t> &counter = starved ? t.underruns
+								 : t.framesDropped;
+			counter.fetch_add(gap, std::memory_order_relaxed);
+		}
+
+		if (metadata.status == FrameMetadata::FrameError) {
+			t.framesDropped.fetch_add(1, std::memory_order_relaxed);
+
+			/*
+			 * Record the sequence number of the erroneous frame to
+			 * avoid accounting for it again as a gap, but keep the
+			 * timestamp of the last delivered frame to measure the
+			 * interval between delivered frames.
+			 */
+			if (t.valid && gap >= 0)
+				t.lastSequence = metadata.sequence;
+			continue;
+		}
+
+		t.framesDelivered.fetch_add(1, std::memory_order_relaxed);
+
+		if (t.valid) {
+			if (metadata.timestamp > t.lastTimestamp) {
+				uint64_t interval = metadata.timestamp - t.lastTimestamp;
+				unsigned int bucket = intervalBucket(interval);
+
+				t.intervalCount.fetch_add(1, std::memory_order_relaxed);
+				t.intervalSum.fetch_add(interval, std::memory_order_relaxed);
+				t.intervals[bucket].fetch_add(1, std::memory_order_relaxed);
+
+				if (interval < t.intervalMin.load(std::memory_order_relaxed))
+					t.intervalMin.store(interval, std::memory_order_relaxed);
+				if (interval > t.intervalMax.load(std::memory_order_relaxed))
+					t.intervalMax.store(interval, std::memory_order_relaxed);
+			}
+		}
+
+		t.valid = true;
+		t.lastSequence = metadata.sequence;
+		t.lastTimestamp = metadata.timestamp;
+	}
+}
+
+/**
+ * \brief Account for a frame captured to an internal buffer
+ * \param[in] stream The stream the frame has been captured for
+ *
+ * Pipeline handlers that keep the device streaming with internal buffers when
+ * the application runs out of requests, such as with the UnderrunGuard, shall
+ * call this function for each frame captured to an internal buffer and
+ * dropped.
+ *
+ * This function shall be called from the pipeline handler thread.
+ */
+void CameraTelemetry::frameAbsorbed(const Stream *stream)
+{
+	auto iter = streams_.find(stream);
+	if (iter == streams_.end())
+		return;
+
+	iter->second->framesAbsorbed.fetch_add(1, std::memory_order_relaxed);
+}
+
+/*
+ * Intervals smaller than 2^kIntervalSubBucketBits units are stored in linear
+ * buckets. Larger intervals are stored in the bucket indexed by their power of
+ * two and their kIntervalSubBucketBits most significant bits after the
+ * leading one.
+ */
+unsigned int CameraTelemetry::intervalBucket(uint64_t interval)
+{
+	constexpr uint64_t subBuckets = 1 << kIntervalSubBucketBits;
+
+	uint64_t value = interval >> kIntervalShift;
+	if (value < subBuckets)
+		return value;
+
+	unsigned int shift = 63 - __builtin_clzll(value) - kIntervalSubBucketBits;
+	uint64_t bucket = shift * subBuckets + (value >> shift);
+
+	return std::min<uint64_t>(bucket, kIntervalBuckets - 1);
+}
+
+/* Return the exclusive upper limit of a bucket, in nanoseconds. */
+uint64_t CameraTelemetry::intervalBucketLimit(unsigned int bucket)
+{
+	constexpr unsigned int subBuckets = 1 << kIntervalSubBucketBits;
+
+	if (bucket < subBuckets)
+		return static_cast<uint64_t>(bucket + 1) << kIntervalShift;
+
+	unsigned int shift = bucket / subBuckets - 1;
+	uint64_t value = bucket % subBuckets + subBuckets + 1;
+
+	return value << (shift + kIntervalShift);
+}
+
+/**
+ * \brief Retrieve the statistics accumulated since the last reset
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return The camera statistics
+ */
+CameraStatistics CameraTelemetry::statistics() const
+{
+	using std::chrono::nanoseconds;
+
+	CameraStatistics stats;
+
+	stats.requestsCompleted = requestsCompleted_.load(std::memory_order_relaxed);
+	stats.requestsCancelled = requestsCancelled_.load(std::memory_order_relaxed);
+
+	for (const auto &[stream, telemetry] : streams_) {
+		const StreamTelemetry &t = *telemetry;
+		StreamStatistics &s = stats.streams[stream];
+
+		s.framesDelivered = t.framesDelivered.load(std::memory_order_relaxed);
+		s.framesDropped = t.framesDropped.load(std::memory_order_relaxed);
+		s.framesCancelled = t.framesCancelled.load(std::memory_order_relaxed);
+		s.underruns = t.underruns.load(std::memory_order_relaxed);
+		s.framesAbsorbed = t.framesAbsorbed.load(std::memory_order_relaxed);
+
+		uint64_t count = t.intervalCount.load(std::memory_order_relaxed);
+		if (!count) {
+			s.minFrameInterval = s.avgFrameInterval = nanoseconds(0);
+			s.maxFrameInterval = s.p99FrameInterval = nanoseconds(0);
+			continue;
+		}
+
+		uint64_t max = t.intervalMax.load(std::memory_order_relaxed);
+
+		s.minFrameInterval = nanoseconds(t.intervalMin.load(std::memory_order_relaxed));
+		s.avgFrameInterval = nanoseconds(t.intervalSum.load(std::memory_order_relaxed) / count);
+		s.maxFrameInterval = nanoseconds(max);
+
+		/*
+		 * Report the upper bound of the bucket that contains the 99th
+		 * percentile bounded by the maximum interval, or the maximum
+		 * interval if the percentile falls in the last bucket. Use the
+		 * sum of the buckets as the total, as it may differ from the
+		 * interval count when the camera is running.
+		 */
+		uint64_t total = 0;
+		for (const std::atomic<uint32_t> &bucket : t.intervals)
+			total += bucket.load(std::memory_order_relaxed);
+
+		uint64_t target = (total * 99 + 99) / 100;
+		uint64_t cumulated = 0;
+		uint64_t p99 = max;
+
+		for (unsigned int i = 0; i < kIntervalBuckets; ++i) {
+			cumulated += t.intervals[i].load(std::memory_order_relaxed);
+			if (cumulated < target)
+				continue;
+
+			if (i < kIntervalBuckets - 1)
+				p99 = std::min<uint64_t>(intervalBucketLimit(i), max);
+			break;
+		}
+
+		s.p99FrameInterval = nanoseconds(p99);
+	}
+
+	return stats;
+}
+
+} /* namespace libcamera */
@@ -0,0 +1,179 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * completion_queue.cpp - Lock-free request completion queue
+ */
+
+#include <libcamera/completion_queue.h>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <libcamera/base/log.h>
+
+/**
+ * \file libcamera/completion_queue.h
+ * \brief Lock-free queue of request completion records
+ */
+
+namespace libcamera {
+
+LOG_DECLARE_CATEGORY(Camera)
+
+/**
+ * \struct RequestCompletion
+ * \brief Description of a completed request
+ *
+ * The RequestCompletion structure is filled by the camera when a request
+ * completes, and passed to the handler registered with
+ * Camera::setCompletionHandler(). It carries the request fields that
+ * applications most commonly need to dispatch the completion, so that they
+ * can be consumed without accessing the request from a different thread.
+ *
+ * \var RequestCompletion::request
+ * \brief The completed request
+ *
+ * \var RequestCompletion::cookie
+ * \brief The request cookie, as returned by Request::cookie()
+ *
+ * \var RequestCompletion::status
+ * \brief The request completion status, as returned by Request::status()
+ *
+ * \var RequestCompletion::sequence
+ * \brief The request sequence number, as returned by Request::sequence()
+ *
+ * \var RequestCompletion::timestamp
+ * \brief The sensor timestamp of the frame in nanoseconds, taken from the
+ * controls::SensorTimestamp metadata, or 0 if not available
+ */
+
+/**
+ * \class RequestCompletionQueue
+ * \brief Single-producer single-consumer queue of request completions
+ *
+ * The RequestCompletionQueue transfers RequestCompletion records from the
+ * camera to the application without locking and without going through the
+ * libcamera signal and message infrastructure. It is meant to be filled from
+ * a completion handler registered with Camera::setCompletionHandler(), and
+ * drained by a single application thread:
+ *
+ * \code{.cpp}
+ * RequestCompletionQueue queue(8);
+ *
+ * camera->setCompletionHandler([&queue](const RequestCompletion &completion) {
+ *	return queue.push(completion);
+ * });
+ * \endcode
+ *
+ * The queue exposes an eventfd through fd() that becomes readable when
+ * completions are available, and can thus be integrated in any event loop.
+ * When the file descriptor is readable, the application shall call pop()
+ * until it returns false. The file descriptor is cleared by pop() when the
+ * queue is found empty.
+ *
+ * The queue has a fixed number of slots, which should be at least equal to
+ * the maximum number of requests queued to the camera at any given time. When
+ * the queue is full, push() fails, and the completion handler above reports
+ * the request as not handled. The camera then emits the
+ * Camera::requestCompleted signal for the request instead, which ensures that
+ * no completion is ever lost.
+ */
+
+/**
+ * \brief Construct a RequestCompletionQueue
+ * \param[in] size The minimum number of completions the queue can hold
+ *
+ * The number of slots is rounded up to the next power of two. If the eventfd
+ * can't be created, the queue is invalid, as reported by isValid().
+ */
+RequestCompletionQueue::RequestCompletionQueue(unsigned int size)
+	: head_(0), tail_(0)
+{
+	unsigned int slots = 1;
+	while (slots < size)
+		slots <<= 1;
+
+	slots_.resize(slots);
+	mask_ = slots - 1;
+
+	eventfd_ = UniqueFD(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+	if (!eventfd_.isValid()) {
+		int ret = errno;
+		LOG(Camera, Error)
+			<< "Failed to create eventfd: " << strerror(ret);
+	}
+}
+
+/**
+ * \fn RequestCompletionQueue::isValid()
+ * \brief Check if the queue is valid
+ * \return True if the queue is valid, false otherwise
+ */
+
+/**
+ * \fn RequestCompletionQueue::fd()
+ * \brief Retrieve the file descriptor signalling available completions
+ * \return The eventfd file descriptor of the queue
+ */
+
+/**
+ * \brief Add a completion to the queue
+ * \param[in] completion The completion record
+ *
+ * This function shall only be called from a single thread, usually from the
+ * completion handler registered with the camera.
+ *
+ * \return True if the completion has been queued, false if the queue is full
+ */
+bool RequestCompletionQueue::push(const RequestCompletion &completion)
+{
+	unsigned int head = head_.load(std::memory_order_relaxed);
+	if (head - tail_.load(std::memory_order_acquire) > mask_)
+		return false;
+
+	slots_[head & mask_] = completion;
+	head_.store(head + 1, std::memory_order_release);
+
+	uint64_t value = 1;
+	if (::write(eventfd_.get(), &value, sizeof(value)) < 0)
+		LOG(Camera, Error) << "Failed to signal request completion";
+
+	return true;
+}
+
+/**
+ * \brief Retrieve the oldest completion from the queue
+ * \param[out] completion The completion record
+ *
+ * This function shall only be called from a single thread.
+ *
+ * \return True if a completion has been retrieved, false if the queue is empty
+ */
+bool RequestCompletionQueue::pop(RequestCompletion *completion)
+{
+	unsigned int tail = tail_.load(std::memory_order_relaxed);
+
+	if (head_.load(std::memory_order_acquire) == tail) {
+		/*
+		 * Clear the eventfd and check the queue again, to catch
+		 * completions pushed before the eventfd was cleared.
+		 */
+		uint64_t value;
+		if (::read(eventfd_.get(), &value, sizeof(value)) < 0 &&
+		    errno != EAGAIN)
+			LOG(Camera, Error) << "Failed to clear completion event";
+
+		if (head_.load(std::memory_order_acquire) == tail)
+			return false;
+	}
+
+	*completion = slots_[tail & mask_];
+	tail_.store(tail + 1, std::memory_order_release);
+
+	return true;
+}
+
+} /* namespace libcamera */
@@ -47,10 +47,15 @@ int DeviceEnumeratorSysfs::enumerate()
 			break;
 	}
 
+	/*
+	 * Systems without media devices, such as containers, can still expose
+	 * virtual cameras. Don't consider a missing media device directory as
+	 * an error.
+	 */
 	if (!dir) {
-		LOG(DeviceEnumerator, Error)
+		LOG(DeviceEnumerator, Warning)
 			<< "No valid sysfs media device directory";
-		return -ENODEV;
+		return 0;
 	}
 
 	while ((ent = readdir(dir)) != nullptr) {
@@ -0,0 +1,439 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2020, Raspberry Pi (Trading) Limited
+ * Copyright (C) 2022, Google Inc.
+ *
+ * dma_buf_allocator.cpp - dma-buf allocator with buffer recycling
+ */
+
+#include "libcamera/internal/dma_buf_allocator.h"
+
+#include <array>
+#include <fcntl.h>
+#include <linux/dma-buf.h>
+#include <linux/dma-heap.h>
+#include <linux/udmabuf.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+
+#include <libcamera/base/log.h>
+#include <libcamera/base/mutex.h>
+#include <libcamera/base/shared_fd.h>
+#include <libcamera/base/utils.h>
+
+#include <libcamera/framebuffer.h>
+
+#include "libcamera/internal/framebuffer.h"
+
+/**
+ * \file internal/dma_buf_allocator.h
+ * \brief dma-buf allocator with buffer recycling
+ */
+
+namespace libcamera {
+
+LOG_DEFINE_CATEGORY(DmaBufAllocator)
+
+namespace {
+
+struct DmaBufAllocatorInfo {
+	DmaBufAllocator::DmaBufAllocatorFlag type;
+	const char *deviceNodeName;
+};
+
+/*
+ * /dev/dma_heap/linux,cma is the CMA dma-heap. When the CMA heap size is
+ * specified on the kernel command line instead of DT, the heap gets named
+ * "reserved" instead.
+ */
+constexpr std::array<DmaBufAllocatorInfo, 4> providerInfos = { {
+	{ DmaBufAllocator::DmaBufAllocatorFlag::CmaHeap, "/dev/dma_heap/linux,cma" },
+	{ DmaBufAllocator::DmaBufAllocatorFlag::CmaHeap, "/dev/dma_heap/reserved" },
+	{ DmaBufAllocator::DmaBufAllocatorFlag::SystemHeap, "/dev/dma_heap/system" },
+	{ DmaBufAllocator::DmaBufAllocatorFlag::UDmaBuf, "/dev/udmabuf" },
+} };
+
+unsigned int pageSize()
+{
+	return static_cast<unsigned int>(sysconf(_SC_PAGESIZE));
+}
+
+} /* namespace */
+
+/*
+ * The pool stores the dma-bufs of the frame buffers exported by the allocator
+ * once the frame buffers are destroyed, for reuse by subsequent exports. It is
+ * shared with the frame buffers, which can outlive the allocator, and is
+ * accessed from the threads that destroy the frame buffers.
+ */
+class DmaBufAllocator::Pool
+{
+public:
+	class Buffer : public FrameBuffer::Private
+	{
+	public:
+		Buffer(std::weak_ptr<Pool> pool, SharedFD fd, std::size_t size)
+			: pool_(std::move(pool)), fd_(std::move(fd)), size_(size)
+		{
+		}
+
+		~Buffer()
+		{
+			std::shared_ptr<Pool> pool = pool_.lock();
+			if (pool)
+				pool->put(std::move(fd_), size_);
+		}
+
+	private:
+		std::weak_ptr<Pool> pool_;
+		SharedFD fd_;
+		std::size_t size_;
+	};
+
+	SharedFD get(std::size_t size)
+	{
+		MutexLocker locker(mutex_);
+
+		for (auto it = buffers_.begin(); it != buffers_.end(); ++it) {
+			if (it->second != size)
+				continue;
+
+			SharedFD fd = std::move(it->first);
+			buffers_.erase(it);
+			return fd;
+		}
+
+		return SharedFD();
+	}
+
+	void put(SharedFD fd, std::size_t size)
+	{
+		MutexLocker locker(mutex_);
+
+		/* Drop the least recently released buffer when the pool is full. */
+		if (buffers_.size() >= kMaxPooledBuffers)
+			buffers_.erase(buffers_.begin());
+
+		buffers_.emplace_back(std::move(fd), size);
+	}
+
+	void clear()
+	{
+		MutexLocker locker(mutex_);
+		buffers_.clear();
+	}
+
+private:
+	Mutex mutex_;
+	std::vector<std::pair<SharedFD, std::size_t>> buffers_
+		LIBCAMERA_TSA_GUARDED_BY(mutex_);
+};
+
+/**
+ * \class DmaBufAllocator
+ * \brief Helper class for dma-buf allocations
+ *
+ * This class wraps a userspace dma-buf provider selected at construction time,
+ * and exposes functions to allocate dma-buf memory from this provider.
+ *
+ * Different providers may be available on different platforms. The following
+ * providers are supported:
+ *
+ * - The CMA dma-heap allocator, available on most systems with a contiguous
+ *   memory area reserved for devices
+ * - The system dma-heap allocator, for devices that don't require physically
+ *   contiguous memory
+ * - The udmabuf allocator, which wraps memfd-backed memory in dma-bufs. It is
+ *   usually available on all systems with a recent enough kernel, and is
+ *   useful to allocate buffers for virtual cameras and tests
+ * - Plain memfd memory, which isn't a dma-buf but is always available. Buffers
+ *   allocated this way can be mapped by the CPU but can't be imported by
+ *   devices
+ *
+ * Frame buffers exported by exportBuffers() are recycled: when they are
+ * destroyed, their memory is kept by the allocator and reused for subsequent
+ * buffers of the same size. This avoids allocating memory every time buffers
+ * are freed and reallocated, such as when a camera is stopped and restarted,
+ * or reconfigured with a different set of streams.
+ */
+
+/**
+ * \enum DmaBufAllocator::DmaBufAllocatorFlag
+ * \brief Type of the dma-buf provider
+ * \var DmaBufAllocator::DmaBufAllocatorFlag::CmaHeap
+ * \brief Allocate from a CMA dma-heap, providing physically-contiguous memory
+ * \var DmaBufAllocator::DmaBufAllocatorFlag::SystemHeap
+ * \brief Allocate from the system dma-heap, using the page allocator
+ * \var DmaBufAllocator::DmaBufAllocatorFlag::UDmaBuf
+ * \brief Allocate using a memfd and the /dev/udmabuf device
+ * \var DmaBufAllocator::DmaBufAllocatorFlag::MemFd
+ * \brief Allocate a memfd, not suitable for device access
+ */
+
+/**
+ * \typedef DmaBufAllocator::DmaBufAllocatorFlags
+ * \brief A bitwise combination of DmaBufAllocator::DmaBufAllocatorFlag values
+ */
+
+/**
+ * \var DmaBufAllocator::kMaxPooledBuffers
+ * \brief The maximum number of buffers kept by the allocator for recycling
+ */
+
+/**
+ * \brief Construct a DmaBufAllocator of a given type
+ * \param[in] type The type(s) of the dma-buf providers to allocate from
+ *
+ * The dma-buf provider type is selected with the \a type parameter, which
+ * defaults to the CMA heap. If multiple providers are specified, the first
+ * available one is used, in the order of the DmaBufAllocatorFlag values.
+ */
+DmaBufAllocator::DmaBufAllocator(DmaBufAllocatorFlags type)
+	: type_(DmaBufAllocatorFlag::CmaHeap), valid_(false),
+	  pool_(std::make_shared<Pool>())
+{
+	for (const DmaBufAllocatorInfo &info : providerInfos) {
+		if (!(type & info.type))
+			continue;
+
+		int ret = ::open(info.deviceNodeName, O_RDWR | O_CLOEXEC, 0);
+		if (ret < 0) {
+			ret = errno;
+			LOG(DmaBufAllocator, Debug)
+				<< "Failed to open " << info.deviceNodeName << ": "
+				<< strerror(ret);
+			continue;
+		}
+
+		LOG(DmaBufAllocator, Debug) << "Using " << info.deviceNodeName;
+		providerHandle_ = UniqueFD(ret);
+		type_ = info.type;
+		valid_ = true;
+		return;
+	}
+
+	if (type & DmaBufAllocatorFlag::MemFd) {
+		LOG(DmaBufAllocator, Debug) << "Using memfd";
+		type_ = DmaBufAllocatorFlag::MemFd;
+		valid_ = true;
+		return;
+	}
+
+	LOG(DmaBufAllocator, Error) << "Could not open any dma-buf provider";
+}
+
+/**
+ * \brief Destroy the DmaBufAllocator instance
+ *
+ * Frame buffers exported by the allocator remain valid after the allocator is
+ * destroyed. Their memory is then freed when they are destroyed.
+ */
+DmaBufAllocator::~DmaBufAllocator() = default;
+
+/**
+ * \fn DmaBufAllocator::isValid()
+ * \brief Check if the DmaBufAllocator instance is valid
+ * \return True if the DmaBufAllocator is valid, false otherwise
+ */
+
+/**
+ * \fn DmaBufAllocator::type()
+ * \brief Retrieve the type of the dma-buf provider in use
+ *
+ * The return value is undefined if the allocator isn't valid.
+ *
+ * \return The dma-buf provider type
+ */
+
+UniqueFD DmaBufAllocator::allocFromHeap(const char *name, std::size_t size)
+{
+	struct dma_heap_allocation_data alloc = {};
+	int ret;
+
+	alloc.len = size;
+	alloc.fd_flags = O_CLOEXEC | O_RDWR;
+
+	ret = ::ioctl(providerHandle_.get(), DMA_HEAP_IOCTL_ALLOC, &alloc);
+	if (ret < 0) {
+		LOG(DmaBufAllocator, Error)
+			<< "dma-heap allocation failure for " << name;
+		return {};
+	}
+
+	UniqueFD allocFd(alloc.fd);
+	ret = ::ioctl(allocFd.get(), DMA_BUF_SET_NAME, name);
+	if (ret < 0) {
+		LOG(DmaBufAllocator, Error)
+			<< "dma-heap naming failure for " << name;
+		return {};
+	}
+
+	return allocFd;
+}
+
+UniqueFD DmaBufAllocator::allocFromUDmaBuf(const char *name, std::size_t size)
+{
+	/* udmabuf requires the memfd to be page-aligned and sealed. */
+	size = utils::alignUp(size, pageSize());
+
+	UniqueFD memfd = allocFromMemFd(name, size);
+	if (!memfd.isValid())
+		return {};
+
+	int ret = ::fcntl(memfd.get(), F_ADD_SEALS, F_SEAL_SHRINK);
+	if (ret < 0) {
+		ret = errno;
+		LOG(DmaBufAllocator, Error)
+			<< "Failed to seal the memfd for " << name << ": "
+			<< strerror(ret);
+		return {};
+	}
+
+	struct udmabuf_create create = {};
+
+	create.memfd = memfd.get();
+	create.flags = UDMABUF_FLAGS_CLOEXEC;
+	create.offset = 0;
+	create.size = size;
+
+	ret = ::ioctl(providerHandle_.get(), UDMABUF_CREATE, &create);
+	if (ret < 0) {
+		ret = errno;
+		LOG(DmaBufAllocator, Error)
+			<< "Failed to create udmabuf for " << name << ": "
+			<< strerror(ret);
+		return {};
+	}
+
+	/* The memfd is not needed anymore, the dma-buf references its pages. */
+	return UniqueFD(ret);
+}
+
+UniqueFD DmaBufAllocator::allocFromMemFd(const char *name, std::size_t size)
+{
+	UniqueFD memfd(::memfd_create(name, MFD_ALLOW_SEALING | MFD_CLOEXEC));
+	if (!memfd.isValid()) {
+		int ret = errno;
+		LOG(DmaBufAllocator, Error)
+			<< "Failed to create memfd for " << name << ": "
+			<< strerror(ret);
+		return {};
+	}
+
+	if (::ftruncate(memfd.get(), size) < 0) {
+		int ret = errno;
+		LOG(DmaBufAllocator, Error)
+			<< "Failed to size memfd for " << name << ": "
+			<< strerror(ret);
+		return {};
+	}
+
+	return memfd;
+}
+
+/**
+ * \brief Allocate a dma-buf from the DmaBufAllocator
+ * \param[in] name The name to set for the allocated buffer
+ * \param[in] size The size of the buffer to allocate
+ *
+ * Allocates a dma-buf with read/write access. The memory is not recycled by
+ * the allocator when the returned file descriptor is closed.
+ *
+ * If the allocation fails, return an invalid UniqueFD.
+ *
+ * \return The UniqueFD of the allocated buffer
+ */
+UniqueFD DmaBufAllocator::alloc(const char *name, std::size_t size)
+{
+	if (!name || !valid_)
+		return {};
+
+	switch (type_) {
+	case DmaBufAllocatorFlag::CmaHeap:
+	case DmaBufAllocatorFlag::SystemHeap:
+		return allocFromHeap(name, size);
+	case DmaBufAllocatorFlag::UDmaBuf:
+		return allocFromUDmaBuf(name, size);
+	case DmaBufAllocatorFlag::MemFd:
+		return allocFromMemFd(name, size);
+	}
+
+	return {};
+}
+
+/**
+ * \brief Allocate frame buffers from the DmaBufAllocator
+ * \param[in] count The number of frame buffers to allocate
+ * \param[in] planeSizes The size of each plane of the frame buffers
+ * \param[out] buffers Array of allocated buffers
+ *
+ * Allocate \a count frame buffers with one plane per entry in \a planeSizes,
+ * and append them to \a buffers. All the planes of a frame buffer are stored
+ * in a single dma-buf, at consecutive offsets.
+ *
+ * Memory is taken from the buffers previously exported by the allocator and
+ * since destroyed, if any of them has the same size, and allocated from the
+ * dma-buf provider otherwise. The function is thus suitable to back the
+ * PipelineHandler::exportFrameBuffers() implementation of pipeline handlers
+ * that can't export buffers from their devices, such as virtual cameras.
+ *
+ * \return The number of allocated buffers on success or a negative error code
+ * otherwise
+ * \retval -EINVAL The \a planeSizes are empty
+ * \retval -ENOMEM Out of memory
+ */
+int DmaBufAllocator::exportBuffers(unsigned int count,
+				   const std::vector<unsigned int> &planeSizes,
+				   std::vector<std::unique_ptr<FrameBuffer>> *buffers)
+{
+	if (planeSizes.empty())
+		return -EINVAL;
+
+	std::size_t size = 0;
+	for (unsigned int planeSize : planeSizes)
+		size += planeSize;
+
+	size = utils::alignUp(size, pageSize());
+
+	for (unsigned int i = 0; i < count; ++i) {
+		SharedFD fd = pool_->get(size);
+		if (!fd.isValid())
+			fd = SharedFD(alloc("libcamera-frame", size));
+		if (!fd.isValid())
+			return -ENOMEM;
+
+		std::vector<FrameBuffer::Plane> planes;
+		unsigned int offset = 0;
+
+		for (unsigned int planeSize : planeSizes) {
+			FrameBuffer::Plane plane;
+			plane.fd = fd;
+			plane.offset = offset;
+			plane.length = planeSize;
+			planes.push_back(std::move(plane));
+
+			offset += planeSize;
+		}
+
+		auto d = std::make_unique<Pool::Buffer>(pool_, std::move(fd), size);
+		buffers->push_back(std::make_unique<FrameBuffer>(std::move(d), planes));
+	}
+
+	return count;
+}
+
+/**
+ * \brief Free the memory of the buffers kept for recycling
+ *
+ * Frame buffers currently exported by the allocator are not affected, and
+ * will be recycled when destroyed.
+ */
+void DmaBufAllocator::clear()
+{
+	pool_->clear();
+}
+
+} /* namespace libcamera */
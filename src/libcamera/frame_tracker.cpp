@@ -0,0 +1,120 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * frame_tracker.cpp - Tracking of in-flight frames for pipeline handlers
+ */
+
+#include "libcamera/internal/frame_tracker.h"
+
+/**
+ * \file internal/frame_tracker.h
+ * \brief Tracking of in-flight frames for pipeline handlers
+ */
+
+namespace libcamera {
+
+/**
+ * \struct FrameInfo
+ * \brief Base information about a frame being processed by a pipeline handler
+ *
+ * Pipeline handlers that process frames through multiple devices need to
+ * store per-frame information, such as the internal buffers associated with
+ * the frame and its completion state. They shall derive their frame
+ * information type from this structure, and manage instances through a
+ * FrameTracker.
+ *
+ * \var FrameInfo::id
+ * \brief The frame identifier, usually the request or frame sequence number
+ *
+ * \var FrameInfo::request
+ * \brief The request associated with the frame
+ */
+
+/**
+ * \class FrameTracker
+ * \brief Track the frames in flight in a pipeline handler
+ * \tparam Info The pipeline handler-specific FrameInfo derived type
+ *
+ * The FrameTracker stores the information about the frames being processed by
+ * a pipeline handler. Frames are looked up by identifier, by request, or by
+ * any of the buffers they have been associated with, in constant time. This
+ * keeps the cost of buffer completion handlers independent of the number of
+ * requests in flight and of the number of streams.
+ *
+ * Info instances are pooled. They are allocated the first time they're needed
+ * and reused for subsequent frames once removed. The lookup indexes are hash
+ * maps, which allocate a node for every frame, request and buffer they index,
+ * so creating a frame and adding buffers to it still allocates memory.
+ */
+
+/**
+ * \fn FrameTracker::create()
+ * \brief Start tracking a frame
+ * \param[in] id The frame identifier
+ * \param[in] request The request associated with the frame
+ *
+ * Obtain an Info instance from the pool, reset it to its default value and
+ * initialise its \a id and \a request. All buffers in the \a request are
+ * associated with the frame.
+ *
+ * \return The frame information
+ */
+
+/**
+ * \fn FrameTracker::addBuffer()
+ * \brief Associate a buffer with a frame
+ * \param[in] info The frame information
+ * \param[in] buffer The buffer
+ *
+ * Associate a buffer not part of the request, such as an internal buffer of
+ * the pipeline handler, with the frame, to allow looking up the frame from the
+ * \a buffer with find(). Internal buffers can be reused for another frame
+ * before the frame completes, in which case the buffer is associated with the
+ * most recent frame. Null buffers are ignored.
+ */
+
+/**
+ * \fn FrameTracker::remove()
+ * \brief Stop tracking a frame
+ * \param[in] info The frame information
+ *
+ * Remove the frame from the tracker and return \a info to the pool. The \a info
+ * pointer shall not be used after this function returns.
+ */
+
+/**
+ * \fn FrameTracker::clear()
+ * \brief Stop tracking all frames
+ */
+
+/**
+ * \fn FrameTracker::find(unsigned int id) const
+ * \brief Find a frame by identifier
+ * \param[in] id The frame identifier
+ * \return The frame information, or nullptr if no frame matches \a id
+ */
+
+/**
+ * \fn FrameTracker::find(const FrameBuffer *buffer) const
+ * \brief Find the frame a buffer is associated with
+ * \param[in] buffer The buffer
+ * \return The frame information, or nullptr if no frame is associated with
+ * \a buffer
+ */
+
+/**
+ * \fn FrameTracker::find(const Request *request) const
+ * \brief Find the frame associated with a request
+ * \param[in] request The request
+ * \return The frame information, or nullptr if no frame is associated with
+ * \a request
+ */
+
+/**
+ * \fn FrameTracker::frames()
+ * \brief Retrieve the frames being tracked
+ * \return A map of the frames being tracked, indexed by identifier
+ */
+
+} /* namespace libcamera */
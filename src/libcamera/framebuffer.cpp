@@ -186,6 +186,16 @@ FrameBuffer::Private::~Private()
  * fence and handle it opportunely before using the buffer again.
  */
 
+/**
+ * \fn FrameBuffer::Private::metadata()
+ * \brief Retrieve the dynamic metadata for write access
+ *
+ * This function is meant for pipeline handlers that produce frames without a
+ * V4L2 video device, and need to fill the buffer metadata themselves.
+ *
+ * \return Dynamic metadata for the frame contained in the buffer
+ */
+
 /**
  * \class FrameBuffer
  * \brief Frame buffer data and its associated dynamic metadata
@@ -27,6 +27,12 @@ LOG_DEFINE_CATEGORY(IPADataSerializer)
  * Static template class that provides functions for serializing and
  * deserializing IPA data.
  *
+ * Objects are serialized in a single pass, appending to the byte and fd vectors
+ * supplied by the caller. The size of variable-length members isn't known
+ * before they are serialized, space is thus reserved for their size and filled
+ * once they have been appended. This allows nested containers and structures
+ * to be serialized without intermediate vectors.
+ *
  * \todo Switch to Span instead of byte and fd vector
  *
  * \todo Harden the vector and map deserializer
@@ -48,6 +54,37 @@ namespace {
  * generated IPA proxies.
  */
 
+/**
+ * \fn template<typename T> void writePOD(std::vector<uint8_t> &vec, size_t pos, T val)
+ * \brief Write POD at a given position in a byte vector, in little-endian order
+ * \tparam T Type of POD to write
+ * \param[in] vec Byte vector to write to
+ * \param[in] pos Index in \a vec to write to
+ * \param[in] val Value to write
+ *
+ * This function is meant to be used by the IPA data serializer, and the
+ * generated IPA proxies, to fill the size of a member once it has been
+ * serialized.
+ *
+ * If the \a pos plus the byte-width of the POD is past the end of \a vec, a
+ * fatal error will occur.
+ */
+
+/**
+ * \fn template<typename T> void serializeMember(const T &data,
+ * 	std::vector<uint8_t> &dataVec, std::vector<SharedFD> &fdsVec,
+ * 	ControlSerializer *cs)
+ * \brief Serialize a container member, prefixed with its size and fd count
+ * \tparam T Type of the member to serialize
+ * \param[in] data The member to serialize
+ * \param[inout] dataVec Byte vector to append to
+ * \param[inout] fdsVec Fd vector to append to
+ * \param[in] cs ControlSerializer
+ *
+ * Append the serialized size of \a data in bytes and its number of fds, as two
+ * uint32_t, followed by \a data serialized in place.
+ */
+
 /**
  * \fn template<typename T> T readPOD(std::vector<uint8_t>::iterator it, size_t pos,
  * 				      std::vector<uint8_t>::iterator end)
@@ -102,6 +139,28 @@ namespace {
  * of \a data
  */
 
+/**
+ * \fn template<typename T> IPADataSerializer<T>::serialize(
+ * 	const T &data,
+ * 	std::vector<uint8_t> &dataVec,
+ * 	std::vector<SharedFD> &fdsVec,
+ * 	ControlSerializer *cs = nullptr)
+ * \brief Serialize an object, appending to a byte vector and fd vector
+ * \tparam T Type of object to serialize
+ * \param[in] data Object to serialize
+ * \param[inout] dataVec Byte vector to append the serialized data to
+ * \param[inout] fdsVec Fd vector to append the serialized fds to
+ * \param[in] cs ControlSerializer
+ *
+ * This version of serialize() appends the serialized form of \a data to the
+ * existing content of \a dataVec and \a fdsVec. It allows callers to serialize
+ * multiple objects in the same buffers, and to reuse the buffers capacity
+ * across calls.
+ *
+ * \a cs is only necessary if the object type \a T or its members contain
+ * ControlList or ControlInfoMap.
+ */
+
 /**
  * \fn template<typename T> IPADataSerializer<T>::deserialize(
  * 	const std::vector<uint8_t> &data,
@@ -201,6 +260,15 @@ IPADataSerializer<type>::serialize(const type &data,			\
 }									\
 									\
 template<>								\
+void IPADataSerializer<type>::serialize(const type &data,		\
+					std::vector<uint8_t> &dataVec,	\
+					[[maybe_unused]] std::vector<SharedFD> &fdsVec, \
+					[[maybe_unused]] ControlSerializer *cs) \
+{									\
+	appendPOD<type>(dataVec, data);					\
+}									\
+									\
+template<>								\
 type IPADataSerializer<type>::deserialize(std::vector<uint8_t>::const_iterator dataBegin, \
 					  std::vector<uint8_t>::const_iterator dataEnd, \
 					  [[maybe_unused]] ControlSerializer *cs) \
@@ -258,6 +326,15 @@ IPADataSerializer<std::string>::serialize(const std::string &data,
 	return { { data.cbegin(), data.end() }, {} };
 }
 
+template<>
+void IPADataSerializer<std::string>::serialize(const std::string &data,
+					       std::vector<uint8_t> &dataVec,
+					       [[maybe_unused]] std::vector<SharedFD> &fdsVec,
+					       [[maybe_unused]] ControlSerializer *cs)
+{
+	dataVec.insert(dataVec.end(), data.cbegin(), data.cend());
+}
+
 template<>
 std::string
 IPADataSerializer<std::string>::deserialize(const std::vector<uint8_t> &data,
@@ -307,51 +384,62 @@ IPADataSerializer<std::string>::deserialize(std::vector<uint8_t>::const_iterator
  * be used. The serialized ControlInfoMap will have zero length.
  */
 template<>
-std::tuple<std::vector<uint8_t>, std::vector<SharedFD>>
-IPADataSerializer<ControlList>::serialize(const ControlList &data, ControlSerializer *cs)
+void IPADataSerializer<ControlList>::serialize(const ControlList &data,
+					       std::vector<uint8_t> &dataVec,
+					       [[maybe_unused]] std::vector<SharedFD> &fdsVec,
+					       ControlSerializer *cs)
 {
 	if (!cs)
 		LOG(IPADataSerializer, Fatal)
 			<< "ControlSerializer not provided for serialization of ControlList";
 
-	size_t size;
-	std::vector<uint8_t> infoData;
+	const size_t start = dataVec.size();
+	size_t infoSize = 0;
 	int ret;
 
 	/*
 	 * \todo Revisit this opportunistic serialization of the
 	 * ControlInfoMap, as it could be fragile
 	 */
-	if (data.infoMap() && !cs->isCached(*data.infoMap())) {
-		size = cs->binarySize(*data.infoMap());
-		infoData.resize(size);
-		ByteStreamBuffer buffer(infoData.data(), infoData.size());
+	if (data.infoMap() && !cs->isCached(*data.infoMap()))
+		infoSize = cs->binarySize(*data.infoMap());
+
+	size_t listSize = cs->binarySize(data);
+
+	dataVec.resize(start + 8 + infoSize + listSize);
+	writePOD<uint32_t>(dataVec, start, infoSize);
+	writePOD<uint32_t>(dataVec, start + 4, listSize);
+
+	if (infoSize) {
+		ByteStreamBuffer buffer(&dataVec[start + 8], infoSize);
 		ret = cs->serialize(*data.infoMap(), buffer);
 
 		if (ret < 0 || buffer.overflow()) {
 			LOG(IPADataSerializer, Error) << "Failed to serialize ControlList's ControlInfoMap";
-			return { {}, {} };
+			dataVec.resize(start);
+			return;
 		}
 	}
 
-	size = cs->binarySize(data);
-	std::vector<uint8_t> listData(size);
-	ByteStreamBuffer buffer(listData.data(), listData.size());
+	ByteStreamBuffer buffer(&dataVec[start + 8 + infoSize], listSize);
 	ret = cs->serialize(data, buffer);
 
 	if (ret < 0 || buffer.overflow()) {
 		LOG(IPADataSerializer, Error) << "Failed to serialize ControlList";
-		return { {}, {} };
+		dataVec.resize(start);
 	}
+}
 
+template<>
+std::tuple<std::vector<uint8_t>, std::vector<SharedFD>>
+IPADataSerializer<ControlList>::serialize(const ControlList &data, ControlSerializer *cs)
+{
 	std::vector<uint8_t> dataVec;
-	dataVec.reserve(8 + infoData.size() + listData.size());
-	appendPOD<uint32_t>(dataVec, infoData.size());
-	appendPOD<uint32_t>(dataVec, listData.size());
-	dataVec.insert(dataVec.end(), infoData.begin(), infoData.end());
-	dataVec.insert(dataVec.end(), listData.begin(), listData.end());
+	std::vector<SharedFD> fdsVec;
 
-	return { dataVec, {} };
+	serialize(data, dataVec, fdsVec, cs);
+
+	return { std::move(dataVec), std::move(fdsVec) };
 }
 
 template<>
@@ -431,29 +519,41 @@ IPADataSerializer<ControlList>::deserialize(std::vector<uint8_t>::const_iterator
  * X bytes - Serialized ControlInfoMap (using ControlSerializer)
  */
 template<>
-std::tuple<std::vector<uint8_t>, std::vector<SharedFD>>
-IPADataSerializer<ControlInfoMap>::serialize(const ControlInfoMap &map,
-					     ControlSerializer *cs)
+void IPADataSerializer<ControlInfoMap>::serialize(const ControlInfoMap &map,
+						  std::vector<uint8_t> &dataVec,
+						  [[maybe_unused]] std::vector<SharedFD> &fdsVec,
+						  ControlSerializer *cs)
 {
 	if (!cs)
 		LOG(IPADataSerializer, Fatal)
 			<< "ControlSerializer not provided for serialization of ControlInfoMap";
 
+	const size_t start = dataVec.size();
 	size_t size = cs->binarySize(map);
-	std::vector<uint8_t> infoData(size);
-	ByteStreamBuffer buffer(infoData.data(), infoData.size());
+
+	dataVec.resize(start + 4 + size);
+	writePOD<uint32_t>(dataVec, start, size);
+
+	ByteStreamBuffer buffer(&dataVec[start + 4], size);
 	int ret = cs->serialize(map, buffer);
 
 	if (ret < 0 || buffer.overflow()) {
 		LOG(IPADataSerializer, Error) << "Failed to serialize ControlInfoMap";
-		return { {}, {} };
+		dataVec.resize(start);
 	}
+}
 
+template<>
+std::tuple<std::vector<uint8_t>, std::vector<SharedFD>>
+IPADataSerializer<ControlInfoMap>::serialize(const ControlInfoMap &map,
+					     ControlSerializer *cs)
+{
 	std::vector<uint8_t> dataVec;
-	appendPOD<uint32_t>(dataVec, infoData.size());
-	dataVec.insert(dataVec.end(), infoData.begin(), infoData.end());
+	std::vector<SharedFD> fdsVec;
 
-	return { dataVec, {} };
+	serialize(map, dataVec, fdsVec, cs);
+
+	return { std::move(dataVec), std::move(fdsVec) };
 }
 
 template<>
@@ -521,13 +621,11 @@ IPADataSerializer<ControlInfoMap>::deserialize(std::vector<uint8_t>::const_itera
  * and it will be recursively consumed as necessary.
  */
 template<>
-std::tuple<std::vector<uint8_t>, std::vector<SharedFD>>
-IPADataSerializer<SharedFD>::serialize(const SharedFD &data,
-				       [[maybe_unused]] ControlSerializer *cs)
+void IPADataSerializer<SharedFD>::serialize(const SharedFD &data,
+					    std::vector<uint8_t> &dataVec,
+					    std::vector<SharedFD> &fdsVec,
+					    [[maybe_unused]] ControlSerializer *cs)
 {
-	std::vector<uint8_t> dataVec;
-	std::vector<SharedFD> fdVec;
-
 	/*
 	 * Store as uint32_t to prepare for conversion from validity flag
 	 * to index, and for alignment.
@@ -535,10 +633,20 @@ IPADataSerializer<SharedFD>::serialize(const SharedFD &data,
 	appendPOD<uint32_t>(dataVec, data.isValid());
 
 	if (data.isValid())
-		fdVec.push_back(data);
+		fdsVec.push_back(data);
+}
+
+template<>
+std::tuple<std::vector<uint8_t>, std::vector<SharedFD>>
+IPADataSerializer<SharedFD>::serialize(const SharedFD &data,
+				       ControlSerializer *cs)
+{
+	std::vector<uint8_t> dataVec;
+	std::vector<SharedFD> fdVec;
 
+	serialize(data, dataVec, fdVec, cs);
 
-	return { dataVec, fdVec };
+	return { std::move(dataVec), std::move(fdVec) };
 }
 
 template<>
@@ -572,25 +680,29 @@ SharedFD IPADataSerializer<SharedFD>::deserialize(const std::vector<uint8_t> &da
  * 4 bytes - uint32_t Offset
  * 4 bytes - uint32_t Length
  */
+template<>
+void IPADataSerializer<FrameBuffer::Plane>::serialize(const FrameBuffer::Plane &data,
+						      std::vector<uint8_t> &dataVec,
+						      std::vector<SharedFD> &fdsVec,
+						      [[maybe_unused]] ControlSerializer *cs)
+{
+	IPADataSerializer<SharedFD>::serialize(data.fd, dataVec, fdsVec);
+
+	appendPOD<uint32_t>(dataVec, data.offset);
+	appendPOD<uint32_t>(dataVec, data.length);
+}
+
 template<>
 std::tuple<std::vector<uint8_t>, std::vector<SharedFD>>
 IPADataSerializer<FrameBuffer::Plane>::serialize(const FrameBuffer::Plane &data,
-						 [[maybe_unused]] ControlSerializer *cs)
+						 ControlSerializer *cs)
 {
 	std::vector<uint8_t> dataVec;
 	std::vector<SharedFD> fdsVec;
 
-	std::vector<uint8_t> fdBuf;
-	std::vector<SharedFD> fdFds;
-	std::tie(fdBuf, fdFds) =
-		IPADataSerializer<SharedFD>::serialize(data.fd);
-	dataVec.insert(dataVec.end(), fdBuf.begin(), fdBuf.end());
-	fdsVec.insert(fdsVec.end(), fdFds.begin(), fdFds.end());
-
-	appendPOD<uint32_t>(dataVec, data.offset);
-	appendPOD<uint32_t>(dataVec, data.length);
+	serialize(data, dataVec, fdsVec, cs);
 
-	return { dataVec, fdsVec };
+	return { std::move(dataVec), std::move(fdsVec) };
 }
 
 template<>
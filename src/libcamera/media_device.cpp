@@ -63,7 +63,8 @@ LOG_DEFINE_CATEGORY(MediaDevice)
  * populate() before the media graph can be queried.
  */
 MediaDevice::MediaDevice(const std::string &deviceNode)
-	: deviceNode_(deviceNode), valid_(false), acquired_(false)
+	: deviceNode_(deviceNode), valid_(false), acquired_(false),
+	  lockGeneration_(0)
 {
 }
 
@@ -147,6 +148,12 @@ bool MediaDevice::lock()
 	if (lockf(fd_.get(), F_TLOCK, 0))
 		return false;
 
+	/*
+	 * Other processes may have used the device since it was last locked,
+	 * invalidate the device state cached by libcamera.
+	 */
+	lockGeneration_++;
+
 	return true;
 }
 
@@ -167,6 +174,20 @@ void MediaDevice::unlock()
 	lockf(fd_.get(), F_ULOCK, 0);
 }
 
+/**
+ * \fn MediaDevice::lockGeneration()
+ * \brief Retrieve the generation number of the device lock
+ *
+ * libcamera caches the state of the media device, such as the state of links,
+ * and of the V4L2 devices of its entities, such as their formats, to avoid
+ * redundant ioctls. The cached state is only valid as long as libcamera is the
+ * only user of the devices, which is guaranteed while the media device is
+ * locked. The lock generation number is incremented every time the media
+ * device is locked, and the cached state shall be dropped when it changes.
+ *
+ * \return The lock generation number
+ */
+
 /**
  * \fn MediaDevice::busy()
  * \brief Check if a device is in use
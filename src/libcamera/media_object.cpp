@@ -115,7 +115,9 @@ LOG_DECLARE_CATEGORY(MediaDevice)
  * disable it is.
  *
  * Enabling a link establishes a data connection between two pads, while
- * disabling it interrupts that connection.
+ * disabling it interrupts that connection. Links already in the requested state
+ * are left untouched, unless the media device has been locked again since the
+ * link state was last set, as other processes may then have modified it.
  *
  * \return 0 on success or a negative error code otherwise
  */
@@ -124,11 +126,16 @@ int MediaLink::setEnabled(bool enable)
 	unsigned int flags = (flags_ & ~MEDIA_LNK_FL_ENABLED)
 			   | (enable ? MEDIA_LNK_FL_ENABLED : 0);
 
+	/* Skip the ioctl if the link is already in the requested state. */
+	if (flags == flags_ && flagsGeneration_ == dev_->lockGeneration())
+		return 0;
+
 	int ret = dev_->setupLink(this, flags);
 	if (ret)
 		return ret;
 
 	flags_ = flags;
+	flagsGeneration_ = dev_->lockGeneration();
 
 	return 0;
 }
@@ -142,7 +149,8 @@ int MediaLink::setEnabled(bool enable)
 MediaLink::MediaLink(const struct media_v2_link *link, MediaPad *source,
 		     MediaPad *sink)
 	: MediaObject(source->device(), link->id), source_(source),
-	  sink_(sink), flags_(link->flags)
+	  sink_(sink), flags_(link->flags),
+	  flagsGeneration_(source->device()->lockGeneration())
 {
 }
 
@@ -63,20 +63,24 @@ IPU3Frames::Info *IPU3Frames::create(Request *request)
 	availableParamBuffers_.pop();
 	availableStatBuffers_.pop();
 
-	/* \todo Remove the dynamic allocation of Info */
-	std::unique_ptr<Info> info = std::make_unique<Info>();
+	Info *info = frameInfo_.create(id, request);
 
-	info->id = id;
-	info->request = request;
 	info->rawBuffer = nullptr;
 	info->paramBuffer = paramBuffer;
 	info->statBuffer = statBuffer;
 	info->paramDequeued = false;
 	info->metadataProcessed = false;
 
-	frameInfo_[id] = std::move(info);
+	frameInfo_.addBuffer(info, paramBuffer);
+	frameInfo_.addBuffer(info, statBuffer);
 
-	return frameInfo_[id].get();
+	return info;
+}
+
+void IPU3Frames::setRawBuffer(IPU3Frames::Info *info, FrameBuffer *buffer)
+{
+	info->rawBuffer = buffer;
+	frameInfo_.addBuffer(info, buffer);
 }
 
 void IPU3Frames::remove(IPU3Frames::Info *info)
@@ -85,8 +89,8 @@ void IPU3Frames::remove(IPU3Frames::Info *info)
 	availableParamBuffers_.push(info->paramBuffer);
 	availableStatBuffers_.push(info->statBuffer);
 
-	/* Delete the extended frame information. */
-	frameInfo_.erase(info->id);
+	/* Release the extended frame information. */
+	frameInfo_.remove(info);
 }
 
 bool IPU3Frames::tryComplete(IPU3Frames::Info *info)
@@ -111,10 +115,9 @@ bool IPU3Frames::tryComplete(IPU3Frames::Info *info)
 
 IPU3Frames::Info *IPU3Frames::find(unsigned int id)
 {
-	const auto &itInfo = frameInfo_.find(id);
-
-	if (itInfo != frameInfo_.end())
-		return itInfo->second.get();
+	Info *info = frameInfo_.find(id);
+	if (info)
+		return info;
 
 	LOG(IPU3, Fatal) << "Can't find tracking information for frame " << id;
 
@@ -123,17 +126,9 @@ IPU3Frames::Info *IPU3Frames::find(unsigned int id)
 
 IPU3Frames::Info *IPU3Frames::find(FrameBuffer *buffer)
 {
-	for (auto const &itInfo : frameInfo_) {
-		Info *info = itInfo.second.get();
-
-		for (auto const itBuffers : info->request->buffers())
-			if (itBuffers.second == buffer)
-				return info;
-
-		if (info->rawBuffer == buffer || info->paramBuffer == buffer ||
-		    info->statBuffer == buffer)
-			return info;
-	}
+	Info *info = frameInfo_.find(buffer);
+	if (info)
+		return info;
 
 	LOG(IPU3, Fatal) << "Can't find tracking information from buffer";
 
@@ -7,7 +7,6 @@
 
 #pragma once
 
-#include <map>
 #include <memory>
 #include <queue>
 #include <vector>
@@ -16,6 +15,8 @@
 
 #include <libcamera/controls.h>
 
+#include "libcamera/internal/frame_tracker.h"
+
 namespace libcamera {
 
 class FrameBuffer;
@@ -28,10 +29,7 @@ struct IPABuffer;
 class IPU3Frames
 {
 public:
-	struct Info {
-		unsigned int id;
-		Request *request;
-
+	struct Info : public FrameInfo {
 		FrameBuffer *rawBuffer;
 		FrameBuffer *paramBuffer;
 		FrameBuffer *statBuffer;
@@ -49,6 +47,7 @@ public:
 	void clear();
 
 	Info *create(Request *request);
+	void setRawBuffer(Info *info, FrameBuffer *buffer);
 	void remove(Info *info);
 	bool tryComplete(Info *info);
 
@@ -61,7 +60,7 @@ private:
 	std::queue<FrameBuffer *> availableParamBuffers_;
 	std::queue<FrameBuffer *> availableStatBuffers_;
 
-	std::map<unsigned int, std::unique_ptr<Info>> frameInfo_;
+	FrameTracker<Info> frameInfo_;
 };
 
 } /* namespace libcamera */
@@ -53,8 +53,6 @@ const std::vector<float> gdcScalingFactors = {
 	14.25, 14.5, 14.75, 15, 15.25, 15.5, 15.75, 16,
 };
 
-std::vector<ImgUDevice::PipeConfig> pipeConfigs;
-
 struct FOV {
 	float w;
 	float h;
@@ -106,7 +104,8 @@ bool isSameRatio(const Size &in, const Size &out)
 }
 
 void calculateBDSHeight(ImgUDevice::Pipe *pipe, const Size &iif, const Size &gdc,
-			unsigned int bdsWidth, float bdsSF)
+			unsigned int bdsWidth, float bdsSF,
+			std::vector<ImgUDevice::PipeConfig> &pipeConfigs)
 {
 	unsigned int minIFHeight = iif.height - ImgUDevice::kIFMaxCropHeight;
 	unsigned int minBDSHeight = gdc.height + ImgUDevice::kFilterHeight * 2;
@@ -182,7 +181,8 @@ void calculateBDSHeight(ImgUDevice::Pipe *pipe, const Size &iif, const Size &gdc
 	}
 }
 
-void calculateBDS(ImgUDevice::Pipe *pipe, const Size &iif, const Size &gdc, float bdsSF)
+void calculateBDS(ImgUDevice::Pipe *pipe, const Size &iif, const Size &gdc, float bdsSF,
+		  std::vector<ImgUDevice::PipeConfig> &pipeConfigs)
 {
 	unsigned int minBDSWidth = gdc.width + ImgUDevice::kFilterWidth * 2;
 	unsigned int minBDSHeight = gdc.height + ImgUDevice::kFilterHeight * 2;
@@ -198,7 +198,8 @@ void calculateBDS(ImgUDevice::Pipe *pipe, const Size &iif, const Size &gdc, floa
 			unsigned int bdsIntHeight = static_cast<unsigned int>(bdsHeight);
 			if (!(bdsIntWidth % ImgUDevice::kBDSAlignWidth) && bdsWidth >= minBDSWidth &&
 			    !(bdsIntHeight % ImgUDevice::kBDSAlignHeight) && bdsHeight >= minBDSHeight)
-				calculateBDSHeight(pipe, iif, gdc, bdsIntWidth, sf);
+				calculateBDSHeight(pipe, iif, gdc, bdsIntWidth, sf,
+						   pipeConfigs);
 		}
 
 		sf += ImgUDevice::kBDSSfStep;
@@ -215,7 +216,8 @@ void calculateBDS(ImgUDevice::Pipe *pipe, const Size &iif, const Size &gdc, floa
 			unsigned int bdsIntHeight = static_cast<unsigned int>(bdsHeight);
 			if (!(bdsIntWidth % ImgUDevice::kBDSAlignWidth) && bdsWidth >= minBDSWidth &&
 			    !(bdsIntHeight % ImgUDevice::kBDSAlignHeight) && bdsHeight >= minBDSHeight)
-				calculateBDSHeight(pipe, iif, gdc, bdsIntWidth, sf);
+				calculateBDSHeight(pipe, iif, gdc, bdsIntWidth, sf,
+						   pipeConfigs);
 		}
 
 		sf -= ImgUDevice::kBDSSfStep;
@@ -271,6 +273,93 @@ FOV calcFOV(const Size &in, const ImgUDevice::PipeConfig &pipe)
 	return fov;
 }
 
+/* Search the pipe configuration with the largest field of view. */
+ImgUDevice::PipeConfig searchPipeConfig(ImgUDevice::Pipe *pipe)
+{
+	std::vector<ImgUDevice::PipeConfig> pipeConfigs;
+
+	LOG(IPU3, Debug) << "Calculating pipe configuration for: ";
+	LOG(IPU3, Debug) << "input: " << pipe->input.toString();
+	LOG(IPU3, Debug) << "main: " << pipe->main.toString();
+	LOG(IPU3, Debug) << "vf: " << pipe->viewfinder.toString();
+
+	const Size &in = pipe->input;
+
+	/*
+	 * \todo Filter out all resolutions < IF_CROP_MAX.
+	 * See https://bugs.libcamera.org/show_bug.cgi?id=32
+	 */
+	if (in.width < ImgUDevice::kIFMaxCropWidth || in.height < ImgUDevice::kIFMaxCropHeight) {
+		LOG(IPU3, Error) << "Input resolution " << in.toString()
+				 << " not supported";
+		return {};
+	}
+
+	Size gdc = calculateGDC(pipe);
+
+	float bdsSF = static_cast<float>(in.width) / gdc.width;
+	float sf = findScaleFactor(bdsSF, bdsScalingFactors, true);
+
+	/* Populate the configurations vector by scaling width and height. */
+	unsigned int ifWidth = utils::alignUp(in.width, ImgUDevice::kIFAlignWidth);
+	unsigned int ifHeight = utils::alignUp(in.height, ImgUDevice::kIFAlignHeight);
+	unsigned int minIfWidth = in.width - ImgUDevice::kIFMaxCropWidth;
+	unsigned int minIfHeight = in.height - ImgUDevice::kIFMaxCropHeight;
+	while (ifWidth >= minIfWidth) {
+		while (ifHeight >= minIfHeight) {
+			Size iif{ ifWidth, ifHeight };
+			calculateBDS(pipe, iif, gdc, sf, pipeConfigs);
+			ifHeight -= ImgUDevice::kIFAlignHeight;
+		}
+
+		ifWidth -= ImgUDevice::kIFAlignWidth;
+	}
+
+	/* Repeat search by scaling width first. */
+	ifWidth = utils::alignUp(in.width, ImgUDevice::kIFAlignWidth);
+	ifHeight = utils::alignUp(in.height, ImgUDevice::kIFAlignHeight);
+	minIfWidth = in.width - ImgUDevice::kIFMaxCropWidth;
+	minIfHeight = in.height - ImgUDevice::kIFMaxCropHeight;
+	while (ifHeight >= minIfHeight) {
+		/*
+		 * \todo This procedure is probably broken:
+		 * https://github.com/intel/intel-ipu3-pipecfg/issues/2
+		 */
+		while (ifWidth >= minIfWidth) {
+			Size iif{ ifWidth, ifHeight };
+			calculateBDS(pipe, iif, gdc, sf, pipeConfigs);
+			ifWidth -= ImgUDevice::kIFAlignWidth;
+		}
+
+		ifHeight -= ImgUDevice::kIFAlignHeight;
+	}
+
+	if (pipeConfigs.size() == 0) {
+		LOG(IPU3, Error) << "Failed to calculate pipe configuration";
+		return {};
+	}
+
+	FOV bestFov = calcFOV(pipe->input, pipeConfigs[0]);
+	unsigned int bestIndex = 0;
+	unsigned int p = 0;
+	for (auto pipeConfig : pipeConfigs) {
+		FOV fov = calcFOV(pipe->input, pipeConfig);
+		if (fov.isLarger(bestFov)) {
+			bestFov = fov;
+			bestIndex = p;
+		}
+
+		++p;
+	}
+
+	LOG(IPU3, Debug) << "Computed pipe configuration: ";
+	LOG(IPU3, Debug) << "IF: " << pipeConfigs[bestIndex].iif.toString();
+	LOG(IPU3, Debug) << "BDS: " << pipeConfigs[bestIndex].bds.toString();
+	LOG(IPU3, Debug) << "GDC: " << pipeConfigs[bestIndex].gdc.toString();
+
+	return pipeConfigs[bestIndex];
+}
+
 } /* namespace */
 
 /**
@@ -378,93 +467,41 @@ int ImgUDevice::init(MediaDevice *media, unsigned int index)
 /**
  * \brief Calculate the ImgU pipe configuration parameters
  * \param[in] pipe The requested ImgU configuration
+ *
+ * The search for the best pipe configuration is expensive. As its result only
+ * depends on the input, main output and viewfinder sizes, it is memoized,
+ * which speeds up validation of configurations already seen, as happens when
+ * a configuration is validated and then applied, or when the Android HAL
+ * enumerates the supported resolutions.
+ *
  * \return An ImgUDevice::PipeConfig instance on success, an empty configuration
  * otherwise
  */
 ImgUDevice::PipeConfig ImgUDevice::calculatePipeConfig(Pipe *pipe)
 {
-	pipeConfigs.clear();
-
-	LOG(IPU3, Debug) << "Calculating pipe configuration for: ";
-	LOG(IPU3, Debug) << "input: " << pipe->input.toString();
-	LOG(IPU3, Debug) << "main: " << pipe->main.toString();
-	LOG(IPU3, Debug) << "vf: " << pipe->viewfinder.toString();
-
-	const Size &in = pipe->input;
-
-	/*
-	 * \todo Filter out all resolutions < IF_CROP_MAX.
-	 * See https://bugs.libcamera.org/show_bug.cgi?id=32
-	 */
-	if (in.width < ImgUDevice::kIFMaxCropWidth || in.height < ImgUDevice::kIFMaxCropHeight) {
-		LOG(IPU3, Error) << "Input resolution " << in.toString()
-				 << " not supported";
-		return {};
+	const auto key = std::make_tuple(pipe->input, pipe->main, pipe->viewfinder);
+
+	MutexLocker locker(pipeConfigCacheMutex_);
+
+	const auto it = pipeConfigCache_.find(key);
+	if (it != pipeConfigCache_.end()) {
+		LOG(IPU3, Debug)
+			<< "Using cached pipe configuration for input "
+			<< pipe->input.toString() << ", main "
+			<< pipe->main.toString() << ", vf "
+			<< pipe->viewfinder.toString();
+		return it->second;
 	}
 
-	Size gdc = calculateGDC(pipe);
-
-	float bdsSF = static_cast<float>(in.width) / gdc.width;
-	float sf = findScaleFactor(bdsSF, bdsScalingFactors, true);
+	PipeConfig pipeConfig = searchPipeConfig(pipe);
 
-	/* Populate the configurations vector by scaling width and height. */
-	unsigned int ifWidth = utils::alignUp(in.width, ImgUDevice::kIFAlignWidth);
-	unsigned int ifHeight = utils::alignUp(in.height, ImgUDevice::kIFAlignHeight);
-	unsigned int minIfWidth = in.width - ImgUDevice::kIFMaxCropWidth;
-	unsigned int minIfHeight = in.height - ImgUDevice::kIFMaxCropHeight;
-	while (ifWidth >= minIfWidth) {
-		while (ifHeight >= minIfHeight) {
-			Size iif{ ifWidth, ifHeight };
-			calculateBDS(pipe, iif, gdc, sf);
-			ifHeight -= ImgUDevice::kIFAlignHeight;
-		}
+	/* Bound the cache size, applications may try arbitrary sizes. */
+	if (pipeConfigCache_.size() >= kMaxCachedPipeConfigs)
+		pipeConfigCache_.clear();
 
-		ifWidth -= ImgUDevice::kIFAlignWidth;
-	}
+	pipeConfigCache_[key] = pipeConfig;
 
-	/* Repeat search by scaling width first. */
-	ifWidth = utils::alignUp(in.width, ImgUDevice::kIFAlignWidth);
-	ifHeight = utils::alignUp(in.height, ImgUDevice::kIFAlignHeight);
-	minIfWidth = in.width - ImgUDevice::kIFMaxCropWidth;
-	minIfHeight = in.height - ImgUDevice::kIFMaxCropHeight;
-	while (ifHeight >= minIfHeight) {
-		/*
-		 * \todo This procedure is probably broken:
-		 * https://github.com/intel/intel-ipu3-pipecfg/issues/2
-		 */
-		while (ifWidth >= minIfWidth) {
-			Size iif{ ifWidth, ifHeight };
-			calculateBDS(pipe, iif, gdc, sf);
-			ifWidth -= ImgUDevice::kIFAlignWidth;
-		}
-
-		ifHeight -= ImgUDevice::kIFAlignHeight;
-	}
-
-	if (pipeConfigs.size() == 0) {
-		LOG(IPU3, Error) << "Failed to calculate pipe configuration";
-		return {};
-	}
-
-	FOV bestFov = calcFOV(pipe->input, pipeConfigs[0]);
-	unsigned int bestIndex = 0;
-	unsigned int p = 0;
-	for (auto pipeConfig : pipeConfigs) {
-		FOV fov = calcFOV(pipe->input, pipeConfig);
-		if (fov.isLarger(bestFov)) {
-			bestFov = fov;
-			bestIndex = p;
-		}
-
-		++p;
-	}
-
-	LOG(IPU3, Debug) << "Computed pipe configuration: ";
-	LOG(IPU3, Debug) << "IF: " << pipeConfigs[bestIndex].iif.toString();
-	LOG(IPU3, Debug) << "BDS: " << pipeConfigs[bestIndex].bds.toString();
-	LOG(IPU3, Debug) << "GDC: " << pipeConfigs[bestIndex].gdc.toString();
-
-	return pipeConfigs[bestIndex];
+	return pipeConfig;
 }
 
 /**
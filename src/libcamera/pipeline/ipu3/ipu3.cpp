@@ -6,7 +6,9 @@
  */
 
 #include <algorithm>
+#include <array>
 #include <iomanip>
+#include <map>
 #include <memory>
 #include <queue>
 #include <vector>
@@ -31,6 +33,7 @@
 #include "libcamera/internal/ipa_manager.h"
 #include "libcamera/internal/media_device.h"
 #include "libcamera/internal/pipeline_handler.h"
+#include "libcamera/internal/stats_capture.h"
 
 #include "cio2.h"
 #include "frames.h"
@@ -77,6 +80,7 @@ public:
 	IPU3Frames frameInfos_;
 
 	std::unique_ptr<ipa::ipu3::IPAProxyIPU3> ipa_;
+	std::unique_ptr<StatsCaptureWriter> statsCapture_;
 
 	/* Requests for which no buffer has been queued to the CIO2 device yet. */
 	std::queue<Request *> pendingRequests_;
@@ -116,6 +120,12 @@ private:
 
 	StreamConfiguration cio2Configuration_;
 	ImgUDevice::PipeConfig pipeConfig_;
+
+	/*
+	 * The CIO2 configurations selected for each raw size, shared between
+	 * successive validations of the configuration.
+	 */
+	std::map<Size, StreamConfiguration> cio2Configurations_;
 };
 
 class PipelineHandlerIPU3 : public PipelineHandler
@@ -292,7 +302,12 @@ CameraConfiguration::Status IPU3CameraConfiguration::validate()
 					       ImgUDevice::kOutputMarginHeight })
 				    .boundedTo(data_->cio2_.sensor()->resolution());
 
-	cio2Configuration_ = data_->cio2_.generateConfiguration(rawSize);
+	auto it = cio2Configurations_.find(rawSize);
+	if (it == cio2Configurations_.end())
+		it = cio2Configurations_.emplace(rawSize,
+						 data_->cio2_.generateConfiguration(rawSize)).first;
+
+	cio2Configuration_ = it->second;
 	if (!cio2Configuration_.pixelFormat.isValid())
 		return Invalid;
 
@@ -676,6 +691,27 @@ int PipelineHandlerIPU3::configure(Camera *camera, CameraConfiguration *c)
 		return ret;
 	}
 
+	data->statsCapture_ = StatsCaptureWriter::create(name());
+	if (data->statsCapture_) {
+		const std::array<uint32_t, 4> pipelineConfig = {
+			configInfo.bdsOutputSize.width,
+			configInfo.bdsOutputSize.height,
+			configInfo.iif.width,
+			configInfo.iif.height,
+		};
+
+		data->statsCapture_->writeSensorInfo(sensorInfo);
+		/*
+		 * Record the device control info maps, not the copies in
+		 * configInfo, as the serializer looks maps up by address when
+		 * serializing the sensor controls of each frame.
+		 */
+		data->statsCapture_->writeControlInfo(0, data->cio2_.sensor()->controls());
+		if (lens)
+			data->statsCapture_->writeControlInfo(1, lens->controls());
+		data->statsCapture_->writePipelineConfig(pipelineConfig);
+	}
+
 	return updateControls(data);
 }
 
@@ -755,6 +791,9 @@ int PipelineHandlerIPU3::freeBuffers(Camera *camera)
 	data->ipa_->unmapBuffers(ids);
 	ipaBuffers_.clear();
 
+	if (data->statsCapture_)
+		data->statsCapture_->releaseBuffers();
+
 	data->imgu_->freeBuffers();
 
 	return 0;
@@ -869,7 +908,7 @@ void IPU3CameraData::queuePendingRequests()
 			break;
 		}
 
-		info->rawBuffer = rawBuffer;
+		frameInfos_.setRawBuffer(info, rawBuffer);
 
 		ipa::ipu3::IPU3Event ev;
 		ev.op = ipa::ipu3::EventProcessControls;
@@ -1444,6 +1483,16 @@ void IPU3CameraData::statBufferReady(FrameBuffer *buffer)
 	ev.bufferId = info->statBuffer->cookie();
 	ev.frameTimestamp = request->metadata().get(controls::SensorTimestamp);
 	ev.sensorControls = info->effectiveSensorControls;
+
+	if (statsCapture_) {
+		statsCapture_->writeSensorControls(info->id, ev.frameTimestamp,
+						   ev.sensorControls);
+		statsCapture_->writeBuffer(StatsCaptureRecordType::Params, info->id,
+					   ev.frameTimestamp, info->paramBuffer);
+		statsCapture_->writeBuffer(StatsCaptureRecordType::Statistics,
+					   info->id, ev.frameTimestamp, buffer);
+	}
+
 	ipa_->processEvent(ev);
 }
 
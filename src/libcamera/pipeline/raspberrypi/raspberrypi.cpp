@@ -5,6 +5,7 @@
  * raspberrypi.cpp - Pipeline handler for Raspberry Pi devices
  */
 #include <algorithm>
+#include <array>
 #include <assert.h>
 #include <cmath>
 #include <fcntl.h>
@@ -36,13 +37,14 @@
 #include "libcamera/internal/camera_sensor.h"
 #include "libcamera/internal/delayed_controls.h"
 #include "libcamera/internal/device_enumerator.h"
+#include "libcamera/internal/dma_buf_allocator.h"
 #include "libcamera/internal/framebuffer.h"
 #include "libcamera/internal/ipa_manager.h"
 #include "libcamera/internal/media_device.h"
 #include "libcamera/internal/pipeline_handler.h"
+#include "libcamera/internal/stats_capture.h"
 #include "libcamera/internal/v4l2_videodevice.h"
 
-#include "dma_heaps.h"
 #include "rpi_stream.h"
 
 namespace libcamera {
@@ -174,6 +176,23 @@ V4L2SubdeviceFormat findBestFormat(const SensorFormats &formatsMap, const Size &
 	return bestFormat;
 }
 
+/*
+ * Find the sensor mode matching the sensor configuration requested by the
+ * application. Unlike findBestFormat(), only exact matches are accepted, and
+ * an empty format is returned if no sensor mode matches.
+ */
+V4L2SubdeviceFormat findSensorConfigFormat(const SensorFormats &formatsMap,
+					   const SensorConfiguration &sensorConfig)
+{
+	V4L2SubdeviceFormat format = findBestFormat(formatsMap, sensorConfig.outputSize,
+						    sensorConfig.bitDepth);
+	if (format.size != sensorConfig.outputSize ||
+	    BayerFormat::fromMbusCode(format.mbus_code).bitDepth != sensorConfig.bitDepth)
+		return {};
+
+	return format;
+}
+
 enum class Unicam : unsigned int { Image, Embedded };
 enum class Isp : unsigned int { Input, Output0, Output1, Stats };
 
@@ -183,9 +202,10 @@ class RPiCameraData : public Camera::Private
 {
 public:
 	RPiCameraData(PipelineHandler *pipe)
-		: Camera::Private(pipe), state_(State::Stopped),
-		  supportsFlips_(false), flipsAlterBayerOrder_(false),
-		  dropFrameCount_(0), buffersAllocated_(false), ispOutputCount_(0)
+		: Camera::Private(pipe), statsCaptureSequence_(0),
+		  state_(State::Stopped), supportsFlips_(false),
+		  flipsAlterBayerOrder_(false), dropFrameCount_(0),
+		  buffersAllocated_(false), ispOutputCount_(0)
 	{
 	}
 
@@ -195,6 +215,7 @@ public:
 	}
 
 	void freeBuffers();
+	std::vector<RPi::Stream *> freeSensorBuffers();
 	void frameStarted(uint32_t sequence);
 
 	int loadIPA(ipa::RPi::SensorConfig *sensorConfig);
@@ -222,6 +243,9 @@ public:
 	void applyScalerCrop(const ControlList &controls);
 
 	std::unique_ptr<ipa::RPi::IPAProxyRPi> ipa_;
+	std::unique_ptr<StatsCaptureWriter> statsCapture_;
+	/* Sequence of the frame being processed by the ISP, for stats capture. */
+	uint32_t statsCaptureSequence_;
 
 	std::unique_ptr<CameraSensor> sensor_;
 	SensorFormats sensorFormats_;
@@ -239,7 +263,7 @@ public:
 	std::vector<std::pair<std::unique_ptr<V4L2Subdevice>, MediaLink *>> bridgeDevices_;
 
 	/* DMAHEAP allocation helper. */
-	RPi::DmaHeap dmaHeap_;
+	DmaBufAllocator dmaHeap_;
 	SharedFD lsTable_;
 
 	std::unique_ptr<DelayedControls> delayedCtrls_;
@@ -319,6 +343,7 @@ public:
 
 	CameraConfiguration *generateConfiguration(Camera *camera, const StreamRoles &roles) override;
 	int configure(Camera *camera, CameraConfiguration *config) override;
+	int reconfigure(Camera *camera, CameraConfiguration *config) override;
 
 	int exportFrameBuffers(Camera *camera, Stream *stream,
 			       std::vector<std::unique_ptr<FrameBuffer>> *buffers) override;
@@ -337,8 +362,10 @@ private:
 	}
 
 	int registerCamera(MediaDevice *unicam, MediaDevice *isp, MediaEntity *sensorEntity);
+	int configureDevices(Camera *camera, CameraConfiguration *config,
+			     const std::vector<RPi::Stream *> &streams);
 	int queueAllBuffers(Camera *camera);
-	int prepareBuffers(Camera *camera);
+	int prepareBuffers(Camera *camera, const std::vector<RPi::Stream *> &streams);
 	void mapBuffers(Camera *camera, const RPi::BufferMap &buffers, unsigned int mask);
 };
 
@@ -411,6 +438,21 @@ CameraConfiguration::Status RPiCameraConfiguration::validate()
 	 */
 	combinedTransform_ = combined;
 
+	/*
+	 * If the application has requested a sensor configuration, it must
+	 * match a sensor mode exactly.
+	 */
+	V4L2SubdeviceFormat sensorConfigFormat;
+	if (sensorConfig) {
+		if (sensorConfig->isValid())
+			sensorConfigFormat = findSensorConfigFormat(data_->sensorFormats_,
+								    *sensorConfig);
+		if (sensorConfigFormat.size.isNull()) {
+			LOG(RPI, Error) << "Invalid sensor configuration";
+			return Invalid;
+		}
+	}
+
 	unsigned int rawCount = 0, outCount = 0, count = 0, maxIndex = 0;
 	std::pair<int, Size> outSize[2];
 	Size maxSize;
@@ -422,7 +464,9 @@ CameraConfiguration::Status RPiCameraConfiguration::validate()
 			 */
 			const PixelFormatInfo &info = PixelFormatInfo::info(cfg.pixelFormat);
 			unsigned int bitDepth = info.isValid() ? info.bitsPerPixel : defaultRawBitDepth;
-			V4L2SubdeviceFormat sensorFormat = findBestFormat(data_->sensorFormats_, cfg.size, bitDepth);
+			V4L2SubdeviceFormat sensorFormat = sensorConfig
+							 ? sensorConfigFormat
+							 : findBestFormat(data_->sensorFormats_, cfg.size, bitDepth);
 			BayerFormat::Packing packing = BayerFormat::Packing::CSI2;
 			if (info.isValid() && !info.packed)
 				packing = BayerFormat::Packing::None;
@@ -688,13 +732,64 @@ CameraConfiguration *PipelineHandlerRPi::generateConfiguration(Camera *camera,
 int PipelineHandlerRPi::configure(Camera *camera, CameraConfiguration *config)
 {
 	RPiCameraData *data = cameraData(camera);
-	int ret;
 
 	/* Start by freeing all buffers and reset the Unicam and ISP stream states. */
 	data->freeBuffers();
 	for (auto const stream : data->streams_)
 		stream->setExternal(false);
 
+	return configureDevices(camera, config, data->streams_);
+}
+
+/*
+ * A sensor mode change only affects the Unicam nodes and the ISP input. Stop
+ * the data flow, release the buffers of those nodes as their format can't be
+ * changed otherwise, and restart with the new configuration. The ISP output and
+ * statistics buffers stay allocated and mapped in the IPA, and the format of
+ * their nodes is left untouched. The IPA handles the restart as a mode switch,
+ * preserving the state of its algorithms.
+ */
+int PipelineHandlerRPi::reconfigure(Camera *camera, CameraConfiguration *config)
+{
+	RPiCameraData *data = cameraData(camera);
+	int ret;
+
+	stopDevice(camera);
+
+	std::vector<RPi::Stream *> streams = data->freeSensorBuffers();
+
+	ret = configureDevices(camera, config, streams);
+	if (ret) {
+		data->freeBuffers();
+		return ret;
+	}
+
+	ret = prepareBuffers(camera, streams);
+	if (ret) {
+		LOG(RPI, Error) << "Failed to allocate buffers";
+		data->freeBuffers();
+		return ret;
+	}
+
+	return start(camera, nullptr);
+}
+
+/*
+ * Configure the sensor, Unicam and ISP for the camera configuration. Formats
+ * are only applied to the nodes of the given \a streams. When reconfiguring a
+ * running camera, the other nodes still have buffers allocated, which prevents
+ * changing their format, and their format doesn't depend on the sensor mode.
+ */
+int PipelineHandlerRPi::configureDevices(Camera *camera, CameraConfiguration *config,
+					 const std::vector<RPi::Stream *> &streams)
+{
+	RPiCameraData *data = cameraData(camera);
+	int ret;
+
+	auto configurable = [&](const RPi::Stream *stream) {
+		return std::find(streams.begin(), streams.end(), stream) != streams.end();
+	};
+
 	BayerFormat::Packing packing = BayerFormat::Packing::CSI2;
 	Size maxSize, sensorSize;
 	unsigned int maxIndex = 0;
@@ -743,24 +838,38 @@ int PipelineHandlerRPi::configure(Camera *camera, CameraConfiguration *config)
 		data->setSensorControls(controls);
 	}
 
-	/* First calculate the best sensor mode we can use based on the user request. */
-	V4L2SubdeviceFormat sensorFormat = findBestFormat(data->sensorFormats_, rawStream ? sensorSize : maxSize, bitDepth);
+	/*
+	 * First calculate the best sensor mode we can use based on the user
+	 * request, unless a sensor configuration has been requested explicitly.
+	 */
+	V4L2SubdeviceFormat sensorFormat =
+		config->sensorConfig
+		? findSensorConfigFormat(data->sensorFormats_, *config->sensorConfig)
+		: findBestFormat(data->sensorFormats_, rawStream ? sensorSize : maxSize, bitDepth);
 	ret = data->sensor_->setFormat(&sensorFormat);
 	if (ret)
 		return ret;
 
 	V4L2DeviceFormat unicamFormat = toV4L2DeviceFormat(sensorFormat, packing);
-	ret = data->unicam_[Unicam::Image].dev()->setFormat(&unicamFormat);
-	if (ret)
-		return ret;
+	if (configurable(&data->unicam_[Unicam::Image])) {
+		ret = data->unicam_[Unicam::Image].dev()->setFormat(&unicamFormat);
+		if (ret)
+			return ret;
+	} else {
+		ret = data->unicam_[Unicam::Image].dev()->getFormat(&unicamFormat);
+		if (ret)
+			return ret;
+	}
 
 	LOG(RPI, Info) << "Sensor: " << camera->id()
 		       << " - Selected sensor format: " << sensorFormat.toString()
 		       << " - Selected unicam format: " << unicamFormat.toString();
 
-	ret = data->isp_[Isp::Input].dev()->setFormat(&unicamFormat);
-	if (ret)
-		return ret;
+	if (configurable(&data->isp_[Isp::Input])) {
+		ret = data->isp_[Isp::Input].dev()->setFormat(&unicamFormat);
+		if (ret)
+			return ret;
+	}
 
 	/*
 	 * See which streams are requested, and route the user
@@ -786,18 +895,20 @@ int PipelineHandlerRPi::configure(Camera *camera, CameraConfiguration *config)
 		format.fourcc = fourcc;
 		format.colorSpace = cfg.colorSpace;
 
-		LOG(RPI, Debug) << "Setting " << stream->name() << " to "
-				<< format.toString();
+		if (configurable(stream)) {
+			LOG(RPI, Debug) << "Setting " << stream->name() << " to "
+					<< format.toString();
 
-		ret = stream->dev()->setFormat(&format);
-		if (ret)
-			return -EINVAL;
+			ret = stream->dev()->setFormat(&format);
+			if (ret)
+				return -EINVAL;
 
-		if (format.size != cfg.size || format.fourcc != fourcc) {
-			LOG(RPI, Error)
-				<< "Failed to set requested format on " << stream->name()
-				<< ", returned " << format.toString();
-			return -EINVAL;
+			if (format.size != cfg.size || format.fourcc != fourcc) {
+				LOG(RPI, Error)
+					<< "Failed to set requested format on " << stream->name()
+					<< ", returned " << format.toString();
+				return -EINVAL;
+			}
 		}
 
 		LOG(RPI, Debug)
@@ -830,6 +941,9 @@ int PipelineHandlerRPi::configure(Camera *camera, CameraConfiguration *config)
 		format.fourcc = V4L2PixelFormat::fromPixelFormat(formats::YUV420);
 		/* No one asked for output, so the color space doesn't matter. */
 		format.colorSpace = ColorSpace::Jpeg;
+	}
+
+	if (!output0Set && configurable(&data->isp_[Isp::Output0])) {
 		ret = data->isp_[Isp::Output0].dev()->setFormat(&format);
 		if (ret) {
 			LOG(RPI, Error)
@@ -853,7 +967,7 @@ int PipelineHandlerRPi::configure(Camera *camera, CameraConfiguration *config)
 	 * \todo If Output 1 format is not YUV420, Output 1 ought to be disabled as
 	 * colour denoise will not run.
 	 */
-	if (!output1Set) {
+	if (!output1Set && configurable(&data->isp_[Isp::Output1])) {
 		V4L2DeviceFormat output1Format;
 		constexpr Size maxDimensions(1200, 1200);
 		const Size limit = maxDimensions.boundedToAspectRatio(format.size);
@@ -876,11 +990,13 @@ int PipelineHandlerRPi::configure(Camera *camera, CameraConfiguration *config)
 	/* ISP statistics output format. */
 	format = {};
 	format.fourcc = V4L2PixelFormat(V4L2_META_FMT_BCM2835_ISP_STATS);
-	ret = data->isp_[Isp::Stats].dev()->setFormat(&format);
-	if (ret) {
-		LOG(RPI, Error) << "Failed to set format on ISP stats stream: "
-				<< format.toString();
-		return ret;
+	if (configurable(&data->isp_[Isp::Stats])) {
+		ret = data->isp_[Isp::Stats].dev()->setFormat(&format);
+		if (ret) {
+			LOG(RPI, Error) << "Failed to set format on ISP stats stream: "
+					<< format.toString();
+			return ret;
+		}
 	}
 
 	/* Figure out the smallest selection the ISP will allow. */
@@ -909,7 +1025,7 @@ int PipelineHandlerRPi::configure(Camera *camera, CameraConfiguration *config)
 	 * Configure the Unicam embedded data output format only if the sensor
 	 * supports it.
 	 */
-	if (data->sensorMetadata_) {
+	if (data->sensorMetadata_ && configurable(&data->unicam_[Unicam::Embedded])) {
 		V4L2SubdeviceFormat embeddedFormat;
 
 		data->sensor_->device()->getFormat(1, &embeddedFormat);
@@ -996,7 +1112,7 @@ int PipelineHandlerRPi::start(Camera *camera, const ControlList *controls)
 
 	if (!data->buffersAllocated_) {
 		/* Allocate buffers for internal pipeline usage. */
-		ret = prepareBuffers(camera);
+		ret = prepareBuffers(camera, data->streams_);
 		if (ret) {
 			LOG(RPI, Error) << "Failed to allocate buffers";
 			data->freeBuffers();
@@ -1376,7 +1492,8 @@ int PipelineHandlerRPi::queueAllBuffers(Camera *camera)
 	return 0;
 }
 
-int PipelineHandlerRPi::prepareBuffers(Camera *camera)
+int PipelineHandlerRPi::prepareBuffers(Camera *camera,
+				       const std::vector<RPi::Stream *> &streams)
 {
 	RPiCameraData *data = cameraData(camera);
 	unsigned int numRawBuffers = 0;
@@ -1390,7 +1507,7 @@ int PipelineHandlerRPi::prepareBuffers(Camera *camera)
 	}
 
 	/* Decide how many internal buffers to allocate. */
-	for (auto const stream : data->streams_) {
+	for (auto const stream : streams) {
 		unsigned int numBuffers;
 		/*
 		 * For Unicam, allocate a minimum of 4 buffers as we want
@@ -1438,8 +1555,13 @@ int PipelineHandlerRPi::prepareBuffers(Camera *camera)
 	 * Pass the stats and embedded data buffers to the IPA. No other
 	 * buffers need to be passed.
 	 */
-	mapBuffers(camera, data->isp_[Isp::Stats].getBuffers(), ipa::RPi::MaskStats);
-	if (data->sensorMetadata_)
+	auto prepared = [&](const RPi::Stream *stream) {
+		return std::find(streams.begin(), streams.end(), stream) != streams.end();
+	};
+
+	if (prepared(&data->isp_[Isp::Stats]))
+		mapBuffers(camera, data->isp_[Isp::Stats].getBuffers(), ipa::RPi::MaskStats);
+	if (data->sensorMetadata_ && prepared(&data->unicam_[Unicam::Embedded]))
 		mapBuffers(camera, data->unicam_[Unicam::Embedded].getBuffers(),
 			   ipa::RPi::MaskEmbeddedData);
 
@@ -1473,12 +1595,46 @@ void RPiCameraData::freeBuffers()
 	ipa_->unmapBuffers(ipaBuffers);
 	ipaBuffers_.clear();
 
+	if (statsCapture_)
+		statsCapture_->releaseBuffers();
+
 	for (auto const stream : streams_)
 		stream->releaseBuffers();
 
 	buffersAllocated_ = false;
 }
 
+/*
+ * Release the buffers of the streams whose format depends on the sensor mode,
+ * and return those streams. The Unicam image buffers are kept when they back a
+ * RAW stream, as the sensor mode can't change without changing the stream.
+ */
+std::vector<RPi::Stream *> RPiCameraData::freeSensorBuffers()
+{
+	std::vector<RPi::Stream *> streams;
+
+	if (!unicam_[Unicam::Image].isExternal()) {
+		streams.push_back(&unicam_[Unicam::Image]);
+		streams.push_back(&isp_[Isp::Input]);
+	}
+
+	if (sensorMetadata_) {
+		std::vector<unsigned int> ids;
+		for (auto const &it : unicam_[Unicam::Embedded].getBuffers()) {
+			ids.push_back(ipa::RPi::MaskEmbeddedData | it.first);
+			ipaBuffers_.erase(ipa::RPi::MaskEmbeddedData | it.first);
+		}
+
+		ipa_->unmapBuffers(ids);
+		streams.push_back(&unicam_[Unicam::Embedded]);
+	}
+
+	for (auto const stream : streams)
+		stream->releaseBuffers();
+
+	return streams;
+}
+
 void RPiCameraData::frameStarted(uint32_t sequence)
 {
 	LOG(RPI, Debug) << "frame start " << sequence;
@@ -1571,6 +1727,18 @@ int RPiCameraData::configureIPA(const CameraConfiguration *config)
 	if (!controls.empty())
 		setSensorControls(controls);
 
+	statsCapture_ = StatsCaptureWriter::create(pipe()->name());
+	if (statsCapture_) {
+		const std::array<uint32_t, 1> pipelineConfig = {
+			ipaConfig.transform,
+		};
+
+		statsCapture_->writeSensorInfo(sensorInfo_);
+		statsCapture_->writeControlInfo(0, sensor_->controls());
+		statsCapture_->writeControlInfo(1, isp_[Isp::Input].dev()->controls());
+		statsCapture_->writePipelineConfig(pipelineConfig);
+	}
+
 	return 0;
 }
 
@@ -1857,6 +2025,12 @@ void RPiCameraData::ispOutputDequeue(FrameBuffer *buffer)
 	 * application until after the IPA signals so.
 	 */
 	if (stream == &isp_[Isp::Stats]) {
+		if (statsCapture_)
+			statsCapture_->writeBuffer(StatsCaptureRecordType::Statistics,
+						   statsCaptureSequence_,
+						   buffer->metadata().timestamp,
+						   buffer);
+
 		ipa_->signalStatReady(ipa::RPi::MaskStats | static_cast<unsigned int>(index));
 	} else {
 		/* Any other ISP output can be handed back to the application now. */
@@ -2111,6 +2285,15 @@ void RPiCameraData::tryRunPipeline()
 				<< " Embedded buffer id: " << embeddedId;
 	}
 
+	if (statsCapture_) {
+		const FrameMetadata &metadata = bayerFrame.buffer->metadata();
+
+		statsCaptureSequence_ = metadata.sequence;
+		statsCapture_->writeSensorControls(metadata.sequence,
+						   metadata.timestamp,
+						   ispPrepare.controls);
+	}
+
 	ipa_->signalIspPrepare(ispPrepare);
 }
 
@@ -31,9 +31,11 @@
 #include "libcamera/internal/camera_sensor.h"
 #include "libcamera/internal/delayed_controls.h"
 #include "libcamera/internal/device_enumerator.h"
+#include "libcamera/internal/frame_tracker.h"
 #include "libcamera/internal/ipa_manager.h"
 #include "libcamera/internal/media_device.h"
 #include "libcamera/internal/pipeline_handler.h"
+#include "libcamera/internal/stats_capture.h"
 #include "libcamera/internal/v4l2_subdevice.h"
 #include "libcamera/internal/v4l2_videodevice.h"
 
@@ -46,10 +48,7 @@ LOG_DEFINE_CATEGORY(RkISP1)
 class PipelineHandlerRkISP1;
 class RkISP1CameraData;
 
-struct RkISP1FrameInfo {
-	unsigned int frame;
-	Request *request;
-
+struct RkISP1FrameInfo : public FrameInfo {
 	FrameBuffer *paramBuffer;
 	FrameBuffer *statBuffer;
 	FrameBuffer *mainPathBuffer;
@@ -74,7 +73,7 @@ public:
 
 private:
 	PipelineHandlerRkISP1 *pipe_;
-	std::map<unsigned int, RkISP1FrameInfo *> frameInfo_;
+	FrameTracker<RkISP1FrameInfo> frameInfo_;
 };
 
 class RkISP1CameraData : public Camera::Private
@@ -102,6 +101,7 @@ public:
 	RkISP1SelfPath *selfPath_;
 
 	std::unique_ptr<ipa::rkisp1::IPAProxyRkISP1> ipa_;
+	std::unique_ptr<StatsCaptureWriter> statsCapture_;
 
 private:
 	void paramFilled(unsigned int frame);
@@ -142,6 +142,7 @@ public:
 	CameraConfiguration *generateConfiguration(Camera *camera,
 		const StreamRoles &roles) override;
 	int configure(Camera *camera, CameraConfiguration *config) override;
+	int reconfigure(Camera *camera, CameraConfiguration *config) override;
 
 	int exportFrameBuffers(Camera *camera, Stream *stream,
 			       std::vector<std::unique_ptr<FrameBuffer>> *buffers) override;
@@ -174,6 +175,10 @@ private:
 	int allocateBuffers(Camera *camera);
 	int freeBuffers(Camera *camera);
 
+	int configurePipeline(Camera *camera, RkISP1CameraConfiguration *config);
+	int startStreaming(Camera *camera);
+	void stopStreaming(Camera *camera);
+
 	MediaDevice *media_;
 	std::unique_ptr<V4L2Subdevice> isp_;
 	std::unique_ptr<V4L2VideoDevice> param_;
@@ -217,10 +222,8 @@ RkISP1FrameInfo *RkISP1Frames::create(const RkISP1CameraData *data, Request *req
 	pipe_->availableParamBuffers_.pop();
 	pipe_->availableStatBuffers_.pop();
 
-	RkISP1FrameInfo *info = new RkISP1FrameInfo;
+	RkISP1FrameInfo *info = frameInfo_.create(frame, request);
 
-	info->frame = frame;
-	info->request = request;
 	info->paramBuffer = paramBuffer;
 	info->mainPathBuffer = mainPathBuffer;
 	info->selfPathBuffer = selfPathBuffer;
@@ -228,7 +231,8 @@ RkISP1FrameInfo *RkISP1Frames::create(const RkISP1CameraData *data, Request *req
 	info->paramDequeued = false;
 	info->metadataProcessed = false;
 
-	frameInfo_[frame] = info;
+	frameInfo_.addBuffer(info, paramBuffer);
+	frameInfo_.addBuffer(info, statBuffer);
 
 	return info;
 }
@@ -242,22 +246,16 @@ int RkISP1Frames::destroy(unsigned int frame)
 	pipe_->availableParamBuffers_.push(info->paramBuffer);
 	pipe_->availableStatBuffers_.push(info->statBuffer);
 
-	frameInfo_.erase(info->frame);
-
-	delete info;
+	frameInfo_.remove(info);
 
 	return 0;
 }
 
 void RkISP1Frames::clear()
 {
-	for (const auto &entry : frameInfo_) {
-		RkISP1FrameInfo *info = entry.second;
-
+	for (const auto &[frame, info] : frameInfo_.frames()) {
 		pipe_->availableParamBuffers_.push(info->paramBuffer);
 		pipe_->availableStatBuffers_.push(info->statBuffer);
-
-		delete info;
 	}
 
 	frameInfo_.clear();
@@ -265,10 +263,9 @@ void RkISP1Frames::clear()
 
 RkISP1FrameInfo *RkISP1Frames::find(unsigned int frame)
 {
-	auto itInfo = frameInfo_.find(frame);
-
-	if (itInfo != frameInfo_.end())
-		return itInfo->second;
+	RkISP1FrameInfo *info = frameInfo_.find(frame);
+	if (info)
+		return info;
 
 	LOG(RkISP1, Fatal) << "Can't locate info from frame";
 
@@ -277,15 +274,9 @@ RkISP1FrameInfo *RkISP1Frames::find(unsigned int frame)
 
 RkISP1FrameInfo *RkISP1Frames::find(FrameBuffer *buffer)
 {
-	for (auto &itInfo : frameInfo_) {
-		RkISP1FrameInfo *info = itInfo.second;
-
-		if (info->paramBuffer == buffer ||
-		    info->statBuffer == buffer ||
-		    info->mainPathBuffer == buffer ||
-		    info->selfPathBuffer == buffer)
-			return info;
-	}
+	RkISP1FrameInfo *info = frameInfo_.find(buffer);
+	if (info)
+		return info;
 
 	LOG(RkISP1, Fatal) << "Can't locate info from buffer";
 
@@ -294,12 +285,9 @@ RkISP1FrameInfo *RkISP1Frames::find(FrameBuffer *buffer)
 
 RkISP1FrameInfo *RkISP1Frames::find(Request *request)
 {
-	for (auto &itInfo : frameInfo_) {
-		RkISP1FrameInfo *info = itInfo.second;
-
-		if (info->request == request)
-			return info;
-	}
+	RkISP1FrameInfo *info = frameInfo_.find(request);
+	if (info)
+		return info;
 
 	LOG(RkISP1, Fatal) << "Can't locate info from request";
 
@@ -475,23 +463,54 @@ CameraConfiguration::Status RkISP1CameraConfiguration::validate()
 	}
 
 	/* Select the sensor format. */
+	std::vector<unsigned int> mbusCodes = { MEDIA_BUS_FMT_SBGGR12_1X12,
+						MEDIA_BUS_FMT_SGBRG12_1X12,
+						MEDIA_BUS_FMT_SGRBG12_1X12,
+						MEDIA_BUS_FMT_SRGGB12_1X12,
+						MEDIA_BUS_FMT_SBGGR10_1X10,
+						MEDIA_BUS_FMT_SGBRG10_1X10,
+						MEDIA_BUS_FMT_SGRBG10_1X10,
+						MEDIA_BUS_FMT_SRGGB10_1X10,
+						MEDIA_BUS_FMT_SBGGR8_1X8,
+						MEDIA_BUS_FMT_SGBRG8_1X8,
+						MEDIA_BUS_FMT_SGRBG8_1X8,
+						MEDIA_BUS_FMT_SRGGB8_1X8 };
+
+	/*
+	 * If the application has requested a sensor configuration, use the
+	 * sensor mode that matches it exactly.
+	 */
+	if (sensorConfig) {
+		if (!sensorConfig->isValid()) {
+			LOG(RkISP1, Error) << "Invalid sensor configuration";
+			return Invalid;
+		}
+
+		std::vector<unsigned int> codes;
+		for (unsigned int code : mbusCodes) {
+			V4L2SubdeviceFormat format{};
+			format.mbus_code = code;
+			if (format.bitsPerPixel() == sensorConfig->bitDepth)
+				codes.push_back(code);
+		}
+
+		sensorFormat_ = sensor->getFormat(codes, sensorConfig->outputSize);
+		if (sensorFormat_.size != sensorConfig->outputSize) {
+			LOG(RkISP1, Error)
+				<< "No sensor mode matches "
+				<< sensorConfig->outputSize.toString() << "-"
+				<< sensorConfig->bitDepth;
+			return Invalid;
+		}
+
+		return status;
+	}
+
 	Size maxSize;
 	for (const StreamConfiguration &cfg : config_)
 		maxSize = std::max(maxSize, cfg.size);
 
-	sensorFormat_ = sensor->getFormat({ MEDIA_BUS_FMT_SBGGR12_1X12,
-					    MEDIA_BUS_FMT_SGBRG12_1X12,
-					    MEDIA_BUS_FMT_SGRBG12_1X12,
-					    MEDIA_BUS_FMT_SRGGB12_1X12,
-					    MEDIA_BUS_FMT_SBGGR10_1X10,
-					    MEDIA_BUS_FMT_SGBRG10_1X10,
-					    MEDIA_BUS_FMT_SGRBG10_1X10,
-					    MEDIA_BUS_FMT_SRGGB10_1X10,
-					    MEDIA_BUS_FMT_SBGGR8_1X8,
-					    MEDIA_BUS_FMT_SGBRG8_1X8,
-					    MEDIA_BUS_FMT_SGRBG8_1X8,
-					    MEDIA_BUS_FMT_SRGGB8_1X8 },
-					  maxSize);
+	sensorFormat_ = sensor->getFormat(mbusCodes, maxSize);
 	if (sensorFormat_.size.isNull())
 		sensorFormat_.size = sensor->resolution();
 
@@ -561,13 +580,68 @@ int PipelineHandlerRkISP1::configure(Camera *camera, CameraConfiguration *c)
 	RkISP1CameraConfiguration *config =
 		static_cast<RkISP1CameraConfiguration *>(c);
 	RkISP1CameraData *data = cameraData(camera);
-	CameraSensor *sensor = data->sensor_.get();
 	int ret;
 
-	ret = initLinks(camera, sensor, *config);
+	ret = initLinks(camera, data->sensor_.get(), *config);
+	if (ret)
+		return ret;
+
+	V4L2DeviceFormat paramFormat;
+	paramFormat.fourcc = V4L2PixelFormat(V4L2_META_FMT_RK_ISP1_PARAMS);
+	ret = param_->setFormat(&paramFormat);
+	if (ret)
+		return ret;
+
+	V4L2DeviceFormat statFormat;
+	statFormat.fourcc = V4L2PixelFormat(V4L2_META_FMT_RK_ISP1_STAT_3A);
+	ret = stat_->setFormat(&statFormat);
+	if (ret)
+		return ret;
+
+	return configurePipeline(camera, config);
+}
+
+/*
+ * The sensor mode can be changed by stopping the data flow and applying the
+ * new sensor configuration. The links and the formats of the parameters and
+ * statistics video nodes are not affected, and their buffers stay allocated
+ * and mapped in the IPA.
+ *
+ * The IPA is reconfigured with the new sensor information through its
+ * configure() function, which resets the state of the algorithms. AGC and AWB
+ * thus restart from their initial state after a sensor mode change.
+ *
+ * \todo Add a mode switch operation to the IPA interface to preserve the state
+ * of the algorithms across sensor mode changes
+ */
+int PipelineHandlerRkISP1::reconfigure(Camera *camera, CameraConfiguration *c)
+{
+	RkISP1CameraConfiguration *config =
+		static_cast<RkISP1CameraConfiguration *>(c);
+	int ret;
+
+	stopStreaming(camera);
+
+	ret = configurePipeline(camera, config);
 	if (ret)
 		return ret;
 
+	return startStreaming(camera);
+}
+
+/*
+ * Apply the sensor format, propagate it through the ISP and the resizers to the
+ * capture video nodes, and configure the IPA accordingly. A new statistics
+ * capture file is started for every sensor configuration, as the capture files
+ * describe a single one.
+ */
+int PipelineHandlerRkISP1::configurePipeline(Camera *camera,
+					     RkISP1CameraConfiguration *config)
+{
+	RkISP1CameraData *data = cameraData(camera);
+	CameraSensor *sensor = data->sensor_.get();
+	int ret;
+
 	/*
 	 * Configure the format on the sensor output and propagate it through
 	 * the pipeline.
@@ -629,18 +703,6 @@ int PipelineHandlerRkISP1::configure(Camera *camera, CameraConfiguration *c)
 			return ret;
 	}
 
-	V4L2DeviceFormat paramFormat;
-	paramFormat.fourcc = V4L2PixelFormat(V4L2_META_FMT_RK_ISP1_PARAMS);
-	ret = param_->setFormat(&paramFormat);
-	if (ret)
-		return ret;
-
-	V4L2DeviceFormat statFormat;
-	statFormat.fourcc = V4L2PixelFormat(V4L2_META_FMT_RK_ISP1_STAT_3A);
-	ret = stat_->setFormat(&statFormat);
-	if (ret)
-		return ret;
-
 	/* Inform IPA of stream configuration and sensor controls. */
 	IPACameraSensorInfo sensorInfo = {};
 	ret = data->sensor_->sensorInfo(&sensorInfo);
@@ -659,6 +721,18 @@ int PipelineHandlerRkISP1::configure(Camera *camera, CameraConfiguration *c)
 		LOG(RkISP1, Error) << "failed configuring IPA (" << ret << ")";
 		return ret;
 	}
+
+	data->statsCapture_ = StatsCaptureWriter::create(name());
+	if (data->statsCapture_) {
+		const std::array<uint32_t, 1> pipelineConfig = {
+			media_->hwRevision(),
+		};
+
+		data->statsCapture_->writeSensorInfo(sensorInfo);
+		data->statsCapture_->writeControlInfo(0, data->sensor_->controls());
+		data->statsCapture_->writePipelineConfig(pipelineConfig);
+	}
+
 	return 0;
 }
 
@@ -724,6 +798,9 @@ int PipelineHandlerRkISP1::freeBuffers(Camera *camera)
 {
 	RkISP1CameraData *data = cameraData(camera);
 
+	if (data->statsCapture_)
+		data->statsCapture_->releaseBuffers();
+
 	while (!availableStatBuffers_.empty())
 		availableStatBuffers_.pop();
 
@@ -751,7 +828,6 @@ int PipelineHandlerRkISP1::freeBuffers(Camera *camera)
 
 int PipelineHandlerRkISP1::start(Camera *camera, [[maybe_unused]] const ControlList *controls)
 {
-	RkISP1CameraData *data = cameraData(camera);
 	int ret;
 
 	/* Allocate buffers for internal pipeline usage. */
@@ -759,20 +835,44 @@ int PipelineHandlerRkISP1::start(Camera *camera, [[maybe_unused]] const ControlL
 	if (ret)
 		return ret;
 
+	ret = startStreaming(camera);
+	if (ret)
+		freeBuffers(camera);
+
+	return ret;
+}
+
+void PipelineHandlerRkISP1::stopDevice(Camera *camera)
+{
+	stopStreaming(camera);
+
+	freeBuffers(camera);
+
+	activeCamera_ = nullptr;
+}
+
+int PipelineHandlerRkISP1::startStreaming(Camera *camera)
+{
+	RkISP1CameraData *data = cameraData(camera);
+	int ret;
+
 	ret = data->ipa_->start();
 	if (ret) {
-		freeBuffers(camera);
 		LOG(RkISP1, Error)
 			<< "Failed to start IPA " << camera->id();
 		return ret;
 	}
 
+	/*
+	 * Number frames from 0 on every start, including after a
+	 * reconfiguration. The IPA algorithms program the ISP blocks at frame
+	 * 0, and the IPA frame context queue is cleared when stopping.
+	 */
 	data->frame_ = 0;
 
 	ret = param_->streamOn();
 	if (ret) {
 		data->ipa_->stop();
-		freeBuffers(camera);
 		LOG(RkISP1, Error)
 			<< "Failed to start parameters " << camera->id();
 		return ret;
@@ -782,7 +882,6 @@ int PipelineHandlerRkISP1::start(Camera *camera, [[maybe_unused]] const ControlL
 	if (ret) {
 		param_->streamOff();
 		data->ipa_->stop();
-		freeBuffers(camera);
 		LOG(RkISP1, Error)
 			<< "Failed to start statistics " << camera->id();
 		return ret;
@@ -794,7 +893,6 @@ int PipelineHandlerRkISP1::start(Camera *camera, [[maybe_unused]] const ControlL
 			param_->streamOff();
 			stat_->streamOff();
 			data->ipa_->stop();
-			freeBuffers(camera);
 			return ret;
 		}
 	}
@@ -806,7 +904,6 @@ int PipelineHandlerRkISP1::start(Camera *camera, [[maybe_unused]] const ControlL
 			param_->streamOff();
 			stat_->streamOff();
 			data->ipa_->stop();
-			freeBuffers(camera);
 			return ret;
 		}
 	}
@@ -817,7 +914,7 @@ int PipelineHandlerRkISP1::start(Camera *camera, [[maybe_unused]] const ControlL
 	return ret;
 }
 
-void PipelineHandlerRkISP1::stopDevice(Camera *camera)
+void PipelineHandlerRkISP1::stopStreaming(Camera *camera)
 {
 	RkISP1CameraData *data = cameraData(camera);
 	int ret;
@@ -841,10 +938,6 @@ void PipelineHandlerRkISP1::stopDevice(Camera *camera)
 
 	ASSERT(data->queuedRequests_.empty());
 	data->frameInfo_.clear();
-
-	freeBuffers(camera);
-
-	activeCamera_ = nullptr;
 }
 
 int PipelineHandlerRkISP1::queueRequestDevice(Camera *camera, Request *request)
@@ -1052,7 +1145,7 @@ void PipelineHandlerRkISP1::tryCompleteRequest(Request *request)
 	if (!info->paramDequeued)
 		return;
 
-	data->frameInfo_.destroy(info->frame);
+	data->frameInfo_.destroy(info->id);
 
 	completeRequest(request);
 }
@@ -1105,8 +1198,22 @@ void PipelineHandlerRkISP1::statReady(FrameBuffer *buffer)
 	if (data->frame_ <= buffer->metadata().sequence)
 		data->frame_ = buffer->metadata().sequence + 1;
 
-	data->ipa_->processStatsBuffer(info->frame, info->statBuffer->cookie(),
-				       data->delayedCtrls_->get(buffer->metadata().sequence));
+	ControlList sensorControls = data->delayedCtrls_->get(buffer->metadata().sequence);
+
+	if (data->statsCapture_) {
+		uint64_t timestamp = buffer->metadata().timestamp;
+
+		data->statsCapture_->writeSensorControls(info->id, timestamp,
+							 sensorControls);
+		data->statsCapture_->writeBuffer(StatsCaptureRecordType::Params,
+						 info->id, timestamp,
+						 info->paramBuffer);
+		data->statsCapture_->writeBuffer(StatsCaptureRecordType::Statistics,
+						 info->id, timestamp, buffer);
+	}
+
+	data->ipa_->processStatsBuffer(info->id, info->statBuffer->cookie(),
+				       sensorControls);
 }
 
 REGISTER_PIPELINE_HANDLER(PipelineHandlerRkISP1)
@@ -29,10 +29,12 @@
 #include <libcamera/stream.h>
 
 #include "libcamera/internal/camera.h"
+#include "libcamera/internal/camera_telemetry.h"
 #include "libcamera/internal/camera_sensor.h"
 #include "libcamera/internal/device_enumerator.h"
 #include "libcamera/internal/media_device.h"
 #include "libcamera/internal/pipeline_handler.h"
+#include "libcamera/internal/underrun_guard.h"
 #include "libcamera/internal/v4l2_subdevice.h"
 #include "libcamera/internal/v4l2_videodevice.h"
 
@@ -225,6 +227,7 @@ public:
 	std::list<Entity> entities_;
 	std::unique_ptr<CameraSensor> sensor_;
 	V4L2VideoDevice *video_;
+	std::unique_ptr<UnderrunGuard> underrunGuard_;
 
 	std::vector<Configuration> configs_;
 	std::map<PixelFormat, const Configuration *> formats_;
@@ -442,6 +445,8 @@ int SimpleCameraData::init()
 	video_ = pipe->video(entities_.back().entity);
 	ASSERT(video_);
 
+	underrunGuard_ = std::make_unique<UnderrunGuard>(video_);
+
 	/*
 	 * Setup links first as some subdev drivers take active links into
 	 * account to propagate TRY formats. Such is life :-(
@@ -630,6 +635,12 @@ void SimpleCameraData::bufferReady(FrameBuffer *buffer)
 {
 	SimplePipelineHandler *pipe = SimpleCameraData::pipe();
 
+	if (!useConverter_ && underrunGuard_->bufferReady(buffer)) {
+		if (buffer->metadata().status == FrameMetadata::FrameSuccess)
+			telemetry()->frameAbsorbed(&streams_[0]);
+		return;
+	}
+
 	/*
 	 * If an error occurred during capture, or if the buffer was cancelled,
 	 * complete the request, even if the converter is in use as there's no
@@ -925,6 +936,9 @@ int SimplePipelineHandler::configure(Camera *camera, CameraConfiguration *c)
 	captureFormat.fourcc = videoFormat;
 	captureFormat.size = pipeConfig->captureSize;
 
+	/* The scratch buffers depend on the format, free them. */
+	data->underrunGuard_->clear();
+
 	ret = video->setFormat(&captureFormat);
 	if (ret)
 		return ret;
@@ -1008,9 +1022,13 @@ int SimplePipelineHandler::start(Camera *camera, [[maybe_unused]] const ControlL
 		ret = video->allocateBuffers(kNumInternalBuffers,
 					     &data->converterBuffers_);
 	} else {
-		/* Otherwise, prepare for using buffers from the only stream. */
+		/*
+		 * Otherwise, prepare for using buffers from the only stream,
+		 * and keep the device streaming with scratch buffers when the
+		 * application runs out of requests.
+		 */
 		Stream *stream = &data->streams_[0];
-		ret = video->importBuffers(stream->configuration().bufferCount);
+		ret = data->underrunGuard_->start(stream->configuration().bufferCount);
 	}
 	if (ret < 0) {
 		releasePipeline(data);
@@ -1049,7 +1067,10 @@ void SimplePipelineHandler::stopDevice(Camera *camera)
 		data->converter_->stop();
 
 	video->streamOff();
-	video->releaseBuffers();
+	if (data->useConverter_)
+		video->releaseBuffers();
+	else
+		data->underrunGuard_->stop();
 
 	video->bufferReady.disconnect(data, &SimpleCameraData::bufferReady);
 
@@ -1074,7 +1095,7 @@ int SimplePipelineHandler::queueRequestDevice(Camera *camera, Request *request)
 		if (data->useConverter_) {
 			buffers.emplace(data->streamIndex(stream), buffer);
 		} else {
-			ret = data->video_->queueBuffer(buffer);
+			ret = data->underrunGuard_->queueBuffer(buffer);
 			if (ret < 0)
 				return ret;
 		}
@@ -23,10 +23,12 @@
 #include <libcamera/stream.h>
 
 #include "libcamera/internal/camera.h"
+#include "libcamera/internal/camera_telemetry.h"
 #include "libcamera/internal/device_enumerator.h"
 #include "libcamera/internal/media_device.h"
 #include "libcamera/internal/pipeline_handler.h"
 #include "libcamera/internal/sysfs.h"
+#include "libcamera/internal/underrun_guard.h"
 #include "libcamera/internal/v4l2_videodevice.h"
 
 namespace libcamera {
@@ -47,6 +49,7 @@ public:
 	void bufferReady(FrameBuffer *buffer);
 
 	std::unique_ptr<V4L2VideoDevice> video_;
+	std::unique_ptr<UnderrunGuard> underrunGuard_;
 	Stream stream_;
 };
 
@@ -210,6 +213,9 @@ int PipelineHandlerUVC::configure(Camera *camera, CameraConfiguration *config)
 	format.fourcc = V4L2PixelFormat::fromPixelFormat(cfg.pixelFormat);
 	format.size = cfg.size;
 
+	/* The scratch buffers depend on the format, free them. */
+	data->underrunGuard_->clear();
+
 	ret = data->video_->setFormat(&format);
 	if (ret)
 		return ret;
@@ -237,13 +243,13 @@ int PipelineHandlerUVC::start(Camera *camera, [[maybe_unused]] const ControlList
 	UVCCameraData *data = cameraData(camera);
 	unsigned int count = data->stream_.configuration().bufferCount;
 
-	int ret = data->video_->importBuffers(count);
+	int ret = data->underrunGuard_->start(count);
 	if (ret < 0)
 		return ret;
 
 	ret = data->video_->streamOn();
 	if (ret < 0) {
-		data->video_->releaseBuffers();
+		data->underrunGuard_->stop();
 		return ret;
 	}
 
@@ -254,7 +260,7 @@ void PipelineHandlerUVC::stopDevice(Camera *camera)
 {
 	UVCCameraData *data = cameraData(camera);
 	data->video_->streamOff();
-	data->video_->releaseBuffers();
+	data->underrunGuard_->stop();
 }
 
 int PipelineHandlerUVC::processControl(ControlList *controls, unsigned int id,
@@ -378,7 +384,7 @@ int PipelineHandlerUVC::queueRequestDevice(Camera *camera, Request *request)
 	if (ret < 0)
 		return ret;
 
-	ret = data->video_->queueBuffer(buffer);
+	ret = data->underrunGuard_->queueBuffer(buffer);
 	if (ret < 0)
 		return ret;
 
@@ -503,6 +509,13 @@ int UVCCameraData::init(MediaDevice *media)
 
 	video_->bufferReady.connect(this, &UVCCameraData::bufferReady);
 
+	/*
+	 * Keep the camera streaming when the application runs out of requests,
+	 * as restarting the stream takes time and resets the camera's exposure
+	 * and white balance control loops.
+	 */
+	underrunGuard_ = std::make_unique<UnderrunGuard>(video_.get());
+
 	/*
 	 * \todo Find a way to tell internal and external UVC cameras apart.
 	 * Until then, treat all UVC cameras as external.
@@ -661,6 +674,12 @@ void UVCCameraData::addControl(uint32_t cid, const ControlInfo &v4l2Info,
 
 void UVCCameraData::bufferReady(FrameBuffer *buffer)
 {
+	if (underrunGuard_->bufferReady(buffer)) {
+		if (buffer->metadata().status == FrameMetadata::FrameSuccess)
+			telemetry()->frameAbsorbed(&stream_);
+		return;
+	}
+
 	Request *request = buffer->request();
 
 	/* \todo Use the UVC metadata to calculate a more precise timestamp */
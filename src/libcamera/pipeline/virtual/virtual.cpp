@@ -0,0 +1,671 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * virtual.cpp - Pipeline handler for virtual cameras
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <libcamera/base/log.h>
+#include <libcamera/base/timer.h>
+#include <libcamera/base/utils.h>
+
+#include <libcamera/camera.h>
+#include <libcamera/control_ids.h>
+#include <libcamera/controls.h>
+#include <libcamera/formats.h>
+#include <libcamera/property_ids.h>
+#include <libcamera/request.h>
+#include <libcamera/stream.h>
+
+#include "libcamera/internal/camera.h"
+#include "libcamera/internal/dma_buf_allocator.h"
+#include "libcamera/internal/formats.h"
+#include "libcamera/internal/framebuffer.h"
+#include "libcamera/internal/mapped_framebuffer.h"
+#include "libcamera/internal/pipeline_handler.h"
+#include "libcamera/internal/request.h"
+
+namespace libcamera {
+
+LOG_DEFINE_CATEGORY(Virtual)
+
+namespace {
+
+constexpr Size kMinSize{ 64, 64 };
+constexpr unsigned int kBufferCount = 4;
+constexpr int64_t kMaxFrameDuration = 1000000;
+
+const std::vector<PixelFormat> kPixelFormats = {
+	formats::NV12,
+	formats::XRGB8888,
+};
+
+struct VirtualCameraConfig {
+	Size resolution;
+	unsigned int frameRate;
+};
+
+/*
+ * Parse the LIBCAMERA_VIRTUAL_CAMERAS environment variable, a comma-separated
+ * list of "<width>x<height>[@<fps>]" camera descriptions. A frame rate of 0
+ * produces frames as fast as requests are queued.
+ */
+std::vector<VirtualCameraConfig> parseConfig(const char *spec)
+{
+	std::vector<VirtualCameraConfig> configs;
+
+	for (const std::string &entry : utils::split(spec, ",")) {
+		if (entry.empty())
+			continue;
+
+		unsigned int width;
+		unsigned int height;
+		unsigned int frameRate = 30;
+		char end;
+
+		int ret = sscanf(entry.c_str(), "%ux%u@%u%c", &width, &height,
+				 &frameRate, &end);
+		if (ret < 2 || ret > 3 || width < kMinSize.width ||
+		    height < kMinSize.height) {
+			LOG(Virtual, Error)
+				<< "Invalid virtual camera description '"
+				<< entry << "'";
+			continue;
+		}
+
+		configs.push_back({ Size(width, height).alignedDownTo(2, 2),
+				    frameRate });
+	}
+
+	return configs;
+}
+
+} /* namespace */
+
+class VirtualCameraData : public Camera::Private
+{
+public:
+	VirtualCameraData(PipelineHandler *pipe, const VirtualCameraConfig &config)
+		: Camera::Private(pipe), config_(config), running_(false)
+	{
+	}
+
+	void init(unsigned int index);
+
+	void generatePattern(const StreamConfiguration &cfg);
+	int queueRequest(Request *request);
+	void frameTimeout();
+	void processRequests();
+	void cancelRequests();
+	void applyControls(const ControlList &controls);
+
+	VirtualCameraConfig config_;
+	Stream stream_;
+
+	Timer timer_;
+	bool running_;
+	bool scheduled_;
+
+	uint32_t sequence_;
+	int64_t frameDuration_;
+	utils::time_point deadline_;
+
+	int32_t exposureTime_;
+	float analogueGain_;
+	int32_t testPatternMode_;
+
+private:
+	void completeFrame(Request *request, uint64_t timestamp);
+
+	std::deque<Request *> pendingRequests_;
+
+	std::vector<std::vector<uint8_t>> pattern_;
+	std::map<const FrameBuffer *, std::unique_ptr<MappedFrameBuffer>> mappedBuffers_;
+};
+
+class VirtualCameraConfiguration : public CameraConfiguration
+{
+public:
+	VirtualCameraConfiguration(VirtualCameraData *data);
+
+	Status validate() override;
+
+private:
+	VirtualCameraData *data_;
+};
+
+class PipelineHandlerVirtual : public PipelineHandler
+{
+public:
+	PipelineHandlerVirtual(CameraManager *manager);
+	~PipelineHandlerVirtual();
+
+	CameraConfiguration *generateConfiguration(Camera *camera,
+		const StreamRoles &roles) override;
+	int configure(Camera *camera, CameraConfiguration *config) override;
+	int reconfigure(Camera *camera, CameraConfiguration *config) override;
+
+	int exportFrameBuffers(Camera *camera, Stream *stream,
+			       std::vector<std::unique_ptr<FrameBuffer>> *buffers) override;
+
+	int start(Camera *camera, const ControlList *controls) override;
+	void stopDevice(Camera *camera) override;
+
+	int queueRequestDevice(Camera *camera, Request *request) override;
+
+	bool match(DeviceEnumerator *enumerator) override;
+
+private:
+	VirtualCameraData *cameraData(Camera *camera)
+	{
+		return static_cast<VirtualCameraData *>(camera->_d());
+	}
+
+	void processRequests(VirtualCameraData *data);
+
+	/*
+	 * Each pipeline handler instance registers a single camera, as the
+	 * camera lock is handled per pipeline handler. Track the cameras
+	 * registered by all instances.
+	 */
+	static std::set<unsigned int> registeredCameras_;
+
+	unsigned int index_;
+	bool registered_;
+
+	DmaBufAllocator allocator_;
+};
+
+std::set<unsigned int> PipelineHandlerVirtual::registeredCameras_;
+
+void VirtualCameraData::init(unsigned int index)
+{
+	timer_.timeout.connect(this, &VirtualCameraData::frameTimeout);
+
+	frameDuration_ = config_.frameRate ? 1000000 / config_.frameRate : 0;
+	exposureTime_ = std::max<int64_t>(frameDuration_, 1000);
+	analogueGain_ = 1.0f;
+	testPatternMode_ = controls::draft::TestPatternModeColorBars;
+
+	properties_.set(properties::Location, properties::CameraLocationExternal);
+	properties_.set(properties::Model, "Virtual Camera " + std::to_string(index));
+	properties_.set(properties::PixelArraySize, config_.resolution);
+	properties_.set(properties::PixelArrayActiveAreas,
+			{ Rectangle(config_.resolution) });
+
+	ControlInfoMap::Map ctrls;
+
+	ctrls[&controls::ExposureTime] =
+		ControlInfo(1, static_cast<int32_t>(kMaxFrameDuration), exposureTime_);
+	ctrls[&controls::AnalogueGain] = ControlInfo(1.0f, 16.0f, 1.0f);
+	ctrls[&controls::FrameDurationLimits] =
+		ControlInfo(int64_t(0), kMaxFrameDuration, frameDuration_);
+	std::vector<ControlValue> testPatternModes = {
+		static_cast<int32_t>(controls::draft::TestPatternModeOff),
+		static_cast<int32_t>(controls::draft::TestPatternModeColorBars),
+	};
+	ctrls[&controls::draft::TestPatternMode] = ControlInfo(testPatternModes);
+
+	controlInfo_ = ControlInfoMap(std::move(ctrls), controls::controls);
+}
+
+/*
+ * Render the frame used for the color bars test pattern. The pattern is
+ * rendered once per configuration and copied to the buffers, to keep the cost
+ * of frame generation as low as possible.
+ */
+void VirtualCameraData::generatePattern(const StreamConfiguration &cfg)
+{
+	/* White, yellow, cyan, green, magenta, red, blue and black. */
+	static const uint8_t rgb[8][3] = {
+		{ 255, 255, 255 }, { 255, 255, 0 }, { 0, 255, 255 }, { 0, 255, 0 },
+		{ 255, 0, 255 }, { 255, 0, 0 }, { 0, 0, 255 }, { 0, 0, 0 },
+	};
+
+	const PixelFormatInfo &info = PixelFormatInfo::info(cfg.pixelFormat);
+	const Size &size = cfg.size;
+
+	pattern_.clear();
+	for (unsigned int i = 0; i < info.numPlanes(); ++i)
+		pattern_.emplace_back(info.planeSize(size, i, 1));
+
+	for (unsigned int x = 0; x < size.width; ++x) {
+		const uint8_t *color = rgb[x * 8 / size.width];
+		uint8_t r = color[0];
+		uint8_t g = color[1];
+		uint8_t b = color[2];
+
+		if (cfg.pixelFormat == formats::XRGB8888) {
+			for (unsigned int y = 0; y < size.height; ++y) {
+				uint8_t *pixel = &pattern_[0][y * cfg.stride + x * 4];
+				pixel[0] = b;
+				pixel[1] = g;
+				pixel[2] = r;
+				pixel[3] = 0xff;
+			}
+
+			continue;
+		}
+
+		/* BT.601 limited range YCbCr. */
+		uint8_t luma = (66 * r + 129 * g + 25 * b + 128) / 256 + 16;
+		uint8_t cb = (-38 * r - 74 * g + 112 * b + 128) / 256 + 128;
+		uint8_t cr = (112 * r - 94 * g - 18 * b + 128) / 256 + 128;
+
+		for (unsigned int y = 0; y < size.height; ++y)
+			pattern_[0][y * cfg.stride + x] = luma;
+
+		for (unsigned int y = 0; y < size.height / 2; ++y)
+			pattern_[1][y * cfg.stride + x] = x & 1 ? cr : cb;
+	}
+}
+
+int VirtualCameraData::queueRequest(Request *request)
+{
+	FrameBuffer *buffer = request->findBuffer(&stream_);
+	if (!buffer) {
+		LOG(Virtual, Error)
+			<< "Attempt to queue request with invalid stream";
+		return -ENOENT;
+	}
+
+	if (testPatternMode_ != controls::draft::TestPatternModeOff ||
+	    request->controls().contains(controls::draft::TestPatternMode)) {
+		/* Map the buffer once, the mappings are kept until stop. */
+		auto iter = mappedBuffers_.find(buffer);
+		if (iter == mappedBuffers_.end()) {
+			auto mapped = std::make_unique<MappedFrameBuffer>(
+				buffer, MappedFrameBuffer::MapFlag::Write);
+			if (!mapped->isValid()) {
+				LOG(Virtual, Error) << "Failed to map buffer";
+				return -ENOMEM;
+			}
+
+			mappedBuffers_[buffer] = std::move(mapped);
+		}
+	}
+
+	pendingRequests_.push_back(request);
+
+	return 0;
+}
+
+void VirtualCameraData::frameTimeout()
+{
+	utils::time_point now = utils::clock::now();
+	uint64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		deadline_.time_since_epoch()).count();
+
+	if (!pendingRequests_.empty()) {
+		Request *request = pendingRequests_.front();
+		pendingRequests_.pop_front();
+		completeFrame(request, timestamp);
+	} else {
+		/* Frames without a request are lost, as with a real sensor. */
+		sequence_++;
+	}
+
+	if (!running_)
+		return;
+
+	if (!frameDuration_) {
+		processRequests();
+		return;
+	}
+
+	/* Drop the frames the timer has missed instead of accumulating. */
+	deadline_ += std::chrono::microseconds(frameDuration_);
+	while (deadline_ < now) {
+		deadline_ += std::chrono::microseconds(frameDuration_);
+		sequence_++;
+	}
+
+	timer_.start(deadline_);
+}
+
+/*
+ * Complete all pending requests immediately, when the camera runs without a
+ * frame rate limit.
+ */
+void VirtualCameraData::processRequests()
+{
+	scheduled_ = false;
+
+	if (!running_ || frameDuration_) {
+		if (running_ && !timer_.isRunning()) {
+			deadline_ = utils::clock::now() +
+				    std::chrono::microseconds(frameDuration_);
+			timer_.start(deadline_);
+		}
+		return;
+	}
+
+	while (!pendingRequests_.empty()) {
+		Request *request = pendingRequests_.front();
+		pendingRequests_.pop_front();
+
+		uint64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			utils::clock::now().time_since_epoch()).count();
+		completeFrame(request, timestamp);
+
+		/*
+		 * The request may have set a frame duration, pace the next
+		 * frames with the timer from now on.
+		 */
+		if (running_ && frameDuration_) {
+			deadline_ = utils::clock::now() +
+				    std::chrono::microseconds(frameDuration_);
+			timer_.start(deadline_);
+			return;
+		}
+	}
+}
+
+void VirtualCameraData::cancelRequests()
+{
+	while (!pendingRequests_.empty()) {
+		Request *request = pendingRequests_.front();
+		pendingRequests_.pop_front();
+
+		request->_d()->cancel();
+		pipe()->completeRequest(request);
+	}
+
+	mappedBuffers_.clear();
+}
+
+void VirtualCameraData::applyControls(const ControlList &controls)
+{
+	if (controls.contains(controls::ExposureTime))
+		exposureTime_ = std::clamp(controls.get(controls::ExposureTime),
+					   1, static_cast<int32_t>(kMaxFrameDuration));
+
+	if (controls.contains(controls::AnalogueGain))
+		analogueGain_ = std::clamp(controls.get(controls::AnalogueGain),
+					   1.0f, 16.0f);
+
+	if (controls.contains(controls::draft::TestPatternMode))
+		testPatternMode_ = controls.get(controls::draft::TestPatternMode);
+
+	if (controls.contains(controls::FrameDurationLimits)) {
+		const auto &limits = controls.get(controls::FrameDurationLimits);
+		if (limits.size() == 2)
+			frameDuration_ = std::clamp<int64_t>(limits[0], 0,
+							     kMaxFrameDuration);
+	}
+}
+
+void VirtualCameraData::completeFrame(Request *request, uint64_t timestamp)
+{
+	applyControls(request->controls());
+
+	FrameBuffer *buffer = request->findBuffer(&stream_);
+
+	if (testPatternMode_ == controls::draft::TestPatternModeColorBars) {
+		auto iter = mappedBuffers_.find(buffer);
+		if (iter != mappedBuffers_.end()) {
+			const std::vector<Span<uint8_t>> &planes = iter->second->planes();
+			for (unsigned int i = 0; i < planes.size() && i < pattern_.size(); ++i)
+				memcpy(planes[i].data(), pattern_[i].data(),
+				       std::min(planes[i].size(), pattern_[i].size()));
+		}
+	}
+
+	FrameMetadata &metadata = buffer->_d()->metadata();
+	metadata.status = FrameMetadata::FrameSuccess;
+	metadata.sequence = sequence_++;
+	metadata.timestamp = timestamp;
+
+	for (unsigned int i = 0; i < buffer->planes().size(); ++i)
+		metadata.planes()[i].bytesused = buffer->planes()[i].length;
+
+	ControlList &requestMetadata = request->metadata();
+	requestMetadata.set(controls::SensorTimestamp, static_cast<int64_t>(timestamp));
+	requestMetadata.set(controls::FrameDuration, frameDuration_);
+	requestMetadata.set(controls::ExposureTime, exposureTime_);
+	requestMetadata.set(controls::AnalogueGain, analogueGain_);
+	requestMetadata.set(controls::draft::TestPatternMode, testPatternMode_);
+
+	pipe()->completeBuffer(request, buffer);
+	pipe()->completeRequest(request);
+}
+
+VirtualCameraConfiguration::VirtualCameraConfiguration(VirtualCameraData *data)
+	: CameraConfiguration(), data_(data)
+{
+}
+
+CameraConfiguration::Status VirtualCameraConfiguration::validate()
+{
+	Status status = Valid;
+
+	if (config_.empty())
+		return Invalid;
+
+	if (transform != Transform::Identity) {
+		transform = Transform::Identity;
+		status = Adjusted;
+	}
+
+	/* Cap the number of entries to the available streams. */
+	if (config_.size() > 1) {
+		config_.resize(1);
+		status = Adjusted;
+	}
+
+	StreamConfiguration &cfg = config_[0];
+
+	if (std::find(kPixelFormats.begin(), kPixelFormats.end(),
+		      cfg.pixelFormat) == kPixelFormats.end()) {
+		cfg.pixelFormat = kPixelFormats.front();
+		status = Adjusted;
+	}
+
+	const Size &resolution = data_->config_.resolution;
+	Size size = cfg.size.boundedTo(resolution).expandedTo(kMinSize)
+			    .alignedDownTo(2, 2);
+	if (cfg.size != size) {
+		LOG(Virtual, Debug)
+			<< "Adjusting size from " << cfg.size.toString()
+			<< " to " << size.toString();
+		cfg.size = size;
+		status = Adjusted;
+	}
+
+	if (!cfg.bufferCount) {
+		cfg.bufferCount = kBufferCount;
+		status = Adjusted;
+	}
+
+	const PixelFormatInfo &info = PixelFormatInfo::info(cfg.pixelFormat);
+	cfg.stride = info.stride(cfg.size.width, 0, 1);
+	cfg.frameSize = info.frameSize(cfg.size, 1);
+
+	return status;
+}
+
+PipelineHandlerVirtual::PipelineHandlerVirtual(CameraManager *manager)
+	: PipelineHandler(manager), index_(0), registered_(false),
+	  allocator_(DmaBufAllocator::DmaBufAllocatorFlag::MemFd)
+{
+}
+
+PipelineHandlerVirtual::~PipelineHandlerVirtual()
+{
+	if (registered_)
+		registeredCameras_.erase(index_);
+}
+
+CameraConfiguration *PipelineHandlerVirtual::generateConfiguration(Camera *camera,
+	const StreamRoles &roles)
+{
+	VirtualCameraData *data = cameraData(camera);
+	CameraConfiguration *config = new VirtualCameraConfiguration(data);
+
+	if (roles.empty())
+		return config;
+
+	std::map<PixelFormat, std::vector<SizeRange>> streamFormats;
+	for (const PixelFormat &pixelFormat : kPixelFormats)
+		streamFormats[pixelFormat] = {
+			SizeRange(kMinSize, data->config_.resolution, 2, 2)
+		};
+
+	StreamConfiguration cfg{ StreamFormats(streamFormats) };
+	cfg.pixelFormat = kPixelFormats.front();
+	cfg.size = data->config_.resolution;
+	cfg.bufferCount = kBufferCount;
+
+	config->addConfiguration(cfg);
+
+	config->validate();
+
+	return config;
+}
+
+int PipelineHandlerVirtual::configure(Camera *camera, CameraConfiguration *config)
+{
+	VirtualCameraData *data = cameraData(camera);
+	StreamConfiguration &cfg = config->at(0);
+
+	cfg.setStream(&data->stream_);
+	data->generatePattern(cfg);
+
+	return 0;
+}
+
+int PipelineHandlerVirtual::reconfigure([[maybe_unused]] Camera *camera,
+					[[maybe_unused]] CameraConfiguration *config)
+{
+	/*
+	 * Virtual cameras have a single sensor mode and the streams can't
+	 * change, there's nothing to reconfigure. Keep capturing without
+	 * dropping any frame.
+	 */
+	return 0;
+}
+
+int PipelineHandlerVirtual::exportFrameBuffers([[maybe_unused]] Camera *camera,
+					       Stream *stream,
+					       std::vector<std::unique_ptr<FrameBuffer>> *buffers)
+{
+	const StreamConfiguration &cfg = stream->configuration();
+	const PixelFormatInfo &info = PixelFormatInfo::info(cfg.pixelFormat);
+
+	std::vector<unsigned int> planeSizes;
+	for (unsigned int i = 0; i < info.numPlanes(); ++i)
+		planeSizes.push_back(info.planeSize(cfg.size, i, 1));
+
+	return allocator_.exportBuffers(cfg.bufferCount, planeSizes, buffers);
+}
+
+int PipelineHandlerVirtual::start(Camera *camera, const ControlList *controls)
+{
+	VirtualCameraData *data = cameraData(camera);
+
+	data->frameDuration_ = data->config_.frameRate
+			     ? 1000000 / data->config_.frameRate : 0;
+	if (controls)
+		data->applyControls(*controls);
+
+	data->sequence_ = 0;
+	data->running_ = true;
+	data->scheduled_ = false;
+
+	if (data->frameDuration_) {
+		data->deadline_ = utils::clock::now() +
+				  std::chrono::microseconds(data->frameDuration_);
+		data->timer_.start(data->deadline_);
+	}
+
+	return 0;
+}
+
+void PipelineHandlerVirtual::stopDevice(Camera *camera)
+{
+	VirtualCameraData *data = cameraData(camera);
+
+	data->running_ = false;
+	data->timer_.stop();
+	data->cancelRequests();
+}
+
+int PipelineHandlerVirtual::queueRequestDevice(Camera *camera, Request *request)
+{
+	VirtualCameraData *data = cameraData(camera);
+
+	int ret = data->queueRequest(request);
+	if (ret < 0)
+		return ret;
+
+	/*
+	 * Without a frame rate limit, complete requests asynchronously from
+	 * the event loop, as a device would.
+	 */
+	if (!data->scheduled_ && !data->timer_.isRunning()) {
+		data->scheduled_ = true;
+		invokeMethod(&PipelineHandlerVirtual::processRequests,
+			     ConnectionTypeQueued, data);
+	}
+
+	return 0;
+}
+
+void PipelineHandlerVirtual::processRequests(VirtualCameraData *data)
+{
+	data->processRequests();
+}
+
+bool PipelineHandlerVirtual::match([[maybe_unused]] DeviceEnumerator *enumerator)
+{
+	const char *spec = utils::secure_getenv("LIBCAMERA_VIRTUAL_CAMERAS");
+	if (!spec)
+		return false;
+
+	std::vector<VirtualCameraConfig> configs = parseConfig(spec);
+
+	/* Register the first camera not registered by another instance. */
+	unsigned int index;
+	for (index = 0; index < configs.size(); ++index) {
+		if (!registeredCameras_.count(index))
+			break;
+	}
+
+	if (index == configs.size())
+		return false;
+
+	std::unique_ptr<VirtualCameraData> data =
+		std::make_unique<VirtualCameraData>(this, configs[index]);
+	data->init(index);
+
+	index_ = index;
+	registered_ = true;
+	registeredCameras_.insert(index);
+
+	std::string id = "Virtual/" + std::to_string(index);
+	std::set<Stream *> streams{ &data->stream_ };
+	std::shared_ptr<Camera> camera =
+		Camera::create(std::move(data), id, streams);
+	registerCamera(std::move(camera));
+
+	LOG(Virtual, Info)
+		<< "Registered virtual camera " << id << " ("
+		<< configs[index].resolution.toString() << "@"
+		<< configs[index].frameRate << ")";
+
+	return true;
+}
+
+REGISTER_PIPELINE_HANDLER(PipelineHandlerVirtual)
+
+} /* namespace libcamera */
@@ -19,6 +19,7 @@
 #include <libcamera/framebuffer.h>
 
 #include "libcamera/internal/camera.h"
+#include "libcamera/internal/camera_telemetry.h"
 #include "libcamera/internal/device_enumerator.h"
 #include "libcamera/internal/framebuffer.h"
 #include "libcamera/internal/media_device.h"
@@ -68,7 +69,7 @@ LOG_DEFINE_CATEGORY(Pipeline)
  * respective factories.
  */
 PipelineHandler::PipelineHandler(CameraManager *manager)
-	: manager_(manager), lockOwner_(false)
+	: manager_(manager), batching_(false), lockOwner_(false)
 {
 }
 
@@ -221,6 +222,59 @@ void PipelineHandler::unlock()
  * passed to the caller.
  */
 
+/**
+ * \brief Validate a list of candidate configurations for a single stream
+ * \param[in] camera The camera to validate the configurations for
+ * \param[in] role The stream role the candidates are intended for
+ * \param[inout] candidates The candidate stream configurations
+ *
+ * Validate each of the \a candidates as the sole stream of a configuration for
+ * the \a camera. Only the pixel format and size of the candidates are
+ * considered, all other parameters are set to the default values generated for
+ * the \a role. Each candidate is updated with the configuration adjusted by
+ * the validation.
+ *
+ * The default implementation generates a single camera configuration for
+ * the \a role and validates all candidates through it, which allows
+ * CameraConfiguration implementations to reuse the results of the
+ * validation of previous candidates, such as the sensor format selection.
+ * Pipeline handlers can override this function when they can share more work
+ * between the candidates.
+ *
+ * \context This function may be called from any thread and shall be
+ * \threadsafe. It shall not modify the state of the \a camera in the pipeline
+ * handler.
+ *
+ * \return The validation status of each candidate, in the same order as the
+ * \a candidates
+ */
+std::vector<CameraConfiguration::Status>
+PipelineHandler::validateConfigurations(Camera *camera, StreamRole role,
+					std::vector<StreamConfiguration> &candidates)
+{
+	std::vector<CameraConfiguration::Status> statuses(candidates.size(),
+							  CameraConfiguration::Invalid);
+
+	std::unique_ptr<CameraConfiguration> config(generateConfiguration(camera, { role }));
+	if (!config || config->size() != 1)
+		return statuses;
+
+	const StreamConfiguration defaults = config->at(0);
+
+	for (unsigned int i = 0; i < candidates.size(); ++i) {
+		StreamConfiguration &cfg = config->at(0);
+
+		cfg = defaults;
+		cfg.pixelFormat = candidates[i].pixelFormat;
+		cfg.size = candidates[i].size;
+
+		statuses[i] = config->validate();
+		candidates[i] = cfg;
+	}
+
+	return statuses;
+}
+
 /**
  * \fn PipelineHandler::configure()
  * \brief Configure a group of streams for capture
@@ -246,6 +300,35 @@ void PipelineHandler::unlock()
  * \return 0 on success or a negative error code otherwise
  */
 
+/**
+ * \brief Change the configuration of a running camera
+ * \param[in] camera The camera to reconfigure
+ * \param[in] config The new camera configuration
+ *
+ * Apply a new configuration to a running \a camera without stopping it. The
+ * intended caller of this function is Camera::reconfigure(), which guarantees
+ * that \a config has been validated and that its stream configurations are
+ * identical to the active ones. Only the parameters that don't affect the
+ * streams, such as CameraConfiguration::sensorConfig, may thus differ from the
+ * current configuration.
+ *
+ * Pipeline handlers shall preserve the buffers allocated for the streams, and
+ * should preserve their internal buffers and the IPA state. Requests queued to
+ * the device may be cancelled, but requests shall keep completing in order.
+ *
+ * The default implementation doesn't support reconfiguration and returns
+ * -ENOTSUP without affecting the camera.
+ *
+ * \context This function is called from the CameraManager thread.
+ *
+ * \return 0 on success or a negative error code otherwise
+ */
+int PipelineHandler::reconfigure([[maybe_unused]] Camera *camera,
+				 [[maybe_unused]] CameraConfiguration *config)
+{
+	return -ENOTSUP;
+}
+
 /**
  * \fn PipelineHandler::exportFrameBuffers()
  * \brief Allocate and export buffers for \a stream
@@ -386,6 +469,37 @@ void PipelineHandler::queueRequest(Request *request)
 	request->_d()->prepare(300ms);
 }
 
+/**
+ * \fn PipelineHandler::queueRequests()
+ * \brief Queue a batch of requests
+ * \param[in] requests The requests to queue
+ *
+ * This function queues all the capture \a requests to the pipeline handler for
+ * processing, in order. It behaves as if queueRequest() was called for each
+ * request, but requests that are prepared immediately are only passed to the
+ * pipeline handler once the whole batch has been added to the list of waiting
+ * requests. All requests that are ready are thus queued to the device in a
+ * single pass.
+ *
+ * \context This function is called from the CameraManager thread.
+ */
+void PipelineHandler::queueRequests(const std::vector<Request *> &requests)
+{
+	batching_ = true;
+
+	for (Request *request : requests) {
+		LIBCAMERA_TRACEPOINT(request_queue, request);
+
+		waitingRequests_.push(request);
+
+		request->_d()->prepare(300ms);
+	}
+
+	batching_ = false;
+
+	doQueueRequests();
+}
+
 /**
  * \brief Queue one requests to the device
  */
@@ -415,10 +529,16 @@ void PipelineHandler::doQueueRequest(Request *request)
  * \brief Queue prepared requests to the device
  *
  * Iterate the list of waiting requests and queue them to the device one
- * by one if they have been prepared.
+ * by one if they have been prepared. When called while a batch of requests is
+ * being added by queueRequests(), queuing is deferred until the end of the
+ * batch.
  */
 void PipelineHandler::doQueueRequests()
 {
+	/* Defer queuing until the whole batch has been prepared. */
+	if (batching_)
+		return;
+
 	while (!waitingRequests_.empty()) {
 		Request *request = waitingRequests_.front();
 		if (!request->_d()->prepared_)
@@ -499,6 +619,7 @@ void PipelineHandler::completeRequest(Request *request)
 
 		ASSERT(!req->hasPendingBuffers());
 		data->queuedRequests_.pop_front();
+		data->telemetry()->requestCompleted(req, data->queuedRequests_.empty());
 		camera->requestComplete(req);
 	}
 }
@@ -516,13 +637,10 @@ void PipelineHandler::registerCamera(std::shared_ptr<Camera> camera)
 {
 	cameras_.push_back(camera);
 
-	if (mediaDevices_.empty())
-		LOG(Pipeline, Fatal)
-			<< "Registering camera with no media devices!";
-
 	/*
 	 * Walk the entity list and map the devnums of all capture video nodes
-	 * to the camera.
+	 * to the camera. Virtual cameras have no media device, and are thus
+	 * not associated with any devnum.
 	 */
 	std::vector<dev_t> devnums;
 	for (const std::shared_ptr<MediaDevice> &media : mediaDevices_) {
@@ -0,0 +1,552 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * stats_capture.cpp - ISP statistics capture file format
+ */
+
+#include "libcamera/internal/stats_capture.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <libcamera/base/log.h>
+#include <libcamera/base/utils.h>
+
+#include <libcamera/ipa/core_ipa_serializer.h>
+
+#include "libcamera/internal/byte_stream_buffer.h"
+
+/**
+ * \file stats_capture.h
+ * \brief ISP statistics capture file format
+ *
+ * Statistics capture files store the data exchanged between a pipeline
+ * handler and its IPA module for every frame, in order to replay it offline
+ * through the IPA algorithms. A file starts with a StatsCaptureHeader,
+ * followed by a sequence of records. Each record is made of a
+ * StatsCaptureRecordHeader immediately followed by \a size bytes of payload.
+ *
+ * The records that describe the camera configuration (SensorInfo,
+ * ControlInfo and PipelineConfig) are stored before the per-frame records
+ * that depend on them. All fields are stored in native endianness, as the
+ * files are meant to be replayed with the IPA modules of the platform they
+ * have been captured on.
+ *
+ * Capture files are written by the StatsCaptureWriter, which pipeline handlers
+ * create when the LIBCAMERA_STATS_CAPTURE_DIR environment variable is set.
+ */
+
+namespace libcamera {
+
+LOG_DEFINE_CATEGORY(StatsCapture)
+
+/**
+ * \struct StatsCaptureHeader
+ * \brief Header of a statistics capture file
+ *
+ * \var StatsCaptureHeader::kMagic
+ * \brief Magic number identifying a statistics capture file
+ *
+ * \var StatsCaptureHeader::kVersion
+ * \brief Version of the file format described in this file
+ *
+ * \var StatsCaptureHeader::magic
+ * \brief Magic number, set to kMagic
+ *
+ * \var StatsCaptureHeader::version
+ * \brief Version of the file format
+ *
+ * \var StatsCaptureHeader::pipeline
+ * \brief Null-terminated name of the pipeline handler that captured the file
+ */
+
+/**
+ * \enum StatsCaptureRecordType
+ * \brief Type of a record in a statistics capture file
+ *
+ * \var StatsCaptureRecordType::SensorInfo
+ * \brief The IPACameraSensorInfo of the camera, serialized with the
+ * IPADataSerializer
+ *
+ * \var StatsCaptureRecordType::ControlInfo
+ * \brief The ControlInfoMap of a device, serialized with a ControlSerializer.
+ * The record sequence holds the pipeline-specific entity number used for the
+ * map in the IPA configure() call (0 for the camera sensor)
+ *
+ * \var StatsCaptureRecordType::PipelineConfig
+ * \brief Pipeline-specific IPA configuration parameters, stored as an array
+ * of 32-bit words
+ *
+ * \var StatsCaptureRecordType::SensorControls
+ * \brief The sensor controls applied to a frame, serialized with a
+ * ControlSerializer and associated with the ControlInfo of entity 0
+ *
+ * \var StatsCaptureRecordType::Params
+ * \brief The raw content of the ISP parameters buffer for a frame
+ *
+ * \var StatsCaptureRecordType::Statistics
+ * \brief The raw content of the ISP statistics buffer for a frame
+ */
+
+/**
+ * \struct StatsCaptureRecordHeader
+ * \brief Header of a record in a statistics capture file
+ *
+ * \var StatsCaptureRecordHeader::type
+ * \brief The record type, as a StatsCaptureRecordType
+ *
+ * \var StatsCaptureRecordHeader::sequence
+ * \brief The frame sequence number, or a type-specific value for records not
+ * related to a frame
+ *
+ * \var StatsCaptureRecordHeader::timestamp
+ * \brief The frame timestamp in nanoseconds, or 0 for records not related to
+ * a frame
+ *
+ * \var StatsCaptureRecordHeader::size
+ * \brief The size of the record payload in bytes
+ *
+ * \var StatsCaptureRecordHeader::reserved
+ * \brief Reserved for future use, set to 0
+ */
+
+/**
+ * \struct StatsCaptureRecord
+ * \brief A record read from a statistics capture file
+ *
+ * \var StatsCaptureRecord::type
+ * \brief The record type
+ *
+ * \var StatsCaptureRecord::sequence
+ * \brief The frame sequence number, or a type-specific value
+ *
+ * \var StatsCaptureRecord::timestamp
+ * \brief The frame timestamp in nanoseconds
+ *
+ * \var StatsCaptureRecord::data
+ * \brief The record payload
+ */
+
+/**
+ * \class StatsCaptureReader
+ * \brief Sequential reader for statistics capture files
+ *
+ * The StatsCaptureReader opens a statistics capture file, validates its
+ * header, and returns the records it contains one by one in file order.
+ */
+
+StatsCaptureReader::StatsCaptureReader()
+{
+}
+
+/**
+ * \brief Open a statistics capture file
+ * \param[in] path The path to the file
+ *
+ * \return 0 on success or a negative error code otherwise
+ */
+int StatsCaptureReader::open(const std::string &path)
+{
+	close();
+
+	file_.setFileName(path);
+	if (!file_.open(File::OpenModeFlag::ReadOnly)) {
+		LOG(StatsCapture, Error)
+			<< "Failed to open " << path << ": "
+			<< strerror(-file_.error());
+		return file_.error();
+	}
+
+	StatsCaptureHeader header;
+	Span<uint8_t> data(reinterpret_cast<uint8_t *>(&header), sizeof(header));
+	if (file_.read(data) != sizeof(header) ||
+	    header.magic != StatsCaptureHeader::kMagic) {
+		LOG(StatsCapture, Error) << path << " is not a capture file";
+		close();
+		return -EINVAL;
+	}
+
+	if (header.version != StatsCaptureHeader::kVersion) {
+		LOG(StatsCapture, Error)
+			<< "Unsupported capture file version " << header.version;
+		close();
+		return -EINVAL;
+	}
+
+	pipeline_ = std::string(header.pipeline,
+				strnlen(header.pipeline, sizeof(header.pipeline)));
+
+	return 0;
+}
+
+/**
+ * \brief Close the statistics capture file
+ */
+void StatsCaptureReader::close()
+{
+	file_.close();
+	pipeline_.clear();
+}
+
+/**
+ * \fn StatsCaptureReader::pipeline()
+ * \brief Retrieve the name of the pipeline handler that captured the file
+ * \return The pipeline handler name
+ */
+
+/**
+ * \brief Read the next record from the file
+ * \param[out] record The record
+ *
+ * \return 0 on success, -ENODATA when the end of the file has been reached,
+ * or another negative error code otherwise
+ */
+int StatsCaptureReader::read(StatsCaptureRecord *record)
+{
+	if (!file_.isOpen())
+		return -EBADF;
+
+	StatsCaptureRecordHeader header;
+	Span<uint8_t> data(reinterpret_cast<uint8_t *>(&header), sizeof(header));
+	ssize_t ret = file_.read(data);
+	if (ret == 0)
+		return -ENODATA;
+	if (ret != sizeof(header)) {
+		LOG(StatsCapture, Error) << "Truncated record header";
+		return ret < 0 ? ret : -EIO;
+	}
+
+	record->type = static_cast<StatsCaptureRecordType>(header.type);
+	record->sequence = header.sequence;
+	record->timestamp = header.timestamp;
+	record->data.resize(header.size);
+
+	ret = file_.read(record->data);
+	if (ret != header.size) {
+		LOG(StatsCapture, Error) << "Truncated record payload";
+		return ret < 0 ? ret : -EIO;
+	}
+
+	return 0;
+}
+
+/**
+ * \class StatsCaptureWriter
+ * \brief Background writer for statistics capture files
+ *
+ * The StatsCaptureWriter records the data exchanged between a pipeline handler
+ * and its IPA module to a statistics capture file. It is meant to be used on
+ * production systems, and thus must not delay the pipeline handler.
+ *
+ * Records are copied to a fixed-size single-producer single-consumer ring of
+ * slots, and written to the file by a dedicated thread. Queuing a record
+ * doesn't take any lock, and the slots' memory is reused once it has been
+ * allocated for the first frames. When the writer thread can't keep up and
+ * the ring is full, records are dropped instead of blocking the caller, and
+ * accounted for in dropped().
+ *
+ * All the write functions shall be called from the same thread, usually the
+ * pipeline handler thread.
+ */
+
+StatsCaptureWriter::StatsCaptureWriter()
+	: head_(0), tail_(0), stopping_(false), dropped_(0),
+	  serializer_(ControlSerializer::Role::Proxy)
+{
+}
+
+StatsCaptureWriter::~StatsCaptureWriter()
+{
+	close();
+}
+
+/**
+ * \brief Create a writer if statistics capture is enabled
+ * \param[in] pipeline The name of the pipeline handler
+ *
+ * Statistics capture is enabled by setting the LIBCAMERA_STATS_CAPTURE_DIR
+ * environment variable to the directory where capture files shall be stored.
+ * A new file, named after the pipeline handler, the process ID and a counter,
+ * is created for every call.
+ *
+ * \return A writer with an open capture file, or nullptr if statistics capture
+ * is disabled or the file can't be created
+ */
+std::unique_ptr<StatsCaptureWriter> StatsCaptureWriter::create(const std::string &pipeline)
+{
+	static std::atomic<unsigned int> index = 0;
+
+	const char *dir = utils::secure_getenv("LIBCAMERA_STATS_CAPTURE_DIR");
+	if (!dir || *dir == '\0')
+		return nullptr;
+
+	std::string path = std::string(dir) + "/" + pipeline + "-"
+			 + std::to_string(getpid()) + "-"
+			 + std::to_string(index++) + ".lccs";
+
+	std::unique_ptr<StatsCaptureWriter> writer =
+		std::make_unique<StatsCaptureWriter>();
+	if (writer->open(path, pipeline))
+		return nullptr;
+
+	LOG(StatsCapture, Info) << "Capturing statistics to " << path;
+
+	return writer;
+}
+
+/**
+ * \brief Create a statistics capture file and start the writer thread
+ * \param[in] path The path to the file
+ * \param[in] pipeline The name of the pipeline handler stored in the header
+ *
+ * Any file previously opened by the writer is closed first. Existing files are
+ * never overwritten.
+ *
+ * \return 0 on success or a negative error code otherwise
+ */
+int StatsCaptureWriter::open(const std::string &path, const std::string &pipeline)
+{
+	close();
+
+	if (File::exists(path)) {
+		LOG(StatsCapture, Error) << path << " already exists";
+		return -EEXIST;
+	}
+
+	eventfd_ = UniqueFD(eventfd(0, EFD_CLOEXEC));
+	if (!eventfd_.isValid()) {
+		int ret = -errno;
+		LOG(StatsCapture, Error)
+			<< "Failed to create eventfd: " << strerror(-ret);
+		return ret;
+	}
+
+	file_.setFileName(path);
+	if (!file_.open(File::OpenModeFlag::WriteOnly)) {
+		LOG(StatsCapture, Error)
+			<< "Failed to open " << path << ": "
+			<< strerror(-file_.error());
+		return file_.error();
+	}
+
+	StatsCaptureHeader header = {};
+	header.magic = StatsCaptureHeader::kMagic;
+	header.version = StatsCaptureHeader::kVersion;
+	strncpy(header.pipeline, pipeline.c_str(), sizeof(header.pipeline) - 1);
+
+	Span<const uint8_t> data(reinterpret_cast<const uint8_t *>(&header),
+				 sizeof(header));
+	if (file_.write(data) != sizeof(header)) {
+		LOG(StatsCapture, Error) << "Failed to write capture header";
+		file_.close();
+		return -EIO;
+	}
+
+	head_ = 0;
+	tail_ = 0;
+	stopping_ = false;
+	dropped_ = 0;
+	serializer_.reset();
+
+	Thread::start();
+
+	return 0;
+}
+
+/**
+ * \brief Flush all queued records and close the statistics capture file
+ */
+void StatsCaptureWriter::close()
+{
+	if (!file_.isOpen())
+		return;
+
+	stopping_.store(true, std::memory_order_release);
+
+	uint64_t value = 1;
+	if (::write(eventfd_.get(), &value, sizeof(value)) < 0)
+		LOG(StatsCapture, Error) << "Failed to wake up writer thread";
+
+	Thread::wait();
+
+	if (dropped_)
+		LOG(StatsCapture, Warning)
+			<< dropped_ << " records dropped from "
+			<< file_.fileName();
+
+	file_.close();
+	eventfd_.reset();
+	mappings_.clear();
+}
+
+/**
+ * \fn StatsCaptureWriter::dropped()
+ * \brief Retrieve the number of records dropped since the file was opened
+ * \return The number of dropped records
+ */
+
+/**
+ * \brief Record the camera sensor information
+ * \param[in] sensorInfo The sensor information passed to the IPA module
+ */
+void StatsCaptureWriter::writeSensorInfo(const IPACameraSensorInfo &sensorInfo)
+{
+	std::vector<uint8_t> data;
+	std::tie(data, std::ignore) =
+		IPADataSerializer<IPACameraSensorInfo>::serialize(sensorInfo);
+
+	write(StatsCaptureRecordType::SensorInfo, 0, 0, data);
+}
+
+/**
+ * \brief Record the controls supported by a device
+ * \param[in] entity The pipeline-specific entity number
+ * \param[in] infoMap The device controls info map
+ *
+ * The \a infoMap must be recorded before any ControlList that refers to it.
+ * The sensor controls info map shall be recorded as entity 0.
+ */
+void StatsCaptureWriter::writeControlInfo(unsigned int entity,
+					  const ControlInfoMap &infoMap)
+{
+	scratch_.resize(serializer_.binarySize(infoMap));
+
+	ByteStreamBuffer buffer(scratch_.data(), scratch_.size());
+	if (serializer_.serialize(infoMap, buffer) < 0)
+		return;
+
+	write(StatsCaptureRecordType::ControlInfo, entity, 0, scratch_);
+}
+
+/**
+ * \brief Record the pipeline-specific IPA configuration parameters
+ * \param[in] config The configuration parameters
+ */
+void StatsCaptureWriter::writePipelineConfig(Span<const uint32_t> config)
+{
+	write(StatsCaptureRecordType::PipelineConfig, 0, 0,
+	      { reinterpret_cast<const uint8_t *>(config.data()),
+		config.size_bytes() });
+}
+
+/**
+ * \brief Record the sensor controls applied to a frame
+ * \param[in] sequence The frame sequence number
+ * \param[in] timestamp The frame timestamp in nanoseconds
+ * \param[in] controls The sensor controls
+ */
+void StatsCaptureWriter::writeSensorControls(uint32_t sequence, uint64_t timestamp,
+					     const ControlList &controls)
+{
+	scratch_.resize(serializer_.binarySize(controls));
+
+	ByteStreamBuffer buffer(scratch_.data(), scratch_.size());
+	if (serializer_.serialize(controls, buffer) < 0)
+		return;
+
+	write(StatsCaptureRecordType::SensorControls, sequence, timestamp,
+	      scratch_);
+}
+
+/**
+ * \brief Record the content of an ISP parameters or statistics buffer
+ * \param[in] type The record type, Params or Statistics
+ * \param[in] sequence The frame sequence number
+ * \param[in] timestamp The frame timestamp in nanoseconds
+ * \param[in] buffer The buffer
+ *
+ * The first plane of the \a buffer is recorded. Buffers are mapped on first
+ * use and stay mapped until releaseBuffers() is called.
+ */
+void StatsCaptureWriter::writeBuffer(StatsCaptureRecordType type, uint32_t sequence,
+				     uint64_t timestamp, const FrameBuffer *buffer)
+{
+	auto it = mappings_.find(buffer);
+	if (it == mappings_.end()) {
+		MappedFrameBuffer mapped(buffer, MappedFrameBuffer::MapFlag::Read);
+		if (!mapped.isValid()) {
+			LOG(StatsCapture, Error)
+				<< "Failed to map buffer: "
+				<< strerror(-mapped.error());
+			return;
+		}
+
+		it = mappings_.emplace(buffer, std::move(mapped)).first;
+	}
+
+	write(type, sequence, timestamp, it->second.planes()[0]);
+}
+
+/**
+ * \brief Unmap all buffers mapped by writeBuffer()
+ *
+ * This function shall be called before the buffers passed to writeBuffer()
+ * are freed.
+ */
+void StatsCaptureWriter::releaseBuffers()
+{
+	mappings_.clear();
+}
+
+void StatsCaptureWriter::write(StatsCaptureRecordType type, uint32_t sequence,
+			       uint64_t timestamp, Span<const uint8_t> data)
+{
+	unsigned int head = head_.load(std::memory_order_relaxed);
+	if (head - tail_.load(std::memory_order_acquire) == kNumSlots) {
+		dropped_++;
+		return;
+	}
+
+	Slot &slot = slots_[head % kNumSlots];
+	slot.header.type = static_cast<uint32_t>(type);
+	slot.header.sequence = sequence;
+	slot.header.timestamp = timestamp;
+	slot.header.size = data.size();
+	slot.header.reserved = 0;
+	slot.data.assign(data.begin(), data.end());
+
+	head_.store(head + 1, std::memory_order_release);
+
+	uint64_t value = 1;
+	if (::write(eventfd_.get(), &value, sizeof(value)) < 0)
+		LOG(StatsCapture, Error) << "Failed to wake up writer thread";
+}
+
+void StatsCaptureWriter::run()
+{
+	bool stopping;
+
+	do {
+		uint64_t value;
+		if (::read(eventfd_.get(), &value, sizeof(value)) < 0 &&
+		    errno != EINTR)
+			break;
+
+		stopping = stopping_.load(std::memory_order_acquire);
+		flush();
+	} while (!stopping);
+}
+
+void StatsCaptureWriter::flush()
+{
+	unsigned int tail = tail_.load(std::memory_order_relaxed);
+	unsigned int head = head_.load(std::memory_order_acquire);
+
+	for (; tail != head; ++tail) {
+		const Slot &slot = slots_[tail % kNumSlots];
+		Span<const uint8_t> header(reinterpret_cast<const uint8_t *>(&slot.header),
+					   sizeof(slot.header));
+
+		if (file_.write(header) != sizeof(slot.header) ||
+		    file_.write(slot.data) != static_cast<ssize_t>(slot.data.size()))
+			LOG(StatsCapture, Error)
+				<< "Failed to write record to " << file_.fileName();
+
+		tail_.store(tail + 1, std::memory_order_release);
+	}
+}
+
+} /* namespace libcamera */
@@ -0,0 +1,187 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * underrun_guard.cpp - Keep capture devices streaming when requests run out
+ */
+
+#include "libcamera/internal/underrun_guard.h"
+
+#include <algorithm>
+
+#include <libcamera/base/log.h>
+
+#include <libcamera/framebuffer.h>
+
+#include "libcamera/internal/v4l2_videodevice.h"
+
+/**
+ * \file internal/underrun_guard.h
+ * \brief Keep capture devices streaming when requests run out
+ */
+
+namespace libcamera {
+
+LOG_DEFINE_CATEGORY(UnderrunGuard)
+
+/**
+ * \class UnderrunGuard
+ * \brief Keep a capture video device streaming when no request is queued
+ *
+ * Pipeline handlers that capture frames directly to the buffers of the
+ * application's requests leave the video device without buffers when the
+ * application doesn't queue requests fast enough. Depending on the device,
+ * this causes the capture to stall, or to restart with a latency of several
+ * frames, and interrupts the control loops of the sensor or camera.
+ *
+ * The UnderrunGuard tracks the buffers queued to a video device through its
+ * queueBuffer() function, and queues an internal scratch buffer when the last
+ * buffer has completed. Frames captured to scratch buffers are silently
+ * dropped. The scratch buffers are allocated by start() and kept until clear()
+ * is called, to avoid reallocating them when the camera is restarted.
+ *
+ * As the scratch buffer is queued before any buffer subsequently queued by the
+ * application, the first frame delivered after an underrun is delayed by up to
+ * one frame.
+ *
+ * Pipeline handlers shall call bufferReady() first in their buffer completion
+ * handler, and ignore buffers for which it returns true.
+ */
+
+/**
+ * \var UnderrunGuard::kNumScratchBuffers
+ * \brief The number of scratch buffers allocated for the video device
+ */
+
+/**
+ * \brief Construct an UnderrunGuard for a video device
+ * \param[in] video The capture video device
+ */
+UnderrunGuard::UnderrunGuard(V4L2VideoDevice *video)
+	: video_(video), queuedBuffers_(0), queuedScratchBuffers_(0)
+{
+}
+
+UnderrunGuard::~UnderrunGuard() = default;
+
+/**
+ * \brief Prepare the video device for streaming
+ * \param[in] bufferCount The number of buffers the application can queue
+ *
+ * Allocate the scratch buffers, if not allocated yet, and prepare the video
+ * device to import \a bufferCount buffers in addition to the scratch buffers.
+ * This function replaces the call to V4L2VideoDevice::importBuffers() when
+ * starting the video device, and shall be called after the device format is
+ * set.
+ *
+ * \return 0 on success or a negative error code otherwise
+ */
+int UnderrunGuard::start(unsigned int bufferCount)
+{
+	if (scratchBuffers_.empty()) {
+		int ret = video_->exportBuffers(kNumScratchBuffers, &scratchBuffers_);
+		if (ret < 0) {
+			LOG(UnderrunGuard, Error)
+				<< "Failed to allocate scratch buffers";
+			return ret;
+		}
+	}
+
+	availableBuffers_.clear();
+	for (const std::unique_ptr<FrameBuffer> &buffer : scratchBuffers_)
+		availableBuffers_.push_back(buffer.get());
+
+	queuedBuffers_ = 0;
+	queuedScratchBuffers_ = 0;
+
+	return video_->importBuffers(bufferCount + scratchBuffers_.size());
+}
+
+/**
+ * \brief Release the video device buffers after streaming
+ *
+ * This function replaces the call to V4L2VideoDevice::releaseBuffers() when
+ * stopping the video device, and shall be called after streaming has been
+ * stopped. The scratch buffers are kept for the next start().
+ */
+void UnderrunGuard::stop()
+{
+	video_->releaseBuffers();
+}
+
+/**
+ * \brief Free the scratch buffers
+ *
+ * The scratch buffers are sized for the format of the video device. This
+ * function shall be called when the format is changed, and when the video
+ * device isn't streaming.
+ */
+void UnderrunGuard::clear()
+{
+	availableBuffers_.clear();
+	scratchBuffers_.clear();
+}
+
+/**
+ * \brief Queue an application buffer to the video device
+ * \param[in] buffer The buffer
+ * \return 0 on success or a negative error code otherwise
+ */
+int UnderrunGuard::queueBuffer(FrameBuffer *buffer)
+{
+	int ret = video_->queueBuffer(buffer);
+	if (ret < 0)
+		return ret;
+
+	queuedBuffers_++;
+	return 0;
+}
+
+/**
+ * \brief Handle the completion of a buffer by the video device
+ * \param[in] buffer The completed buffer
+ *
+ * Account for the completion of \a buffer, and queue a scratch buffer to the
+ * video device if no other buffer is queued.
+ *
+ * \return True if \a buffer is a scratch buffer, which shall be ignored by the
+ * caller, or false otherwise
+ */
+bool UnderrunGuard::bufferReady(FrameBuffer *buffer)
+{
+	auto it = std::find_if(scratchBuffers_.begin(), scratchBuffers_.end(),
+			       [buffer](const std::unique_ptr<FrameBuffer> &scratch) {
+				       return scratch.get() == buffer;
+			       });
+	bool scratch = it != scratchBuffers_.end();
+
+	if (scratch) {
+		queuedScratchBuffers_--;
+		availableBuffers_.push_back(buffer);
+	} else {
+		queuedBuffers_--;
+	}
+
+	/* Cancelled buffers are completed when the device stops streaming. */
+	if (buffer->metadata().status != FrameMetadata::FrameCancelled)
+		fill();
+
+	return scratch;
+}
+
+void UnderrunGuard::fill()
+{
+	if (queuedBuffers_ || queuedScratchBuffers_ || availableBuffers_.empty())
+		return;
+
+	FrameBuffer *buffer = availableBuffers_.back();
+	if (video_->queueBuffer(buffer) < 0)
+		return;
+
+	availableBuffers_.pop_back();
+	queuedScratchBuffers_++;
+
+	LOG(UnderrunGuard, Debug) << "No buffer queued, capturing to scratch buffer";
+}
+
+} /* namespace libcamera */
@@ -58,7 +58,7 @@ LOG_DEFINE_CATEGORY(V4L2)
  */
 V4L2Device::V4L2Device(const std::string &deviceNode)
 	: deviceNode_(deviceNode), fdEventNotifier_(nullptr),
-	  frameStartEnabled_(false)
+	  frameStartEnabled_(false), layoutGeneration_(0)
 {
 }
 
@@ -143,6 +143,9 @@ void V4L2Device::close()
 	delete fdEventNotifier_;
 
 	fd_.reset();
+
+	/* The device state isn't preserved across close and open. */
+	layoutGeneration_++;
 }
 
 /**
@@ -361,6 +364,15 @@ int V4L2Device::setControls(ControlList *ctrls)
 
 	updateControls(ctrls, v4l2Ctrls);
 
+	if (!layoutControls_.empty()) {
+		for (const v4l2_ext_control &v4l2Ctrl : v4l2Ctrls) {
+			if (layoutControls_.count(v4l2Ctrl.id)) {
+				layoutGeneration_++;
+				break;
+			}
+		}
+	}
+
 	return ret;
 }
 
@@ -471,6 +483,20 @@ int V4L2Device::ioctl(unsigned long request, void *argp)
  * \return The V4L2 device file descriptor, -1 if the device node is not open
  */
 
+/**
+ * \fn V4L2Device::layoutGeneration()
+ * \brief Retrieve the generation number of the device data layout
+ *
+ * The layout generation number is incremented every time the device is closed,
+ * and every time a control flagged with V4L2_CTRL_FLAG_MODIFY_LAYOUT is
+ * written. Such controls, for instance the flip controls of sensors whose
+ * Bayer pattern order depends on the flips, may modify the device formats.
+ * Derived classes that cache device formats use the generation number to
+ * detect when the cached formats may have become stale.
+ *
+ * \return The layout generation number
+ */
+
 /**
  * \brief Retrieve the libcamera control type associated with the V4L2 control
  * \param[in] ctrlType The V4L2 control type
@@ -627,6 +653,9 @@ void V4L2Device::listControls()
 		controlIdMap_[ctrl.id] = controlIds_.back().get();
 		controlInfo_.emplace(ctrl.id, ctrl);
 
+		if (ctrl.flags & V4L2_CTRL_FLAG_MODIFY_LAYOUT)
+			layoutControls_.insert(ctrl.id);
+
 		ctrls.emplace(controlIds_.back().get(), v4l2ControlInfo(ctrl));
 	}
 
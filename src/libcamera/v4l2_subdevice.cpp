@@ -129,6 +129,12 @@ const std::map<uint32_t, V4L2SubdeviceFormatInfo> formatInfoMap = {
 	{ V4L2_MBUS_FMT_AHSV8888_1X32, { 32, "AHSV8888_1X32" } },
 };
 
+bool isSameFormat(const V4L2SubdeviceFormat &a, const V4L2SubdeviceFormat &b)
+{
+	return a.mbus_code == b.mbus_code && a.size == b.size &&
+	       a.colorSpace == b.colorSpace;
+}
+
 } /* namespace */
 
 /**
@@ -253,7 +259,8 @@ uint8_t V4L2SubdeviceFormat::bitsPerPixel() const
  * path
  */
 V4L2Subdevice::V4L2Subdevice(const MediaEntity *entity)
-	: V4L2Device(entity->deviceNode()), entity_(entity)
+	: V4L2Device(entity->deviceNode()), entity_(entity),
+	  formatCacheGeneration_(0), formatCacheLockGeneration_(0)
 {
 }
 
@@ -338,6 +345,9 @@ int V4L2Subdevice::setSelection(unsigned int pad, unsigned int target,
 	sel.r.width = rect->width;
 	sel.r.height = rect->height;
 
+	/* Selection rectangles propagate to the formats of the subdevice. */
+	formatCache_.clear();
+
 	int ret = ioctl(VIDIOC_SUBDEV_S_SELECTION, &sel);
 	if (ret < 0) {
 		LOG(V4L2, Error)
@@ -430,11 +440,46 @@ int V4L2Subdevice::getFormat(unsigned int pad, V4L2SubdeviceFormat *format,
  * Apply the requested image format to the desired media pad and return the
  * actually applied format parameters, as getFormat() would do.
  *
+ * Active formats are cached per pad. When the same format is requested again on
+ * a pad, and no other format, selection rectangle or layout-modifying control
+ * has been set on the subdevice since, the device state is known to match the
+ * request. The cached result is then returned without calling the driver, which
+ * avoids redundant ioctls when switching between camera configurations.
+ *
+ * The cache assumes that libcamera is the only user of the subdevice, and is
+ * thus dropped every time the media device is locked, as other processes may
+ * have modified the formats while it was unlocked.
+ *
  * \return 0 on success or a negative error code otherwise
  */
 int V4L2Subdevice::setFormat(unsigned int pad, V4L2SubdeviceFormat *format,
 			     Whence whence)
 {
+	const V4L2SubdeviceFormat request = *format;
+
+	if (whence == ActiveFormat) {
+		unsigned int lockGeneration = entity_->device()->lockGeneration();
+
+		if (formatCacheGeneration_ != layoutGeneration() ||
+		    formatCacheLockGeneration_ != lockGeneration) {
+			formatCache_.clear();
+			formatCacheGeneration_ = layoutGeneration();
+			formatCacheLockGeneration_ = lockGeneration;
+		}
+
+		auto it = formatCache_.find(pad);
+		if (it != formatCache_.end() && isSameFormat(it->second.request, request)) {
+			*format = it->second.format;
+			return 0;
+		}
+
+		/*
+		 * Drivers propagate formats from sink to source pads, setting a
+		 * format may thus modify the format of any pad.
+		 */
+		formatCache_.clear();
+	}
+
 	struct v4l2_subdev_format subdevFmt = {};
 	subdevFmt.which = whence == ActiveFormat ? V4L2_SUBDEV_FORMAT_ACTIVE
 			: V4L2_SUBDEV_FORMAT_TRY;
@@ -458,6 +503,9 @@ int V4L2Subdevice::setFormat(unsigned int pad, V4L2SubdeviceFormat *format,
 	format->mbus_code = subdevFmt.format.code;
 	format->colorSpace = toColorSpace(subdevFmt.format);
 
+	if (whence == ActiveFormat)
+		formatCache_[pad] = { request, *format };
+
 	return 0;
 }
 
@@ -41,6 +41,25 @@ namespace libcamera {
 
 LOG_DECLARE_CATEGORY(V4L2)
 
+namespace {
+
+bool isSameFormat(const V4L2DeviceFormat &a, const V4L2DeviceFormat &b)
+{
+	if (a.fourcc != b.fourcc || a.size != b.size ||
+	    a.colorSpace != b.colorSpace || a.planesCount != b.planesCount)
+		return false;
+
+	for (unsigned int i = 0; i < a.planes.size(); ++i) {
+		if (a.planes[i].bpl != b.planes[i].bpl ||
+		    a.planes[i].size != b.planes[i].size)
+			return false;
+	}
+
+	return true;
+}
+
+} /* namespace */
+
 /**
  * \struct V4L2Capability
  * \brief struct v4l2_capability object wrapper and helpers
@@ -519,7 +538,9 @@ const std::string V4L2DeviceFormat::toString() const
  * \param[in] deviceNode The file-system path to the video device node
  */
 V4L2VideoDevice::V4L2VideoDevice(const std::string &deviceNode)
-	: V4L2Device(deviceNode), formatInfo_(nullptr), cache_(nullptr),
+	: V4L2Device(deviceNode), formatInfo_(nullptr), media_(nullptr),
+	  formatCacheEnabled_(false), formatRequestGeneration_(0),
+	  formatRequestLockGeneration_(0), cache_(nullptr),
 	  fdBufferNotifier_(nullptr), state_(State::Stopped)
 {
 	/*
@@ -539,6 +560,7 @@ V4L2VideoDevice::V4L2VideoDevice(const std::string &deviceNode)
 V4L2VideoDevice::V4L2VideoDevice(const MediaEntity *entity)
 	: V4L2VideoDevice(entity->deviceNode())
 {
+	media_ = entity->device();
 }
 
 V4L2VideoDevice::~V4L2VideoDevice()
@@ -625,6 +647,13 @@ int V4L2VideoDevice::open()
 
 	formatInfo_ = &PixelFormatInfo::info(format_.fourcc);
 
+	/*
+	 * The format cache is dropped when the media device is locked. Without
+	 * a media device, libcamera can't know when other processes may have
+	 * modified the format, don't cache it.
+	 */
+	formatCacheEnabled_ = media_ != nullptr;
+
 	return 0;
 }
 
@@ -715,6 +744,13 @@ int V4L2VideoDevice::open(SharedFD handle, enum v4l2_buf_type type)
 
 	formatInfo_ = &PixelFormatInfo::info(format_.fourcc);
 
+	/*
+	 * The file handle may be shared with another video device, as for M2M
+	 * devices where setting the format of one queue may modify the format of
+	 * the other queue. Don't cache formats in that case.
+	 */
+	formatCacheEnabled_ = false;
+
 	return 0;
 }
 
@@ -730,6 +766,7 @@ void V4L2VideoDevice::close()
 	delete fdBufferNotifier_;
 
 	formatInfo_ = nullptr;
+	formatRequest_.reset();
 
 	V4L2Device::close();
 }
@@ -806,10 +843,32 @@ int V4L2VideoDevice::tryFormat(V4L2DeviceFormat *format)
  * Apply the supplied \a format to the video device, and return the actually
  * applied format parameters, as \ref V4L2VideoDevice::getFormat would do.
  *
+ * If the \a format is identical to the one requested by the previous call to
+ * this function, and no selection rectangle or layout-modifying control has
+ * been set on the device since, the device state is known to match the
+ * request. The previously applied format is then returned without calling the
+ * driver, which avoids redundant ioctls when switching between camera
+ * configurations.
+ *
+ * The cache assumes that libcamera is the only user of the device, and is thus
+ * dropped every time the media device is locked, as other processes may have
+ * modified the format while it was unlocked. Formats are not cached for video
+ * devices created without a media entity.
+ *
  * \return 0 on success or a negative error code otherwise
  */
 int V4L2VideoDevice::setFormat(V4L2DeviceFormat *format)
 {
+	if (formatRequest_ && formatRequestGeneration_ == layoutGeneration() &&
+	    formatRequestLockGeneration_ == media_->lockGeneration() &&
+	    isSameFormat(*formatRequest_, *format)) {
+		*format = format_;
+		return 0;
+	}
+
+	const V4L2DeviceFormat request = *format;
+	formatRequest_.reset();
+
 	int ret = 0;
 	if (caps_.isMeta())
 		ret = trySetFormatMeta(format, true);
@@ -825,6 +884,12 @@ int V4L2VideoDevice::setFormat(V4L2DeviceFormat *format)
 	format_ = *format;
 	formatInfo_ = &PixelFormatInfo::info(format_.fourcc);
 
+	if (formatCacheEnabled_) {
+		formatRequest_ = request;
+		formatRequestGeneration_ = layoutGeneration();
+		formatRequestLockGeneration_ = media_->lockGeneration();
+	}
+
 	return 0;
 }
 
@@ -1162,6 +1227,9 @@ int V4L2VideoDevice::setSelection(unsigned int target, Rectangle *rect)
 	sel.r.width = rect->width;
 	sel.r.height = rect->height;
 
+	/* Selection rectangles may modify the format of the device. */
+	formatRequest_.reset();
+
 	int ret = ioctl(VIDIOC_S_SELECTION, &sel);
 	if (ret < 0) {
 		LOG(V4L2, Error) << "Unable to set rectangle " << target
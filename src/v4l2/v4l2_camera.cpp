@@ -7,10 +7,18 @@
 
 #include "v4l2_camera.h"
 
+#include <algorithm>
 #include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <libcamera/base/log.h>
+#include <libcamera/base/utils.h>
+
+#include <libcamera/control_ids.h>
+
+#include "libcamera/internal/formats.h"
 
 using namespace libcamera;
 
@@ -18,9 +26,17 @@ LOG_DECLARE_CATEGORY(V4L2Compat)
 
 V4L2Camera::V4L2Camera(std::shared_ptr<Camera> camera)
 	: camera_(camera), isRunning_(false), bufferAllocator_(nullptr),
+	  memory_(Memory::Mmap), conversionEnabled_(false),
+	  outputAllocator_(DmaBufAllocator::DmaBufAllocatorFlag::MemFd),
+	  worker_(this), frameDuration_(0), frameDurationChanged_(false),
 	  efd_(-1), bufferAvailableCount_(0)
 {
 	camera_->requestCompleted.connect(this, &V4L2Camera::requestComplete);
+
+	const char *convert = utils::secure_getenv("LIBCAMERA_V4L2_CONVERT_FORMATS");
+	conversionEnabled_ = convert && convert[0] != '\0';
+
+	worker_.moveToThread(&workerThread_);
 }
 
 V4L2Camera::~V4L2Camera()
@@ -43,13 +59,24 @@ int V4L2Camera::open(StreamConfiguration *streamConfig)
 
 	bufferAllocator_ = new FrameBufferAllocator(camera_);
 
+	workerThread_.start();
+
 	*streamConfig = config_->at(0);
 	return 0;
 }
 
 void V4L2Camera::close()
 {
+	workerThread_.exit();
+	workerThread_.wait();
+
 	requestPool_.clear();
+	outputs_.clear();
+	mappedBuffers_.clear();
+	mappedOutputs_.clear();
+	outputBuffers_.clear();
+	importedBuffers_.clear();
+	converter_.reset();
 
 	delete bufferAllocator_;
 	bufferAllocator_ = nullptr;
@@ -85,12 +112,83 @@ void V4L2Camera::requestComplete(Request *request)
 	if (request->status() == Request::RequestCancelled)
 		return;
 
+	/*
+	 * Process the frame in the worker thread, to avoid delaying the
+	 * completion of the next requests in the camera manager thread.
+	 */
+	if (converter_ || memory_ == Memory::UserPtr) {
+		worker_.invokeMethod(&Worker::process, ConnectionTypeQueued,
+				     request);
+		return;
+	}
+
 	/* We only have one stream at the moment. */
-	bufferLock_.lock();
 	FrameBuffer *buffer = request->buffers().begin()->second;
-	std::unique_ptr<Buffer> metadata =
-		std::make_unique<Buffer>(request->cookie(), buffer->metadata());
-	completedBuffers_.push_back(std::move(metadata));
+	completeRequest(request, buffer->metadata());
+}
+
+void V4L2Camera::processRequest(Request *request)
+{
+	unsigned int index = request->cookie();
+	FrameBuffer *buffer = request->buffers().begin()->second;
+	FrameMetadata metadata = buffer->metadata();
+
+	if (metadata.status != FrameMetadata::FrameSuccess ||
+	    index >= outputs_.size() || !outputs_[index].data()) {
+		completeRequest(request, metadata);
+		return;
+	}
+
+	if (mappedBuffers_.size() <= index)
+		mappedBuffers_.resize(index + 1);
+
+	std::unique_ptr<MappedFrameBuffer> &mapped = mappedBuffers_[index];
+	if (!mapped) {
+		mapped = std::make_unique<MappedFrameBuffer>(buffer,
+							     MappedFrameBuffer::MapFlag::Read);
+		if (!mapped->isValid()) {
+			LOG(V4L2Compat, Error) << "Failed to map buffer " << index;
+			mapped.reset();
+			metadata.status = FrameMetadata::FrameError;
+			completeRequest(request, metadata);
+			return;
+		}
+	}
+
+	Span<uint8_t> output = outputs_[index];
+
+	if (converter_) {
+		converter_->convert(mapped->planes(), output);
+
+		Span<FrameMetadata::Plane> planes = metadata.planes();
+		for (auto [i, plane] : utils::enumerate(planes))
+			plane.bytesused = i == 0 ? converter_->frameSize() : 0;
+	} else {
+		size_t offset = 0;
+
+		/* Don't return a truncated frame as a valid one. */
+		for (const Span<uint8_t> &plane : mapped->planes()) {
+			if (plane.size() > output.size() - offset) {
+				LOG(V4L2Compat, Error)
+					<< "Buffer " << index << " too small for the frame";
+				metadata.status = FrameMetadata::FrameError;
+				break;
+			}
+
+			memcpy(output.data() + offset, plane.data(), plane.size());
+			offset += plane.size();
+		}
+	}
+
+	completeRequest(request, metadata);
+}
+
+void V4L2Camera::completeRequest(Request *request, const FrameMetadata &metadata)
+{
+	bufferLock_.lock();
+	std::unique_ptr<Buffer> buffer =
+		std::make_unique<Buffer>(request->cookie(), metadata);
+	completedBuffers_.push_back(std::move(buffer));
 	bufferLock_.unlock();
 
 	uint64_t data = 1;
@@ -113,7 +211,7 @@ int V4L2Camera::configure(StreamConfiguration *streamConfigOut,
 	StreamConfiguration &streamConfig = config_->at(0);
 	streamConfig.size.width = size.width;
 	streamConfig.size.height = size.height;
-	streamConfig.pixelFormat = pixelformat;
+	streamConfig.pixelFormat = captureFormat(pixelformat);
 	streamConfig.bufferCount = bufferCount;
 	/* \todo memoryType (interval vs external) */
 
@@ -132,7 +230,18 @@ int V4L2Camera::configure(StreamConfiguration *streamConfigOut,
 	if (ret < 0)
 		return ret;
 
+	converter_ = createConverter(streamConfig, pixelformat);
+
 	*streamConfigOut = config_->at(0);
+	if (converter_) {
+		streamConfigOut->pixelFormat = pixelformat;
+		streamConfigOut->stride = converter_->stride();
+		streamConfigOut->frameSize = converter_->frameSize();
+
+		LOG(V4L2Compat, Debug)
+			<< "Converting from " << streamConfig.pixelFormat
+			<< " to " << pixelformat;
+	}
 
 	return 0;
 }
@@ -145,7 +254,7 @@ int V4L2Camera::validateConfiguration(const PixelFormat &pixelFormat,
 		camera_->generateConfiguration({ StreamRole::Viewfinder });
 	StreamConfiguration &cfg = config->at(0);
 	cfg.size = size;
-	cfg.pixelFormat = pixelFormat;
+	cfg.pixelFormat = captureFormat(pixelFormat);
 	cfg.bufferCount = 1;
 
 	CameraConfiguration::Status validation = config->validate();
@@ -154,17 +263,64 @@ int V4L2Camera::validateConfiguration(const PixelFormat &pixelFormat,
 
 	*streamConfigOut = cfg;
 
+	std::unique_ptr<V4L2FormatConverter> converter =
+		createConverter(cfg, pixelFormat);
+	if (converter) {
+		streamConfigOut->pixelFormat = pixelFormat;
+		streamConfigOut->stride = converter->stride();
+		streamConfigOut->frameSize = converter->frameSize();
+	}
+
 	return 0;
 }
 
-int V4L2Camera::allocBuffers(unsigned int count)
+/*
+ * Return the formats not supported by the camera that can be produced by
+ * converting frames in the compatibility layer.
+ */
+std::vector<PixelFormat> V4L2Camera::convertedFormats() const
 {
-	Stream *stream = config_->at(0).stream();
+	if (!conversionEnabled_)
+		return {};
 
-	int ret = bufferAllocator_->allocate(stream);
-	if (ret < 0)
-		return ret;
+	return V4L2FormatConverter::outputFormats(config_->at(0).formats().pixelformats());
+}
+
+/*
+ * Return the format to capture frames in to produce frames in the requested
+ * pixel format, which differs from the requested format when the camera
+ * doesn't support it and frames can be converted.
+ */
+PixelFormat V4L2Camera::captureFormat(const PixelFormat &pixelFormat) const
+{
+	if (!conversionEnabled_)
+		return pixelFormat;
+
+	const std::vector<PixelFormat> formats = config_->at(0).formats().pixelformats();
+	if (std::find(formats.begin(), formats.end(), pixelFormat) != formats.end())
+		return pixelFormat;
+
+	PixelFormat format = V4L2FormatConverter::inputFormat(formats, pixelFormat);
+	return format.isValid() ? format : pixelFormat;
+}
+
+std::unique_ptr<V4L2FormatConverter>
+V4L2Camera::createConverter(const StreamConfiguration &streamConfig,
+			    const PixelFormat &pixelFormat) const
+{
+	if (!conversionEnabled_ || streamConfig.pixelFormat == pixelFormat)
+		return nullptr;
+
+	auto converter = std::make_unique<V4L2FormatConverter>(streamConfig,
+								 pixelFormat);
+	if (!converter->isValid())
+		return nullptr;
 
+	return converter;
+}
+
+int V4L2Camera::createRequests(unsigned int count)
+{
 	for (unsigned int i = 0; i < count; i++) {
 		std::unique_ptr<Request> request = camera_->createRequest(i);
 		if (!request) {
@@ -174,7 +330,60 @@ int V4L2Camera::allocBuffers(unsigned int count)
 		requestPool_.push_back(std::move(request));
 	}
 
-	return ret;
+	return 0;
+}
+
+/*
+ * Allocate buffers for the given memory type. DMABUF buffers are imported
+ * from the application with importBuffer() when queued, and captured to
+ * directly. Otherwise frames are captured to internal buffers, and converted
+ * or copied to the output buffers in the worker thread when needed. Output
+ * buffers are allocated for the MMAP memory type, imported with
+ * importBuffer() for DMABUF, and provided with importUserPointer() for
+ * USERPTR.
+ */
+int V4L2Camera::allocBuffers(unsigned int count, Memory memory)
+{
+	Stream *stream = config_->at(0).stream();
+	int ret;
+
+	memory_ = memory;
+
+	if (memory_ != Memory::DmaBuf || converter_) {
+		ret = bufferAllocator_->allocate(stream);
+		if (ret < 0)
+			return ret;
+	}
+
+	if (memory_ == Memory::DmaBuf)
+		importedBuffers_.resize(count);
+
+	outputs_.resize(count);
+
+	if (memory_ == Memory::Mmap && converter_) {
+		ret = outputAllocator_.exportBuffers(count, { converter_->frameSize() },
+						     &outputBuffers_);
+		if (ret < 0) {
+			freeBuffers();
+			return ret;
+		}
+
+		for (unsigned int i = 0; i < count; ++i) {
+			ret = mapOutput(i, outputBuffers_[i].get());
+			if (ret < 0) {
+				freeBuffers();
+				return ret;
+			}
+		}
+	}
+
+	ret = createRequests(count);
+	if (ret < 0) {
+		freeBuffers();
+		return ret;
+	}
+
+	return count;
 }
 
 void V4L2Camera::freeBuffers()
@@ -182,12 +391,26 @@ void V4L2Camera::freeBuffers()
 	pendingRequests_.clear();
 	requestPool_.clear();
 
+	outputs_.clear();
+	mappedBuffers_.clear();
+	mappedOutputs_.clear();
+	outputBuffers_.clear();
+	importedBuffers_.clear();
+
 	Stream *stream = config_->at(0).stream();
-	bufferAllocator_->free(stream);
+	if (!bufferAllocator_->buffers(stream).empty())
+		bufferAllocator_->free(stream);
 }
 
 int V4L2Camera::getBufferFd(unsigned int index)
 {
+	if (memory_ == Memory::Mmap && converter_) {
+		if (index >= outputBuffers_.size())
+			return -1;
+
+		return outputBuffers_[index]->planes()[0].fd.get();
+	}
+
 	Stream *stream = config_->at(0).stream();
 	const std::vector<std::unique_ptr<FrameBuffer>> &buffers =
 		bufferAllocator_->buffers(stream);
@@ -198,23 +421,185 @@ int V4L2Camera::getBufferFd(unsigned int index)
 	return buffers[index]->planes()[0].fd.get();
 }
 
+/*
+ * Import the dmabuf fd as the buffer for the given index. The FrameBuffer is
+ * reused as long as the application queues the same dmabuf at that index, to
+ * avoid the cost of importing it in the pipeline handler for every frame.
+ */
+int V4L2Camera::importBuffer(unsigned int index, int fd)
+{
+	if (index >= importedBuffers_.size())
+		return -EINVAL;
+
+	struct stat st;
+	if (fstat(fd, &st) < 0)
+		return -errno;
+
+	ImportedBuffer &imported = importedBuffers_[index];
+	if (imported.buffer && imported.dev == st.st_dev && imported.ino == st.st_ino)
+		return 0;
+
+	const StreamConfiguration &streamConfig = config_->at(0);
+	const PixelFormatInfo &info = PixelFormatInfo::info(streamConfig.pixelFormat);
+	size_t frameSize = converter_ ? converter_->frameSize() : streamConfig.frameSize;
+
+	/* The dmabuf must be large enough to hold the frame. */
+	off_t size = lseek(fd, 0, SEEK_END);
+	lseek(fd, 0, SEEK_SET);
+	if (size >= 0 && static_cast<size_t>(size) < frameSize) {
+		LOG(V4L2Compat, Error)
+			<< "dmabuf too small (" << size << " < "
+			<< frameSize << ")";
+		return -EINVAL;
+	}
+
+	/*
+	 * The V4L2 single-planar API stores all colour planes contiguously in
+	 * the buffer. Compute the stride of the other planes from the stride
+	 * of the first plane, as in V4L2VideoDevice::createBuffer(). Converted
+	 * formats are all single-planar.
+	 */
+	SharedFD sharedFd(fd);
+	std::vector<FrameBuffer::Plane> planes(info.isValid() && !converter_
+					       ? info.numPlanes() : 1);
+	size_t offset = 0;
+
+	for (auto [i, plane] : utils::enumerate(planes)) {
+		plane.fd = sharedFd;
+		plane.offset = offset;
+
+		if (info.isValid() && !converter_) {
+			unsigned int stride = streamConfig.stride
+					    * info.planes[i].bytesPerGroup
+					    / info.planes[0].bytesPerGroup;
+			plane.length = info.planeSize(streamConfig.size.height,
+						      i, stride);
+		} else {
+			plane.length = frameSize;
+		}
+
+		offset += plane.length;
+	}
+
+	imported.dev = st.st_dev;
+	imported.ino = st.st_ino;
+	imported.buffer = std::make_unique<FrameBuffer>(planes);
+
+	if (converter_)
+		return mapOutput(index, imported.buffer.get());
+
+	return 0;
+}
+
+/*
+ * Set the application memory that frames captured for the given index are
+ * copied or converted to, for the USERPTR memory type.
+ */
+int V4L2Camera::importUserPointer(unsigned int index, void *data, size_t length)
+{
+	if (index >= outputs_.size())
+		return -EINVAL;
+
+	outputs_[index] = { static_cast<uint8_t *>(data), length };
+
+	return 0;
+}
+
+int V4L2Camera::mapOutput(unsigned int index, FrameBuffer *buffer)
+{
+	if (mappedOutputs_.size() <= index)
+		mappedOutputs_.resize(index + 1);
+
+	std::unique_ptr<MappedFrameBuffer> &mapped = mappedOutputs_[index];
+	mapped = std::make_unique<MappedFrameBuffer>(buffer,
+						     MappedFrameBuffer::MapFlag::Write);
+	if (!mapped->isValid()) {
+		LOG(V4L2Compat, Error) << "Failed to map output buffer " << index;
+		mapped.reset();
+		outputs_[index] = {};
+		return -ENOMEM;
+	}
+
+	outputs_[index] = mapped->planes()[0];
+
+	return 0;
+}
+
+FrameBuffer *V4L2Camera::captureBuffer(unsigned int index)
+{
+	if (memory_ == Memory::DmaBuf && !converter_)
+		return index < importedBuffers_.size()
+		       ? importedBuffers_[index].buffer.get() : nullptr;
+
+	Stream *stream = config_->at(0).stream();
+	const std::vector<std::unique_ptr<FrameBuffer>> &buffers =
+		bufferAllocator_->buffers(stream);
+
+	return index < buffers.size() ? buffers[index].get() : nullptr;
+}
+
+const ControlInfoMap &V4L2Camera::controls() const
+{
+	return camera_->controls();
+}
+
+/*
+ * Set the frame duration requested by the application through the frame
+ * interval, or 0 to let the camera select it. The frame duration is applied
+ * when starting the camera, or with the next queued request when running.
+ */
+void V4L2Camera::setFrameDuration(int64_t duration)
+{
+	frameDuration_ = duration;
+	frameDurationChanged_ = true;
+}
+
+/*
+ * Fix the frame duration to the one requested by the application, or to the
+ * camera default when none is requested, to undo a previously requested frame
+ * duration.
+ */
+void V4L2Camera::setFrameDurationLimits(ControlList *controls) const
+{
+	if (frameDuration_) {
+		controls->set(controls::FrameDurationLimits,
+			      { frameDuration_, frameDuration_ });
+		return;
+	}
+
+	const ControlInfoMap &infoMap = camera_->controls();
+	const auto it = infoMap.find(&controls::FrameDurationLimits);
+	if (it == infoMap.end())
+		return;
+
+	const ControlValue &duration = it->second.def();
+	if (duration.type() != ControlTypeInteger64 || duration.isArray())
+		return;
+
+	controls->set(controls::FrameDurationLimits,
+		      { duration.get<int64_t>(), duration.get<int64_t>() });
+}
+
 int V4L2Camera::streamOn()
 {
 	if (isRunning_)
 		return 0;
 
-	int ret = camera_->start();
+	ControlList controls(controls::controls);
+	setFrameDurationLimits(&controls);
+
+	int ret = camera_->start(&controls);
 	if (ret < 0)
 		return ret == -EACCES ? -EBUSY : ret;
 
+	frameDurationChanged_ = false;
+
 	isRunning_ = true;
 
-	for (Request *req : pendingRequests_) {
-		/* \todo What should we do if this returns -EINVAL? */
-		ret = camera_->queueRequest(req);
-		if (ret < 0)
-			return ret == -EACCES ? -EBUSY : ret;
-	}
+	/* \todo What should we do if this returns -EINVAL? */
+	ret = camera_->queueRequests(pendingRequests_);
+	if (ret < 0)
+		return ret == -EACCES ? -EBUSY : ret;
 
 	pendingRequests_.clear();
 
@@ -236,6 +621,10 @@ int V4L2Camera::streamOff()
 	if (ret < 0)
 		return ret == -EACCES ? -EBUSY : ret;
 
+	/* Wait for the worker thread to complete processing frames. */
+	if (converter_ || memory_ == Memory::UserPtr)
+		worker_.invokeMethod(&Worker::flush, ConnectionTypeBlocking);
+
 	{
 		MutexLocker locker(bufferMutex_);
 		isRunning_ = false;
@@ -254,7 +643,12 @@ int V4L2Camera::qbuf(unsigned int index)
 	Request *request = requestPool_[index].get();
 
 	Stream *stream = config_->at(0).stream();
-	FrameBuffer *buffer = bufferAllocator_->buffers(stream)[index].get();
+	FrameBuffer *buffer = captureBuffer(index);
+	if (!buffer) {
+		LOG(V4L2Compat, Error) << "No buffer at index " << index;
+		return -EINVAL;
+	}
+
 	int ret = request->addBuffer(stream, buffer);
 	if (ret < 0) {
 		LOG(V4L2Compat, Error) << "Can't set buffer for request";
@@ -266,6 +660,11 @@ int V4L2Camera::qbuf(unsigned int index)
 		return 0;
 	}
 
+	if (frameDurationChanged_) {
+		setFrameDurationLimits(&request->controls());
+		frameDurationChanged_ = false;
+	}
+
 	ret = camera_->queueRequest(request);
 	if (ret < 0) {
 		LOG(V4L2Compat, Error) << "Can't queue request";
@@ -8,16 +8,26 @@
 #pragma once
 
 #include <deque>
+#include <sys/types.h>
 #include <utility>
+#include <vector>
 
 #include <libcamera/base/mutex.h>
+#include <libcamera/base/object.h>
 #include <libcamera/base/semaphore.h>
 #include <libcamera/base/shared_fd.h>
+#include <libcamera/base/span.h>
+#include <libcamera/base/thread.h>
 
 #include <libcamera/camera.h>
 #include <libcamera/framebuffer.h>
 #include <libcamera/framebuffer_allocator.h>
 
+#include "libcamera/internal/dma_buf_allocator.h"
+#include "libcamera/internal/mapped_framebuffer.h"
+
+#include "v4l2_format_converter.h"
+
 class V4L2Camera
 {
 public:
@@ -31,6 +41,12 @@ public:
 		libcamera::FrameMetadata data_;
 	};
 
+	enum class Memory {
+		Mmap,
+		DmaBuf,
+		UserPtr,
+	};
+
 	V4L2Camera(std::shared_ptr<libcamera::Camera> camera);
 	~V4L2Camera();
 
@@ -49,9 +65,17 @@ public:
 				  const libcamera::Size &size,
 				  libcamera::StreamConfiguration *streamConfigOut);
 
-	int allocBuffers(unsigned int count);
+	std::vector<libcamera::PixelFormat> convertedFormats() const;
+	libcamera::PixelFormat captureFormat(const libcamera::PixelFormat &pixelFormat) const;
+
+	int allocBuffers(unsigned int count, Memory memory);
 	void freeBuffers();
 	int getBufferFd(unsigned int index);
+	int importBuffer(unsigned int index, int fd);
+	int importUserPointer(unsigned int index, void *data, size_t length);
+
+	const libcamera::ControlInfoMap &controls() const;
+	void setFrameDuration(int64_t duration);
 
 	int streamOn();
 	int streamOff();
@@ -64,7 +88,44 @@ public:
 	bool isRunning();
 
 private:
+	struct ImportedBuffer {
+		dev_t dev;
+		ino_t ino;
+		std::unique_ptr<libcamera::FrameBuffer> buffer;
+	};
+
+	class Worker : public libcamera::Object
+	{
+	public:
+		Worker(V4L2Camera *camera)
+			: camera_(camera)
+		{
+		}
+
+		void process(libcamera::Request *request)
+		{
+			camera_->processRequest(request);
+		}
+
+		void flush()
+		{
+		}
+
+	private:
+		V4L2Camera *camera_;
+	};
+
+	std::unique_ptr<V4L2FormatConverter>
+	createConverter(const libcamera::StreamConfiguration &streamConfig,
+			const libcamera::PixelFormat &pixelFormat) const;
+	libcamera::FrameBuffer *captureBuffer(unsigned int index);
+	int mapOutput(unsigned int index, libcamera::FrameBuffer *buffer);
+	int createRequests(unsigned int count);
+	void setFrameDurationLimits(libcamera::ControlList *controls) const;
 	void requestComplete(libcamera::Request *request);
+	void processRequest(libcamera::Request *request);
+	void completeRequest(libcamera::Request *request,
+			     const libcamera::FrameMetadata &metadata);
 
 	std::shared_ptr<libcamera::Camera> camera_;
 	std::unique_ptr<libcamera::CameraConfiguration> config_;
@@ -73,10 +134,32 @@ private:
 
 	libcamera::Mutex bufferLock_;
 	libcamera::FrameBufferAllocator *bufferAllocator_;
+	Memory memory_;
+	std::vector<ImportedBuffer> importedBuffers_;
+
+	/*
+	 * Frames converted to a format not supported by the camera, or copied
+	 * to USERPTR buffers, are captured to internal buffers and processed
+	 * by the worker thread to the output buffers.
+	 */
+	bool conversionEnabled_;
+	std::unique_ptr<V4L2FormatConverter> converter_;
+	libcamera::DmaBufAllocator outputAllocator_;
+	std::vector<std::unique_ptr<libcamera::FrameBuffer>> outputBuffers_;
+	std::vector<std::unique_ptr<libcamera::MappedFrameBuffer>> mappedBuffers_;
+	std::vector<std::unique_ptr<libcamera::MappedFrameBuffer>> mappedOutputs_;
+	std::vector<libcamera::Span<uint8_t>> outputs_;
+
+	libcamera::Thread workerThread_;
+	Worker worker_;
+
+	/* Frame duration requested by the application, in microseconds. */
+	int64_t frameDuration_;
+	bool frameDurationChanged_;
 
 	std::vector<std::unique_ptr<libcamera::Request>> requestPool_;
 
-	std::deque<libcamera::Request *> pendingRequests_;
+	std::vector<libcamera::Request *> pendingRequests_;
 	std::deque<std::unique_ptr<Buffer>> completedBuffers_;
 
 	int efd_;
@@ -23,6 +23,7 @@
 #include <libcamera/base/utils.h>
 
 #include <libcamera/camera.h>
+#include <libcamera/control_ids.h>
 #include <libcamera/formats.h>
 
 #include "libcamera/internal/formats.h"
@@ -37,12 +38,26 @@ using namespace libcamera;
 
 LOG_DECLARE_CATEGORY(V4L2Compat)
 
+namespace {
+
+struct v4l2_fract durationToInterval(int64_t duration)
+{
+	int64_t divisor = std::gcd<int64_t>(duration, 1000000);
+
+	return { static_cast<uint32_t>(duration / divisor),
+		 static_cast<uint32_t>(1000000 / divisor) };
+}
+
+} /* namespace */
+
 V4L2CameraProxy::V4L2CameraProxy(unsigned int index,
 				 std::shared_ptr<Camera> camera)
 	: refcount_(0), index_(index), bufferCount_(0), currentBuf_(0),
+	  memory_(V4L2_MEMORY_MMAP), frameDuration_(0),
 	  vcam_(std::make_unique<V4L2Camera>(camera)), owner_(nullptr)
 {
 	querycap(camera);
+	updateFrameIntervals(camera->controls());
 }
 
 int V4L2CameraProxy::open(V4L2CameraFile *file)
@@ -173,7 +188,8 @@ bool V4L2CameraProxy::validateBufferType(uint32_t type)
 
 bool V4L2CameraProxy::validateMemoryType(uint32_t memory)
 {
-	return memory == V4L2_MEMORY_MMAP;
+	return memory == V4L2_MEMORY_MMAP || memory == V4L2_MEMORY_DMABUF ||
+	       memory == V4L2_MEMORY_USERPTR;
 }
 
 void V4L2CameraProxy::setFmtFromConfig(const StreamConfiguration &streamConfig)
@@ -216,6 +232,55 @@ void V4L2CameraProxy::querycap(std::shared_ptr<Camera> camera)
 	memset(capabilities_.reserved, 0, sizeof(capabilities_.reserved));
 }
 
+/*
+ * Update the frame duration limits from the camera controls, which depend on
+ * the camera configuration. The frame interval requested by the application is
+ * kept if it is within the new limits, and clamped otherwise.
+ */
+void V4L2CameraProxy::updateFrameIntervals(const ControlInfoMap &controls)
+{
+	minFrameDuration_ = 0;
+	maxFrameDuration_ = 0;
+	defaultFrameDuration_ = 0;
+
+	const auto it = controls.find(&controls::FrameDurationLimits);
+	const ControlInfo *info = it != controls.end() ? &it->second : nullptr;
+	if (!info || info->min().type() != ControlTypeInteger64 ||
+	    info->max().type() != ControlTypeInteger64) {
+		if (frameDuration_) {
+			frameDuration_ = 0;
+			vcam_->setFrameDuration(0);
+		}
+
+		timePerFrame_ = {};
+		return;
+	}
+
+	/* A null minimum frame duration denotes the absence of a limit. */
+	minFrameDuration_ = std::max<int64_t>(info->min().get<int64_t>(), 1);
+	maxFrameDuration_ = std::max(info->max().get<int64_t>(), minFrameDuration_);
+
+	defaultFrameDuration_ = info->def().type() == ControlTypeInteger64 &&
+				!info->def().isArray()
+			      ? info->def().get<int64_t>() : minFrameDuration_;
+	defaultFrameDuration_ = std::clamp(defaultFrameDuration_, minFrameDuration_,
+					   maxFrameDuration_);
+
+	if (!frameDuration_) {
+		timePerFrame_ = durationToInterval(defaultFrameDuration_);
+		return;
+	}
+
+	int64_t clamped = std::clamp(frameDuration_, minFrameDuration_,
+				     maxFrameDuration_);
+	if (clamped == frameDuration_)
+		return;
+
+	frameDuration_ = clamped;
+	timePerFrame_ = durationToInterval(frameDuration_);
+	vcam_->setFrameDuration(frameDuration_);
+}
+
 void V4L2CameraProxy::updateBuffers()
 {
 	std::vector<V4L2Camera::Buffer> completedBuffers = vcam_->completedBuffers();
@@ -262,7 +327,7 @@ int V4L2CameraProxy::vidioc_enum_framesizes(V4L2CameraFile *file, struct v4l2_fr
 		<< "[" << file->description() << "] " << __func__ << "()";
 
 	V4L2PixelFormat v4l2Format = V4L2PixelFormat(arg->pixel_format);
-	PixelFormat format = v4l2Format.toPixelFormat();
+	PixelFormat format = vcam_->captureFormat(v4l2Format.toPixelFormat());
 	/*
 	 * \todo This might need to be expanded as few pipeline handlers
 	 * report StreamFormats.
@@ -280,19 +345,72 @@ int V4L2CameraProxy::vidioc_enum_framesizes(V4L2CameraFile *file, struct v4l2_fr
 	return 0;
 }
 
+int V4L2CameraProxy::vidioc_enum_frameintervals(V4L2CameraFile *file,
+						struct v4l2_frmivalenum *arg)
+{
+	LOG(V4L2Compat, Debug)
+		<< "[" << file->description() << "] " << __func__ << "()";
+
+	if (arg->index != 0 || !minFrameDuration_)
+		return -EINVAL;
+
+	V4L2PixelFormat v4l2Format = V4L2PixelFormat(arg->pixel_format);
+	PixelFormat format = vcam_->captureFormat(v4l2Format.toPixelFormat());
+	const std::vector<Size> &frameSizes = streamConfig_.formats().sizes(format);
+	Size size(arg->width, arg->height);
+
+	/*
+	 * \todo As for vidioc_enum_framesizes(), accept all sizes when the
+	 * pipeline handler doesn't report StreamFormats.
+	 */
+	if (!frameSizes.empty() &&
+	    std::find(frameSizes.begin(), frameSizes.end(), size) == frameSizes.end())
+		return -EINVAL;
+
+	/*
+	 * The frame duration limits are reported by the camera independently
+	 * of the format.
+	 */
+	arg->type = V4L2_FRMIVAL_TYPE_CONTINUOUS;
+	arg->stepwise.min = durationToInterval(minFrameDuration_);
+	arg->stepwise.max = durationToInterval(maxFrameDuration_);
+	arg->stepwise.step = { 1, 1000000 };
+	memset(arg->reserved, 0, sizeof(arg->reserved));
+
+	return 0;
+}
+
 int V4L2CameraProxy::vidioc_enum_fmt(V4L2CameraFile *file, struct v4l2_fmtdesc *arg)
 {
 	LOG(V4L2Compat, Debug)
 		<< "[" << file->description() << "] " << __func__ << "()";
 
-	if (!validateBufferType(arg->type) ||
-	    arg->index >= streamConfig_.formats().pixelformats().size())
+	if (!validateBufferType(arg->type))
 		return -EINVAL;
 
-	PixelFormat format = streamConfig_.formats().pixelformats()[arg->index];
+	/*
+	 * Enumerate the formats supported by the camera first, followed by the
+	 * formats produced by conversion in the compatibility layer.
+	 */
+	const std::vector<PixelFormat> supported = streamConfig_.formats().pixelformats();
+	const std::vector<PixelFormat> converted = vcam_->convertedFormats();
+	PixelFormat format;
+	bool emulated = false;
+
+	if (arg->index < supported.size()) {
+		format = supported[arg->index];
+	} else if (arg->index - supported.size() < converted.size()) {
+		format = converted[arg->index - supported.size()];
+		emulated = true;
+	} else {
+		return -EINVAL;
+	}
+
 	V4L2PixelFormat v4l2Format = V4L2PixelFormat::fromPixelFormat(format);
 
 	arg->flags = format == formats::MJPEG ? V4L2_FMT_FLAG_COMPRESSED : 0;
+	if (emulated)
+		arg->flags |= V4L2_FMT_FLAG_EMULATED;
 	utils::strlcpy(reinterpret_cast<char *>(arg->description),
 		       v4l2Format.description(), sizeof(arg->description));
 	arg->pixelformat = v4l2Format;
@@ -373,6 +491,7 @@ int V4L2CameraProxy::vidioc_s_fmt(V4L2CameraFile *file, struct v4l2_format *arg)
 		return -EINVAL;
 
 	setFmtFromConfig(streamConfig_);
+	updateFrameIntervals(vcam_->controls());
 
 	return 0;
 }
@@ -427,6 +546,85 @@ int V4L2CameraProxy::vidioc_s_priority(V4L2CameraFile *file, enum v4l2_priority
 	return 0;
 }
 
+int V4L2CameraProxy::vidioc_g_parm(V4L2CameraFile *file, struct v4l2_streamparm *arg)
+{
+	LOG(V4L2Compat, Debug)
+		<< "[" << file->description() << "] " << __func__ << "()";
+
+	if (!validateBufferType(arg->type))
+		return -EINVAL;
+
+	memset(&arg->parm, 0, sizeof(arg->parm));
+
+	if (minFrameDuration_) {
+		arg->parm.capture.capability = V4L2_CAP_TIMEPERFRAME;
+		arg->parm.capture.timeperframe = timePerFrame_;
+	}
+
+	return 0;
+}
+
+int V4L2CameraProxy::vidioc_s_parm(V4L2CameraFile *file, struct v4l2_streamparm *arg)
+{
+	LOG(V4L2Compat, Debug)
+		<< "[" << file->description() << "] " << __func__ << "()";
+
+	if (!validateBufferType(arg->type))
+		return -EINVAL;
+
+	if (file->priority() < maxPriority())
+		return -EBUSY;
+
+	if (!hasOwnership(file) && owner_)
+		return -EBUSY;
+
+	if (minFrameDuration_) {
+		struct v4l2_fract interval = arg->parm.capture.timeperframe;
+
+		if (!interval.numerator || !interval.denominator) {
+			/*
+			 * A null frame interval lets the camera select the
+			 * frame rate.
+			 */
+			frameDuration_ = 0;
+			timePerFrame_ = durationToInterval(defaultFrameDuration_);
+		} else {
+			int64_t duration = static_cast<int64_t>(interval.numerator)
+					 * 1000000 / interval.denominator;
+
+			/*
+			 * Keep the frame interval requested by the application
+			 * if it can be honoured, to avoid rounding it to
+			 * microseconds.
+			 */
+			frameDuration_ = std::clamp(duration, minFrameDuration_,
+						    maxFrameDuration_);
+			if (frameDuration_ == duration) {
+				uint32_t divisor = std::gcd(interval.numerator,
+							    interval.denominator);
+				timePerFrame_ = { interval.numerator / divisor,
+						  interval.denominator / divisor };
+			} else {
+				timePerFrame_ = durationToInterval(frameDuration_);
+			}
+		}
+
+		LOG(V4L2Compat, Debug)
+			<< "Setting frame duration to " << frameDuration_ << "us";
+
+		vcam_->setFrameDuration(frameDuration_);
+	}
+
+	memset(&arg->parm, 0, sizeof(arg->parm));
+
+	if (minFrameDuration_) {
+		arg->parm.capture.capability = V4L2_CAP_TIMEPERFRAME;
+		arg->parm.capture.timeperframe = timePerFrame_;
+	}
+
+	return 0;
+}
+
 int V4L2CameraProxy::vidioc_enuminput(V4L2CameraFile *file, struct v4l2_input *arg)
 {
 	LOG(V4L2Compat, Debug)
@@ -490,7 +688,9 @@ int V4L2CameraProxy::vidioc_reqbufs(V4L2CameraFile *file, struct v4l2_requestbuf
 	if (!hasOwnership(file) && owner_)
 		return -EBUSY;
 
-	arg->capabilities = V4L2_BUF_CAP_SUPPORTS_MMAP;
+	arg->capabilities = V4L2_BUF_CAP_SUPPORTS_MMAP
+			  | V4L2_BUF_CAP_SUPPORTS_DMABUF
+			  | V4L2_BUF_CAP_SUPPORTS_USERPTR;
 	arg->flags = 0;
 	memset(arg->reserved, 0, sizeof(arg->reserved));
 
@@ -519,11 +719,33 @@ int V4L2CameraProxy::vidioc_reqbufs(V4L2CameraFile *file, struct v4l2_requestbuf
 		return -EINVAL;
 
 	setFmtFromConfig(streamConfig_);
+	updateFrameIntervals(vcam_->controls());
 
 	arg->count = streamConfig_.bufferCount;
 	bufferCount_ = arg->count;
+	memory_ = arg->memory;
 
-	ret = vcam_->allocBuffers(arg->count);
+	/*
+	 * DMABUF buffers are imported from the application when queued, and
+	 * captured to without any copy. USERPTR buffers can't be imported, as
+	 * libcamera requires dmabuf-backed frame buffers. They are backed by
+	 * internal buffers, copied to the application memory when completed.
+	 */
+	V4L2Camera::Memory memory;
+	switch (memory_) {
+	case V4L2_MEMORY_DMABUF:
+		memory = V4L2Camera::Memory::DmaBuf;
+		break;
+	case V4L2_MEMORY_USERPTR:
+		memory = V4L2Camera::Memory::UserPtr;
+		break;
+	case V4L2_MEMORY_MMAP:
+	default:
+		memory = V4L2Camera::Memory::Mmap;
+		break;
+	}
+
+	ret = vcam_->allocBuffers(arg->count, memory);
 	if (ret < 0) {
 		arg->count = 0;
 		return ret;
@@ -534,8 +756,9 @@ int V4L2CameraProxy::vidioc_reqbufs(V4L2CameraFile *file, struct v4l2_requestbuf
 		struct v4l2_buffer buf = {};
 		buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 		buf.length = v4l2PixFormat_.sizeimage;
-		buf.memory = V4L2_MEMORY_MMAP;
-		buf.m.offset = i * v4l2PixFormat_.sizeimage;
+		buf.memory = memory_;
+		if (memory_ == V4L2_MEMORY_MMAP)
+			buf.m.offset = i * v4l2PixFormat_.sizeimage;
 		buf.index = i;
 		buf.flags = V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
 
@@ -584,7 +807,7 @@ int V4L2CameraProxy::vidioc_prepare_buf(V4L2CameraFile *file, struct v4l2_buffer
 		return -EINVAL;
 
 	if (!validateBufferType(arg->type) ||
-	    !validateMemoryType(arg->memory))
+	    arg->memory != memory_)
 		return -EINVAL;
 
 	struct v4l2_buffer &buffer = buffers_[arg->index];
@@ -616,14 +839,45 @@ int V4L2CameraProxy::vidioc_qbuf(V4L2CameraFile *file, struct v4l2_buffer *arg)
 		return -EBUSY;
 
 	if (!validateBufferType(arg->type) ||
-	    !validateMemoryType(arg->memory) ||
+	    arg->memory != memory_ ||
 	    arg->index >= bufferCount_)
 		return -EINVAL;
 
-	int ret = vcam_->qbuf(arg->index);
+	struct v4l2_buffer &buffer = buffers_[arg->index];
+	int ret;
+
+	switch (memory_) {
+	case V4L2_MEMORY_DMABUF:
+		ret = vcam_->importBuffer(arg->index, arg->m.fd);
+		if (ret < 0)
+			return ret;
+
+		buffer.m.fd = arg->m.fd;
+		break;
+
+	case V4L2_MEMORY_USERPTR:
+		if (!arg->m.userptr || arg->length < sizeimage_)
+			return -EINVAL;
+
+		ret = vcam_->importUserPointer(arg->index,
+					       reinterpret_cast<void *>(arg->m.userptr),
+					       arg->length);
+		if (ret < 0)
+			return ret;
+
+		buffer.m.userptr = arg->m.userptr;
+		buffer.length = arg->length;
+		break;
+
+	default:
+		break;
+	}
+
+	ret = vcam_->qbuf(arg->index);
 	if (ret < 0)
 		return ret;
 
+	buffers_[arg->index].flags &= ~V4L2_BUF_FLAG_ERROR;
 	buffers_[arg->index].flags |= V4L2_BUF_FLAG_QUEUED;
 
 	arg->flags = buffers_[arg->index].flags;
@@ -647,7 +901,7 @@ int V4L2CameraProxy::vidioc_dqbuf(V4L2CameraFile *file, struct v4l2_buffer *arg,
 		return -EINVAL;
 
 	if (!validateBufferType(arg->type) ||
-	    !validateMemoryType(arg->memory))
+	    arg->memory != memory_)
 		return -EINVAL;
 
 	if (!file->nonBlocking()) {
@@ -669,7 +923,10 @@ int V4L2CameraProxy::vidioc_dqbuf(V4L2CameraFile *file, struct v4l2_buffer *arg,
 	struct v4l2_buffer &buf = buffers_[currentBuf_];
 
 	buf.flags &= ~(V4L2_BUF_FLAG_QUEUED | V4L2_BUF_FLAG_DONE | V4L2_BUF_FLAG_PREPARED);
-	buf.length = sizeimage_;
+
+	if (memory_ != V4L2_MEMORY_USERPTR)
+		buf.length = sizeimage_;
+
 	*arg = buf;
 
 	currentBuf_ = (currentBuf_ + 1) % bufferCount_;
@@ -690,8 +947,7 @@ int V4L2CameraProxy::vidioc_expbuf(V4L2CameraFile *file, struct v4l2_exportbuffe
 	if (!hasOwnership(file))
 		return -EBUSY;
 
-	/* \todo Verify that the memory type is MMAP when adding DMABUF support */
-	if (!validateBufferType(arg->type))
+	if (!validateBufferType(arg->type) || memory_ != V4L2_MEMORY_MMAP)
 		return -EINVAL;
 
 	if (arg->index >= bufferCount_)
@@ -759,12 +1015,15 @@ int V4L2CameraProxy::vidioc_streamoff(V4L2CameraFile *file, int *arg)
 const std::set<unsigned long> V4L2CameraProxy::supportedIoctls_ = {
 	VIDIOC_QUERYCAP,
 	VIDIOC_ENUM_FRAMESIZES,
+	VIDIOC_ENUM_FRAMEINTERVALS,
 	VIDIOC_ENUM_FMT,
 	VIDIOC_G_FMT,
 	VIDIOC_S_FMT,
 	VIDIOC_TRY_FMT,
 	VIDIOC_G_PRIORITY,
 	VIDIOC_S_PRIORITY,
+	VIDIOC_G_PARM,
+	VIDIOC_S_PARM,
 	VIDIOC_ENUMINPUT,
 	VIDIOC_G_INPUT,
 	VIDIOC_S_INPUT,
@@ -805,6 +1064,9 @@ int V4L2CameraProxy::ioctl(V4L2CameraFile *file, unsigned long request, void *ar
 	case VIDIOC_ENUM_FRAMESIZES:
 		ret = vidioc_enum_framesizes(file, static_cast<struct v4l2_frmsizeenum *>(arg));
 		break;
+	case VIDIOC_ENUM_FRAMEINTERVALS:
+		ret = vidioc_enum_frameintervals(file, static_cast<struct v4l2_frmivalenum *>(arg));
+		break;
 	case VIDIOC_ENUM_FMT:
 		ret = vidioc_enum_fmt(file, static_cast<struct v4l2_fmtdesc *>(arg));
 		break;
@@ -823,6 +1085,12 @@ int V4L2CameraProxy::ioctl(V4L2CameraFile *file, unsigned long request, void *ar
 	case VIDIOC_S_PRIORITY:
 		ret = vidioc_s_priority(file, static_cast<enum v4l2_priority *>(arg));
 		break;
+	case VIDIOC_G_PARM:
+		ret = vidioc_g_parm(file, static_cast<struct v4l2_streamparm *>(arg));
+		break;
+	case VIDIOC_S_PARM:
+		ret = vidioc_s_parm(file, static_cast<struct v4l2_streamparm *>(arg));
+		break;
 	case VIDIOC_ENUMINPUT:
 		ret = vidioc_enuminput(file, static_cast<struct v4l2_input *>(arg));
 		break;
@@ -40,6 +40,7 @@ private:
 	bool validateMemoryType(uint32_t memory);
 	void setFmtFromConfig(const libcamera::StreamConfiguration &streamConfig);
 	void querycap(std::shared_ptr<libcamera::Camera> camera);
+	void updateFrameIntervals(const libcamera::ControlInfoMap &controls);
 	int tryFormat(struct v4l2_format *arg);
 	enum v4l2_priority maxPriority();
 	void updateBuffers();
@@ -47,12 +48,15 @@ private:
 
 	int vidioc_querycap(V4L2CameraFile *file, struct v4l2_capability *arg);
 	int vidioc_enum_framesizes(V4L2CameraFile *file, struct v4l2_frmsizeenum *arg);
+	int vidioc_enum_frameintervals(V4L2CameraFile *file, struct v4l2_frmivalenum *arg);
 	int vidioc_enum_fmt(V4L2CameraFile *file, struct v4l2_fmtdesc *arg);
 	int vidioc_g_fmt(V4L2CameraFile *file, struct v4l2_format *arg);
 	int vidioc_s_fmt(V4L2CameraFile *file, struct v4l2_format *arg);
 	int vidioc_try_fmt(V4L2CameraFile *file, struct v4l2_format *arg);
 	int vidioc_g_priority(V4L2CameraFile *file, enum v4l2_priority *arg);
 	int vidioc_s_priority(V4L2CameraFile *file, enum v4l2_priority *arg);
+	int vidioc_g_parm(V4L2CameraFile *file, struct v4l2_streamparm *arg);
+	int vidioc_s_parm(V4L2CameraFile *file, struct v4l2_streamparm *arg);
 	int vidioc_enuminput(V4L2CameraFile *file, struct v4l2_input *arg);
 	int vidioc_g_input(V4L2CameraFile *file, int *arg);
 	int vidioc_s_input(V4L2CameraFile *file, int *arg);
@@ -79,10 +83,21 @@ private:
 	unsigned int bufferCount_;
 	unsigned int currentBuf_;
 	unsigned int sizeimage_;
+	uint32_t memory_;
 
 	struct v4l2_capability capabilities_;
 	struct v4l2_pix_format v4l2PixFormat_;
 
+	/*
+	 * Frame duration limits, and frame duration requested by the
+	 * application or 0 for the camera default, in microseconds.
+	 */
+	int64_t minFrameDuration_;
+	int64_t maxFrameDuration_;
+	int64_t defaultFrameDuration_;
+	int64_t frameDuration_;
+	struct v4l2_fract timePerFrame_;
+
 	std::vector<struct v4l2_buffer> buffers_;
 	std::map<void *, unsigned int> mmaps_;
 
@@ -0,0 +1,524 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * v4l2_format_converter.cpp - V4L2 compatibility pixel format conversion
+ */
+
+#include "v4l2_format_converter.h"
+
+#include <algorithm>
+#include <string.h>
+
+#include <libcamera/base/log.h>
+
+#include <libcamera/formats.h>
+
+#include "libcamera/internal/formats.h"
+
+using namespace libcamera;
+
+LOG_DECLARE_CATEGORY(V4L2Compat)
+
+/*
+ * The converter processes frames line by line. Each input line is decoded to
+ * an intermediate line, either in RGB (R, G, B byte order) or YUYV format,
+ * small enough to stay in the CPU cache, which is then encoded to the output
+ * format. When the intermediate line format matches the output format, lines
+ * are decoded directly to the output buffer. The conversion loops only use
+ * integer arithmetic and no data-dependent branches, to let the compiler
+ * vectorize them.
+ */
+
+namespace {
+
+enum class LineFormat {
+	Invalid,
+	RGB,
+	YUYV,
+};
+
+/*
+ * Formats commonly expected by V4L2 applications, in order of preference.
+ * formats::BGR888 and formats::RGB888 map to V4L2_PIX_FMT_RGB24 and
+ * V4L2_PIX_FMT_BGR24 respectively.
+ */
+const std::array<PixelFormat, 3> convertedFormats = {
+	formats::YUYV,
+	formats::BGR888,
+	formats::RGB888,
+};
+
+LineFormat outputLineFormat(const PixelFormat &format)
+{
+	if (format == formats::YUYV)
+		return LineFormat::YUYV;
+	if (format == formats::BGR888 || format == formats::RGB888)
+		return LineFormat::RGB;
+
+	return LineFormat::Invalid;
+}
+
+LineFormat inputLineFormat(const PixelFormat &format)
+{
+	static const std::array<PixelFormat, 11> yuvFormats = {
+		formats::NV12, formats::NV21, formats::NV16, formats::NV61,
+		formats::YUV420, formats::YVU420, formats::YUV422,
+		formats::YUYV, formats::YVYU, formats::UYVY, formats::VYUY,
+	};
+	static const std::array<PixelFormat, 6> rgbFormats = {
+		formats::XRGB8888, formats::ARGB8888,
+		formats::XBGR8888, formats::ABGR8888,
+		formats::RGB888, formats::BGR888,
+	};
+
+	if (std::find(yuvFormats.begin(), yuvFormats.end(), format) != yuvFormats.end())
+		return LineFormat::YUYV;
+	if (std::find(rgbFormats.begin(), rgbFormats.end(), format) != rgbFormats.end())
+		return LineFormat::RGB;
+
+	BayerFormat bayer = BayerFormat::fromPixelFormat(format);
+	if (!bayer.isValid() || bayer.bitDepth < 8 || bayer.bitDepth > 16)
+		return LineFormat::Invalid;
+
+	switch (bayer.packing) {
+	case BayerFormat::Packing::None:
+		return LineFormat::RGB;
+	case BayerFormat::Packing::CSI2:
+		return bayer.bitDepth == 10 || bayer.bitDepth == 12
+		       ? LineFormat::RGB : LineFormat::Invalid;
+	default:
+		return LineFormat::Invalid;
+	}
+}
+
+/*
+ * BT.601 limited range conversion, matching the V4L2_YCBCR_ENC_DEFAULT and
+ * V4L2_QUANTIZATION_DEFAULT encoding reported for the sRGB colorspace.
+ */
+inline uint8_t clamp8(int value)
+{
+	return std::clamp(value, 0, 255);
+}
+
+inline void yuvToRgb(int y, int u, int v, uint8_t *r, uint8_t *g, uint8_t *b)
+{
+	int c = 298 * (y - 16) + 128;
+	int d = u - 128;
+	int e = v - 128;
+
+	*r = clamp8((c + 409 * e) >> 8);
+	*g = clamp8((c - 100 * d - 208 * e) >> 8);
+	*b = clamp8((c + 516 * d) >> 8);
+}
+
+inline uint8_t rgbToY(int r, int g, int b)
+{
+	return ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+}
+
+/* Offset by 128 << 8 to keep the intermediate value positive. */
+inline uint8_t rgbToU(int r, int g, int b)
+{
+	return (-38 * r - 74 * g + 112 * b + 128 + (128 << 8)) >> 8;
+}
+
+inline uint8_t rgbToV(int r, int g, int b)
+{
+	return (112 * r - 94 * g - 18 * b + 128 + (128 << 8)) >> 8;
+}
+
+} /* namespace */
+
+V4L2FormatConverter::V4L2FormatConverter(const StreamConfiguration &input,
+					 const PixelFormat &output)
+	: size_(input.size), outputStride_(0), outputFrameSize_(0),
+	  decode_(nullptr), encode_(nullptr), direct_(false),
+	  linesPerDecode_(1), swapChroma_(false), bytesPerPixel_(0),
+	  offsets_({ 0, 0, 0, 0 })
+{
+	const PixelFormatInfo &inputInfo = PixelFormatInfo::info(input.pixelFormat);
+	const PixelFormatInfo &outputInfo = PixelFormatInfo::info(output);
+	if (!inputInfo.isValid() || !outputInfo.isValid())
+		return;
+
+	LineFormat inLine = inputLineFormat(input.pixelFormat);
+	LineFormat outLine = outputLineFormat(output);
+	if (inLine == LineFormat::Invalid || outLine == LineFormat::Invalid)
+		return;
+
+	/*
+	 * Compute the stride of all planes from the stride of the first plane,
+	 * as colour planes are stored contiguously.
+	 */
+	for (unsigned int i = 0; i < inputInfo.numPlanes(); ++i) {
+		strides_.push_back(input.stride * inputInfo.planes[i].bytesPerGroup
+				   / inputInfo.planes[0].bytesPerGroup);
+		verticalSubSampling_.push_back(inputInfo.planes[i].verticalSubSampling);
+	}
+
+	const PixelFormat &format = input.pixelFormat;
+
+	if (format == formats::NV12 || format == formats::NV16) {
+		decode_ = &V4L2FormatConverter::decodeNV;
+	} else if (format == formats::NV21 || format == formats::NV61) {
+		decode_ = &V4L2FormatConverter::decodeNV;
+		swapChroma_ = true;
+	} else if (format == formats::YUV420 || format == formats::YUV422) {
+		decode_ = &V4L2FormatConverter::decodeYUV420;
+	} else if (format == formats::YVU420) {
+		decode_ = &V4L2FormatConverter::decodeYUV420;
+		swapChroma_ = true;
+	} else if (format == formats::YUYV) {
+		decode_ = &V4L2FormatConverter::decodePackedYUV;
+		offsets_ = { 0, 1, 2, 3 };
+	} else if (format == formats::YVYU) {
+		decode_ = &V4L2FormatConverter::decodePackedYUV;
+		offsets_ = { 0, 3, 2, 1 };
+	} else if (format == formats::UYVY) {
+		decode_ = &V4L2FormatConverter::decodePackedYUV;
+		offsets_ = { 1, 0, 3, 2 };
+	} else if (format == formats::VYUY) {
+		decode_ = &V4L2FormatConverter::decodePackedYUV;
+		offsets_ = { 1, 2, 3, 0 };
+	} else if (format == formats::XRGB8888 || format == formats::ARGB8888) {
+		decode_ = &V4L2FormatConverter::decodeRGB;
+		bytesPerPixel_ = 4;
+		offsets_ = { 2, 1, 0, 0 };
+	} else if (format == formats::XBGR8888 || format == formats::ABGR8888) {
+		decode_ = &V4L2FormatConverter::decodeRGB;
+		bytesPerPixel_ = 4;
+		offsets_ = { 0, 1, 2, 0 };
+	} else if (format == formats::RGB888) {
+		decode_ = &V4L2FormatConverter::decodeRGB;
+		bytesPerPixel_ = 3;
+		offsets_ = { 2, 1, 0, 0 };
+	} else if (format == formats::BGR888) {
+		decode_ = &V4L2FormatConverter::decodeRGB;
+		bytesPerPixel_ = 3;
+		offsets_ = { 0, 1, 2, 0 };
+	} else {
+		decode_ = &V4L2FormatConverter::decodeBayer;
+		bayer_ = BayerFormat::fromPixelFormat(format);
+		for (std::vector<uint8_t> &line : bayerLines_)
+			line.resize(size_.width);
+
+		/*
+		 * The debayering interpolates colours over 2x2 quads, producing
+		 * identical output lines for each pair of input lines.
+		 */
+		if (bayer_.order != BayerFormat::MONO)
+			linesPerDecode_ = 2;
+	}
+
+	if (inLine == LineFormat::YUYV) {
+		if (output == formats::YUYV)
+			direct_ = true;
+		else if (output == formats::BGR888)
+			encode_ = &V4L2FormatConverter::encodeYUYVToRGB;
+		else
+			encode_ = &V4L2FormatConverter::encodeYUYVToBGR;
+	} else {
+		if (output == formats::YUYV)
+			encode_ = &V4L2FormatConverter::encodeRGBToYUYV;
+		else if (output == formats::BGR888)
+			direct_ = true;
+		else
+			encode_ = &V4L2FormatConverter::encodeRGBToBGR;
+	}
+
+	line_.resize(size_.width * 3);
+
+	outputStride_ = outputInfo.stride(size_.width, 0, 1);
+	outputFrameSize_ = outputInfo.frameSize(size_, 1);
+}
+
+void V4L2FormatConverter::convert(const std::vector<Span<uint8_t>> &input,
+				  Span<uint8_t> output)
+{
+	if (input.size() < strides_.size() || output.size() < outputFrameSize_) {
+		LOG(V4L2Compat, Error) << "Invalid buffers for format conversion";
+		return;
+	}
+
+	const uint8_t *rows[3] = {};
+
+	for (unsigned int y = 0; y < size_.height; ++y) {
+		uint8_t *dst = output.data() + y * outputStride_;
+		uint8_t *line = direct_ ? dst : line_.data();
+
+		if (y % linesPerDecode_ == 0) {
+			for (unsigned int i = 0; i < strides_.size(); ++i)
+				rows[i] = input[i].data()
+					+ y / verticalSubSampling_[i] * strides_[i];
+
+			/* Bayer formats are decoded from pairs of lines. */
+			if (linesPerDecode_ == 2)
+				rows[1] = y + 1 < size_.height
+					? rows[0] + strides_[0] : rows[0];
+
+			(this->*decode_)(rows, line);
+		} else if (direct_) {
+			memcpy(dst, dst - outputStride_, outputStride_);
+			continue;
+		}
+
+		if (!direct_)
+			encode_(line, dst, size_.width);
+	}
+}
+
+/*
+ * Return the formats that can be produced by conversion from the input
+ * formats, excluding the input formats themselves.
+ */
+std::vector<PixelFormat>
+V4L2FormatConverter::outputFormats(const std::vector<PixelFormat> &inputs)
+{
+	std::vector<PixelFormat> outputs;
+
+	for (const PixelFormat &output : convertedFormats) {
+		if (std::find(inputs.begin(), inputs.end(), output) != inputs.end())
+			continue;
+
+		if (inputFormat(inputs, output).isValid())
+			outputs.push_back(output);
+	}
+
+	return outputs;
+}
+
+/*
+ * Select the input format to convert to the output format. Formats that
+ * share the same intermediate line format as the output are the cheapest to
+ * convert, and Bayer formats the most expensive.
+ */
+PixelFormat V4L2FormatConverter::inputFormat(const std::vector<PixelFormat> &inputs,
+					     const PixelFormat &output)
+{
+	LineFormat outLine = outputLineFormat(output);
+	if (outLine == LineFormat::Invalid)
+		return {};
+
+	PixelFormat best;
+	unsigned int bestScore = 0;
+
+	for (const PixelFormat &input : inputs) {
+		LineFormat inLine = inputLineFormat(input);
+		if (inLine == LineFormat::Invalid)
+			continue;
+
+		unsigned int score;
+		if (BayerFormat::fromPixelFormat(input).isValid())
+			score = 1;
+		else if (inLine != outLine)
+			score = 2;
+		else
+			score = 3;
+
+		if (score > bestScore) {
+			best = input;
+			bestScore = score;
+		}
+	}
+
+	return best;
+}
+
+void V4L2FormatConverter::decodeNV(const uint8_t *const *rows, uint8_t *line)
+{
+	const uint8_t *luma = rows[0];
+	const uint8_t *chroma = rows[1];
+	const unsigned int u = swapChroma_ ? 1 : 0;
+	const unsigned int v = 1 - u;
+
+	for (unsigned int x = 0; x < size_.width / 2; ++x) {
+		line[4 * x + 0] = luma[2 * x];
+		line[4 * x + 1] = chroma[2 * x + u];
+		line[4 * x + 2] = luma[2 * x + 1];
+		line[4 * x + 3] = chroma[2 * x + v];
+	}
+}
+
+void V4L2FormatConverter::decodeYUV420(const uint8_t *const *rows, uint8_t *line)
+{
+	const uint8_t *luma = rows[0];
+	const uint8_t *cb = rows[swapChroma_ ? 2 : 1];
+	const uint8_t *cr = rows[swapChroma_ ? 1 : 2];
+
+	for (unsigned int x = 0; x < size_.width / 2; ++x) {
+		line[4 * x + 0] = luma[2 * x];
+		line[4 * x + 1] = cb[x];
+		line[4 * x + 2] = luma[2 * x + 1];
+		line[4 * x + 3] = cr[x];
+	}
+}
+
+void V4L2FormatConverter::decodePackedYUV(const uint8_t *const *rows, uint8_t *line)
+{
+	const uint8_t *src = rows[0];
+
+	for (unsigned int x = 0; x < size_.width / 2; ++x) {
+		line[4 * x + 0] = src[4 * x + offsets_[0]];
+		line[4 * x + 1] = src[4 * x + offsets_[1]];
+		line[4 * x + 2] = src[4 * x + offsets_[2]];
+		line[4 * x + 3] = src[4 * x + offsets_[3]];
+	}
+}
+
+void V4L2FormatConverter::decodeRGB(const uint8_t *const *rows, uint8_t *line)
+{
+	const uint8_t *src = rows[0];
+
+	for (unsigned int x = 0; x < size_.width; ++x) {
+		line[3 * x + 0] = src[bytesPerPixel_ * x + offsets_[0]];
+		line[3 * x + 1] = src[bytesPerPixel_ * x + offsets_[1]];
+		line[3 * x + 2] = src[bytesPerPixel_ * x + offsets_[2]];
+	}
+}
+
+/* Unpack a line of Bayer samples to 8 bits per sample, keeping the MSBs. */
+void V4L2FormatConverter::unpackBayer(const uint8_t *src, uint8_t *dst)
+{
+	const unsigned int width = size_.width;
+
+	if (bayer_.packing == BayerFormat::Packing::CSI2) {
+		/*
+		 * CSI-2 packed formats store the MSBs of groups of 4 (10-bit)
+		 * or 2 (12-bit) samples first, followed by a byte of LSBs.
+		 */
+		if (bayer_.bitDepth == 10) {
+			for (unsigned int x = 0; x < width; ++x)
+				dst[x] = src[x / 4 * 5 + x % 4];
+		} else {
+			for (unsigned int x = 0; x < width; ++x)
+				dst[x] = src[x / 2 * 3 + x % 2];
+		}
+	} else if (bayer_.bitDepth == 8) {
+		memcpy(dst, src, width);
+	} else {
+		const unsigned int shift = bayer_.bitDepth - 8;
+
+		for (unsigned int x = 0; x < width; ++x)
+			dst[x] = (src[2 * x] | (src[2 * x + 1] << 8)) >> shift;
+	}
+}
+
+/*
+ * Debayer a pair of lines. Each 2x2 quad is converted to a single RGB value,
+ * with the green value averaged from the two green samples. This is a simple
+ * but cheap interpolation, good enough for preview purposes.
+ */
+void V4L2FormatConverter::decodeBayer(const uint8_t *const *rows, uint8_t *line)
+{
+	uint8_t *line0 = bayerLines_[0].data();
+	uint8_t *line1 = bayerLines_[1].data();
+	const unsigned int width = size_.width;
+
+	unpackBayer(rows[0], line0);
+
+	if (bayer_.order == BayerFormat::MONO) {
+		for (unsigned int x = 0; x < width; ++x) {
+			line[3 * x + 0] = line0[x];
+			line[3 * x + 1] = line0[x];
+			line[3 * x + 2] = line0[x];
+		}
+		return;
+	}
+
+	unpackBayer(rows[1], line1);
+
+	/* Position of the red and blue samples in the quad, in raster order. */
+	unsigned int r, b;
+	switch (bayer_.order) {
+	case BayerFormat::BGGR:
+		r = 3;
+		b = 0;
+		break;
+	case BayerFormat::GBRG:
+		r = 2;
+		b = 1;
+		break;
+	case BayerFormat::GRBG:
+		r = 1;
+		b = 2;
+		break;
+	case BayerFormat::RGGB:
+	default:
+		r = 0;
+		b = 3;
+		break;
+	}
+
+	for (unsigned int x = 0; x < width / 2; ++x) {
+		const unsigned int quad[4] = {
+			line0[2 * x], line0[2 * x + 1],
+			line1[2 * x], line1[2 * x + 1],
+		};
+		const unsigned int sum = quad[0] + quad[1] + quad[2] + quad[3];
+		const uint8_t red = quad[r];
+		const uint8_t blue = quad[b];
+		const uint8_t green = (sum - red - blue) / 2;
+
+		line[6 * x + 0] = red;
+		line[6 * x + 1] = green;
+		line[6 * x + 2] = blue;
+		line[6 * x + 3] = red;
+		line[6 * x + 4] = green;
+		line[6 * x + 5] = blue;
+	}
+
+	/* Replicate the last pixel for odd widths. */
+	if (width % 2)
+		memcpy(&line[3 * (width - 1)], &line[3 * (width - 2)], 3);
+}
+
+void V4L2FormatConverter::encodeRGBToBGR(const uint8_t *line, uint8_t *dst,
+					 unsigned int width)
+{
+	for (unsigned int x = 0; x < width; ++x) {
+		dst[3 * x + 0] = line[3 * x + 2];
+		dst[3 * x + 1] = line[3 * x + 1];
+		dst[3 * x + 2] = line[3 * x + 0];
+	}
+}
+
+void V4L2FormatConverter::encodeRGBToYUYV(const uint8_t *line, uint8_t *dst,
+					  unsigned int width)
+{
+	for (unsigned int x = 0; x < width / 2; ++x) {
+		const uint8_t *p = &line[6 * x];
+		int r = (p[0] + p[3] + 1) / 2;
+		int g = (p[1] + p[4] + 1) / 2;
+		int b = (p[2] + p[5] + 1) / 2;
+
+		dst[4 * x + 0] = rgbToY(p[0], p[1], p[2]);
+		dst[4 * x + 1] = rgbToU(r, g, b);
+		dst[4 * x + 2] = rgbToY(p[3], p[4], p[5]);
+		dst[4 * x + 3] = rgbToV(r, g, b);
+	}
+}
+
+void V4L2FormatConverter::encodeYUYVToRGB(const uint8_t *line, uint8_t *dst,
+					  unsigned int width)
+{
+	for (unsigned int x = 0; x < width / 2; ++x) {
+		const uint8_t *p = &line[4 * x];
+		uint8_t *q = &dst[6 * x];
+
+		yuvToRgb(p[0], p[1], p[3], &q[0], &q[1], &q[2]);
+		yuvToRgb(p[2], p[1], p[3], &q[3], &q[4], &q[5]);
+	}
+}
+
+void V4L2FormatConverter::encodeYUYVToBGR(const uint8_t *line, uint8_t *dst,
+					  unsigned int width)
+{
+	for (unsigned int x = 0; x < width / 2; ++x) {
+		const uint8_t *p = &line[4 * x];
+		uint8_t *q = &dst[6 * x];
+
+		yuvToRgb(p[0], p[1], p[3], &q[2], &q[1], &q[0]);
+		yuvToRgb(p[2], p[1], p[3], &q[5], &q[4], &q[3]);
+	}
+}
@@ -0,0 +1,81 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * v4l2_format_converter.h - V4L2 compatibility pixel format conversion
+ */
+
+#pragma once
+
+#include <array>
+#include <stdint.h>
+#include <vector>
+
+#include <libcamera/base/span.h>
+
+#include <libcamera/geometry.h>
+#include <libcamera/pixel_format.h>
+#include <libcamera/stream.h>
+
+#include "libcamera/internal/bayer_format.h"
+
+class V4L2FormatConverter
+{
+public:
+	V4L2FormatConverter(const libcamera::StreamConfiguration &input,
+			    const libcamera::PixelFormat &output);
+
+	bool isValid() const { return decode_ && (encode_ || direct_); }
+
+	unsigned int stride() const { return outputStride_; }
+	unsigned int frameSize() const { return outputFrameSize_; }
+
+	void convert(const std::vector<libcamera::Span<uint8_t>> &input,
+		     libcamera::Span<uint8_t> output);
+
+	static std::vector<libcamera::PixelFormat>
+	outputFormats(const std::vector<libcamera::PixelFormat> &inputs);
+	static libcamera::PixelFormat
+	inputFormat(const std::vector<libcamera::PixelFormat> &inputs,
+		    const libcamera::PixelFormat &output);
+
+private:
+	using DecodeFunc = void (V4L2FormatConverter::*)(const uint8_t *const *rows,
+							 uint8_t *line);
+	using EncodeFunc = void (*)(const uint8_t *line, uint8_t *dst,
+				    unsigned int width);
+
+	void decodeNV(const uint8_t *const *rows, uint8_t *line);
+	void decodeYUV420(const uint8_t *const *rows, uint8_t *line);
+	void decodePackedYUV(const uint8_t *const *rows, uint8_t *line);
+	void decodeRGB(const uint8_t *const *rows, uint8_t *line);
+	void decodeBayer(const uint8_t *const *rows, uint8_t *line);
+
+	void unpackBayer(const uint8_t *src, uint8_t *dst);
+
+	static void encodeRGBToBGR(const uint8_t *line, uint8_t *dst, unsigned int width);
+	static void encodeRGBToYUYV(const uint8_t *line, uint8_t *dst, unsigned int width);
+	static void encodeYUYVToRGB(const uint8_t *line, uint8_t *dst, unsigned int width);
+	static void encodeYUYVToBGR(const uint8_t *line, uint8_t *dst, unsigned int width);
+
+	libcamera::Size size_;
+	unsigned int outputStride_;
+	unsigned int outputFrameSize_;
+
+	std::vector<unsigned int> strides_;
+	std::vector<unsigned int> verticalSubSampling_;
+
+	DecodeFunc decode_;
+	EncodeFunc encode_;
+	bool direct_;
+	unsigned int linesPerDecode_;
+
+	/* Format-specific decoder parameters. */
+	bool swapChroma_;
+	unsigned int bytesPerPixel_;
+	std::array<unsigned int, 4> offsets_;
+	libcamera::BayerFormat bayer_;
+
+	std::vector<uint8_t> line_;
+	std::array<std::vector<uint8_t>, 2> bayerLines_;
+};
@@ -0,0 +1,96 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * control_serializer.cpp - ControlSerializer benchmark
+ */
+
+#include <iostream>
+#include <vector>
+
+#include <libcamera/control_ids.h>
+#include <libcamera/controls.h>
+
+#include "libcamera/internal/byte_stream_buffer.h"
+#include "libcamera/internal/control_serializer.h"
+
+#include "benchmark.h"
+
+using namespace std;
+using namespace libcamera;
+
+class ControlSerializerBenchmark : public Benchmark
+{
+protected:
+	int init() override
+	{
+		infoMap_ = ControlInfoMap({
+				{ &controls::AeEnable, ControlInfo(false, true) },
+				{ &controls::ExposureTime, ControlInfo(0, 999999) },
+				{ &controls::AnalogueGain, ControlInfo(1.0f, 32.0f) },
+				{ &controls::ColourGains, ControlInfo(0.0f, 32.0f) },
+				{ &controls::Brightness, ControlInfo(-1.0f, 1.0f) },
+				{ &controls::Contrast, ControlInfo(0.0f, 32.0f) },
+				{ &controls::Saturation, ControlInfo(0.0f, 32.0f) },
+			}, controls::controls);
+
+		return TestPass;
+	}
+
+	int benchmark() override
+	{
+		ControlSerializer serializer(ControlSerializer::Role::Proxy);
+		ControlSerializer deserializer(ControlSerializer::Role::Worker);
+
+		/* Serialize the info map once, as the IPA proxies do. */
+		vector<uint8_t> infoData(serializer.binarySize(infoMap_));
+		ByteStreamBuffer infoBuffer(infoData.data(), infoData.size());
+
+		if (serializer.serialize(infoMap_, infoBuffer) < 0) {
+			cerr << "Failed to serialize info map" << endl;
+			return TestFail;
+		}
+
+		ByteStreamBuffer infoReader(const_cast<const uint8_t *>(infoData.data()),
+					    infoData.size());
+		deserializer.deserialize<ControlInfoMap>(infoReader);
+
+		ControlList list(infoMap_);
+		list.set(controls::AeEnable, false);
+		list.set(controls::ExposureTime, 33000);
+		list.set(controls::AnalogueGain, 4.0f);
+		list.set(controls::ColourGains, Span<const float, 2>({ 1.5f, 1.8f }));
+		list.set(controls::Brightness, 0.25f);
+
+		vector<uint8_t> listData(serializer.binarySize(list));
+
+		measure("ControlSerializer::binarySize", [&] {
+			doNotOptimize(serializer.binarySize(list));
+		});
+
+		measure("ControlSerializer::serialize", [&] {
+			ByteStreamBuffer buffer(listData.data(), listData.size());
+			doNotOptimize(serializer.serialize(list, buffer));
+		});
+
+		measure("ControlSerializer::deserialize", [&] {
+			ByteStreamBuffer buffer(const_cast<const uint8_t *>(listData.data()),
+						listData.size());
+			ControlList result = deserializer.deserialize<ControlList>(buffer);
+			doNotOptimize(result);
+		});
+
+		measure("ControlSerializer::infoMap", [&] {
+			ControlSerializer proxy(ControlSerializer::Role::Proxy);
+			ByteStreamBuffer buffer(infoData.data(), infoData.size());
+			doNotOptimize(proxy.serialize(infoMap_, buffer));
+		}, 100);
+
+		return TestPass;
+	}
+
+private:
+	ControlInfoMap infoMap_;
+};
+
+TEST_REGISTER(ControlSerializerBenchmark)
@@ -0,0 +1,91 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * controls.cpp - ControlList benchmark
+ */
+
+#include <libcamera/control_ids.h>
+#include <libcamera/controls.h>
+
+#include "benchmark.h"
+
+using namespace std;
+using namespace libcamera;
+
+class ControlsBenchmark : public Benchmark
+{
+protected:
+	int init() override
+	{
+		infoMap_ = ControlInfoMap({
+				{ &controls::AeEnable, ControlInfo(false, true) },
+				{ &controls::ExposureTime, ControlInfo(0, 999999) },
+				{ &controls::AnalogueGain, ControlInfo(1.0f, 32.0f) },
+				{ &controls::ColourGains, ControlInfo(0.0f, 32.0f) },
+				{ &controls::Brightness, ControlInfo(-1.0f, 1.0f) },
+				{ &controls::Contrast, ControlInfo(0.0f, 32.0f) },
+				{ &controls::Saturation, ControlInfo(0.0f, 32.0f) },
+				{ &controls::FrameDurationLimits, ControlInfo(int64_t(0), int64_t(1000000)) },
+			}, controls::controls);
+
+		return TestPass;
+	}
+
+	/* Fill a list with the controls a typical request carries. */
+	void fill(ControlList &list)
+	{
+		list.set(controls::AeEnable, false);
+		list.set(controls::ExposureTime, 33000);
+		list.set(controls::AnalogueGain, 4.0f);
+		list.set(controls::ColourGains, Span<const float, 2>({ 1.5f, 1.8f }));
+		list.set(controls::Brightness, 0.25f);
+		list.set(controls::FrameDurationLimits,
+			 Span<const int64_t, 2>({ 33333, 33333 }));
+	}
+
+	int benchmark() override
+	{
+		measure("ControlList::set", [&] {
+			ControlList list(infoMap_);
+			fill(list);
+			doNotOptimize(list);
+		});
+
+		ControlList list(infoMap_);
+		fill(list);
+
+		measure("ControlList::get", [&] {
+			doNotOptimize(list.get(controls::ExposureTime));
+			doNotOptimize(list.get(controls::AnalogueGain));
+		});
+
+		measure("ControlList::contains", [&] {
+			doNotOptimize(list.contains(controls::Brightness));
+			doNotOptimize(list.contains(controls::Contrast));
+		});
+
+		measure("ControlList::copy", [&] {
+			ControlList copy(list);
+			doNotOptimize(copy);
+		});
+
+		measure("ControlList::merge", [&] {
+			ControlList merged(infoMap_);
+			merged.merge(list);
+			doNotOptimize(merged);
+		});
+
+		measure("ControlInfoMap::find", [&] {
+			doNotOptimize(infoMap_.find(controls::ExposureTime.id()));
+			doNotOptimize(infoMap_.find(&controls::Saturation));
+		});
+
+		return TestPass;
+	}
+
+private:
+	ControlInfoMap infoMap_;
+};
+
+TEST_REGISTER(ControlsBenchmark)
@@ -0,0 +1,158 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * grid_statistics.cpp - libipa grid statistics benchmark
+ */
+
+#include <algorithm>
+#include <array>
+#include <random>
+#include <stdint.h>
+#include <vector>
+
+#include "libipa/grid_statistics.h"
+
+#include "benchmark.h"
+
+using namespace std;
+using namespace libcamera;
+using namespace libcamera::ipa;
+
+/*
+ * Synthetic statistics grid, with the dimensions and zone layout used by the
+ * IPU3 IPA for a 1280x720 output.
+ */
+static constexpr unsigned int kGridWidth = 80;
+static constexpr unsigned int kGridHeight = 45;
+static constexpr unsigned int kZonesX = 16;
+static constexpr unsigned int kZonesY = 12;
+static constexpr unsigned int kCellsPerZoneX = 5;
+static constexpr unsigned int kCellsPerZoneY = 4;
+static constexpr uint8_t kSaturationThreshold = 229;
+static constexpr unsigned int kLuminanceIterations = 8;
+
+struct Cell {
+	uint8_t red;
+	uint8_t green;
+	uint8_t blue;
+	uint8_t saturation;
+};
+
+class GridStatisticsBenchmark : public Benchmark
+{
+protected:
+	int init() override
+	{
+		std::mt19937 gen(42);
+		std::uniform_int_distribution<unsigned int> value(0, 255);
+
+		cells_.resize(kGridWidth * kGridHeight);
+		for (Cell &cell : cells_)
+			cell = { static_cast<uint8_t>(value(gen)),
+				 static_cast<uint8_t>(value(gen)),
+				 static_cast<uint8_t>(value(gen)),
+				 static_cast<uint8_t>(value(gen)) };
+
+		return TestPass;
+	}
+
+	/*
+	 * One AWB and AGC iteration, walking the grid for each reduction as the
+	 * IPU3 IPA did before using GridStatistics.
+	 */
+	double reference()
+	{
+		std::array<GridStatistics::Zone, kZonesX * kZonesY> zones{};
+		std::array<uint32_t, GridStatistics::kNumBins> hist{};
+		double sum = 0.0;
+
+		const unsigned int height = std::min(kZonesY * kCellsPerZoneY, kGridHeight);
+		const unsigned int width = std::min(kZonesX * kCellsPerZoneX, kGridWidth);
+
+		for (unsigned int y = 0; y < height; y++) {
+			for (unsigned int x = 0; x < width; x++) {
+				const Cell &cell = cells_[y * kGridWidth + x];
+				if (cell.saturation > kSaturationThreshold)
+					continue;
+
+				GridStatistics::Zone &zone =
+					zones[y / kCellsPerZoneY * kZonesX + x / kCellsPerZoneX];
+				zone.counted++;
+				zone.sum[GridStatistics::Red] += cell.red;
+				zone.sum[GridStatistics::Green] += cell.green;
+				zone.sum[GridStatistics::Blue] += cell.blue;
+			}
+		}
+
+		for (const Cell &cell : cells_)
+			hist[cell.green]++;
+
+		double gain = 1.0;
+		for (unsigned int i = 0; i < kLuminanceIterations; i++) {
+			for (const Cell &cell : cells_)
+				sum += std::min(cell.red * gain, 255.0)
+				     + std::min(cell.green * gain, 255.0)
+				     + std::min(cell.blue * gain, 255.0);
+			gain *= 1.1;
+		}
+
+		return sum + zones[0].counted + hist[0];
+	}
+
+	/* One AWB and AGC iteration with the single-pass reduction. */
+	double singlePass(GridStatistics &stats)
+	{
+		std::array<uint8_t, kGridWidth> red;
+		std::array<uint8_t, kGridWidth> green;
+		std::array<uint8_t, kGridWidth> blue;
+		std::array<uint8_t, kGridWidth> saturation;
+		double sum = 0.0;
+
+		stats.reset();
+
+		for (unsigned int y = 0; y < kGridHeight; y++) {
+			const Cell *row = &cells_[y * kGridWidth];
+
+			for (unsigned int x = 0; x < kGridWidth; x++) {
+				red[x] = row[x].red;
+				green[x] = row[x].green;
+				blue[x] = row[x].blue;
+				saturation[x] = row[x].saturation;
+			}
+
+			stats.accumulateRow(y, red, green, blue, saturation);
+		}
+
+		double gain = 1.0;
+		for (unsigned int i = 0; i < kLuminanceIterations; i++) {
+			sum += stats.clippedSum(GridStatistics::Red, gain)
+			     + stats.clippedSum(GridStatistics::Green, gain)
+			     + stats.clippedSum(GridStatistics::Blue, gain);
+			gain *= 1.1;
+		}
+
+		return sum;
+	}
+
+	int benchmark() override
+	{
+		GridStatistics stats;
+		stats.configure({ kGridWidth, kGridHeight });
+		stats.setZones({ kZonesX, kZonesY },
+			       { kCellsPerZoneX, kCellsPerZoneY },
+			       kSaturationThreshold);
+
+		measure("Grid statistics reference",
+			[&] { doNotOptimize(reference()); }, 10);
+		measure("Grid statistics single pass",
+			[&] { doNotOptimize(singlePass(stats)); }, 10);
+
+		return TestPass;
+	}
+
+private:
+	std::vector<Cell> cells_;
+};
+
+TEST_REGISTER(GridStatisticsBenchmark)
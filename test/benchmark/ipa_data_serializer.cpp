@@ -0,0 +1,156 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * ipa_data_serializer.cpp - IPA interfaces serialization benchmark
+ */
+
+#include <fcntl.h>
+#include <map>
+#include <string>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
+
+#include <libcamera/base/shared_fd.h>
+#include <libcamera/base/unique_fd.h>
+
+#include <libcamera/control_ids.h>
+
+#include <libcamera/ipa/core_ipa_serializer.h>
+#include <libcamera/ipa/ipu3_ipa_serializer.h>
+#include <libcamera/ipa/raspberrypi_ipa_serializer.h>
+
+#include "libcamera/internal/control_serializer.h"
+#include "libcamera/internal/ipa_data_serializer.h"
+
+#include "benchmark.h"
+
+using namespace std;
+using namespace libcamera;
+
+static constexpr unsigned int kNumBuffers = 8;
+
+class IPADataSerializerBenchmark : public Benchmark
+{
+protected:
+	int init() override
+	{
+		infoMap_ = ControlInfoMap({
+				{ &controls::AeEnable, ControlInfo(false, true) },
+				{ &controls::ExposureTime, ControlInfo(0, 999999) },
+				{ &controls::AnalogueGain, ControlInfo(1.0f, 32.0f) },
+				{ &controls::ColourGains, ControlInfo(0.0f, 32.0f) },
+				{ &controls::Brightness, ControlInfo(-1.0f, 1.0f) },
+				{ &controls::Contrast, ControlInfo(0.0f, 32.0f) },
+				{ &controls::Saturation, ControlInfo(0.0f, 32.0f) },
+			}, controls::controls);
+
+		fd_ = SharedFD(UniqueFD(open("/dev/null", O_RDONLY | O_CLOEXEC)));
+		if (!fd_.isValid())
+			return TestFail;
+
+		return TestPass;
+	}
+
+	ControlList makeControls()
+	{
+		ControlList ctrls(infoMap_);
+		ctrls.set(controls::AeEnable, true);
+		ctrls.set(controls::ExposureTime, 33000);
+		ctrls.set(controls::AnalogueGain, 4.0f);
+		ctrls.set(controls::ColourGains, Span<const float, 2>({ 1.5f, 1.8f }));
+		ctrls.set(controls::Brightness, 0.25f);
+		return ctrls;
+	}
+
+	/*
+	 * Measure the serialization of \a data, both through the allocating API
+	 * and by appending to a reused pair of buffers.
+	 */
+	template<typename T>
+	void measureSerialize(const string &name, const T &data)
+	{
+		ControlSerializer serializer(ControlSerializer::Role::Proxy);
+		vector<uint8_t> buffer;
+		vector<SharedFD> fds;
+
+		/* Serialize once to cache the ControlInfoMap in the serializer. */
+		tie(buffer, fds) = IPADataSerializer<T>::serialize(data, &serializer);
+
+		measure(name + " serialize", [&] {
+			tie(buffer, fds) = IPADataSerializer<T>::serialize(data, &serializer);
+			doNotOptimize(buffer.size());
+		});
+
+		measure(name + " serialize append", [&] {
+			buffer.clear();
+			fds.clear();
+			IPADataSerializer<T>::serialize(data, buffer, fds, &serializer);
+			doNotOptimize(buffer.size());
+		});
+	}
+
+	int benchmark() override
+	{
+		/* IPU3 */
+		ipa::ipu3::IPU3Event event;
+		event.op = ipa::ipu3::EventStatReady;
+		event.frame = 42;
+		event.frameTimestamp = 123456789;
+		event.bufferId = 3;
+		event.controls = makeControls();
+		event.sensorControls = makeControls();
+		event.lensControls = makeControls();
+
+		ipa::ipu3::IPAConfigInfo configInfo;
+		configInfo.sensorInfo.model = "imx258";
+		configInfo.sensorInfo.outputSize = Size(4096, 3072);
+		configInfo.sensorControls = infoMap_;
+		configInfo.lensControls = infoMap_;
+		configInfo.bdsOutputSize = Size(2560, 1920);
+		configInfo.iif = Size(4096, 3072);
+
+		/* RkISP1 */
+		map<uint32_t, IPAStream> streamConfig = {
+			{ 1, IPAStream(0x1234, Size(1920, 1080)) },
+			{ 2, IPAStream(0x5678, Size(640, 480)) },
+		};
+
+		/* Raspberry Pi */
+		ipa::RPi::ISPConfig ispConfig;
+		ispConfig.embeddedBufferId = 1;
+		ispConfig.bayerBufferId = 2;
+		ispConfig.embeddedBufferPresent = true;
+		ispConfig.controls = makeControls();
+
+		ipa::RPi::IPAConfig ipaConfig;
+		ipaConfig.transform = 3;
+		ipaConfig.lsTableHandle = fd_;
+
+		/* Buffers mapping, common to all IPA modules. */
+		vector<IPABuffer> buffers;
+		for (unsigned int i = 0; i < kNumBuffers; i++) {
+			FrameBuffer::Plane plane;
+			plane.fd = fd_;
+			plane.offset = 0;
+			plane.length = 4096;
+			buffers.emplace_back(i, vector<FrameBuffer::Plane>{ plane });
+		}
+
+		measureSerialize("ipu3::IPU3Event", event);
+		measureSerialize("ipu3::IPAConfigInfo", configInfo);
+		measureSerialize("rkisp1 streamConfig", streamConfig);
+		measureSerialize("RPi::ISPConfig", ispConfig);
+		measureSerialize("RPi::IPAConfig", ipaConfig);
+		measureSerialize("vector<IPABuffer>", buffers);
+
+		return TestPass;
+	}
+
+private:
+	ControlInfoMap infoMap_;
+	SharedFD fd_;
+};
+
+TEST_REGISTER(IPADataSerializerBenchmark)
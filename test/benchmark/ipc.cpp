@@ -0,0 +1,105 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * ipc.cpp - IPCUnixSocket benchmark
+ */
+
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+
+#include <libcamera/base/event_dispatcher.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/unique_fd.h>
+
+#include "libcamera/internal/ipc_unixsocket.h"
+
+#include "benchmark.h"
+
+using namespace std;
+using namespace libcamera;
+
+class IPCBenchmark : public Benchmark
+{
+protected:
+	int init() override
+	{
+		UniqueFD fd = sender_.create();
+		if (!fd.isValid() || receiver_.bind(std::move(fd))) {
+			cerr << "Failed to create IPC socket pair" << endl;
+			return TestFail;
+		}
+
+		receiver_.readyRead.connect(this, &IPCBenchmark::readyRead);
+
+		fd_ = UniqueFD(open("/dev/null", O_RDONLY | O_CLOEXEC));
+		if (!fd_.isValid()) {
+			cerr << "Failed to open /dev/null" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	void readyRead()
+	{
+		receiver_.receive(&received_);
+
+		for (int32_t fd : received_.fds)
+			close(fd);
+
+		receivedCount_++;
+	}
+
+	/* Send a message and wait for the receiver to read it. */
+	void roundTrip(const IPCUnixSocket::Payload &payload)
+	{
+		EventDispatcher *dispatcher = Thread::current()->eventDispatcher();
+		unsigned int count = receivedCount_ + 1;
+
+		sender_.send(payload);
+
+		while (receivedCount_ < count)
+			dispatcher->processEvents();
+	}
+
+	int benchmark() override
+	{
+		receivedCount_ = 0;
+
+		IPCUnixSocket::Payload small;
+		small.data.resize(64);
+
+		IPCUnixSocket::Payload large;
+		large.data.resize(4096);
+
+		IPCUnixSocket::Payload withFd;
+		withFd.data.resize(64);
+		withFd.fds.push_back(fd_.get());
+
+		measure("IPCUnixSocket::send/receive 64B",
+			[&] { roundTrip(small); }, 100);
+		measure("IPCUnixSocket::send/receive 4KiB",
+			[&] { roundTrip(large); }, 100);
+		measure("IPCUnixSocket::send/receive 64B+fd",
+			[&] { roundTrip(withFd); }, 100);
+
+		if (received_.data.size() != 64 || received_.fds.size() != 1) {
+			cerr << "Invalid payload received" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+private:
+	IPCUnixSocket sender_;
+	IPCUnixSocket receiver_;
+	IPCUnixSocket::Payload received_;
+	unsigned int receivedCount_;
+
+	UniqueFD fd_;
+};
+
+TEST_REGISTER(IPCBenchmark)
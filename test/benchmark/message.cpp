@@ -0,0 +1,117 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * message.cpp - Message passing benchmark
+ */
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+
+#include <libcamera/base/message.h>
+#include <libcamera/base/object.h>
+#include <libcamera/base/thread.h>
+
+#include "benchmark.h"
+
+using namespace std;
+using namespace libcamera;
+
+namespace {
+
+class Receiver : public Object
+{
+public:
+	Receiver()
+		: count_(0)
+	{
+	}
+
+	void method(int value)
+	{
+		count_ += value;
+	}
+
+	int methodWithReturn(int value)
+	{
+		return value;
+	}
+
+	unsigned int count() const { return count_; }
+
+protected:
+	void message(Message *msg) override
+	{
+		if (msg->type() >= Message::UserMessage) {
+			count_++;
+			return;
+		}
+
+		Object::message(msg);
+	}
+
+private:
+	std::atomic<unsigned int> count_;
+};
+
+} /* namespace */
+
+class MessageBenchmark : public Benchmark
+{
+protected:
+	int init() override
+	{
+		remote_.moveToThread(&thread_);
+		thread_.start();
+
+		return TestPass;
+	}
+
+	int benchmark() override
+	{
+		Thread *current = Thread::current();
+		Message::Type type = Message::registerMessageType();
+
+		measure("Thread::postMessage+dispatch", [&] {
+			local_.postMessage(std::make_unique<Message>(type));
+			current->dispatchMessages(type);
+		});
+
+		measure("Thread::postMessage cross-thread", [&] {
+			remote_.postMessage(std::make_unique<Message>(type));
+		});
+
+		measure("Object::invokeMethod queued", [&] {
+			remote_.invokeMethod(&Receiver::method,
+					     ConnectionTypeQueued, 1);
+		});
+
+		measure("Object::invokeMethod blocking", [&] {
+			doNotOptimize(remote_.invokeMethod(&Receiver::methodWithReturn,
+							   ConnectionTypeBlocking, 1));
+		}, 100);
+
+		unsigned int expected = (kWarmupSamples + kSamples) * 1000 * 2;
+		if (remote_.count() != expected) {
+			cerr << "Lost messages, expected " << expected
+			     << ", got " << remote_.count() << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	void cleanup() override
+	{
+		thread_.exit(0);
+		thread_.wait();
+	}
+
+private:
+	Thread thread_;
+	Receiver local_;
+	Receiver remote_;
+};
+
+TEST_REGISTER(MessageBenchmark)
@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * pixel_format.cpp - PixelFormatInfo benchmark
+ */
+
+#include <libcamera/formats.h>
+#include <libcamera/geometry.h>
+
+#include "libcamera/internal/formats.h"
+#include "libcamera/internal/v4l2_pixelformat.h"
+
+#include "benchmark.h"
+
+using namespace std;
+using namespace libcamera;
+
+class PixelFormatBenchmark : public Benchmark
+{
+protected:
+	int benchmark() override
+	{
+		measure("PixelFormatInfo::info(PixelFormat)", [&] {
+			doNotOptimize(PixelFormatInfo::info(formats::NV12));
+			doNotOptimize(PixelFormatInfo::info(formats::SRGGB10_CSI2P));
+		});
+
+		V4L2PixelFormat v4l2Format(V4L2_PIX_FMT_NV12);
+		measure("PixelFormatInfo::info(V4L2PixelFormat)", [&] {
+			doNotOptimize(PixelFormatInfo::info(v4l2Format));
+		});
+
+		measure("PixelFormatInfo::info(string)", [&] {
+			doNotOptimize(PixelFormatInfo::info("NV12"));
+		});
+
+		const PixelFormatInfo &info = PixelFormatInfo::info(formats::NV12);
+		Size size(1920, 1080);
+
+		measure("PixelFormatInfo::stride", [&] {
+			doNotOptimize(info.stride(size.width, 0, 64));
+		});
+
+		measure("PixelFormatInfo::frameSize", [&] {
+			doNotOptimize(info.frameSize(size, 64));
+		});
+
+		measure("PixelFormat::toString", [&] {
+			doNotOptimize(formats::NV12.toString());
+		});
+
+		measure("PixelFormat::fromString", [&] {
+			doNotOptimize(PixelFormat::fromString("NV12"));
+		});
+
+		return TestPass;
+	}
+};
+
+TEST_REGISTER(PixelFormatBenchmark)
@@ -0,0 +1,142 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * signal.cpp - Signal emission benchmark
+ */
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <libcamera/base/object.h>
+#include <libcamera/base/signal.h>
+
+#include "benchmark.h"
+
+using namespace std;
+using namespace libcamera;
+
+namespace {
+
+class Receiver
+{
+public:
+	void slot(int value) { sum_ += value; }
+
+	int sum_ = 0;
+};
+
+class ObjectReceiver : public Object
+{
+public:
+	void slot(int value) { sum_ += value; }
+
+	int sum_ = 0;
+};
+
+/*
+ * Run a background activity in threads for the lifetime of the instance, to
+ * measure the cost of emission under contention. The function is called with
+ * the index of the thread.
+ */
+class BackgroundThreads
+{
+public:
+	template<typename Func>
+	BackgroundThreads(unsigned int count, Func func)
+		: stop_(false)
+	{
+		for (unsigned int i = 0; i < count; ++i)
+			threads_.emplace_back([this, func, i]() {
+				while (!stop_.load(std::memory_order_relaxed))
+					func(i);
+			});
+	}
+
+	~BackgroundThreads()
+	{
+		stop_ = true;
+		for (std::thread &thread : threads_)
+			thread.join();
+	}
+
+private:
+	std::atomic<bool> stop_;
+	std::vector<std::thread> threads_;
+};
+
+} /* namespace */
+
+class SignalBenchmark : public Benchmark
+{
+protected:
+	int benchmark() override
+	{
+		Signal<int> unconnected;
+		measure("Signal::emit 0 slot", [&] { unconnected.emit(1); });
+
+		Receiver receiver;
+		Signal<int> plain;
+		plain.connect(&receiver, &Receiver::slot);
+		measure("Signal::emit 1 slot", [&] { plain.emit(1); });
+
+		ObjectReceiver objectReceiver;
+		Signal<int> object;
+		object.connect(&objectReceiver, &ObjectReceiver::slot);
+		measure("Signal::emit 1 Object slot", [&] { object.emit(1); });
+
+		Receiver receivers[4];
+		Signal<int> multiple;
+		for (Receiver &r : receivers)
+			multiple.connect(&r, &Receiver::slot);
+		measure("Signal::emit 4 slots", [&] { multiple.emit(1); });
+
+		int sum = 0;
+		Signal<int> lambda;
+		lambda.connect(&objectReceiver, [&](int value) { sum += value; });
+		measure("Signal::emit 1 functor", [&] { lambda.emit(1); });
+
+		/*
+		 * Emit a signal while other threads emit their own signals, to
+		 * check that emission of different signals doesn't contend.
+		 */
+		for (unsigned int count : { 1, 3, 7 }) {
+			std::vector<Receiver> others(count);
+			std::vector<Signal<int>> signals(count);
+			for (unsigned int i = 0; i < count; ++i)
+				signals[i].connect(&others[i], &Receiver::slot);
+
+			BackgroundThreads emitters(count, [&](unsigned int i) {
+				signals[i].emit(1);
+			});
+
+			measure("Signal::emit 1 slot, " + std::to_string(count) + " emitters",
+				[&] { plain.emit(1); });
+		}
+
+		/* Emit a signal while another thread connects and disconnects it. */
+		{
+			Receiver other;
+			BackgroundThreads writer(1, [&]([[maybe_unused]] unsigned int i) {
+				plain.connect(&other, &Receiver::slot);
+				plain.disconnect(&other, &Receiver::slot);
+			});
+
+			measure("Signal::emit 1 slot, 1 writer", [&] { plain.emit(1); });
+		}
+
+		measure("Signal::connect/disconnect", [&] {
+			Signal<int> signal;
+			signal.connect(&receiver, &Receiver::slot);
+			signal.disconnect(&receiver);
+		});
+
+		doNotOptimize(receiver.sum_ + objectReceiver.sum_ + sum);
+
+		return TestPass;
+	}
+};
+
+TEST_REGISTER(SignalBenchmark)
@@ -0,0 +1,114 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * timer.cpp - Timer start and stop benchmark
+ */
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <libcamera/base/thread.h>
+#include <libcamera/base/timer.h>
+
+#include "benchmark.h"
+
+using namespace std;
+using namespace libcamera;
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr unsigned int kTimers = 1000;
+
+/*
+ * Keep kTimers timers armed with deadlines spread over one second, as a
+ * pipeline handler arming per-frame timeouts would, and rearm them in turn.
+ */
+class ArmedTimers
+{
+public:
+	ArmedTimers()
+		: begin_(chrono::steady_clock::now()), next_(0)
+	{
+		for (unsigned int i = 0; i < kTimers; ++i) {
+			timers_.push_back(make_unique<Timer>());
+			timers_.back()->start(begin_ + 1s + i * 1ms);
+		}
+	}
+
+	void rearm()
+	{
+		Timer *timer = timers_[next_].get();
+		timer->stop();
+		timer->start(begin_ + 1s + next_ * 1ms);
+
+		next_ = (next_ + 1) % kTimers;
+	}
+
+private:
+	chrono::steady_clock::time_point begin_;
+	vector<unique_ptr<Timer>> timers_;
+	unsigned int next_;
+};
+
+/* Rearm timers in a separate thread, to measure the cost under contention. */
+class BackgroundThread : public Thread
+{
+public:
+	BackgroundThread()
+		: stop_(false)
+	{
+	}
+
+	void stop() { stop_ = true; }
+
+protected:
+	void run() override
+	{
+		ArmedTimers timers;
+
+		while (!stop_.load(std::memory_order_relaxed))
+			timers.rearm();
+	}
+
+private:
+	std::atomic<bool> stop_;
+};
+
+} /* namespace */
+
+class TimerBenchmark : public Benchmark
+{
+protected:
+	int benchmark() override
+	{
+		ArmedTimers timers;
+
+		measure("Timer stop/start " + to_string(kTimers) + " armed",
+			[&] { timers.rearm(); });
+
+		for (unsigned int count : { 1, 3 }) {
+			vector<unique_ptr<BackgroundThread>> threads;
+			for (unsigned int i = 0; i < count; ++i) {
+				threads.push_back(make_unique<BackgroundThread>());
+				threads.back()->start();
+			}
+
+			measure("Timer stop/start, " + to_string(count) + " threads",
+				[&] { timers.rearm(); });
+
+			for (unique_ptr<BackgroundThread> &thread : threads) {
+				thread->stop();
+				thread->wait();
+			}
+		}
+
+		return TestPass;
+	}
+};
+
+TEST_REGISTER(TimerBenchmark)
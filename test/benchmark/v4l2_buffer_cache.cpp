@@ -0,0 +1,93 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * v4l2_buffer_cache.cpp - V4L2BufferCache benchmark
+ */
+
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <libcamera/base/shared_fd.h>
+#include <libcamera/base/unique_fd.h>
+
+#include <libcamera/framebuffer.h>
+
+#include "libcamera/internal/v4l2_videodevice.h"
+
+#include "benchmark.h"
+
+using namespace std;
+using namespace libcamera;
+
+class V4L2BufferCacheBenchmark : public Benchmark
+{
+protected:
+	static constexpr unsigned int kNumBuffers = 8;
+
+	int init() override
+	{
+		/* Create multi-planar buffers, each backed by distinct fds. */
+		for (unsigned int i = 0; i < kNumBuffers; ++i) {
+			std::vector<FrameBuffer::Plane> planes;
+
+			for (unsigned int j = 0; j < 2; ++j) {
+				UniqueFD fd(open("/dev/null", O_RDONLY | O_CLOEXEC));
+				if (!fd.isValid()) {
+					cerr << "Failed to open /dev/null" << endl;
+					return TestFail;
+				}
+
+				FrameBuffer::Plane plane;
+				plane.fd = SharedFD(std::move(fd));
+				plane.offset = 0;
+				plane.length = 4096;
+				planes.push_back(std::move(plane));
+			}
+
+			buffers_.push_back(std::make_unique<FrameBuffer>(planes));
+		}
+
+		return TestPass;
+	}
+
+	int benchmark() override
+	{
+		unsigned int index = 0;
+
+		/* Buffers cycling in the same order, always hitting the cache. */
+		V4L2BufferCache hot(buffers_);
+		measure("V4L2BufferCache::get/put hit", [&] {
+			const FrameBuffer &buffer = *buffers_[index++ % kNumBuffers];
+			int entry = hot.get(buffer);
+			hot.put(entry);
+		});
+
+		/* Buffers imported in a cache too small to hold them all. */
+		V4L2BufferCache small(kNumBuffers / 2);
+		measure("V4L2BufferCache::get/put miss", [&] {
+			const FrameBuffer &buffer = *buffers_[index++ % kNumBuffers];
+			int entry = small.get(buffer);
+			small.put(entry);
+		});
+
+		/* All buffers queued at once, as with a deep request queue. */
+		V4L2BufferCache full(kNumBuffers);
+		measure("V4L2BufferCache::get full queue", [&] {
+			int entries[kNumBuffers];
+			for (unsigned int i = 0; i < kNumBuffers; ++i)
+				entries[i] = full.get(*buffers_[i]);
+			for (unsigned int i = 0; i < kNumBuffers; ++i)
+				full.put(entries[i]);
+		}, 100);
+
+		return TestPass;
+	}
+
+private:
+	std::vector<std::unique_ptr<FrameBuffer>> buffers_;
+};
+
+TEST_REGISTER(V4L2BufferCacheBenchmark)
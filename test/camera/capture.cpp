@@ -161,6 +161,23 @@ protected:
 			return TestFail;
 		}
 
+		CameraStatistics stats = camera_->statistics();
+		const StreamStatistics &streamStats = stats.streams[stream];
+
+		if (stats.requestsCompleted - stats.requestsCancelled != completeRequestsCount_ ||
+		    streamStats.framesDelivered != completeBuffersCount_) {
+			cout << "Camera statistics don't match completed requests" << endl;
+			return TestFail;
+		}
+
+		if (!streamStats.avgFrameInterval.count() ||
+		    streamStats.minFrameInterval > streamStats.avgFrameInterval ||
+		    streamStats.avgFrameInterval > streamStats.maxFrameInterval ||
+		    streamStats.p99FrameInterval > streamStats.maxFrameInterval) {
+			cout << "Invalid frame interval statistics" << endl;
+			return TestFail;
+		}
+
 		return TestPass;
 	}
 
@@ -0,0 +1,213 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * libcamera request completion queue tests
+ */
+
+#include <iostream>
+
+#include <libcamera/completion_queue.h>
+
+#include <libcamera/base/event_notifier.h>
+
+#include "virtual_camera_test.h"
+
+using namespace libcamera;
+using namespace std;
+using namespace std::chrono_literals;
+
+namespace {
+
+class CompletionQueueTest : public VirtualCameraTest
+{
+public:
+	CompletionQueueTest()
+		: VirtualCameraTest("320x240@0"), queue_(4)
+	{
+	}
+
+protected:
+	void requestComplete([[maybe_unused]] Request *request)
+	{
+		signalledRequestsCount_++;
+	}
+
+	void completionAvailable()
+	{
+		RequestCompletion completion;
+
+		while (queue_.pop(&completion)) {
+			Request *request = completion.request;
+
+			if (completion.cookie != request->cookie() ||
+			    completion.status != request->status() ||
+			    completion.sequence != request->sequence())
+				invalidCompletions_++;
+
+			if (completion.status != Request::RequestComplete)
+				continue;
+
+			if (!completion.timestamp)
+				invalidCompletions_++;
+
+			completeRequestsCount_++;
+
+			request->reuse(Request::ReuseBuffers);
+			camera_->queueRequest(request);
+		}
+	}
+
+	int testQueue()
+	{
+		RequestCompletionQueue queue(3);
+		RequestCompletion completion = {};
+
+		if (!queue.isValid()) {
+			cout << "Failed to create completion queue" << endl;
+			return TestFail;
+		}
+
+		if (queue.pop(&completion)) {
+			cout << "Empty queue returned a completion" << endl;
+			return TestFail;
+		}
+
+		/* The queue size is rounded up to 4. */
+		for (unsigned int i = 0; i < 4; ++i) {
+			completion.cookie = i;
+			if (!queue.push(completion)) {
+				cout << "Failed to push completion " << i << endl;
+				return TestFail;
+			}
+		}
+
+		if (queue.push(completion)) {
+			cout << "Full queue accepted a completion" << endl;
+			return TestFail;
+		}
+
+		for (unsigned int i = 0; i < 4; ++i) {
+			if (!queue.pop(&completion) || completion.cookie != i) {
+				cout << "Failed to pop completion " << i << endl;
+				return TestFail;
+			}
+		}
+
+		if (queue.pop(&completion)) {
+			cout << "Drained queue returned a completion" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int init() override
+	{
+		int ret = VirtualCameraTest::init();
+		if (ret != TestPass)
+			return ret;
+
+		if (!queue_.isValid())
+			return TestFail;
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		int ret = testQueue();
+		if (ret != TestPass)
+			return ret;
+
+		ret = configureCamera();
+		if (ret != TestPass)
+			return ret;
+
+		ret = createRequests();
+		if (ret != TestPass)
+			return ret;
+
+		std::vector<Request *> batch;
+		for (std::unique_ptr<Request> &request : requests_)
+			batch.push_back(request.get());
+
+		ret = camera_->setCompletionHandler([this](const RequestCompletion &completion) {
+			return queue_.push(completion);
+		});
+		if (ret) {
+			cout << "Failed to set completion handler" << endl;
+			return TestFail;
+		}
+
+		EventNotifier notifier(queue_.fd().get(), EventNotifier::Read);
+		notifier.activated.connect(this, &CompletionQueueTest::completionAvailable);
+
+		camera_->requestCompleted.connect(this, &CompletionQueueTest::requestComplete);
+
+		completeRequestsCount_ = 0;
+		signalledRequestsCount_ = 0;
+		invalidCompletions_ = 0;
+
+		if (camera_->start()) {
+			cout << "Failed to start camera" << endl;
+			return TestFail;
+		}
+
+		if (camera_->setCompletionHandler({}) != -EACCES) {
+			cout << "Completion handler changed while running" << endl;
+			return TestFail;
+		}
+
+		if (camera_->queueRequests(batch)) {
+			cout << "Failed to queue requests" << endl;
+			return TestFail;
+		}
+
+		runCapture(500ms);
+
+		if (camera_->stop()) {
+			cout << "Failed to stop camera" << endl;
+			return TestFail;
+		}
+
+		/* Drain the completions of the requests cancelled by stop(). */
+		RequestCompletion completion;
+		while (queue_.pop(&completion)) {
+			if (completion.status != Request::RequestCancelled)
+				completeRequestsCount_++;
+		}
+
+		if (completeRequestsCount_ < 30) {
+			cout << "Failed to capture enough frames" << endl;
+			return TestFail;
+		}
+
+		if (invalidCompletions_) {
+			cout << invalidCompletions_ << " invalid completions" << endl;
+			return TestFail;
+		}
+
+		/*
+		 * The queue holds as many completions as there are requests, no
+		 * completion shall thus be reported through the signal.
+		 */
+		if (signalledRequestsCount_) {
+			cout << signalledRequestsCount_
+			     << " completions reported through the signal" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	RequestCompletionQueue queue_;
+
+	unsigned int completeRequestsCount_;
+	unsigned int signalledRequestsCount_;
+	unsigned int invalidCompletions_;
+};
+
+} /* namespace */
+
+TEST_REGISTER(CompletionQueueTest)
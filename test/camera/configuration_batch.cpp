@@ -0,0 +1,103 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * libcamera Camera API tests
+ *
+ * Validate a list of candidate stream configurations in a single call
+ */
+
+#include <iostream>
+#include <vector>
+
+#include "camera_test.h"
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+
+namespace {
+
+class ConfigurationBatch : public CameraTest, public Test
+{
+public:
+	ConfigurationBatch()
+		: CameraTest("platform/vimc.0 Sensor B")
+	{
+	}
+
+protected:
+	int init() override
+	{
+		return status_;
+	}
+
+	int run() override
+	{
+		std::unique_ptr<CameraConfiguration> config =
+			camera_->generateConfiguration({ StreamRole::Viewfinder });
+		if (!config || config->size() != 1) {
+			cout << "Failed to generate default configuration" << endl;
+			return TestFail;
+		}
+
+		const StreamConfiguration &defaults = config->at(0);
+		const std::vector<Size> sizes = {
+			defaults.size,
+			{ 640, 480 },
+			{ 1, 1 },
+			{ 65536, 65536 },
+		};
+
+		std::vector<StreamConfiguration> candidates;
+		for (const Size &size : sizes) {
+			StreamConfiguration cfg;
+			cfg.pixelFormat = defaults.pixelFormat;
+			cfg.size = size;
+			candidates.push_back(cfg);
+		}
+
+		std::vector<CameraConfiguration::Status> statuses =
+			camera_->validateConfigurations(StreamRole::Viewfinder,
+							candidates);
+		if (statuses.size() != candidates.size()) {
+			cout << "Invalid number of validation results" << endl;
+			return TestFail;
+		}
+
+		/*
+		 * The batch validation must produce the same results as
+		 * validating each candidate individually.
+		 */
+		for (unsigned int i = 0; i < sizes.size(); ++i) {
+			config = camera_->generateConfiguration({ StreamRole::Viewfinder });
+			StreamConfiguration &cfg = config->at(0);
+			cfg.size = sizes[i];
+
+			CameraConfiguration::Status status = config->validate();
+			if (status != statuses[i]) {
+				cout << "Status mismatch for " << sizes[i].toString()
+				     << endl;
+				return TestFail;
+			}
+
+			if (cfg.toString() != candidates[i].toString() ||
+			    cfg.bufferCount != candidates[i].bufferCount) {
+				cout << "Configuration mismatch for "
+				     << sizes[i].toString() << endl;
+				return TestFail;
+			}
+		}
+
+		if (statuses[0] != CameraConfiguration::Valid) {
+			cout << "Default configuration not reported as valid" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+};
+
+} /* namespace */
+
+TEST_REGISTER(ConfigurationBatch)
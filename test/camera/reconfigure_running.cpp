@@ -0,0 +1,130 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * libcamera running camera reconfiguration tests
+ */
+
+#include <iostream>
+
+#include <libcamera/base/object.h>
+
+#include "virtual_camera_test.h"
+
+using namespace libcamera;
+using namespace std;
+using namespace std::chrono_literals;
+
+namespace {
+
+/*
+ * The virtual pipeline handler has a single sensor mode, and its reconfigure()
+ * implementation is a no-op. This test thus covers the checks performed by
+ * Camera::reconfigure() and the request flow across a reconfiguration, but not
+ * the sensor mode switch of the hardware pipeline handlers.
+ */
+class ReconfigureRunningTest : public Object, public VirtualCameraTest
+{
+public:
+	ReconfigureRunningTest()
+		: VirtualCameraTest("320x240@0")
+	{
+	}
+
+protected:
+	void requestComplete(Request *request)
+	{
+		if (request->status() != Request::RequestComplete) {
+			cancelledRequestsCount_++;
+			return;
+		}
+
+		completeRequestsCount_++;
+
+		request->reuse(Request::ReuseBuffers);
+		camera_->queueRequest(request);
+	}
+
+	int run() override
+	{
+		int ret = configureCamera();
+		if (ret != TestPass)
+			return ret;
+
+		if (camera_->reconfigure(config_.get()) != -EACCES) {
+			cout << "Camera reconfigured while not running" << endl;
+			return TestFail;
+		}
+
+		ret = createRequests();
+		if (ret != TestPass)
+			return ret;
+
+		camera_->requestCompleted.connect(this, &ReconfigureRunningTest::requestComplete);
+
+		completeRequestsCount_ = 0;
+		cancelledRequestsCount_ = 0;
+
+		if (camera_->start()) {
+			cout << "Failed to start camera" << endl;
+			return TestFail;
+		}
+
+		for (std::unique_ptr<Request> &request : requests_) {
+			if (camera_->queueRequest(request.get())) {
+				cout << "Failed to queue request" << endl;
+				return TestFail;
+			}
+		}
+
+		runCapture(100ms);
+
+		/* Reconfiguration can't change the streams. */
+		StreamConfiguration &cfg = config_->at(0);
+		const Size size = cfg.size;
+
+		cfg.size = size / 2;
+		if (camera_->reconfigure(config_.get()) != -EINVAL) {
+			cout << "Stream size changed by reconfiguration" << endl;
+			return TestFail;
+		}
+
+		cfg.size = size;
+
+		/* The camera shall keep capturing through the reconfiguration. */
+		if (camera_->reconfigure(config_.get())) {
+			cout << "Failed to reconfigure the camera" << endl;
+			return TestFail;
+		}
+
+		unsigned int count = completeRequestsCount_;
+
+		runCapture(100ms);
+
+		if (completeRequestsCount_ <= count) {
+			cout << "No frame captured after reconfiguration" << endl;
+			return TestFail;
+		}
+
+		/* The virtual camera reconfigures without dropping requests. */
+		if (cancelledRequestsCount_) {
+			cout << cancelledRequestsCount_
+			     << " requests cancelled by reconfiguration" << endl;
+			return TestFail;
+		}
+
+		if (camera_->stop()) {
+			cout << "Failed to stop camera" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	unsigned int completeRequestsCount_;
+	unsigned int cancelledRequestsCount_;
+};
+
+} /* namespace */
+
+TEST_REGISTER(ReconfigureRunningTest)
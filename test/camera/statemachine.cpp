@@ -42,6 +42,10 @@ protected:
 		if (camera_->queueRequest(&request) != -EACCES)
 			return TestFail;
 
+		Request *batch[] = { &request };
+		if (camera_->queueRequests(batch) != -EACCES)
+			return TestFail;
+
 		/* Test operations which should pass. */
 		if (camera_->release())
 			return TestFail;
@@ -0,0 +1,244 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * libcamera virtual camera tests
+ */
+
+#include <iostream>
+#include <vector>
+
+#include <libcamera/control_ids.h>
+#include <libcamera/formats.h>
+
+#include <libcamera/base/object.h>
+
+#include "libcamera/internal/mapped_framebuffer.h"
+
+#include "virtual_camera_test.h"
+
+using namespace libcamera;
+using namespace std;
+using namespace std::chrono_literals;
+
+namespace {
+
+/*
+ * Derive from Object to handle request completion in the test thread. The
+ * requests are then never requeued concurrently with the camera being stopped.
+ */
+class VirtualCapture : public Object, public VirtualCameraTest
+{
+public:
+	VirtualCapture()
+		: VirtualCameraTest("640x480@0,320x240@30")
+	{
+	}
+
+protected:
+	void requestComplete(Request *request)
+	{
+		if (request->status() != Request::RequestComplete)
+			return;
+
+		FrameBuffer *buffer = request->buffers().begin()->second;
+		const FrameMetadata &metadata = buffer->metadata();
+
+		if (metadata.status != FrameMetadata::FrameSuccess ||
+		    (completeRequestsCount_ && metadata.sequence != lastSequence_ + 1) ||
+		    !request->metadata().contains(controls::SensorTimestamp) ||
+		    request->metadata().get(controls::AnalogueGain) != 2.0f)
+			invalidFrames_++;
+
+		lastSequence_ = metadata.sequence;
+		completeRequestsCount_++;
+
+		if (recordTimestamps_)
+			timestamps_.push_back(metadata.timestamp);
+
+		if (completeRequestsCount_ == 1) {
+			MappedFrameBuffer mapped(buffer, MappedFrameBuffer::MapFlag::Read);
+			const uint8_t *pixel = mapped.planes()[0].data();
+
+			/* The first bar of the test pattern is white. */
+			if (pixel[0] != 0xff || pixel[1] != 0xff || pixel[2] != 0xff)
+				invalidFrames_++;
+		}
+
+		request->reuse(Request::ReuseBuffers);
+		request->controls().set(controls::AnalogueGain, 2.0f);
+		camera_->queueRequest(request);
+	}
+
+	int init() override
+	{
+		int ret = VirtualCameraTest::init();
+		if (ret != TestPass)
+			return ret;
+
+		if (!cm_->get("Virtual/1")) {
+			cout << "Second virtual camera not found" << endl;
+			return TestFail;
+		}
+
+		StreamConfiguration &cfg = config_->at(0);
+		cfg.pixelFormat = formats::XRGB8888;
+		cfg.size = { 1920, 1080 };
+
+		if (config_->validate() != CameraConfiguration::Adjusted ||
+		    cfg.size != Size(640, 480)) {
+			cout << "Configuration not adjusted to the camera" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		int ret = configureCamera();
+		if (ret != TestPass)
+			return ret;
+
+		ret = createRequests();
+		if (ret != TestPass)
+			return ret;
+
+		for (std::unique_ptr<Request> &request : requests_)
+			request->controls().set(controls::AnalogueGain, 2.0f);
+
+		camera_->requestCompleted.connect(this, &VirtualCapture::requestComplete);
+
+		completeRequestsCount_ = 0;
+		invalidFrames_ = 0;
+
+		if (camera_->start()) {
+			cout << "Failed to start camera" << endl;
+			return TestFail;
+		}
+
+		std::vector<Request *> batch;
+		for (std::unique_ptr<Request> &request : requests_)
+			batch.push_back(request.get());
+
+		/* A batch with an invalid request shall be rejected as a whole. */
+		std::unique_ptr<Request> invalid = camera_->createRequest();
+		batch.push_back(invalid.get());
+
+		if (camera_->queueRequests(batch) != -EINVAL) {
+			cout << "Invalid request batch not rejected" << endl;
+			return TestFail;
+		}
+
+		batch.pop_back();
+
+		/* So shall a batch containing the same request twice. */
+		batch.push_back(batch.front());
+
+		if (camera_->queueRequests(batch) != -EINVAL) {
+			cout << "Request batch with duplicates not rejected" << endl;
+			return TestFail;
+		}
+
+		batch.pop_back();
+
+		if (camera_->queueRequests(batch)) {
+			cout << "Failed to queue requests" << endl;
+			return TestFail;
+		}
+
+		runCapture(500ms);
+
+		if (camera_->stop()) {
+			cout << "Failed to stop camera" << endl;
+			return TestFail;
+		}
+
+		cout << "Captured " << completeRequestsCount_ * 2
+		     << " frames per second without frame rate limit" << endl;
+
+		/* Without a frame rate limit, 30fps shall be easily exceeded. */
+		if (completeRequestsCount_ < 30) {
+			cout << "Failed to capture enough frames" << endl;
+			return TestFail;
+		}
+
+		if (invalidFrames_) {
+			cout << invalidFrames_ << " invalid frames" << endl;
+			return TestFail;
+		}
+
+		/*
+		 * A frame duration set by a request shall pace the following
+		 * frames, even if the camera started without a frame rate
+		 * limit.
+		 */
+		for (std::unique_ptr<Request> &request : requests_) {
+			request->reuse(Request::ReuseBuffers);
+			request->controls().set(controls::AnalogueGain, 2.0f);
+		}
+
+		const int64_t frameDuration = 100000;
+		requests_[0]->controls().set(controls::FrameDurationLimits,
+					     { frameDuration, frameDuration });
+
+		completeRequestsCount_ = 0;
+		recordTimestamps_ = true;
+
+		if (camera_->start()) {
+			cout << "Failed to restart camera" << endl;
+			return TestFail;
+		}
+
+		if (camera_->queueRequests(batch)) {
+			cout << "Failed to queue requests" << endl;
+			return TestFail;
+		}
+
+		runCapture(500ms);
+
+		if (camera_->stop()) {
+			cout << "Failed to stop camera" << endl;
+			return TestFail;
+		}
+
+		/*
+		 * The first request completes immediately, the next ones, from
+		 * the same batch or requeued, at the requested frame duration.
+		 */
+		if (timestamps_.size() < 2) {
+			cout << "Captured " << timestamps_.size()
+			     << " frames with a 100ms frame duration in 500ms"
+			     << endl;
+			return TestFail;
+		}
+
+		for (unsigned int i = 1; i < timestamps_.size(); ++i) {
+			uint64_t interval = timestamps_[i] - timestamps_[i - 1];
+			if (interval < frameDuration * 1000) {
+				cout << "Frame " << i << " captured after "
+				     << interval << "ns, expected at least "
+				     << frameDuration * 1000 << "ns" << endl;
+				return TestFail;
+			}
+		}
+
+		if (invalidFrames_) {
+			cout << invalidFrames_ << " invalid frames" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	unsigned int completeRequestsCount_;
+	unsigned int invalidFrames_;
+	uint32_t lastSequence_;
+
+	bool recordTimestamps_ = false;
+	std::vector<uint64_t> timestamps_;
+};
+
+} /* namespace */
+
+TEST_REGISTER(VirtualCapture)
@@ -0,0 +1,140 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * dma-buf-allocator.cpp - DmaBufAllocator test
+ */
+
+#include <iostream>
+#include <memory>
+#include <set>
+#include <sys/stat.h>
+#include <vector>
+
+#include <libcamera/framebuffer.h>
+
+#include "libcamera/internal/dma_buf_allocator.h"
+#include "libcamera/internal/mapped_framebuffer.h"
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+
+namespace {
+
+constexpr unsigned int kNumBuffers = 4;
+
+class DmaBufAllocatorTest : public Test
+{
+protected:
+	/* Identify the memory of the buffers by the inode of their fd. */
+	static set<ino_t> inodes(const vector<unique_ptr<FrameBuffer>> &buffers)
+	{
+		set<ino_t> inodes;
+
+		for (const unique_ptr<FrameBuffer> &buffer : buffers) {
+			struct stat st;
+			if (fstat(buffer->planes()[0].fd.get(), &st) < 0)
+				return {};
+
+			inodes.insert(st.st_ino);
+		}
+
+		return inodes;
+	}
+
+	int run() override
+	{
+		using DmaBufAllocatorFlag = DmaBufAllocator::DmaBufAllocatorFlag;
+
+		/* Prefer udmabuf, and fall back to memfd when not available. */
+		auto allocator = make_unique<DmaBufAllocator>(DmaBufAllocatorFlag::UDmaBuf |
+							      DmaBufAllocatorFlag::MemFd);
+		if (!allocator->isValid()) {
+			cerr << "Failed to create allocator" << endl;
+			return TestFail;
+		}
+
+		const vector<unsigned int> planeSizes = { 640 * 480, 640 * 480 / 2 };
+		vector<unique_ptr<FrameBuffer>> buffers;
+
+		int ret = allocator->exportBuffers(kNumBuffers, planeSizes, &buffers);
+		if (ret != static_cast<int>(kNumBuffers) || buffers.size() != kNumBuffers) {
+			cerr << "Failed to export buffers" << endl;
+			return TestFail;
+		}
+
+		for (const unique_ptr<FrameBuffer> &buffer : buffers) {
+			const vector<FrameBuffer::Plane> &planes = buffer->planes();
+			if (planes.size() != 2 ||
+			    planes[0].length != planeSizes[0] ||
+			    planes[1].length != planeSizes[1] ||
+			    planes[1].offset != planeSizes[0] ||
+			    planes[0].fd != planes[1].fd) {
+				cerr << "Invalid buffer planes" << endl;
+				return TestFail;
+			}
+
+			MappedFrameBuffer map(buffer.get(), MappedFrameBuffer::MapFlag::ReadWrite);
+			if (!map.isValid()) {
+				cerr << "Failed to map buffer" << endl;
+				return TestFail;
+			}
+
+			map.planes()[1][0] = 0xa5;
+		}
+
+		set<ino_t> first = inodes(buffers);
+		if (first.size() != kNumBuffers) {
+			cerr << "Buffers don't have distinct memory" << endl;
+			return TestFail;
+		}
+
+		/* Freeing and reallocating buffers must recycle the memory. */
+		buffers.clear();
+
+		ret = allocator->exportBuffers(kNumBuffers, planeSizes, &buffers);
+		if (ret != static_cast<int>(kNumBuffers) || inodes(buffers) != first) {
+			cerr << "Buffers not recycled" << endl;
+			return TestFail;
+		}
+
+		/* Buffers of a different size must not reuse the pooled memory. */
+		vector<unique_ptr<FrameBuffer>> otherBuffers;
+		buffers.clear();
+
+		ret = allocator->exportBuffers(1, { 1920 * 1080 }, &otherBuffers);
+		if (ret != 1 || first.count(*inodes(otherBuffers).begin())) {
+			cerr << "Buffer of mismatched size recycled" << endl;
+			return TestFail;
+		}
+
+		/* Clearing the allocator must free the pooled memory. */
+		allocator->clear();
+
+		ret = allocator->exportBuffers(kNumBuffers, planeSizes, &buffers);
+		if (ret != static_cast<int>(kNumBuffers) || inodes(buffers) == first) {
+			cerr << "Buffers recycled after clear" << endl;
+			return TestFail;
+		}
+
+		/* Buffers must outlive the allocator. */
+		allocator.reset();
+
+		MappedFrameBuffer map(buffers[0].get(), MappedFrameBuffer::MapFlag::Write);
+		if (!map.isValid()) {
+			cerr << "Failed to map buffer after destroying allocator" << endl;
+			return TestFail;
+		}
+
+		buffers.clear();
+		otherBuffers.clear();
+
+		return TestPass;
+	}
+};
+
+} /* namespace */
+
+TEST_REGISTER(DmaBufAllocatorTest)
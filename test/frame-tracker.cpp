@@ -0,0 +1,165 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * frame-tracker.cpp - FrameTracker tests
+ */
+
+#include <iostream>
+
+#include <libcamera/framebuffer.h>
+
+#include "libcamera/internal/frame_tracker.h"
+
+#include "virtual_camera_test.h"
+
+using namespace libcamera;
+using namespace std;
+
+namespace {
+
+struct TestFrameInfo : public FrameInfo {
+	bool completed;
+};
+
+class FrameTrackerTest : public VirtualCameraTest
+{
+public:
+	FrameTrackerTest()
+		: VirtualCameraTest("320x240@0")
+	{
+	}
+
+protected:
+	int init() override
+	{
+		int ret = VirtualCameraTest::init();
+		if (ret != TestPass)
+			return ret;
+
+		ret = configureCamera();
+		if (ret != TestPass)
+			return ret;
+
+		ret = createRequests();
+		if (ret != TestPass)
+			return ret;
+
+		if (requests_.size() < 3) {
+			cout << "Not enough requests" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		FrameTracker<TestFrameInfo> tracker;
+		Request *request0 = requests_[0].get();
+		Request *request1 = requests_[1].get();
+		FrameBuffer *buffer0 = request0->buffers().begin()->second;
+		FrameBuffer *buffer1 = request1->buffers().begin()->second;
+
+		/* Create frames and look them up by id, request and buffer. */
+		TestFrameInfo *info0 = tracker.create(0, request0);
+		TestFrameInfo *info1 = tracker.create(1, request1);
+
+		if (info0->id != 0 || info0->request != request0 ||
+		    info1->id != 1 || info1->request != request1) {
+			cout << "Frame information not initialised" << endl;
+			return TestFail;
+		}
+
+		if (tracker.find(0u) != info0 || tracker.find(1u) != info1 ||
+		    tracker.find(2u) != nullptr) {
+			cout << "Failed to find frame by id" << endl;
+			return TestFail;
+		}
+
+		if (tracker.find(request0) != info0 || tracker.find(request1) != info1 ||
+		    tracker.find(requests_[2].get()) != nullptr) {
+			cout << "Failed to find frame by request" << endl;
+			return TestFail;
+		}
+
+		if (tracker.find(buffer0) != info0 || tracker.find(buffer1) != info1) {
+			cout << "Failed to find frame by request buffer" << endl;
+			return TestFail;
+		}
+
+		/*
+		 * Internal buffers are found through the most recent frame they
+		 * have been associated with, and null buffers are ignored.
+		 */
+		FrameBuffer internal({});
+
+		tracker.addBuffer(info0, &internal);
+		tracker.addBuffer(info0, nullptr);
+		if (tracker.find(&internal) != info0) {
+			cout << "Failed to find frame by internal buffer" << endl;
+			return TestFail;
+		}
+
+		tracker.addBuffer(info1, &internal);
+		if (tracker.find(&internal) != info1) {
+			cout << "Reused internal buffer not associated with new frame" << endl;
+			return TestFail;
+		}
+
+		/* Removing a frame drops all its lookup entries, but no other. */
+		info0->completed = true;
+		tracker.remove(info0);
+
+		if (tracker.find(0u) || tracker.find(request0) || tracker.find(buffer0)) {
+			cout << "Removed frame still found" << endl;
+			return TestFail;
+		}
+
+		if (tracker.find(&internal) != info1) {
+			cout << "Removing frame dropped newer internal buffer entry" << endl;
+			return TestFail;
+		}
+
+		if (tracker.frames().size() != 1 || tracker.frames().at(1) != info1) {
+			cout << "Invalid frames map after removal" << endl;
+			return TestFail;
+		}
+
+		/* Removed frames are reused, and reset to their default value. */
+		TestFrameInfo *info2 = tracker.create(2, request0);
+		if (info2 != info0) {
+			cout << "Removed frame information not reused" << endl;
+			return TestFail;
+		}
+
+		if (info2->completed || info2->id != 2 || tracker.find(buffer0) != info2) {
+			cout << "Reused frame information not reset" << endl;
+			return TestFail;
+		}
+
+		/* Clearing the tracker drops all frames. */
+		tracker.clear();
+
+		if (!tracker.frames().empty() || tracker.find(1u) || tracker.find(2u) ||
+		    tracker.find(request1) || tracker.find(buffer1) ||
+		    tracker.find(&internal)) {
+			cout << "Frames still found after clear" << endl;
+			return TestFail;
+		}
+
+		TestFrameInfo *info3 = tracker.create(3, request1);
+		if (info3 != info1 && info3 != info2) {
+			cout << "Cleared frame information not reused" << endl;
+			return TestFail;
+		}
+
+		tracker.remove(info3);
+
+		return TestPass;
+	}
+};
+
+} /* namespace */
+
+TEST_REGISTER(FrameTrackerTest)
@@ -0,0 +1,216 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * fc_queue_test.cpp - Test the libipa frame context queue
+ */
+
+#include <iostream>
+#include <stdint.h>
+
+#include "libipa/fc_queue.h"
+
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+using namespace libcamera::ipa;
+
+namespace {
+
+struct TestFrameContext : public FrameContext {
+	uint32_t exposure;
+	bool updated;
+};
+
+constexpr unsigned int kQueueDepth = 4;
+
+} /* namespace */
+
+class FCQueueTest : public Test
+{
+protected:
+	int testAllocation()
+	{
+		FCQueue<TestFrameContext> queue(kQueueDepth);
+
+		TestFrameContext &ctx = queue.alloc(1);
+		if (ctx.exposure || ctx.updated) {
+			cerr << "Allocated frame context is not initialised" << endl;
+			return TestFail;
+		}
+
+		ctx.exposure = 100;
+
+		/* The context is retrieved with the state stored at allocation. */
+		TestFrameContext &got = queue.get(1);
+		if (&got != &ctx || got.exposure != 100) {
+			cerr << "Failed to retrieve frame context" << endl;
+			return TestFail;
+		}
+
+		/* Allocating a frame twice must not reset its state. */
+		got.updated = true;
+		TestFrameContext &again = queue.alloc(1);
+		if (&again != &ctx || again.exposure != 100 || !again.updated) {
+			cerr << "Frame context reset by a second allocation" << endl;
+			return TestFail;
+		}
+
+		/* Retrieving a frame that hasn't been allocated initialises it. */
+		ctx.exposure = 200;
+		TestFrameContext &ahead = queue.get(1 + kQueueDepth);
+		if (&ahead != &ctx || ahead.exposure || ahead.updated) {
+			cerr << "Unallocated frame context is not initialised" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int testWraparound()
+	{
+		FCQueue<TestFrameContext> queue(kQueueDepth);
+
+		/* Run through the ring several times, one frame in flight. */
+		for (uint32_t frame = 1; frame < 10 * kQueueDepth; frame++) {
+			TestFrameContext &ctx = queue.alloc(frame);
+			if (ctx.exposure) {
+				cerr << "Frame " << frame
+				     << " inherited a previous frame context" << endl;
+				return TestFail;
+			}
+
+			ctx.exposure = frame;
+
+			if (queue.get(frame).exposure != frame) {
+				cerr << "Frame " << frame << " context mismatch" << endl;
+				return TestFail;
+			}
+		}
+
+		/* All frames within the queue depth are retrievable. */
+		const uint32_t last = 10 * kQueueDepth - 1;
+		for (uint32_t frame = last - kQueueDepth + 1; frame <= last; frame++) {
+			if (queue.get(frame).exposure != frame) {
+				cerr << "Frame " << frame << " context lost" << endl;
+				return TestFail;
+			}
+		}
+
+		return TestPass;
+	}
+
+	int testOverrun()
+	{
+		FCQueue<TestFrameContext> queue(kQueueDepth);
+
+		for (uint32_t frame = 1; frame <= 2 * kQueueDepth; frame++)
+			queue.alloc(frame).exposure = frame;
+
+		/*
+		 * Frame 2 has been overwritten by frame 2 + kQueueDepth. Its
+		 * context can't be recovered, and the queue hands out a freshly
+		 * initialised one instead of the one of the newer frame.
+		 */
+		TestFrameContext &ctx = queue.get(2);
+		if (ctx.exposure) {
+			cerr << "Overwritten frame context returned stale data" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int testFrameZero()
+	{
+		FCQueue<TestFrameContext> queue(kQueueDepth);
+
+		/*
+		 * Cleared contexts are marked as belonging to frame 0, so frame 0
+		 * is always re-initialised when allocated, even if it appears to
+		 * have been allocated already.
+		 */
+		queue.alloc(0).exposure = 100;
+		if (queue.alloc(0).exposure) {
+			cerr << "Frame 0 context not re-initialised" << endl;
+			return TestFail;
+		}
+
+		queue.alloc(0).exposure = 100;
+		if (queue.get(0).exposure != 100) {
+			cerr << "Failed to retrieve frame 0 context" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int testRestart()
+	{
+		FCQueue<TestFrameContext> queue(kQueueDepth);
+
+		/* Stream up to frame 37, then stop. */
+		for (uint32_t frame = 0; frame <= 37; frame++) {
+			TestFrameContext &ctx = queue.alloc(frame);
+			ctx.exposure = frame + 1;
+			ctx.updated = true;
+		}
+
+		queue.clear();
+
+		/*
+		 * Restarting, for instance after a sensor mode change, numbers
+		 * frames from 0 again. The RkISP1 algorithms rely on this to
+		 * program the ISP at frame 0, so the contexts of the new
+		 * sequence must not carry state from before the restart.
+		 */
+		for (uint32_t frame = 0; frame < kQueueDepth; frame++) {
+			TestFrameContext &ctx = queue.alloc(frame);
+			if (ctx.exposure || ctx.updated) {
+				cerr << "Frame " << frame
+				     << " context kept state across restart" << endl;
+				return TestFail;
+			}
+
+			ctx.exposure = frame + 100;
+		}
+
+		for (uint32_t frame = 0; frame < kQueueDepth; frame++) {
+			if (queue.get(frame).exposure != frame + 100) {
+				cerr << "Frame " << frame
+				     << " context lost after restart" << endl;
+				return TestFail;
+			}
+		}
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		int ret = testAllocation();
+		if (ret != TestPass)
+			return ret;
+
+		ret = testWraparound();
+		if (ret != TestPass)
+			return ret;
+
+		ret = testOverrun();
+		if (ret != TestPass)
+			return ret;
+
+		ret = testFrameZero();
+		if (ret != TestPass)
+			return ret;
+
+		ret = testRestart();
+		if (ret != TestPass)
+			return ret;
+
+		return TestPass;
+	}
+};
+
+TEST_REGISTER(FCQueueTest)
@@ -0,0 +1,219 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * grid_statistics_test.cpp - Test the libipa grid statistics
+ */
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <stdint.h>
+#include <vector>
+
+#include "libipa/grid_statistics.h"
+
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+using namespace libcamera::ipa;
+
+/*
+ * Synthetic statistics grid, with the dimensions and zone layout used by the
+ * IPU3 IPA for a 1280x720 output.
+ */
+static constexpr unsigned int kGridWidth = 80;
+static constexpr unsigned int kGridHeight = 45;
+static constexpr unsigned int kZonesX = 16;
+static constexpr unsigned int kZonesY = 12;
+static constexpr unsigned int kCellsPerZoneX = 5;
+static constexpr unsigned int kCellsPerZoneY = 4;
+static constexpr uint8_t kSaturationThreshold = 229;
+
+struct Cell {
+	uint8_t red;
+	uint8_t green;
+	uint8_t blue;
+	uint8_t saturation;
+};
+
+class GridStatisticsTest : public Test
+{
+protected:
+	int init()
+	{
+		std::mt19937 gen(42);
+		std::uniform_int_distribution<unsigned int> value(0, 255);
+
+		cells_.resize(kGridWidth * kGridHeight);
+		for (Cell &cell : cells_)
+			cell = { static_cast<uint8_t>(value(gen)),
+				 static_cast<uint8_t>(value(gen)),
+				 static_cast<uint8_t>(value(gen)),
+				 static_cast<uint8_t>(value(gen)) };
+
+		return TestPass;
+	}
+
+	/* Reduce the grid in a single pass with the GridStatistics helper. */
+	void reduce(GridStatistics &stats)
+	{
+		std::array<uint8_t, kGridWidth> red;
+		std::array<uint8_t, kGridWidth> green;
+		std::array<uint8_t, kGridWidth> blue;
+		std::array<uint8_t, kGridWidth> saturation;
+
+		stats.reset();
+
+		for (unsigned int y = 0; y < kGridHeight; y++) {
+			const Cell *row = &cells_[y * kGridWidth];
+
+			for (unsigned int x = 0; x < kGridWidth; x++) {
+				red[x] = row[x].red;
+				green[x] = row[x].green;
+				blue[x] = row[x].blue;
+				saturation[x] = row[x].saturation;
+			}
+
+			stats.accumulateRow(y, red, green, blue, saturation);
+		}
+	}
+
+	/* Reference per-zone accumulation, walking the grid cell by cell. */
+	void referenceZones(std::vector<GridStatistics::Zone> &zones)
+	{
+		zones.assign(kZonesX * kZonesY, GridStatistics::Zone{});
+
+		const unsigned int height = std::min(kZonesY * kCellsPerZoneY, kGridHeight);
+		const unsigned int width = std::min(kZonesX * kCellsPerZoneX, kGridWidth);
+
+		for (unsigned int y = 0; y < height; y++) {
+			for (unsigned int x = 0; x < width; x++) {
+				const Cell &cell = cells_[y * kGridWidth + x];
+				if (cell.saturation > kSaturationThreshold)
+					continue;
+
+				GridStatistics::Zone &zone =
+					zones[y / kCellsPerZoneY * kZonesX + x / kCellsPerZoneX];
+				zone.counted++;
+				zone.sum[GridStatistics::Red] += cell.red;
+				zone.sum[GridStatistics::Green] += cell.green;
+				zone.sum[GridStatistics::Blue] += cell.blue;
+			}
+		}
+	}
+
+	/* Reference green histogram, walking the grid cell by cell. */
+	void referenceHistogram(std::array<uint32_t, GridStatistics::kNumBins> &hist)
+	{
+		hist.fill(0);
+
+		for (const Cell &cell : cells_)
+			hist[cell.green]++;
+	}
+
+	/* Reference clipped sums, walking the grid cell by cell. */
+	std::array<double, 3> referenceSums(double gain)
+	{
+		std::array<double, 3> sums{};
+
+		for (const Cell &cell : cells_) {
+			sums[0] += std::min(cell.red * gain, 255.0);
+			sums[1] += std::min(cell.green * gain, 255.0);
+			sums[2] += std::min(cell.blue * gain, 255.0);
+		}
+
+		return sums;
+	}
+
+	int validate(const GridStatistics &stats)
+	{
+		std::vector<GridStatistics::Zone> zones;
+		referenceZones(zones);
+
+		if (stats.zones().size() != zones.size()) {
+			cerr << "Invalid number of zones " << stats.zones().size()
+			     << endl;
+			return TestFail;
+		}
+
+		for (unsigned int i = 0; i < zones.size(); i++) {
+			const GridStatistics::Zone &zone = stats.zones()[i];
+			const GridStatistics::Zone &ref = zones[i];
+
+			if (zone.counted != ref.counted ||
+			    !std::equal(std::begin(zone.sum), std::end(zone.sum),
+					std::begin(ref.sum))) {
+				cerr << "Zone " << i << " mismatch" << endl;
+				return TestFail;
+			}
+		}
+
+		std::array<uint32_t, GridStatistics::kNumBins> hist;
+		referenceHistogram(hist);
+
+		Span<const uint32_t> green = stats.histogram(GridStatistics::Green);
+		if (!std::equal(green.begin(), green.end(), hist.begin(), hist.end())) {
+			cerr << "Green histogram mismatch" << endl;
+			return TestFail;
+		}
+
+		for (double gain : { 0.5, 1.0, 1.7, 4.0 }) {
+			std::array<double, 3> ref = referenceSums(gain);
+			std::array<double, 3> sums = {
+				stats.clippedSum(GridStatistics::Red, gain),
+				stats.clippedSum(GridStatistics::Green, gain),
+				stats.clippedSum(GridStatistics::Blue, gain),
+			};
+
+			for (unsigned int c = 0; c < 3; c++) {
+				if (std::abs(sums[c] - ref[c]) > 1e-6 * ref[c]) {
+					cerr << "Clipped sum mismatch for gain "
+					     << gain << ": " << sums[c] << " != "
+					     << ref[c] << endl;
+					return TestFail;
+				}
+			}
+		}
+
+		return TestPass;
+	}
+
+	int run()
+	{
+		GridStatistics stats;
+		stats.configure({ kGridWidth, kGridHeight });
+		stats.setZones({ kZonesX, kZonesY },
+			       { kCellsPerZoneX, kCellsPerZoneY },
+			       kSaturationThreshold);
+
+		reduce(stats);
+
+		int ret = validate(stats);
+		if (ret != TestPass)
+			return ret;
+
+		/* Reconfiguring the grid must disable zones. */
+		stats.configure({ kGridWidth, kGridHeight });
+		if (!stats.zones().empty()) {
+			cerr << "Zones not disabled by configure()" << endl;
+			return TestFail;
+		}
+
+		stats.setZones({ kZonesX, kZonesY },
+			       { kCellsPerZoneX, kCellsPerZoneY },
+			       kSaturationThreshold);
+
+		reduce(stats);
+
+		return validate(stats);
+	}
+
+private:
+	std::vector<Cell> cells_;
+};
+
+TEST_REGISTER(GridStatisticsTest)
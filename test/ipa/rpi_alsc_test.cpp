@@ -0,0 +1,240 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * rpi_alsc_test.cpp - Raspberry Pi ALSC solver regression test
+ */
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <string.h>
+#include <thread>
+
+#include <boost/property_tree/ptree.hpp>
+
+#include "awb_status.h"
+#include "camera_mode.h"
+#include "metadata.hpp"
+#include "rpi/alsc.hpp"
+
+#include "test.h"
+
+using namespace std;
+using namespace std::chrono_literals;
+using namespace RPiController;
+
+namespace {
+
+constexpr unsigned int kCellsX = ALSC_CELLS_X;
+constexpr unsigned int kCellsY = ALSC_CELLS_Y;
+
+/*
+ * Reference output of the solver for the synthetic fixture below, recorded
+ * with the solver as it was before its restructuring. Each entry is the
+ * value of the red and blue tables at one cell.
+ */
+struct Reference {
+	unsigned int x;
+	unsigned int y;
+	double r;
+	double b;
+};
+
+constexpr double kRefSumR = 225.664103347;
+constexpr double kRefSumB = 239.519506781;
+constexpr std::array<Reference, 5> kReference = { {
+	{ 0, 0, 1.474217074, 1.616012360 },
+	{ 15, 0, 1.334895122, 1.334895122 },
+	{ 7, 5, 1.044019418, 1.107742843 },
+	{ 0, 11, 1.473635054, 1.368135843 },
+	{ 15, 11, 1.335078401, 1.655248776 },
+} };
+
+double cellX(unsigned int x)
+{
+	return (x - (kCellsX - 1) / 2.0) / ((kCellsX - 1) / 2.0);
+}
+
+double cellY(unsigned int y)
+{
+	return (y - (kCellsY - 1) / 2.0) / ((kCellsY - 1) / 2.0);
+}
+
+boost::property_tree::ptree calibration(double ct, double strength, bool horizontal)
+{
+	boost::property_tree::ptree table;
+	for (unsigned int y = 0; y < kCellsY; y++) {
+		for (unsigned int x = 0; x < kCellsX; x++) {
+			double d = horizontal ? cellX(x) : cellY(y);
+			boost::property_tree::ptree value;
+			value.put_value(1.0 + strength * d);
+			table.push_back({ "", value });
+		}
+	}
+
+	boost::property_tree::ptree cal;
+	cal.put("ct", ct);
+	cal.add_child("table", table);
+	return cal;
+}
+
+boost::property_tree::ptree tuning()
+{
+	boost::property_tree::ptree params;
+
+	/* Keep the IIR filter out of the way, results are used as-is. */
+	params.put("startup_frames", 1000);
+	params.put("corner_strength", 1.5);
+	params.put("n_iter", 50);
+
+	boost::property_tree::ptree cr;
+	cr.push_back({ "", calibration(3000, 0.10, true) });
+	cr.push_back({ "", calibration(6000, 0.04, true) });
+	params.add_child("calibrations_Cr", cr);
+
+	boost::property_tree::ptree cb;
+	cb.push_back({ "", calibration(3000, -0.03, false) });
+	cb.push_back({ "", calibration(6000, 0.08, false) });
+	params.add_child("calibrations_Cb", cb);
+
+	return params;
+}
+
+CameraMode cameraMode()
+{
+	CameraMode mode = {};
+
+	/* A cropped and binned mode, to exercise the table resampling. */
+	mode.bitdepth = 10;
+	mode.sensor_width = 3280;
+	mode.sensor_height = 2464;
+	mode.width = 1440;
+	mode.height = 1080;
+	mode.crop_x = 200;
+	mode.crop_y = 152;
+	mode.bin_x = 2;
+	mode.bin_y = 2;
+	mode.scale_x = 2.0;
+	mode.scale_y = 2.0;
+	mode.noise_factor = 1.0;
+	mode.transform = libcamera::Transform::Identity;
+	mode.sensitivity = 1.0;
+
+	return mode;
+}
+
+StatisticsPtr statistics()
+{
+	StatisticsPtr stats = std::make_shared<bcm2835_isp_stats>();
+
+	/*
+	 * A grey scene seen through a lens with vignetting and with a colour
+	 * cast that varies across the image.
+	 */
+	for (unsigned int y = 0; y < kCellsY; y++) {
+		for (unsigned int x = 0; x < kCellsX; x++) {
+			double dx = cellX(x);
+			double dy = cellY(y);
+			double v = 1.0 - 0.25 * (dx * dx + dy * dy);
+
+			bcm2835_isp_stats_region &region = stats->awb_stats[y * kCellsX + x];
+			region.counted = 1000;
+			region.g_sum = 400.0 * v * region.counted;
+			region.r_sum = region.g_sum * 0.8 * (1.0 + 0.15 * dx);
+			region.b_sum = region.g_sum * 0.6 * (1.0 - 0.1 * dx * dy);
+		}
+	}
+
+	return stats;
+}
+
+bool equal(double a, double b)
+{
+	return std::abs(a - b) <= 1e-6 * std::max(1.0, std::abs(b));
+}
+
+} /* namespace */
+
+class RPiAlscTest : public Test
+{
+protected:
+	int run() override
+	{
+		Alsc alsc;
+
+		alsc.Read(tuning());
+		alsc.Initialise();
+
+		Metadata metadata;
+		AwbStatus awb = {};
+		awb.temperature_K = 4200;
+		metadata.Set("awb.status", awb);
+
+		alsc.SwitchMode(cameraMode(), &metadata);
+		alsc.Prepare(&metadata);
+
+		AlscStatus initial;
+		if (metadata.Get("alsc.status", initial)) {
+			cerr << "No ALSC status after prepare" << endl;
+			return TestFail;
+		}
+
+		/* Run the adaptive solver once, and wait for its results. */
+		StatisticsPtr stats = statistics();
+		alsc.Process(stats, &metadata);
+
+		AlscStatus status;
+		bool updated = false;
+		for (unsigned int i = 0; i < 5000 && !updated; i++) {
+			std::this_thread::sleep_for(1ms);
+
+			Metadata result;
+			alsc.Prepare(&result);
+			result.Get("alsc.status", status);
+
+			updated = memcmp(status.r, initial.r, sizeof(status.r)) ||
+				  memcmp(status.b, initial.b, sizeof(status.b));
+		}
+
+		if (!updated) {
+			cerr << "ALSC solver produced no result" << endl;
+			return TestFail;
+		}
+
+		double sumR = 0.0;
+		double sumB = 0.0;
+		for (unsigned int y = 0; y < kCellsY; y++) {
+			for (unsigned int x = 0; x < kCellsX; x++) {
+				sumR += status.r[y][x];
+				sumB += status.b[y][x];
+			}
+		}
+
+		if (!equal(sumR, kRefSumR) || !equal(sumB, kRefSumB)) {
+			cerr << "ALSC table sums " << sumR << ", " << sumB
+			     << " differ from reference " << kRefSumR << ", "
+			     << kRefSumB << endl;
+			return TestFail;
+		}
+
+		for (const Reference &ref : kReference) {
+			double r = status.r[ref.y][ref.x];
+			double b = status.b[ref.y][ref.x];
+
+			if (!equal(r, ref.r) || !equal(b, ref.b)) {
+				cerr << "ALSC tables at (" << ref.x << ", " << ref.y
+				     << ") are " << r << ", " << b
+				     << ", expected " << ref.r << ", " << ref.b
+				     << endl;
+				return TestFail;
+			}
+		}
+
+		return TestPass;
+	}
+};
+
+TEST_REGISTER(RPiAlscTest)
@@ -0,0 +1,104 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * benchmark.cpp - libcamera benchmark base class
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <stdlib.h>
+
+#include "benchmark.h"
+
+using namespace std;
+
+int Benchmark::run()
+{
+	int ret = benchmark();
+	if (ret != TestPass)
+		return ret;
+
+	cout << left << setw(40) << "benchmark" << right
+	     << setw(10) << "iters" << setw(12) << "mean(ns)"
+	     << setw(12) << "p50(ns)" << setw(12) << "p90(ns)"
+	     << setw(12) << "p99(ns)" << setw(12) << "max(ns)" << endl;
+
+	cout << fixed << setprecision(1);
+
+	for (const Result &result : results_)
+		cout << left << setw(40) << result.name << right
+		     << setw(10) << result.iterations << setw(12) << result.mean
+		     << setw(12) << result.p50 << setw(12) << result.p90
+		     << setw(12) << result.p99 << setw(12) << result.max << endl;
+
+	return writeJson();
+}
+
+void Benchmark::record(const string &name, unsigned int iterations,
+		       vector<double> samples)
+{
+	Result result;
+	result.name = name;
+	result.iterations = iterations;
+	result.mean = accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+
+	sort(samples.begin(), samples.end());
+
+	auto percentile = [&](unsigned int p) {
+		return samples[(samples.size() - 1) * p / 100];
+	};
+
+	result.p50 = percentile(50);
+	result.p90 = percentile(90);
+	result.p99 = percentile(99);
+	result.max = samples.back();
+
+	results_.push_back(result);
+}
+
+/*
+ * Write the results to <name>.json in the directory pointed to by the
+ * LIBCAMERA_BENCHMARK_OUTPUT environment variable, if set.
+ */
+int Benchmark::writeJson() const
+{
+	const char *dir = getenv("LIBCAMERA_BENCHMARK_OUTPUT");
+	if (!dir)
+		return TestPass;
+
+	string name = self().substr(self().find_last_of('/') + 1);
+	string path = string(dir) + "/" + name + ".json";
+
+	ofstream file(path);
+	if (!file) {
+		cerr << "Failed to open " << path << endl;
+		return TestFail;
+	}
+
+	file << fixed << setprecision(1);
+	file << "{" << endl
+	     << "  \"benchmark\": \"" << name << "\"," << endl
+	     << "  \"results\": [" << endl;
+
+	for (unsigned int i = 0; i < results_.size(); ++i) {
+		const Result &result = results_[i];
+
+		file << "    { \"name\": \"" << result.name << "\""
+		     << ", \"iterations\": " << result.iterations
+		     << ", \"mean_ns\": " << result.mean
+		     << ", \"p50_ns\": " << result.p50
+		     << ", \"p90_ns\": " << result.p90
+		     << ", \"p99_ns\": " << result.p99
+		     << ", \"max_ns\": " << result.max << " }"
+		     << (i + 1 < results_.size() ? "," : "") << endl;
+	}
+
+	file << "  ]" << endl
+	     << "}" << endl;
+
+	return file ? TestPass : TestFail;
+}
@@ -0,0 +1,78 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * benchmark.h - libcamera benchmark base class
+ */
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "test.h"
+
+class Benchmark : public Test
+{
+protected:
+	static constexpr unsigned int kWarmupSamples = 10;
+	static constexpr unsigned int kSamples = 100;
+
+	/*
+	 * Measure the duration of func(). The function is called batch times
+	 * per sample, to amortize the cost of reading the clock, and the
+	 * durations are reported per call.
+	 */
+	template<typename Func>
+	void measure(const std::string &name, Func func, unsigned int batch = 1000)
+	{
+		using clock = std::chrono::steady_clock;
+
+		std::vector<double> samples;
+		samples.reserve(kSamples);
+
+		for (unsigned int i = 0; i < kWarmupSamples + kSamples; ++i) {
+			clock::time_point begin = clock::now();
+
+			for (unsigned int j = 0; j < batch; ++j)
+				func();
+
+			clock::time_point end = clock::now();
+
+			if (i >= kWarmupSamples)
+				samples.push_back(std::chrono::duration<double, std::nano>(end - begin).count()
+						  / batch);
+		}
+
+		record(name, batch * kSamples, std::move(samples));
+	}
+
+	/* Prevent the compiler from optimizing away the computation of value. */
+	template<typename T>
+	static void doNotOptimize(const T &value)
+	{
+		asm volatile("" : : "m"(value) : "memory");
+	}
+
+	virtual int benchmark() = 0;
+
+private:
+	struct Result {
+		std::string name;
+		unsigned int iterations;
+		double mean;
+		double p50;
+		double p90;
+		double p99;
+		double max;
+	};
+
+	int run() override;
+
+	void record(const std::string &name, unsigned int iterations,
+		    std::vector<double> samples);
+	int writeJson() const;
+
+	std::vector<Result> results_;
+};
@@ -0,0 +1,105 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * libcamera virtual camera test base class
+ */
+
+#include "virtual_camera_test.h"
+
+#include <iostream>
+#include <stdlib.h>
+
+#include <libcamera/base/event_dispatcher.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/timer.h>
+
+using namespace libcamera;
+using namespace std;
+
+namespace {
+
+/*
+ * Describe the virtual cameras before the camera manager is started by the
+ * CameraTest constructor.
+ */
+const char *setupVirtualCameras(const char *cameras, const char *name)
+{
+	setenv("LIBCAMERA_VIRTUAL_CAMERAS", cameras, 1);
+	return name;
+}
+
+} /* namespace */
+
+VirtualCameraTest::VirtualCameraTest(const char *cameras, const char *name)
+	: CameraTest(setupVirtualCameras(cameras, name))
+{
+}
+
+int VirtualCameraTest::init()
+{
+	if (status_ != TestPass)
+		return status_;
+
+	config_ = camera_->generateConfiguration({ StreamRole::VideoRecording });
+	if (!config_ || config_->size() != 1) {
+		cout << "Failed to generate default configuration" << endl;
+		return TestFail;
+	}
+
+	allocator_ = make_unique<FrameBufferAllocator>(camera_);
+
+	return TestPass;
+}
+
+int VirtualCameraTest::configureCamera()
+{
+	if (camera_->acquire()) {
+		cout << "Failed to acquire the camera" << endl;
+		return TestFail;
+	}
+
+	if (camera_->configure(config_.get())) {
+		cout << "Failed to configure the camera" << endl;
+		return TestFail;
+	}
+
+	return TestPass;
+}
+
+int VirtualCameraTest::createRequests()
+{
+	Stream *stream = config_->at(0).stream();
+	if (allocator_->allocate(stream) < 0) {
+		cout << "Failed to allocate buffers" << endl;
+		return TestFail;
+	}
+
+	/* Use the request index as the cookie. */
+	for (const unique_ptr<FrameBuffer> &buffer : allocator_->buffers(stream)) {
+		unique_ptr<Request> request = camera_->createRequest(requests_.size());
+		if (!request) {
+			cout << "Failed to create request" << endl;
+			return TestFail;
+		}
+
+		if (request->addBuffer(stream, buffer.get())) {
+			cout << "Failed to associate buffer with request" << endl;
+			return TestFail;
+		}
+
+		requests_.push_back(std::move(request));
+	}
+
+	return TestPass;
+}
+
+void VirtualCameraTest::runCapture(std::chrono::milliseconds duration)
+{
+	EventDispatcher *dispatcher = Thread::current()->eventDispatcher();
+
+	Timer timer;
+	timer.start(duration);
+	while (timer.isRunning())
+		dispatcher->processEvents();
+}
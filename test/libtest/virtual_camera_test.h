@@ -0,0 +1,36 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * virtual_camera_test.h - libcamera virtual camera test base class
+ */
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include <libcamera/camera.h>
+#include <libcamera/framebuffer_allocator.h>
+#include <libcamera/request.h>
+
+#include "camera_test.h"
+#include "test.h"
+
+class VirtualCameraTest : public CameraTest, public Test
+{
+public:
+	VirtualCameraTest(const char *cameras, const char *name = "Virtual/0");
+
+protected:
+	int init() override;
+
+	int configureCamera();
+	int createRequests();
+	void runCapture(std::chrono::milliseconds duration);
+
+	std::unique_ptr<libcamera::CameraConfiguration> config_;
+	std::unique_ptr<libcamera::FrameBufferAllocator> allocator_;
+	std::vector<std::unique_ptr<libcamera::Request>> requests_;
+};
@@ -0,0 +1,223 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * object-invoke-alloc.cpp - Cross-thread invocation memory allocation test
+ */
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <numeric>
+#include <thread>
+
+#include <libcamera/base/object.h>
+#include <libcamera/base/signal.h>
+#include <libcamera/base/thread.h>
+
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+/*
+ * Count the memory allocations performed by threads that have enabled
+ * counting.
+ */
+static thread_local bool countAllocations = false;
+static std::atomic<unsigned int> allocations{ 0 };
+
+void *operator new(std::size_t size)
+{
+	if (countAllocations)
+		allocations++;
+
+	void *mem = std::malloc(size ? size : 1);
+	if (!mem)
+		throw std::bad_alloc();
+
+	return mem;
+}
+
+void operator delete(void *mem) noexcept
+{
+	std::free(mem);
+}
+
+void operator delete(void *mem, [[maybe_unused]] std::size_t size) noexcept
+{
+	std::free(mem);
+}
+
+namespace {
+
+struct LargeArgument {
+	std::array<unsigned int, 128> values;
+};
+
+class Receiver : public Object
+{
+public:
+	Receiver()
+		: calls_(0), sum_(0)
+	{
+	}
+
+	void method(unsigned int value)
+	{
+		sum_ += value;
+		calls_++;
+	}
+
+	void largeMethod(LargeArgument arg)
+	{
+		sum_ += std::accumulate(arg.values.begin(), arg.values.end(), 0u);
+		calls_++;
+	}
+
+	void stall()
+	{
+		this_thread::sleep_for(chrono::milliseconds(50));
+	}
+
+	unsigned int methodWithReturn(unsigned int value)
+	{
+		calls_++;
+		return value * 2;
+	}
+
+	unsigned int calls() const { return calls_.load(); }
+	unsigned int sum() const { return sum_.load(); }
+
+private:
+	std::atomic<unsigned int> calls_;
+	std::atomic<unsigned int> sum_;
+};
+
+class ObjectInvokeAllocTest : public Test
+{
+protected:
+	static constexpr unsigned int kBatch = 8;
+	static constexpr unsigned int kRounds = 20;
+
+	int init()
+	{
+		receiver_.moveToThread(&thread_);
+		signal_.connect(&receiver_, &Receiver::method);
+		thread_.start();
+
+		return TestPass;
+	}
+
+	/* Post a batch of invocations, and return the number of messages. */
+	unsigned int post()
+	{
+		for (unsigned int i = 0; i < kBatch; ++i) {
+			receiver_.invokeMethod(&Receiver::method,
+					       ConnectionTypeQueued, 1);
+			signal_.emit(1);
+		}
+
+		return kBatch * 2;
+	}
+
+	bool wait(unsigned int calls)
+	{
+		for (unsigned int i = 0; i < 1000; ++i) {
+			if (receiver_.calls() >= calls)
+				break;
+			this_thread::sleep_for(chrono::milliseconds(1));
+		}
+
+		/* Let the thread recycle the messages it has delivered. */
+		this_thread::sleep_for(chrono::milliseconds(10));
+
+		return receiver_.calls() == calls;
+	}
+
+	int run()
+	{
+		/*
+		 * Prime the message pools of the receiver thread with as many
+		 * messages as each round queues, by stalling the thread while
+		 * posting them.
+		 */
+		receiver_.invokeMethod(&Receiver::stall, ConnectionTypeQueued);
+		unsigned int expected = post();
+		receiver_.invokeMethod(&Receiver::methodWithReturn,
+				       ConnectionTypeBlocking, 0);
+		expected++;
+
+		if (!wait(expected)) {
+			cerr << "Failed to deliver messages" << endl;
+			return TestFail;
+		}
+
+		for (unsigned int i = 0; i < kRounds; ++i) {
+			countAllocations = true;
+			expected += post();
+
+			unsigned int ret = receiver_.invokeMethod(&Receiver::methodWithReturn,
+								  ConnectionTypeBlocking, i);
+			expected++;
+			countAllocations = false;
+
+			if (ret != i * 2) {
+				cerr << "Invalid return value " << ret << endl;
+				return TestFail;
+			}
+
+			if (!wait(expected)) {
+				cerr << "Failed to deliver messages" << endl;
+				return TestFail;
+			}
+		}
+
+		if (allocations) {
+			cerr << allocations << " allocations for "
+			     << kRounds * (kBatch * 2 + 1) << " invocations" << endl;
+			return TestFail;
+		}
+
+		/* Arguments that don't fit in the message shall be preserved. */
+		LargeArgument arg;
+		std::iota(arg.values.begin(), arg.values.end(), 0);
+
+		unsigned int sum = receiver_.sum();
+		receiver_.invokeMethod(&Receiver::largeMethod,
+				       ConnectionTypeQueued, arg);
+		expected++;
+
+		if (!wait(expected)) {
+			cerr << "Failed to deliver large argument" << endl;
+			return TestFail;
+		}
+
+		unsigned int expectedSum = std::accumulate(arg.values.begin(),
+							   arg.values.end(), sum);
+		if (receiver_.sum() != expectedSum) {
+			cerr << "Large argument corrupted" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	void cleanup()
+	{
+		thread_.exit(0);
+		thread_.wait();
+	}
+
+private:
+	Thread thread_;
+	Receiver receiver_;
+	Signal<unsigned int> signal_;
+};
+
+} /* namespace */
+
+TEST_REGISTER(ObjectInvokeAllocTest)
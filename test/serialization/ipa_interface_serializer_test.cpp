@@ -0,0 +1,208 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * ipa_interface_serializer_test.cpp - Test the IPA interfaces serializers
+ */
+
+#include <fcntl.h>
+#include <iostream>
+#include <map>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
+
+#include <libcamera/base/shared_fd.h>
+#include <libcamera/base/unique_fd.h>
+
+#include <libcamera/control_ids.h>
+
+#include <libcamera/ipa/core_ipa_serializer.h>
+#include <libcamera/ipa/ipu3_ipa_serializer.h>
+#include <libcamera/ipa/raspberrypi_ipa_serializer.h>
+
+#include "libcamera/internal/control_serializer.h"
+#include "libcamera/internal/ipa_data_serializer.h"
+
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+static constexpr unsigned int kNumBuffers = 8;
+
+class IPAInterfaceSerializerTest : public Test
+{
+protected:
+	int init() override
+	{
+		infoMap_ = ControlInfoMap({
+				{ &controls::AeEnable, ControlInfo(false, true) },
+				{ &controls::ExposureTime, ControlInfo(0, 999999) },
+				{ &controls::AnalogueGain, ControlInfo(1.0f, 32.0f) },
+				{ &controls::ColourGains, ControlInfo(0.0f, 32.0f) },
+				{ &controls::Brightness, ControlInfo(-1.0f, 1.0f) },
+				{ &controls::Contrast, ControlInfo(0.0f, 32.0f) },
+				{ &controls::Saturation, ControlInfo(0.0f, 32.0f) },
+			}, controls::controls);
+
+		fd_ = SharedFD(UniqueFD(open("/dev/null", O_RDONLY | O_CLOEXEC)));
+		if (!fd_.isValid()) {
+			cerr << "Failed to open /dev/null" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	ControlList makeControls()
+	{
+		ControlList ctrls(infoMap_);
+		ctrls.set(controls::AeEnable, true);
+		ctrls.set(controls::ExposureTime, 33000);
+		ctrls.set(controls::AnalogueGain, 4.0f);
+		ctrls.set(controls::ColourGains, Span<const float, 2>({ 1.5f, 1.8f }));
+		ctrls.set(controls::Brightness, 0.25f);
+		return ctrls;
+	}
+
+	/*
+	 * Serialize \a in after existing data in the buffers, and deserialize it
+	 * to \a out. The size must match the output of the allocating API.
+	 */
+	template<typename T>
+	bool roundTrip(const T &in, T *out)
+	{
+		ControlSerializer serializer(ControlSerializer::Role::Proxy);
+		std::vector<uint8_t> data;
+		std::vector<SharedFD> fds;
+
+		std::tie(data, fds) = IPADataSerializer<T>::serialize(in, &serializer);
+
+		ControlSerializer appendSerializer(ControlSerializer::Role::Proxy);
+		ControlSerializer deserializer(ControlSerializer::Role::Worker);
+		std::vector<uint8_t> appended = { 0xca, 0xfe };
+		std::vector<SharedFD> appendedFds = { fd_ };
+
+		IPADataSerializer<T>::serialize(in, appended, appendedFds,
+						&appendSerializer);
+
+		if (appended.size() != data.size() + 2 ||
+		    appendedFds.size() != fds.size() + 1)
+			return false;
+
+		*out = IPADataSerializer<T>::deserialize(appended.cbegin() + 2,
+							 appended.cend(),
+							 appendedFds.cbegin() + 1,
+							 appendedFds.cend(),
+							 &deserializer);
+
+		return true;
+	}
+
+	int run() override
+	{
+		/* IPU3 */
+		ipa::ipu3::IPU3Event event;
+		event.op = ipa::ipu3::EventStatReady;
+		event.frame = 42;
+		event.frameTimestamp = 123456789;
+		event.bufferId = 3;
+		event.controls = makeControls();
+		event.sensorControls = makeControls();
+		event.lensControls = makeControls();
+
+		ipa::ipu3::IPU3Event event2;
+		if (!roundTrip(event, &event2) || event2.frame != 42 ||
+		    event2.frameTimestamp != 123456789 ||
+		    event2.sensorControls.get(controls::ExposureTime) != 33000) {
+			cerr << "IPU3Event serialization failed" << endl;
+			return TestFail;
+		}
+
+		ipa::ipu3::IPAConfigInfo configInfo;
+		configInfo.sensorInfo.model = "imx258";
+		configInfo.sensorInfo.outputSize = Size(4096, 3072);
+		configInfo.sensorControls = infoMap_;
+		configInfo.lensControls = infoMap_;
+		configInfo.bdsOutputSize = Size(2560, 1920);
+		configInfo.iif = Size(4096, 3072);
+
+		ipa::ipu3::IPAConfigInfo configInfo2;
+		if (!roundTrip(configInfo, &configInfo2) ||
+		    configInfo2.sensorInfo.model != "imx258" ||
+		    configInfo2.bdsOutputSize != Size(2560, 1920) ||
+		    configInfo2.sensorControls.size() != infoMap_.size()) {
+			cerr << "IPAConfigInfo serialization failed" << endl;
+			return TestFail;
+		}
+
+		/* RkISP1 */
+		std::map<uint32_t, IPAStream> streamConfig = {
+			{ 1, IPAStream(0x1234, Size(1920, 1080)) },
+			{ 2, IPAStream(0x5678, Size(640, 480)) },
+		};
+
+		std::map<uint32_t, IPAStream> streamConfig2;
+		if (!roundTrip(streamConfig, &streamConfig2) ||
+		    streamConfig2.size() != 2 ||
+		    streamConfig2[2].size != Size(640, 480)) {
+			cerr << "IPAStream map serialization failed" << endl;
+			return TestFail;
+		}
+
+		/* Raspberry Pi */
+		ipa::RPi::ISPConfig ispConfig;
+		ispConfig.embeddedBufferId = 1;
+		ispConfig.bayerBufferId = 2;
+		ispConfig.embeddedBufferPresent = true;
+		ispConfig.controls = makeControls();
+
+		ipa::RPi::ISPConfig ispConfig2;
+		if (!roundTrip(ispConfig, &ispConfig2) ||
+		    ispConfig2.embeddedBufferId != 1 || ispConfig2.bayerBufferId != 2 ||
+		    !ispConfig2.embeddedBufferPresent ||
+		    ispConfig2.controls.get(controls::ExposureTime) != 33000) {
+			cerr << "ISPConfig serialization failed" << endl;
+			return TestFail;
+		}
+
+		ipa::RPi::IPAConfig ipaConfig;
+		ipaConfig.transform = 3;
+		ipaConfig.lsTableHandle = fd_;
+
+		ipa::RPi::IPAConfig ipaConfig2;
+		if (!roundTrip(ipaConfig, &ipaConfig2) ||
+		    ipaConfig2.transform != 3 || !ipaConfig2.lsTableHandle.isValid()) {
+			cerr << "IPAConfig serialization failed" << endl;
+			return TestFail;
+		}
+
+		/* Buffers mapping, common to all IPA modules. */
+		std::vector<IPABuffer> buffers;
+		for (unsigned int i = 0; i < kNumBuffers; i++) {
+			FrameBuffer::Plane plane;
+			plane.fd = fd_;
+			plane.offset = 0;
+			plane.length = 4096;
+			buffers.emplace_back(i, std::vector<FrameBuffer::Plane>{ plane });
+		}
+
+		std::vector<IPABuffer> buffers2;
+		if (!roundTrip(buffers, &buffers2) ||
+		    buffers2.size() != kNumBuffers ||
+		    buffers2.back().id != kNumBuffers - 1 ||
+		    buffers2.back().planes[0].length != 4096) {
+			cerr << "IPABuffer vector serialization failed" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+private:
+	ControlInfoMap infoMap_;
+	SharedFD fd_;
+};
+
+TEST_REGISTER(IPAInterfaceSerializerTest)
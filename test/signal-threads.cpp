@@ -5,6 +5,7 @@
  * signal-threads.cpp - Cross-thread signal delivery test
  */
 
+#include <atomic>
 #include <chrono>
 #include <iostream>
 #include <thread>
@@ -55,6 +56,25 @@ private:
 	int value_;
 };
 
+class SignalCounter
+{
+public:
+	SignalCounter()
+		: count_(0)
+	{
+	}
+
+	unsigned int count() const { return count_.load(); }
+
+	void slot(int value)
+	{
+		count_.fetch_add(value, std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<unsigned int> count_;
+};
+
 class SignalThreadsTest : public Test
 {
 protected:
@@ -108,6 +128,40 @@ protected:
 			return TestFail;
 		}
 
+		/*
+		 * Emit a signal continuously from a thread while connecting and
+		 * disconnecting slots from the main thread. The slot connected
+		 * permanently must receive all emissions.
+		 */
+		Signal<int> signal;
+		SignalCounter permanent;
+		SignalCounter transient;
+
+		signal.connect(&permanent, &SignalCounter::slot);
+
+		std::atomic<bool> stop = false;
+		unsigned int emissions = 0;
+
+		std::thread emitter([&]() {
+			while (!stop.load()) {
+				signal.emit(1);
+				emissions++;
+			}
+		});
+
+		for (unsigned int i = 0; i < 10000; ++i) {
+			signal.connect(&transient, &SignalCounter::slot);
+			signal.disconnect(&transient, &SignalCounter::slot);
+		}
+
+		stop = true;
+		emitter.join();
+
+		if (permanent.count() != emissions) {
+			cout << "Signal emissions lost while connecting slots" << endl;
+			return TestFail;
+		}
+
 		return TestPass;
 	}
 
@@ -184,6 +184,22 @@ protected:
 			return TestFail;
 		}
 
+		/* Test deletion of the signal from a slot. */
+		Signal<> *signal = new Signal<>();
+		signal->connect(this, [&signal]() {
+			delete signal;
+			signal = nullptr;
+		});
+		signal->connect(this, &SignalTest::slotVoid);
+
+		called_ = false;
+		signal->emit();
+
+		if (signal || !called_) {
+			cout << "Signal deletion from slot test failed" << endl;
+			return TestFail;
+		}
+
 		/*
 		 * Test connecting to slots that return a value. This targets
 		 * compilation, there's no need to check runtime results.
@@ -0,0 +1,233 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * stats-capture.cpp - Statistics capture file tests
+ */
+
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+#include <libcamera/base/shared_fd.h>
+#include <libcamera/base/unique_fd.h>
+
+#include <libcamera/control_ids.h>
+#include <libcamera/framebuffer.h>
+
+#include <libcamera/ipa/core_ipa_serializer.h>
+
+#include "libcamera/internal/byte_stream_buffer.h"
+#include "libcamera/internal/control_serializer.h"
+#include "libcamera/internal/stats_capture.h"
+
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+class StatsCaptureTest : public Test
+{
+protected:
+	static constexpr unsigned int kNumFrames = 4;
+	static constexpr size_t kBufferSize = 4096;
+
+	int init()
+	{
+		fileName_ = "/tmp/libcamera.test.XXXXXX";
+		int fd = mkstemp(&fileName_.front());
+		if (fd == -1)
+			return TestFail;
+
+		close(fd);
+		unlink(fileName_.c_str());
+
+		UniqueFD memfd(memfd_create("stats-capture", MFD_CLOEXEC));
+		if (!memfd.isValid() || ftruncate(memfd.get(), kBufferSize) < 0)
+			return TestFail;
+
+		void *mem = mmap(nullptr, kBufferSize, PROT_READ | PROT_WRITE,
+				 MAP_SHARED, memfd.get(), 0);
+		if (mem == MAP_FAILED)
+			return TestFail;
+
+		mem_ = static_cast<uint8_t *>(mem);
+
+		FrameBuffer::Plane plane;
+		plane.fd = SharedFD(std::move(memfd));
+		plane.offset = 0;
+		plane.length = kBufferSize;
+		buffer_ = std::make_unique<FrameBuffer>(std::vector<FrameBuffer::Plane>{ plane });
+
+		return TestPass;
+	}
+
+	int writeCapture()
+	{
+		StatsCaptureWriter writer;
+
+		if (writer.open(fileName_, "PipelineHandlerTest")) {
+			cerr << "Failed to create capture file" << endl;
+			return TestFail;
+		}
+
+		if (writer.open(fileName_, "PipelineHandlerTest") != -EEXIST) {
+			cerr << "Existing capture file not detected" << endl;
+			return TestFail;
+		}
+
+		if (writer.open(fileName_ + ".new", "PipelineHandlerTest")) {
+			cerr << "Failed to reopen capture file" << endl;
+			return TestFail;
+		}
+
+		IPACameraSensorInfo sensorInfo{};
+		sensorInfo.model = "test-sensor";
+		sensorInfo.outputSize = Size(1920, 1080);
+		writer.writeSensorInfo(sensorInfo);
+		writer.writeControlInfo(0, infoMap_);
+
+		const uint32_t config[] = { 1, 2, 3 };
+		writer.writePipelineConfig(config);
+
+		for (unsigned int i = 0; i < kNumFrames; ++i) {
+			ControlList controls(infoMap_);
+			controls.set(controls::Brightness, 0.25f * i);
+
+			memset(mem_, i, kBufferSize);
+
+			writer.writeSensorControls(i, i * 1000, controls);
+			writer.writeBuffer(StatsCaptureRecordType::Statistics,
+					   i, i * 1000, buffer_.get());
+		}
+
+		writer.close();
+
+		if (writer.dropped()) {
+			cerr << "Records dropped" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int readCapture()
+	{
+		StatsCaptureReader reader;
+		ControlSerializer serializer(ControlSerializer::Role::Worker);
+		StatsCaptureRecord record;
+
+		if (reader.open(fileName_ + ".new")) {
+			cerr << "Failed to open capture file" << endl;
+			return TestFail;
+		}
+
+		if (reader.pipeline() != "PipelineHandlerTest") {
+			cerr << "Invalid pipeline name " << reader.pipeline() << endl;
+			return TestFail;
+		}
+
+		if (reader.read(&record) ||
+		    record.type != StatsCaptureRecordType::SensorInfo) {
+			cerr << "Failed to read sensor info" << endl;
+			return TestFail;
+		}
+
+		IPACameraSensorInfo sensorInfo =
+			IPADataSerializer<IPACameraSensorInfo>::deserialize(record.data);
+		if (sensorInfo.model != "test-sensor" ||
+		    sensorInfo.outputSize != Size(1920, 1080)) {
+			cerr << "Invalid sensor info" << endl;
+			return TestFail;
+		}
+
+		if (reader.read(&record) ||
+		    record.type != StatsCaptureRecordType::ControlInfo ||
+		    record.sequence != 0) {
+			cerr << "Failed to read control info" << endl;
+			return TestFail;
+		}
+
+		const std::vector<uint8_t> &infoData = record.data;
+		ByteStreamBuffer infoBuffer(infoData.data(), infoData.size());
+		ControlInfoMap infoMap = serializer.deserialize<ControlInfoMap>(infoBuffer);
+		if (infoMap.size() != infoMap_.size()) {
+			cerr << "Invalid control info" << endl;
+			return TestFail;
+		}
+
+		if (reader.read(&record) ||
+		    record.type != StatsCaptureRecordType::PipelineConfig ||
+		    record.data.size() != 3 * sizeof(uint32_t)) {
+			cerr << "Failed to read pipeline configuration" << endl;
+			return TestFail;
+		}
+
+		for (unsigned int i = 0; i < kNumFrames; ++i) {
+			if (reader.read(&record) ||
+			    record.type != StatsCaptureRecordType::SensorControls ||
+			    record.sequence != i || record.timestamp != i * 1000) {
+				cerr << "Failed to read sensor controls " << i << endl;
+				return TestFail;
+			}
+
+			const std::vector<uint8_t> &data = record.data;
+			ByteStreamBuffer buffer(data.data(), data.size());
+			ControlList controls = serializer.deserialize<ControlList>(buffer);
+			if (controls.get(controls::Brightness) != 0.25f * i) {
+				cerr << "Invalid sensor controls " << i << endl;
+				return TestFail;
+			}
+
+			if (reader.read(&record) ||
+			    record.type != StatsCaptureRecordType::Statistics ||
+			    record.sequence != i || record.data.size() != kBufferSize) {
+				cerr << "Failed to read statistics " << i << endl;
+				return TestFail;
+			}
+
+			if (record.data.front() != i || record.data.back() != i) {
+				cerr << "Invalid statistics " << i << endl;
+				return TestFail;
+			}
+		}
+
+		if (reader.read(&record) != -ENODATA) {
+			cerr << "Unexpected record at end of file" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int run()
+	{
+		int ret = writeCapture();
+		if (ret != TestPass)
+			return ret;
+
+		return readCapture();
+	}
+
+	void cleanup()
+	{
+		if (mem_)
+			munmap(mem_, kBufferSize);
+
+		unlink(fileName_.c_str());
+		unlink((fileName_ + ".new").c_str());
+	}
+
+private:
+	string fileName_;
+	uint8_t *mem_ = nullptr;
+	std::unique_ptr<FrameBuffer> buffer_;
+
+	ControlInfoMap infoMap_{ { { &controls::Brightness, ControlInfo(-1.0f, 1.0f) } },
+				 controls::controls };
+};
+
+TEST_REGISTER(StatsCaptureTest)
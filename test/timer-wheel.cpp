@@ -0,0 +1,143 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * timer-wheel.cpp - Timer wheel test
+ */
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <libcamera/base/event_dispatcher.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/timer.h>
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+using namespace std::chrono_literals;
+
+namespace {
+
+class RecordingTimer : public Timer
+{
+public:
+	RecordingTimer(vector<RecordingTimer *> *expired)
+		: expired_(expired)
+	{
+		timeout.connect(this, &RecordingTimer::timeoutHandler);
+	}
+
+	chrono::steady_clock::time_point expiration() const { return expiration_; }
+
+private:
+	void timeoutHandler()
+	{
+		expiration_ = chrono::steady_clock::now();
+		expired_->push_back(this);
+	}
+
+	vector<RecordingTimer *> *expired_;
+	chrono::steady_clock::time_point expiration_;
+};
+
+class TimerWheelTest : public Test
+{
+protected:
+	int run() override
+	{
+		EventDispatcher *dispatcher = Thread::current()->eventDispatcher();
+
+		/*
+		 * Start timers with random deadlines spanning several levels of
+		 * the wheel, and stop some of them. The remaining timers must
+		 * expire exactly once, in order, and never early. How late they
+		 * expire depends on the system load and isn't checked.
+		 */
+		std::mt19937 gen(42);
+		std::uniform_int_distribution<unsigned int> dist(0, 300);
+
+		vector<RecordingTimer *> expired;
+		vector<unique_ptr<RecordingTimer>> timers;
+		unsigned int expected = 0;
+
+		auto now = chrono::steady_clock::now();
+
+		for (unsigned int i = 0; i < 500; ++i) {
+			timers.push_back(make_unique<RecordingTimer>(&expired));
+			timers.back()->start(now + chrono::milliseconds(dist(gen)));
+		}
+
+		for (unsigned int i = 0; i < timers.size(); ++i) {
+			if (i % 5 == 0)
+				timers[i]->stop();
+			else
+				expected++;
+		}
+
+		/* Deadlines in the past expire immediately. */
+		timers.push_back(make_unique<RecordingTimer>(&expired));
+		timers.back()->start(now - 1s);
+		expected++;
+
+		/* Deadlines beyond the range of the wheel are supported. */
+		RecordingTimer distant(&expired);
+		distant.start(chrono::steady_clock::time_point::max());
+
+		auto timeout = chrono::steady_clock::now() + 10s;
+		while (expired.size() < expected &&
+		       chrono::steady_clock::now() < timeout)
+			dispatcher->processEvents();
+
+		if (!distant.isRunning()) {
+			cout << "Distant timer stopped" << endl;
+			return TestFail;
+		}
+
+		distant.stop();
+
+		if (expired.size() != expected) {
+			cout << "Expected " << expected << " timeouts, got "
+			     << expired.size() << endl;
+			return TestFail;
+		}
+
+		for (unsigned int i = 0; i < expired.size(); ++i) {
+			RecordingTimer *timer = expired[i];
+
+			if (timer->isRunning()) {
+				cout << "Timer still running after timeout" << endl;
+				return TestFail;
+			}
+
+			if (timer->expiration() < timer->deadline()) {
+				cout << "Timer expired early" << endl;
+				return TestFail;
+			}
+
+			if (i && timer->deadline() < expired[i - 1]->deadline()) {
+				cout << "Timers expired out of order" << endl;
+				return TestFail;
+			}
+		}
+
+		for (unsigned int i = 0; i < 500; i += 5) {
+			for (RecordingTimer *timer : expired) {
+				if (timer == timers[i].get()) {
+					cout << "Stopped timer expired" << endl;
+					return TestFail;
+				}
+			}
+		}
+
+		return TestPass;
+	}
+};
+
+} /* namespace */
+
+TEST_REGISTER(TimerWheelTest)
@@ -0,0 +1,167 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * libcamera V4L2 subdevice format cache test
+ */
+
+#include <iostream>
+#include <memory>
+
+#include <libcamera/geometry.h>
+
+#include "libcamera/internal/v4l2_subdevice.h"
+
+#include "v4l2_subdevice_test.h"
+
+using namespace std;
+using namespace libcamera;
+
+/* Test format caching on the "Scaler" subdevice of vimc media device. */
+
+class FormatCacheTest : public V4L2SubdeviceTest
+{
+protected:
+	int init() override;
+	int run() override;
+	void cleanup() override;
+
+private:
+	int setScalerFormat(const Size &size);
+	int setOtherFormat(const Size &size);
+	bool checkFormat(const Size &size);
+
+	unique_ptr<V4L2Subdevice> other_;
+	V4L2SubdeviceFormat format_;
+};
+
+int FormatCacheTest::init()
+{
+	int ret = V4L2SubdeviceTest::init();
+	if (ret)
+		return ret;
+
+	/*
+	 * Simulate another user of the subdevice with a second instance opened
+	 * on the same subdevice node.
+	 */
+	other_ = make_unique<V4L2Subdevice>(scaler_->entity());
+	if (other_->open())
+		return TestFail;
+
+	if (scaler_->getFormat(0, &format_))
+		return TestFail;
+
+	return TestPass;
+}
+
+int FormatCacheTest::setScalerFormat(const Size &size)
+{
+	V4L2SubdeviceFormat format = format_;
+	format.size = size;
+
+	return scaler_->setFormat(0, &format);
+}
+
+/* Set the sink pad format through another file handle. */
+int FormatCacheTest::setOtherFormat(const Size &size)
+{
+	V4L2SubdeviceFormat format = format_;
+	format.size = size;
+
+	return other_->setFormat(0, &format);
+}
+
+/* Check the sink pad format through another file handle. */
+bool FormatCacheTest::checkFormat(const Size &size)
+{
+	V4L2SubdeviceFormat format = {};
+	if (other_->getFormat(0, &format))
+		return false;
+
+	return format.size == size;
+}
+
+int FormatCacheTest::run()
+{
+	const Size large(640, 480);
+	const Size small(320, 240);
+
+	if (setScalerFormat(large) || !checkFormat(large)) {
+		cerr << "Failed to set format" << endl;
+		return TestFail;
+	}
+
+	/*
+	 * The format is cached, as libcamera is assumed to be the only user of
+	 * the subdevice while the media device is locked. A format change by
+	 * another user is thus not noticed.
+	 */
+	if (setOtherFormat(small)) {
+		cerr << "Failed to set format through other handle" << endl;
+		return TestFail;
+	}
+
+	if (setScalerFormat(large) || !checkFormat(small)) {
+		cerr << "Format not cached" << endl;
+		return TestFail;
+	}
+
+	/* Setting a selection rectangle drops the cache. */
+	Rectangle crop(small);
+	if (scaler_->setSelection(0, V4L2_SEL_TGT_CROP, &crop)) {
+		cerr << "Failed to set crop rectangle" << endl;
+		return TestFail;
+	}
+
+	if (setScalerFormat(large) || !checkFormat(large)) {
+		cerr << "Format cache not dropped by selection" << endl;
+		return TestFail;
+	}
+
+	/* So does locking the media device. */
+	if (setOtherFormat(small)) {
+		cerr << "Failed to set format through other handle" << endl;
+		return TestFail;
+	}
+
+	if (!media_->acquire() || !media_->lock()) {
+		cerr << "Failed to lock media device" << endl;
+		return TestFail;
+	}
+
+	media_->unlock();
+	media_->release();
+
+	if (setScalerFormat(large) || !checkFormat(large)) {
+		cerr << "Format cache not dropped by media device lock" << endl;
+		return TestFail;
+	}
+
+	/* And closing the subdevice, which bumps its layout generation. */
+	if (setOtherFormat(small)) {
+		cerr << "Failed to set format through other handle" << endl;
+		return TestFail;
+	}
+
+	scaler_->close();
+	if (scaler_->open()) {
+		cerr << "Failed to reopen subdevice" << endl;
+		return TestFail;
+	}
+
+	if (setScalerFormat(large) || !checkFormat(large)) {
+		cerr << "Format cache not dropped by closing the subdevice" << endl;
+		return TestFail;
+	}
+
+	return TestPass;
+}
+
+void FormatCacheTest::cleanup()
+{
+	other_.reset();
+	V4L2SubdeviceTest::cleanup();
+}
+
+TEST_REGISTER(FormatCacheTest)
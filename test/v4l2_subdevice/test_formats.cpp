@@ -72,6 +72,52 @@ int FormatHandlingTest::run()
 		return TestFail;
 	}
 
+	/*
+	 * Setting the same format twice shall return the same adjusted format,
+	 * and setting the sink pad format shall not leave a stale format cached
+	 * on the source pad.
+	 */
+	V4L2SubdeviceFormat sourceFormat = {};
+	ret = scaler_->getFormat(1, &sourceFormat);
+	if (ret) {
+		cerr << "Failed to get source format" << endl;
+		return TestFail;
+	}
+
+	for (unsigned int i = 0; i < 2; ++i) {
+		V4L2SubdeviceFormat sinkFormat = format;
+		sinkFormat.size = { 640 * (i + 1), 480 * (i + 1) };
+		ret = scaler_->setFormat(0, &sinkFormat);
+		if (ret) {
+			cerr << "Failed to set sink format" << endl;
+			return TestFail;
+		}
+
+		V4L2SubdeviceFormat requested = sourceFormat;
+		ret = scaler_->setFormat(1, &requested);
+		if (ret) {
+			cerr << "Failed to set source format" << endl;
+			return TestFail;
+		}
+
+		V4L2SubdeviceFormat cached = sourceFormat;
+		ret = scaler_->setFormat(1, &cached);
+		if (ret || cached.size != requested.size ||
+		    cached.mbus_code != requested.mbus_code) {
+			cerr << "Cached format differs from applied format" << endl;
+			return TestFail;
+		}
+
+		V4L2SubdeviceFormat current = {};
+		ret = scaler_->getFormat(1, &current);
+		if (ret || current.size != cached.size ||
+		    current.mbus_code != cached.mbus_code) {
+			cerr << "Stale source format returned after propagation"
+			     << endl;
+			return TestFail;
+		}
+	}
+
 	return TestPass;
 }
 
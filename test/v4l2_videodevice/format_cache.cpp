@@ -0,0 +1,157 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * libcamera V4L2 video device format cache test
+ */
+
+#include <iostream>
+#include <memory>
+
+#include "libcamera/internal/v4l2_videodevice.h"
+
+#include "v4l2_videodevice_test.h"
+
+using namespace std;
+using namespace libcamera;
+
+namespace {
+
+class FormatCache : public V4L2VideoDeviceTest
+{
+public:
+	FormatCache()
+		: V4L2VideoDeviceTest("vimc", "Raw Capture 0") {}
+
+protected:
+	/* Set the format of the device through another file handle. */
+	int setOtherFormat(const Size &size)
+	{
+		V4L2DeviceFormat format = format_;
+		format.size = size;
+
+		return other_->setFormat(&format);
+	}
+
+	/* Check the format of the device through another file handle. */
+	bool checkFormat(const Size &size)
+	{
+		V4L2DeviceFormat format = {};
+		if (other_->getFormat(&format))
+			return false;
+
+		return format.size == size;
+	}
+
+	int init() override
+	{
+		int ret = V4L2VideoDeviceTest::init();
+		if (ret != TestPass)
+			return ret;
+
+		/*
+		 * Simulate another user of the device with a second instance
+		 * opened on the same video node.
+		 */
+		other_ = make_unique<V4L2VideoDevice>(media_->getEntityByName(entity_));
+		if (other_->open())
+			return TestFail;
+
+		if (capture_->getFormat(&format_))
+			return TestFail;
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		const Size large(640, 480);
+		const Size small(320, 240);
+
+		/* Setting the same format twice returns the applied format. */
+		V4L2DeviceFormat format = format_;
+		format.size = large;
+		if (capture_->setFormat(&format)) {
+			cerr << "Failed to set format" << endl;
+			return TestFail;
+		}
+
+		V4L2DeviceFormat applied = format;
+		format = format_;
+		format.size = large;
+		if (capture_->setFormat(&format) || format.size != applied.size ||
+		    format.fourcc != applied.fourcc ||
+		    format.planes[0].bpl != applied.planes[0].bpl) {
+			cerr << "Cached format differs from applied format" << endl;
+			return TestFail;
+		}
+
+		/*
+		 * The format is cached, as libcamera is assumed to be the only
+		 * user of the device while the media device is locked. A format
+		 * change by another user is thus not noticed.
+		 */
+		if (setOtherFormat(small)) {
+			cerr << "Failed to set format through other handle" << endl;
+			return TestFail;
+		}
+
+		format = format_;
+		format.size = large;
+		if (capture_->setFormat(&format) || !checkFormat(small)) {
+			cerr << "Format not cached" << endl;
+			return TestFail;
+		}
+
+		/* Locking the media device drops the cache. */
+		if (!media_->acquire() || !media_->lock()) {
+			cerr << "Failed to lock media device" << endl;
+			return TestFail;
+		}
+
+		media_->unlock();
+		media_->release();
+
+		format = format_;
+		format.size = large;
+		if (capture_->setFormat(&format) || !checkFormat(large)) {
+			cerr << "Format cache not dropped by media device lock" << endl;
+			return TestFail;
+		}
+
+		/* So does closing the device. */
+		if (setOtherFormat(small)) {
+			cerr << "Failed to set format through other handle" << endl;
+			return TestFail;
+		}
+
+		capture_->close();
+		if (capture_->open()) {
+			cerr << "Failed to reopen device" << endl;
+			return TestFail;
+		}
+
+		format = format_;
+		format.size = large;
+		if (capture_->setFormat(&format) || !checkFormat(large)) {
+			cerr << "Format cache not dropped by closing the device" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	void cleanup() override
+	{
+		other_.reset();
+		V4L2VideoDeviceTest::cleanup();
+	}
+
+private:
+	unique_ptr<V4L2VideoDevice> other_;
+	V4L2DeviceFormat format_;
+};
+
+} /* namespace */
+
+TEST_REGISTER(FormatCache)
@@ -0,0 +1,131 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * libcamera V4L2 API tests
+ *
+ * Validate that the UnderrunGuard keeps the device streaming when no buffer
+ * is queued
+ */
+
+#include <iostream>
+
+#include <libcamera/framebuffer.h>
+
+#include <libcamera/base/event_dispatcher.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/timer.h>
+
+#include "libcamera/internal/underrun_guard.h"
+
+#include "v4l2_videodevice_test.h"
+
+using namespace libcamera;
+using namespace std::chrono_literals;
+
+class UnderrunGuardTest : public V4L2VideoDeviceTest
+{
+public:
+	UnderrunGuardTest()
+		: V4L2VideoDeviceTest("vimc", "Raw Capture 0"), frames_(0),
+		  scratchFrames_(0)
+	{
+	}
+
+	void receiveBuffer(FrameBuffer *buffer)
+	{
+		if (guard_->bufferReady(buffer)) {
+			scratchFrames_++;
+			return;
+		}
+
+		frames_++;
+	}
+
+protected:
+	int run()
+	{
+		const unsigned int bufferCount = 4;
+
+		EventDispatcher *dispatcher = Thread::current()->eventDispatcher();
+		Timer timeout;
+		int ret;
+
+		ret = capture_->exportBuffers(bufferCount, &buffers_);
+		if (ret < 0) {
+			std::cout << "Failed to export buffers" << std::endl;
+			return TestFail;
+		}
+
+		guard_ = std::make_unique<UnderrunGuard>(capture_);
+
+		ret = guard_->start(bufferCount);
+		if (ret < 0) {
+			std::cout << "Failed to start the underrun guard" << std::endl;
+			return TestFail;
+		}
+
+		capture_->bufferReady.connect(this, &UnderrunGuardTest::receiveBuffer);
+
+		/* Queue the buffers once, the guard must take over afterwards. */
+		for (const std::unique_ptr<FrameBuffer> &buffer : buffers_) {
+			if (guard_->queueBuffer(buffer.get())) {
+				std::cout << "Failed to queue buffer" << std::endl;
+				return TestFail;
+			}
+		}
+
+		ret = capture_->streamOn();
+		if (ret)
+			return TestFail;
+
+		timeout.start(10000ms);
+		while (timeout.isRunning()) {
+			dispatcher->processEvents();
+			if (scratchFrames_ > 10)
+				break;
+		}
+
+		if (frames_ != bufferCount) {
+			std::cout << "Captured " << frames_ << " frames, expected "
+				  << bufferCount << std::endl;
+			return TestFail;
+		}
+
+		if (scratchFrames_ <= 10) {
+			std::cout << "Capture stalled after running out of buffers"
+				  << std::endl;
+			return TestFail;
+		}
+
+		/* Queued buffers must be used again once available. */
+		if (guard_->queueBuffer(buffers_[0].get())) {
+			std::cout << "Failed to queue buffer" << std::endl;
+			return TestFail;
+		}
+
+		timeout.start(1000ms);
+		while (timeout.isRunning() && frames_ == bufferCount)
+			dispatcher->processEvents();
+
+		if (frames_ != bufferCount + 1) {
+			std::cout << "Failed to capture after an underrun" << std::endl;
+			return TestFail;
+		}
+
+		ret = capture_->streamOff();
+		if (ret)
+			return TestFail;
+
+		guard_->stop();
+
+		return TestPass;
+	}
+
+private:
+	std::unique_ptr<UnderrunGuard> guard_;
+	unsigned int frames_;
+	unsigned int scratchFrames_;
+};
+
+TEST_REGISTER(UnderrunGuardTest)